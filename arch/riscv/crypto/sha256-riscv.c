@@ -0,0 +1,287 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * sha256-riscv.c - SHA-224/SHA-256 using RISC-V scalar crypto/bitmanip
+ *
+ * Two block functions are provided:
+ *  - Zknh: the Sigma/sigma functions are single sha256sum/sha256sig
+ *    instructions
+ *  - Zbb: the rotates are single ror instructions and Ch() uses andn
+ *
+ * The variant is picked at runtime from the ISA string of the harts in
+ * the device tree, with Zknh preferred. If neither extension is present
+ * on all harts, nothing is registered and the generic implementation
+ * is used.
+ *
+ * The instructions are emitted with .insn, so no assembler support for
+ * the extensions is required.
+ */
+
+#include <common.h>
+#include <digest.h>
+#include <init.h>
+#include <of.h>
+#include <crypto/sha.h>
+#include <crypto/sha256_base.h>
+#include <crypto/internal.h>
+#include <asm/unaligned.h>
+
+#define sha256_zknh_op(imm, x) ({					\
+	unsigned long __r;						\
+	asm (".insn i 0x13, 0x1, %0, %1, " #imm				\
+	     : "=r" (__r) : "r" (x));					\
+	(u32)__r;							\
+})
+
+/* sha256sum0, sha256sum1, sha256sig0, sha256sig1 */
+#define zknh_S0(x)	sha256_zknh_op(0x100, x)
+#define zknh_S1(x)	sha256_zknh_op(0x101, x)
+#define zknh_s0(x)	sha256_zknh_op(0x102, x)
+#define zknh_s1(x)	sha256_zknh_op(0x103, x)
+
+/* 32-bit rotate right: roriw on RV64, rori on RV32 */
+#ifdef CONFIG_64BIT
+#define ZBB_RORI32_OPCODE	"0x1b"
+#else
+#define ZBB_RORI32_OPCODE	"0x13"
+#endif
+
+#define zbb_ror32(x, n) ({						\
+	unsigned long __r;						\
+	asm (".insn i " ZBB_RORI32_OPCODE ", 0x5, %0, %1, %2"		\
+	     : "=r" (__r) : "r" (x), "i" (0x600 | (n)));		\
+	(u32)__r;							\
+})
+
+/* andn rd, rs1, rs2: rd = rs1 & ~rs2 */
+static __always_inline u32 zbb_andn(u32 a, u32 b)
+{
+	unsigned long r;
+
+	asm (".insn r 0x33, 0x7, 0x20, %0, %1, %2"
+	     : "=r" (r) : "r" (a), "r" (b));
+
+	return r;
+}
+
+#define zbb_S0(x)	(zbb_ror32(x, 2) ^ zbb_ror32(x, 13) ^ zbb_ror32(x, 22))
+#define zbb_S1(x)	(zbb_ror32(x, 6) ^ zbb_ror32(x, 11) ^ zbb_ror32(x, 25))
+#define zbb_s0(x)	(zbb_ror32(x, 7) ^ zbb_ror32(x, 18) ^ ((x) >> 3))
+#define zbb_s1(x)	(zbb_ror32(x, 17) ^ zbb_ror32(x, 19) ^ ((x) >> 10))
+
+static const u32 sha256_K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/*
+ * Both block functions are instantiated from this template, @zknh is a
+ * compile time constant so each gets only its own instructions.
+ */
+static __always_inline void sha256_riscv_blocks(u32 *state, const u8 *src,
+						int blocks, const bool zknh)
+{
+	u32 a, b, c, d, e, f, g, h, t1, t2;
+	u32 W[16];
+	int i;
+
+	while (blocks--) {
+		a = state[0]; b = state[1]; c = state[2]; d = state[3];
+		e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+		for (i = 0; i < 64; i++) {
+			u32 ch, S0, S1;
+
+			if (i < 16) {
+				W[i] = get_unaligned_be32(src + 4 * i);
+			} else {
+				u32 w15 = W[(i - 15) & 15], w2 = W[(i - 2) & 15];
+
+				W[i & 15] += W[(i - 7) & 15] +
+					(zknh ? zknh_s0(w15) : zbb_s0(w15)) +
+					(zknh ? zknh_s1(w2) : zbb_s1(w2));
+			}
+
+			if (zknh) {
+				S0 = zknh_S0(a);
+				S1 = zknh_S1(e);
+				ch = g ^ (e & (f ^ g));
+			} else {
+				S0 = zbb_S0(a);
+				S1 = zbb_S1(e);
+				ch = (e & f) ^ zbb_andn(g, e);
+			}
+
+			t1 = h + S1 + ch + sha256_K[i] + W[i & 15];
+			t2 = S0 + ((a & b) | (c & (a | b)));
+
+			h = g; g = f; f = e; e = d + t1;
+			d = c; c = b; b = a; a = t1 + t2;
+		}
+
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+
+		src += SHA256_BLOCK_SIZE;
+	}
+}
+
+static void sha256_zknh_transform(struct sha256_state *sst, u8 const *src,
+				  int blocks)
+{
+	sha256_riscv_blocks(sst->state, src, blocks, true);
+}
+
+static void sha256_zbb_transform(struct sha256_state *sst, u8 const *src,
+				 int blocks)
+{
+	sha256_riscv_blocks(sst->state, src, blocks, false);
+}
+
+static sha256_block_fn *sha256_riscv_transform;
+
+static int sha256_riscv_update(struct digest *desc, const void *data,
+			       unsigned long len)
+{
+	return sha256_base_do_update(desc, data, len, sha256_riscv_transform);
+}
+
+static int sha256_riscv_final(struct digest *desc, u8 *out)
+{
+	sha256_base_do_finalize(desc, sha256_riscv_transform);
+	return sha256_base_finish(desc, out);
+}
+
+static struct digest_algo sha224 = {
+	.base = {
+		.name		=	"sha224",
+		.priority	=	200,
+		.algo		=	HASH_ALGO_SHA224,
+	},
+
+	.length	=	SHA224_DIGEST_SIZE,
+	.init	=	sha224_base_init,
+	.update	=	sha256_riscv_update,
+	.final	=	sha256_riscv_final,
+	.digest	=	digest_generic_digest,
+	.verify	=	digest_generic_verify,
+	.ctx_length =	sizeof(struct sha256_state),
+};
+
+static struct digest_algo sha256 = {
+	.base = {
+		.name		=	"sha256",
+		.priority	=	200,
+		.algo		=	HASH_ALGO_SHA256,
+	},
+
+	.length	=	SHA256_DIGEST_SIZE,
+	.init	=	sha256_base_init,
+	.update	=	sha256_riscv_update,
+	.final	=	sha256_riscv_final,
+	.digest	=	digest_generic_digest,
+	.verify	=	digest_generic_verify,
+	.ctx_length =	sizeof(struct sha256_state),
+};
+
+/*
+ * Look for a multi-letter extension in a "riscv,isa" string, e.g.
+ * "rv64imafdc_zicsr_zifencei_zbb". Multi-letter extensions follow the
+ * single-letter ones and are separated by underscores.
+ */
+static bool riscv_isa_string_has(const char *isa, const char *ext)
+{
+	size_t len = strlen(ext);
+	const char *p;
+
+	for (p = strchr(isa, '_'); p; p = strchr(p, '_')) {
+		p++;
+		if (!strncasecmp(p, ext, len) && (p[len] == '_' || !p[len]))
+			return true;
+	}
+
+	return false;
+}
+
+static bool riscv_cpu_has(struct device_node *cpu, const char *ext)
+{
+	const char *isa;
+
+	if (of_property_match_string(cpu, "riscv,isa-extensions", ext) >= 0)
+		return true;
+
+	if (of_property_read_string(cpu, "riscv,isa", &isa))
+		return false;
+
+	return riscv_isa_string_has(isa, ext);
+}
+
+/* Extension must be available on all harts */
+static bool riscv_isa_extension_available(const char * const *exts)
+{
+	struct device_node *cpus, *cpu;
+	const char * const *ext;
+	bool found = false;
+
+	cpus = of_find_node_by_path("/cpus");
+	if (!cpus)
+		return false;
+
+	for_each_child_of_node(cpus, cpu) {
+		const char *type;
+
+		if (of_property_read_string(cpu, "device_type", &type) ||
+		    strcmp(type, "cpu"))
+			continue;
+
+		for (ext = exts; *ext; ext++)
+			if (riscv_cpu_has(cpu, *ext))
+				break;
+
+		if (!*ext)
+			return false;
+
+		found = true;
+	}
+
+	return found;
+}
+
+static int sha256_riscv_digest_register(void)
+{
+	static const char * const zknh[] = { "zknh", "zkn", "zk", NULL };
+	static const char * const zbb[] = { "zbb", NULL };
+	int ret;
+
+	if (riscv_isa_extension_available(zknh)) {
+		sha256_riscv_transform = sha256_zknh_transform;
+		sha224.base.driver_name = "sha224-zknh";
+		sha256.base.driver_name = "sha256-zknh";
+	} else if (riscv_isa_extension_available(zbb)) {
+		sha256_riscv_transform = sha256_zbb_transform;
+		sha224.base.driver_name = "sha224-zbb";
+		sha256.base.driver_name = "sha256-zbb";
+	} else {
+		return 0;
+	}
+
+	ret = digest_algo_register(&sha224);
+	if (ret)
+		return ret;
+
+	return digest_algo_register(&sha256);
+}
+coredevice_initcall(sha256_riscv_digest_register);
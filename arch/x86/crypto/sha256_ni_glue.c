@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * sha256_ni_glue.c - SHA-224/SHA-256 using the x86 SHA extensions
+ *
+ * The algorithms are only registered if the CPU advertises SHA-NI,
+ * otherwise the generic implementation is used.
+ */
+
+#include <common.h>
+#include <digest.h>
+#include <init.h>
+#include <crypto/sha.h>
+#include <crypto/sha256_base.h>
+#include <crypto/internal.h>
+#include <linux/linkage.h>
+#include <asm/cpufeature.h>
+
+asmlinkage void sha256_ni_transform(u32 *digest, const void *data,
+				    size_t blocks);
+
+static void __sha256_ni_transform(struct sha256_state *sst, u8 const *src,
+				  int blocks)
+{
+	sha256_ni_transform(sst->state, src, blocks);
+}
+
+static int sha256_ni_update(struct digest *desc, const void *data,
+			    unsigned long len)
+{
+	return sha256_base_do_update(desc, data, len, __sha256_ni_transform);
+}
+
+static int sha256_ni_final(struct digest *desc, u8 *out)
+{
+	sha256_base_do_finalize(desc, __sha256_ni_transform);
+	return sha256_base_finish(desc, out);
+}
+
+static struct digest_algo sha224 = {
+	.base = {
+		.name		=	"sha224",
+		.driver_name	=	"sha224-ni",
+		.priority	=	200,
+		.algo		=	HASH_ALGO_SHA224,
+	},
+
+	.length	=	SHA224_DIGEST_SIZE,
+	.init	=	sha224_base_init,
+	.update	=	sha256_ni_update,
+	.final	=	sha256_ni_final,
+	.digest	=	digest_generic_digest,
+	.verify	=	digest_generic_verify,
+	.ctx_length =	sizeof(struct sha256_state),
+};
+
+static struct digest_algo sha256 = {
+	.base = {
+		.name		=	"sha256",
+		.driver_name	=	"sha256-ni",
+		.priority	=	200,
+		.algo		=	HASH_ALGO_SHA256,
+	},
+
+	.length	=	SHA256_DIGEST_SIZE,
+	.init	=	sha256_base_init,
+	.update	=	sha256_ni_update,
+	.final	=	sha256_ni_final,
+	.digest	=	digest_generic_digest,
+	.verify	=	digest_generic_verify,
+	.ctx_length =	sizeof(struct sha256_state),
+};
+
+static bool sha256_ni_usable(void)
+{
+	return boot_cpu_has(X86_FEATURE_SHA_NI) &&
+	       boot_cpu_has(X86_FEATURE_SSSE3);
+}
+
+static int sha224_ni_digest_register(void)
+{
+	if (!sha256_ni_usable())
+		return 0;
+
+	return digest_algo_register(&sha224);
+}
+coredevice_initcall(sha224_ni_digest_register);
+
+static int sha256_ni_digest_register(void)
+{
+	if (!sha256_ni_usable())
+		return 0;
+
+	return digest_algo_register(&sha256);
+}
+coredevice_initcall(sha256_ni_digest_register);
@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#ifndef __ASM_X86_CPUFEATURE_H
+#define __ASM_X86_CPUFEATURE_H
+
+#include <linux/types.h>
+#include <linux/bits.h>
+
+enum cpuid_regs_idx {
+	CPUID_EAX = 0,
+	CPUID_EBX,
+	CPUID_ECX,
+	CPUID_EDX,
+};
+
+/* A feature is identified by its CPUID leaf, output register and bit */
+#define X86_FEATURE(leaf, reg, bit)	(((leaf) << 16) | ((reg) << 8) | (bit))
+
+#define X86_FEATURE_SSSE3	X86_FEATURE(1, CPUID_ECX, 9)
+#define X86_FEATURE_SSE4_1	X86_FEATURE(1, CPUID_ECX, 19)
+#define X86_FEATURE_ERMS	X86_FEATURE(7, CPUID_EBX, 9)
+#define X86_FEATURE_SHA_NI	X86_FEATURE(7, CPUID_EBX, 29)
+#define X86_FEATURE_FSRM	X86_FEATURE(7, CPUID_EDX, 4)
+
+static inline void cpuid_count(u32 op, u32 count, u32 regs[4])
+{
+	asm volatile("cpuid"
+		     : "=a" (regs[CPUID_EAX]), "=b" (regs[CPUID_EBX]),
+		       "=c" (regs[CPUID_ECX]), "=d" (regs[CPUID_EDX])
+		     : "0" (op), "2" (count));
+}
+
+static inline bool boot_cpu_has(unsigned int feature)
+{
+	u32 leaf = feature >> 16;
+	u32 regs[4];
+
+	cpuid_count(0, 0, regs);
+	if (leaf > regs[CPUID_EAX])
+		return false;
+
+	cpuid_count(leaf, 0, regs);
+
+	return regs[(feature >> 8) & 0xff] & BIT(feature & 0xff);
+}
+
+#endif /* __ASM_X86_CPUFEATURE_H */
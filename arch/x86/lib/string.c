@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memcpy/memset/memmove for x86_64
+ *
+ * CPUs with ERMS (Enhanced REP MOVSB/STOSB) run "rep movsb" and
+ * "rep stosb" at full cache line speed, but only once the startup cost
+ * is amortized. With FSRM (Fast Short REP MOV) that cost is gone for
+ * short copies as well. Everything else goes through the SSE2 routines.
+ */
+
+#include <common.h>
+#include <init.h>
+#include <string.h>
+#include <asm/cpufeature.h>
+
+#define X86_REP_THRESHOLD	256
+
+void *__memcpy_sse2(void *dest, const void *src, size_t count);
+void *__memmove_sse2(void *dest, const void *src, size_t count);
+void *__memset_sse2(void *s, int c, size_t count);
+
+static bool x86_erms, x86_fsrm;
+
+static inline void *rep_movsb(void *dest, const void *src, size_t count)
+{
+	void *ret = dest;
+
+	asm volatile("rep movsb"
+		     : "+D" (dest), "+S" (src), "+c" (count)
+		     : : "memory");
+
+	return ret;
+}
+
+static inline void *rep_stosb(void *s, int c, size_t count)
+{
+	void *ret = s;
+
+	asm volatile("rep stosb"
+		     : "+D" (s), "+c" (count)
+		     : "a" (c) : "memory");
+
+	return ret;
+}
+
+void *memcpy(void *dest, const void *src, size_t count)
+{
+	if (x86_fsrm || (x86_erms && count >= X86_REP_THRESHOLD))
+		return rep_movsb(dest, src, count);
+
+	return __memcpy_sse2(dest, src, count);
+}
+
+void *__memcpy(void *dest, const void *src, size_t count)
+	__alias(memcpy);
+
+void *memset(void *s, int c, size_t count)
+{
+	if (x86_erms && count >= X86_REP_THRESHOLD)
+		return rep_stosb(s, c, count);
+
+	return __memset_sse2(s, c, count);
+}
+
+void *__memset(void *s, int c, size_t count)
+	__alias(memset);
+
+void *memmove(void *dest, const void *src, size_t count)
+{
+	/* forward copy is safe unless dest starts inside src */
+	if ((uintptr_t)dest - (uintptr_t)src >= count)
+		return memcpy(dest, src, count);
+
+	return __memmove_sse2(dest, src, count);
+}
+
+void *__memmove(void *dest, const void *src, size_t count)
+	__alias(memmove);
+
+static int x86_string_init(void)
+{
+	x86_erms = boot_cpu_has(X86_FEATURE_ERMS);
+	x86_fsrm = boot_cpu_has(X86_FEATURE_FSRM);
+
+	return 0;
+}
+pure_initcall(x86_string_init);
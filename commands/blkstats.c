@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+#include <block.h>
+#include <command.h>
+#include <common.h>
+#include <complete.h>
+#include <fs.h>
+#include <getopt.h>
+#include <linux/math64.h>
+#include <linux/sizes.h>
+
+static void blkstats_io(const char *name, struct block_io_stats *stats)
+{
+	printf("  %-6s %10llu requests %10s in %6llu ms", name, stats->requests,
+	       size_human_readable(stats->bytes),
+	       div_u64(stats->ns, NSEC_PER_MSEC));
+
+	if (stats->ns)
+		printf(", %llu KiB/s", div64_u64(stats->bytes * (NSEC_PER_SEC / SZ_1K),
+						 stats->ns));
+
+	printf("\n");
+}
+
+static void blkstats_show(struct block_device *blk, bool histogram)
+{
+	struct block_stats *stats = &blk->stats;
+	int i;
+
+	printf("%s:\n", blk->cdev.name);
+	blkstats_io("read", &stats->read);
+	blkstats_io("write", &stats->write);
+	printf("  cache  %10llu hits     %10llu misses\n", stats->cache_hits,
+	       stats->cache_misses);
+
+	if (!histogram)
+		return;
+
+	printf("  latency (us)          reads     writes\n");
+
+	for (i = 0; i < BLOCK_STATS_BUCKETS; i++) {
+		u32 reads = stats->read.hist[i], writes = stats->write.hist[i];
+
+		if (!reads && !writes)
+			continue;
+
+		if (i == BLOCK_STATS_BUCKETS - 1)
+			printf("  %8u -           ", 1 << i);
+		else
+			printf("  %8u - %8u  ", i ? 1 << i : 0, (2 << i) - 1);
+
+		printf("%10u %10u\n", reads, writes);
+	}
+}
+
+static int do_blkstats(int argc, char *argv[])
+{
+	struct block_device *blk;
+	bool histogram = false, reset = false;
+	int opt, i, ret = 0;
+
+	while ((opt = getopt(argc, argv, "lr")) > 0) {
+		switch (opt) {
+		case 'l':
+			histogram = true;
+			break;
+		case 'r':
+			reset = true;
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (optind == argc) {
+		for_each_block_device(blk) {
+			blkstats_show(blk, histogram);
+			if (reset)
+				memset(&blk->stats, 0, sizeof(blk->stats));
+		}
+
+		return 0;
+	}
+
+	for (i = optind; i < argc; i++) {
+		struct cdev *cdev = cdev_by_name(devpath_to_name(argv[i]));
+
+		blk = cdev_get_block_device(cdev);
+		if (!blk) {
+			printf("%s: not a block device\n", argv[i]);
+			ret = COMMAND_ERROR;
+			continue;
+		}
+
+		blkstats_show(blk, histogram);
+		if (reset)
+			memset(&blk->stats, 0, sizeof(blk->stats));
+	}
+
+	return ret;
+}
+
+BAREBOX_CMD_HELP_START(blkstats)
+BAREBOX_CMD_HELP_TEXT("Show the request counters of all or the given block devices. The time")
+BAREBOX_CMD_HELP_TEXT("is spent in the driver, the throughput is calculated from it. Cache hits")
+BAREBOX_CMD_HELP_TEXT("and misses count blocks looked up in the block cache.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-l", "also show the request latency histograms")
+BAREBOX_CMD_HELP_OPT ("-r", "reset the counters after showing them")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(blkstats)
+	.cmd		= do_blkstats,
+	BAREBOX_CMD_DESC("show block device statistics")
+	BAREBOX_CMD_OPTS("[-lr] [DEVICE...]")
+	BAREBOX_CMD_GROUP(CMD_GRP_INFO)
+	BAREBOX_CMD_HELP(cmd_blkstats_help)
+	BAREBOX_CMD_COMPLETE(devfs_partition_complete)
+BAREBOX_CMD_END
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/* zstdmap.c - map a seekable zstd file to a device */
+
+#include <common.h>
+#include <command.h>
+#include <environment.h>
+#include <fs.h>
+#include <getopt.h>
+#include <zstd_seekable.h>
+
+static int do_zstdmap(int argc, char *argv[])
+{
+	const char *variable = NULL;
+	bool remove = false;
+	struct cdev *cdev;
+	int opt, ret;
+
+	while ((opt = getopt(argc, argv, "dv:")) > 0) {
+		switch (opt) {
+		case 'd':
+			remove = true;
+			break;
+		case 'v':
+			variable = optarg;
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (argc - optind != 1)
+		return COMMAND_ERROR_USAGE;
+
+	if (remove) {
+		cdev = cdev_by_name(devpath_to_name(argv[optind]));
+		if (!cdev) {
+			printf("zstdmap: %s not found\n", argv[optind]);
+			return -ENOENT;
+		}
+
+		ret = zstd_seekable_cdev_remove(cdev);
+		if (ret)
+			printf("zstdmap: cannot remove %s: %pe\n", argv[optind],
+			       ERR_PTR(ret));
+		return ret;
+	}
+
+	cdev = zstd_seekable_cdev_create(argv[optind]);
+	if (IS_ERR(cdev)) {
+		printf("zstdmap: %s: %pe\n", argv[optind], cdev);
+		return PTR_ERR(cdev);
+	}
+
+	if (variable)
+		return setenv(variable, cdev->name);
+
+	printf("%s\n", cdev->name);
+
+	return 0;
+}
+
+BAREBOX_CMD_HELP_START(zstdmap)
+BAREBOX_CMD_HELP_TEXT("Create a device reading the decompressed contents of a zstd")
+BAREBOX_CMD_HELP_TEXT("file in seekable format. Only the frames covering a read are")
+BAREBOX_CMD_HELP_TEXT("decompressed, so a file system image on the device can be")
+BAREBOX_CMD_HELP_TEXT("mounted without decompressing it completely.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-v VAR", "write the device name to VAR instead of printing it")
+BAREBOX_CMD_HELP_OPT ("-d",     "remove the device given instead of FILE")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(zstdmap)
+	.cmd		= do_zstdmap,
+	BAREBOX_CMD_DESC("map a seekable zstd file to a device")
+	BAREBOX_CMD_OPTS("[-v VAR] FILE | -d DEVICE")
+	BAREBOX_CMD_GROUP(CMD_GRP_FILE)
+	BAREBOX_CMD_HELP(cmd_zstdmap_help)
+BAREBOX_CMD_END
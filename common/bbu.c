@@ -424,7 +424,7 @@ int bbu_std_file_handler(struct bbu_handler *handler,
 {
 	int fd, ret;
 	struct stat s;
-	unsigned oflags = O_WRONLY;
+	unsigned oflags = O_RDWR;
 
 	device_detect_by_name(devpath_to_name(data->devicefile));
 
@@ -453,17 +453,14 @@ int bbu_std_file_handler(struct bbu_handler *handler,
 		goto err_close;
 	}
 
-	ret = erase(fd, data->len, 0);
-	if (ret && ret != -ENOSYS) {
-		printf("erasing %s failed with %s\n", data->devicefile,
+	/* only erases and programs the blocks that differ */
+	ret = write_full_flash(fd, data->image, data->len);
+	if (ret) {
+		printf("writing %s failed with %s\n", data->devicefile,
 				strerror(-ret));
 		goto err_close;
 	}
 
-	ret = write_full(fd, data->image, data->len);
-	if (ret < 0)
-		goto err_close;
-
 	protect(fd, data->len, 0, 1);
 
 	ret = 0;
@@ -10,8 +10,13 @@
 #include <malloc.h>
 #include <linux/err.h>
 #include <linux/list.h>
+#include <linux/sizes.h>
+#include <clock.h>
 #include <dma.h>
 #include <file-list.h>
+#include <param.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
 
 LIST_HEAD(block_device_list);
 
@@ -25,33 +30,158 @@ struct chunk {
 };
 
 #define BUFSIZE (PAGE_SIZE * 16)
+#define BLOCK_NUM_CHUNKS 8
+#define BLOCK_DIRECT_MAX SZ_1M
 
 static int writebuffer_io_len(struct block_device *blk, struct chunk *chunk)
 {
 	return min_t(blkcnt_t, blk->rdbufsize, blk->num_blocks - chunk->block_start);
 }
 
+static void block_stats_account(struct block_io_stats *stats, u64 bytes, u64 ns)
+{
+	u64 us = div_u64(ns, NSEC_PER_USEC);
+
+	stats->requests++;
+	stats->bytes += bytes;
+	stats->ns += ns;
+	stats->hist[us ? min_t(int, ilog2(us), BLOCK_STATS_BUCKETS - 1) : 0]++;
+}
+
+static int block_dev_read(struct block_device *blk, void *buf, sector_t block,
+			  blkcnt_t num_blocks)
+{
+	u64 start;
+	int ret;
+
+	if (!IS_ENABLED(CONFIG_BLOCK_STATS))
+		return blk->ops->read(blk, buf, block, num_blocks);
+
+	start = get_time_ns();
+	ret = blk->ops->read(blk, buf, block, num_blocks);
+	block_stats_account(&blk->stats.read, num_blocks << blk->blockbits,
+			    get_time_ns() - start);
+
+	return ret;
+}
+
+static int block_dev_write(struct block_device *blk, const void *buf,
+			   sector_t block, blkcnt_t num_blocks)
+{
+	u64 start;
+	int ret;
+
+	if (!IS_ENABLED(CONFIG_BLOCK_STATS))
+		return blk->ops->write(blk, buf, block, num_blocks);
+
+	start = get_time_ns();
+	ret = blk->ops->write(blk, buf, block, num_blocks);
+	block_stats_account(&blk->stats.write, num_blocks << blk->blockbits,
+			    get_time_ns() - start);
+
+	return ret;
+}
+
 /*
- * Write all dirty chunks back to the device
+ * Find the dirty chunk starting at @block_start without changing the LRU
+ * order
  */
-static int writebuffer_flush(struct block_device *blk)
+static struct chunk *chunk_get_dirty(struct block_device *blk, sector_t block_start)
 {
 	struct chunk *chunk;
+
+	list_for_each_entry(chunk, &blk->buffered_blocks, list) {
+		if (chunk->dirty && chunk->block_start == block_start)
+			return chunk;
+	}
+
+	return NULL;
+}
+
+/*
+ * Write back @chunk together with the dirty chunks adjacent to it on the
+ * device. Adjacent chunks are copied to a bounce buffer and written with a
+ * single ops->write call of at most blk->max_blocks, or one by one if
+ * there's no memory for that.
+ */
+static int writebuffer_write_run(struct block_device *blk, struct chunk *chunk)
+{
+	struct chunk *run[BLOCK_NUM_CHUNKS], *next;
+	int max = clamp_t(blkcnt_t, blk->max_blocks / blk->rdbufsize, 1,
+			  ARRAY_SIZE(run));
+	blkcnt_t num_blocks = 0;
+	int i, n = 0, ret = 0;
+	void *buf;
+
+	while (chunk->block_start >= blk->rdbufsize &&
+	       (next = chunk_get_dirty(blk, chunk->block_start - blk->rdbufsize)))
+		chunk = next;
+
+	run[n++] = chunk;
+
+	while (n < max &&
+	       (next = chunk_get_dirty(blk, chunk->block_start + blk->rdbufsize)))
+		run[n++] = chunk = next;
+
+	buf = n > 1 ? dma_alloc(n * BUFSIZE) : NULL;
+
+	for (i = 0; i < n; i++) {
+		blkcnt_t len = writebuffer_io_len(blk, run[i]);
+
+		if (buf) {
+			memcpy(buf + (num_blocks << blk->blockbits), run[i]->data,
+			       len << blk->blockbits);
+			num_blocks += len;
+			continue;
+		}
+
+		ret = block_dev_write(blk, run[i]->data, run[i]->block_start, len);
+		if (ret < 0)
+			return ret;
+
+		run[i]->dirty = 0;
+	}
+
+	if (buf) {
+		ret = block_dev_write(blk, buf, run[0]->block_start, num_blocks);
+		dma_free(buf);
+		if (ret < 0)
+			return ret;
+
+		for (i = 0; i < n; i++)
+			run[i]->dirty = 0;
+	}
+
+	return 0;
+}
+
+/*
+ * Write all dirty chunks back to the device, in ascending order and
+ * adjacent chunks merged
+ */
+static int writebuffer_flush(struct block_device *blk)
+{
+	struct chunk *chunk, *first;
 	int ret;
 
 	if (!IS_ENABLED(CONFIG_BLOCK_WRITE))
 		return 0;
 
-	list_for_each_entry(chunk, &blk->buffered_blocks, list) {
-		if (chunk->dirty) {
-			ret = blk->ops->write(blk, chunk->data,
-					      chunk->block_start,
-					      writebuffer_io_len(blk, chunk));
-			if (ret < 0)
-				return ret;
+	while (1) {
+		first = NULL;
 
-			chunk->dirty = 0;
+		list_for_each_entry(chunk, &blk->buffered_blocks, list) {
+			if (chunk->dirty &&
+			    (!first || chunk->block_start < first->block_start))
+				first = chunk;
 		}
+
+		if (!first)
+			break;
+
+		ret = writebuffer_write_run(blk, first);
+		if (ret < 0)
+			return ret;
 	}
 
 	if (blk->ops->flush)
@@ -113,13 +243,9 @@ static struct chunk *get_chunk(struct block_device *blk)
 		/* use last entry which is the most unused */
 		chunk = list_last_entry(&blk->buffered_blocks, struct chunk, list);
 		if (chunk->dirty) {
-			ret = blk->ops->write(blk, chunk->data,
-					      chunk->block_start,
-					      writebuffer_io_len(blk, chunk));
+			ret = writebuffer_write_run(blk, chunk);
 			if (ret < 0)
 				return ERR_PTR(ret);
-
-			chunk->dirty = 0;
 		}
 	} else {
 		chunk = list_first_entry(&blk->idle_blocks, struct chunk, list);
@@ -150,14 +276,14 @@ static int block_cache(struct block_device *blk, sector_t block)
 		chunk->num);
 
 	if (chunk->block_start * BLOCKSIZE(blk) >= blk->discard_start &&
-	    chunk->block_start * BLOCKSIZE(blk) + writebuffer_io_len(blk, chunk)
+	    (chunk->block_start + writebuffer_io_len(blk, chunk)) * BLOCKSIZE(blk)
 	    <= blk->discard_start + blk->discard_size) {
-		memset(chunk->data, 0, writebuffer_io_len(blk, chunk));
+		memset(chunk->data, 0, writebuffer_io_len(blk, chunk) << blk->blockbits);
 		list_add(&chunk->list, &blk->buffered_blocks);
 		return 0;
 	}
 
-	ret = blk->ops->read(blk, chunk->data, chunk->block_start,
+	ret = block_dev_read(blk, chunk->data, chunk->block_start,
 			     writebuffer_io_len(blk, chunk));
 	if (ret) {
 		list_add_tail(&chunk->list, &blk->idle_blocks);
@@ -181,8 +307,12 @@ static void *block_get(struct block_device *blk, sector_t block)
 		return ERR_PTR(-ENXIO);
 
 	outdata = block_get_cached(blk, block);
-	if (outdata)
+	if (outdata) {
+		blk->stats.cache_hits++;
 		return outdata;
+	}
+
+	blk->stats.cache_misses++;
 
 	ret = block_cache(blk, block);
 	if (ret)
@@ -195,6 +325,90 @@ static void *block_get(struct block_device *blk, sector_t block)
 	return outdata;
 }
 
+/*
+ * Return how many blocks starting at @block, up to @num_blocks, are not in
+ * the cache. With @only_dirty clean chunks are ignored.
+ */
+static blkcnt_t block_not_buffered(struct block_device *blk, sector_t block,
+				   blkcnt_t num_blocks, bool only_dirty)
+{
+	struct chunk *chunk;
+
+	list_for_each_entry(chunk, &blk->buffered_blocks, list) {
+		if (only_dirty && !chunk->dirty)
+			continue;
+		if (chunk->block_start + blk->rdbufsize <= block)
+			continue;
+		if (chunk->block_start <= block)
+			return 0;
+		num_blocks = min_t(blkcnt_t, num_blocks,
+				   chunk->block_start - block);
+	}
+
+	return num_blocks;
+}
+
+/*
+ * Return how many blocks starting at @block, up to @num_blocks, can be read
+ * from the device directly into the caller's buffer: none of them may be
+ * in the cache, which might hold newer data, or in the discard range.
+ */
+static blkcnt_t block_uncached(struct block_device *blk, sector_t block,
+			       blkcnt_t num_blocks)
+{
+	loff_t start = block * BLOCKSIZE(blk);
+
+	if (block >= blk->num_blocks)
+		return 0;
+
+	num_blocks = min_t(blkcnt_t, num_blocks, blk->num_blocks - block);
+
+	if (blk->discard_size &&
+	    start < blk->discard_start + blk->discard_size &&
+	    start + num_blocks * BLOCKSIZE(blk) > blk->discard_start)
+		return 0;
+
+	return block_not_buffered(blk, block, num_blocks, false);
+}
+
+/*
+ * Read blocks from the device without going through the cache, in requests
+ * of at most blk->max_blocks. Buffers not suitable for DMA are bounced,
+ * that's still cheaper than splitting the read into chunks.
+ */
+static int block_read_direct(struct block_device *blk, void *buf,
+			     sector_t block, blkcnt_t num_blocks)
+{
+	blkcnt_t max = blk->max_blocks;
+	void *bounce = NULL;
+	int ret = 0;
+
+	if (!IS_ALIGNED((unsigned long)buf, DMA_ALIGNMENT)) {
+		bounce = memalign(DMA_ALIGNMENT,
+				  min(num_blocks, max) << blk->blockbits);
+		if (!bounce)
+			return -ENOMEM;
+	}
+
+	while (num_blocks) {
+		blkcnt_t now = min(num_blocks, max);
+
+		ret = block_dev_read(blk, bounce ?: buf, block, now);
+		if (ret)
+			break;
+
+		if (bounce)
+			memcpy(buf, bounce, now << blk->blockbits);
+		buf += now << blk->blockbits;
+		block += now;
+		num_blocks -= now;
+	}
+
+	free(bounce);
+
+	return ret;
+}
+
 static ssize_t block_op_read(struct cdev *cdev, void *buf, size_t count,
 		loff_t offset, unsigned long flags)
 {
@@ -222,8 +436,34 @@ static ssize_t block_op_read(struct cdev *cdev, void *buf, size_t count,
 	blocks = count >> blk->blockbits;
 
 	while (blocks) {
-		void *iobuf = block_get(blk, block);
+		void *iobuf;
+
+		/*
+		 * Reads of at least a whole chunk bypass the cache, so the
+		 * driver can transfer them with as few commands as possible.
+		 */
+		if (blocks >= blk->rdbufsize) {
+			blkcnt_t now = block_uncached(blk, block, blocks);
+
+			if (now >= blk->rdbufsize) {
+				int ret = block_read_direct(blk, buf, block, now);
+
+				/* without a bounce buffer fall back to the cache */
+				if (ret == -ENOMEM)
+					goto cached;
+				if (ret)
+					return ret;
+
+				buf += now << blk->blockbits;
+				count -= now << blk->blockbits;
+				blocks -= now;
+				block += now;
+				continue;
+			}
+		}
 
+cached:
+		iobuf = block_get(blk, block);
 		if (IS_ERR(iobuf))
 			return PTR_ERR(iobuf);
 
@@ -272,6 +512,78 @@ static int block_put(struct block_device *blk, const void *buf, sector_t block)
 	return 0;
 }
 
+/*
+ * Drop the cached data of a range of blocks. Dirty data must have been
+ * written back before.
+ */
+static void block_invalidate(struct block_device *blk, sector_t block,
+			     blkcnt_t num_blocks)
+{
+	struct chunk *chunk, *tmp;
+
+	list_for_each_entry_safe(chunk, tmp, &blk->buffered_blocks, list) {
+		if (chunk->block_start + blk->rdbufsize <= block ||
+		    chunk->block_start >= block + num_blocks)
+			continue;
+
+		list_move_tail(&chunk->list, &blk->idle_blocks);
+	}
+}
+
+/*
+ * Write blocks to the device without going through the cache, in requests
+ * of at most blk->max_blocks. None of the blocks may be in a dirty chunk,
+ * clean chunks are dropped. The blocks no longer read back as zeroes when
+ * they were in the discard range, so the range is shrunk accordingly.
+ */
+static int block_write_direct(struct block_device *blk, const void *buf,
+			      sector_t block, blkcnt_t num_blocks)
+{
+	loff_t start = (loff_t)block << blk->blockbits;
+	loff_t end = start + (num_blocks << blk->blockbits);
+	loff_t discard_end = blk->discard_start + blk->discard_size;
+	blkcnt_t max = blk->max_blocks;
+	void *bounce = NULL;
+	int ret = 0;
+
+	block_invalidate(blk, block, num_blocks);
+
+	if (blk->discard_size && start < discard_end && end > blk->discard_start) {
+		if (start <= blk->discard_start) {
+			blk->discard_start = min(end, discard_end);
+			blk->discard_size = discard_end - blk->discard_start;
+		} else {
+			blk->discard_size = start - blk->discard_start;
+		}
+	}
+
+	if (!IS_ALIGNED((unsigned long)buf, DMA_ALIGNMENT)) {
+		bounce = memalign(DMA_ALIGNMENT,
+				  min(num_blocks, max) << blk->blockbits);
+		if (!bounce)
+			return -ENOMEM;
+	}
+
+	while (num_blocks) {
+		blkcnt_t now = min(num_blocks, max);
+
+		if (bounce)
+			memcpy(bounce, buf, now << blk->blockbits);
+
+		ret = block_dev_write(blk, bounce ?: buf, block, now);
+		if (ret)
+			break;
+
+		buf += now << blk->blockbits;
+		block += now;
+		num_blocks -= now;
+	}
+
+	free(bounce);
+
+	return ret;
+}
+
 static ssize_t block_op_write(struct cdev *cdev, const void *buf, size_t count,
 		loff_t offset, ulong flags)
 {
@@ -315,6 +627,30 @@ static ssize_t block_op_write(struct cdev *cdev, const void *buf, size_t count,
 	blocks = count >> blk->blockbits;
 
 	while (blocks) {
+		/*
+		 * Like reads, writes of at least a whole chunk which isn't
+		 * cached are streamed to the device.
+		 */
+		if (blocks >= blk->rdbufsize && block < blk->num_blocks) {
+			blkcnt_t now = block_not_buffered(blk, block,
+					min_t(blkcnt_t, blocks, blk->num_blocks - block),
+					true);
+
+			if (now >= blk->rdbufsize) {
+				ret = block_write_direct(blk, buf, block, now);
+				if (ret == -ENOMEM)
+					goto cached;
+				if (ret)
+					return ret;
+
+				buf += now << blk->blockbits;
+				count -= now << blk->blockbits;
+				blocks -= now;
+				block += now;
+				continue;
+			}
+		}
+cached:
 		ret = block_put(blk, buf, block);
 		if (ret)
 			return ret;
@@ -341,6 +677,76 @@ static ssize_t block_op_write(struct cdev *cdev, const void *buf, size_t count,
 }
 #endif
 
+#ifdef CONFIG_BLOCK_WRITE
+/*
+ * Zero a range of bytes in the cache, used for the parts of an erased
+ * range not covering whole blocks.
+ */
+static int block_zero(struct block_device *blk, loff_t offset, loff_t count)
+{
+	unsigned long mask = BLOCKSIZE(blk) - 1;
+	struct chunk *chunk;
+	sector_t block;
+	size_t now;
+	void *data;
+
+	while (count > 0) {
+		block = offset >> blk->blockbits;
+		now = min_t(loff_t, count, BLOCKSIZE(blk) - (offset & mask));
+
+		data = block_get(blk, block);
+		if (IS_ERR(data))
+			return PTR_ERR(data);
+
+		memset(data + (offset & mask), 0, now);
+
+		chunk = chunk_get_cached(blk, block);
+		chunk->dirty = 1;
+
+		offset += now;
+		count -= now;
+	}
+
+	return 0;
+}
+
+static int block_op_erase(struct cdev *cdev, loff_t count, loff_t offset)
+{
+	struct block_device *blk = cdev->priv;
+	unsigned long mask = BLOCKSIZE(blk) - 1;
+	loff_t end = offset + count;
+	sector_t block = (offset + mask) >> blk->blockbits;
+	sector_t last = end >> blk->blockbits;
+	int ret;
+
+	if (!blk->ops->erase)
+		return -ENOSYS;
+
+	if (offset < 2 * SECTOR_SIZE)
+		blk->need_reparse = true;
+
+	if (block >= last)
+		return block_zero(blk, offset, count);
+
+	ret = writebuffer_flush(blk);
+	if (ret)
+		return ret;
+
+	block_invalidate(blk, block, last - block);
+
+	ret = blk->ops->erase(blk, block, last - block);
+	if (ret)
+		return ret;
+
+	ret = block_zero(blk, offset, ((loff_t)block << blk->blockbits) - offset);
+	if (ret)
+		return ret;
+
+	return block_zero(blk, (loff_t)last << blk->blockbits,
+			  end - ((loff_t)last << blk->blockbits));
+}
+#endif
+
 static int block_op_flush(struct cdev *cdev)
 {
 	struct block_device *blk = cdev->priv;
@@ -378,6 +784,7 @@ static struct cdev_operations block_ops = {
 	.read	= block_op_read,
 #ifdef CONFIG_BLOCK_WRITE
 	.write	= block_op_write,
+	.erase	= block_op_erase,
 #endif
 	.close	= block_op_close,
 	.flush	= block_op_flush,
@@ -392,6 +799,37 @@ struct block_device *cdev_get_block_device(const struct cdev *cdev)
 	return cdev->priv;
 }
 
+/*
+ * The counters are parameters of their own device, a device can have more
+ * than one block device, e.g. the hardware partitions of an eMMC.
+ */
+static void block_stats_register(struct block_device *blk)
+{
+	struct block_stats *stats = &blk->stats;
+	struct device *dev;
+
+	dev = xzalloc(sizeof(*dev));
+	dev_set_name(dev, "%s.stats", blk->cdev.name);
+	dev->id = DEVICE_ID_SINGLE;
+	dev->parent = blk->dev;
+
+	if (register_device(dev)) {
+		free(dev);
+		return;
+	}
+
+	dev_add_param_uint64_ro(dev, "read_requests", &stats->read.requests, "%llu");
+	dev_add_param_uint64_ro(dev, "read_bytes", &stats->read.bytes, "%llu");
+	dev_add_param_uint64_ro(dev, "read_ns", &stats->read.ns, "%llu");
+	dev_add_param_uint64_ro(dev, "write_requests", &stats->write.requests, "%llu");
+	dev_add_param_uint64_ro(dev, "write_bytes", &stats->write.bytes, "%llu");
+	dev_add_param_uint64_ro(dev, "write_ns", &stats->write.ns, "%llu");
+	dev_add_param_uint64_ro(dev, "cache_hits", &stats->cache_hits, "%llu");
+	dev_add_param_uint64_ro(dev, "cache_misses", &stats->cache_misses, "%llu");
+
+	blk->stats_dev = dev;
+}
+
 int blockdevice_register(struct block_device *blk)
 {
 	loff_t size = (loff_t)blk->num_blocks * BLOCKSIZE(blk);
@@ -404,6 +842,9 @@ int blockdevice_register(struct block_device *blk)
 	blk->cdev.priv = blk;
 	blk->rdbufsize = BUFSIZE >> blk->blockbits;
 
+	if (!blk->max_blocks || blk->max_blocks > BLOCK_DIRECT_MAX >> blk->blockbits)
+		blk->max_blocks = BLOCK_DIRECT_MAX >> blk->blockbits;
+
 	INIT_LIST_HEAD(&blk->buffered_blocks);
 	INIT_LIST_HEAD(&blk->idle_blocks);
 	blk->blkmask = blk->rdbufsize - 1;
@@ -416,7 +857,7 @@ int blockdevice_register(struct block_device *blk)
 		return -ENOSYS;
 	}
 
-	for (i = 0; i < 8; i++) {
+	for (i = 0; i < BLOCK_NUM_CHUNKS; i++) {
 		struct chunk *chunk = xzalloc(sizeof(*chunk));
 		chunk->data = dma_alloc(BUFSIZE);
 		chunk->num = i;
@@ -429,6 +870,9 @@ int blockdevice_register(struct block_device *blk)
 
 	list_add_tail(&blk->list, &block_device_list);
 
+	if (IS_ENABLED(CONFIG_BLOCK_STATS))
+		block_stats_register(blk);
+
 	cdev_create_default_automount(&blk->cdev);
 
 	/* Lack of partition table is unusual, but not a failure */
@@ -453,6 +897,11 @@ int blockdevice_unregister(struct block_device *blk)
 		free(chunk);
 	}
 
+	if (blk->stats_dev) {
+		unregister_device(blk->stats_dev);
+		free(blk->stats_dev);
+	}
+
 	devfs_remove(&blk->cdev);
 	list_del(&blk->list);
 
@@ -34,10 +34,12 @@ static struct bthread {
 	u8 should_stop :1;
 	u8 should_clean :1;
 	u8 has_stopped :1;
+	u8 foreground :1;
 } main_thread = {
 	.list = LIST_HEAD_INIT(main_thread.list),
 	.name = "main",
 	.awake = true,
+	.foreground = true,
 };
 
 struct bthread *current = &main_thread;
@@ -135,6 +137,16 @@ void bthread_suspend(struct bthread *bthread)
 	bthread->awake = false;
 }
 
+/*
+ * Foreground threads are helpers of the command currently running in the
+ * main thread. Unlike other bthreads, they are also scheduled from delay
+ * loops while the command slice is held.
+ */
+void bthread_set_foreground(struct bthread *bthread)
+{
+	bthread->foreground = true;
+}
+
 void bthread_cancel(struct bthread *bthread)
 {
 	bthread->should_stop = true;
@@ -172,7 +184,7 @@ void bthread_info(void)
 		printf("%s\n", bthread->name);
 }
 
-void bthread_reschedule(void)
+static void __bthread_reschedule(bool foreground)
 {
 	struct bthread *next, *tmp;
 
@@ -180,7 +192,7 @@ void bthread_reschedule(void)
 		return;
 
 	list_for_each_entry_safe(next, tmp, &current->list, list) {
-		if (next->awake) {
+		if (next->awake && (next->foreground || !foreground)) {
 			pr_debug("switch %s -> %s\n", current->name, next->name);
 			bthread_schedule(next);
 			return;
@@ -193,6 +205,25 @@ void bthread_reschedule(void)
 	}
 }
 
+void bthread_reschedule(void)
+{
+	__bthread_reschedule(false);
+}
+
+/*
+ * Switch between the main thread and its foreground helpers. Background
+ * threads calling this, e.g. from a driver delay loop while the command
+ * slice is held, keep running so that the command can't enter the driver
+ * in the middle of their I/O.
+ */
+void bthread_reschedule_foreground(void)
+{
+	if (!current->foreground)
+		return;
+
+	__bthread_reschedule(true);
+}
+
 void bthread_schedule(struct bthread *to)
 {
 	struct bthread *from = current;
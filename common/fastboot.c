@@ -31,6 +31,7 @@
 #include <unistd.h>
 #include <magicvar.h>
 #include <linux/log2.h>
+#include <linux/math64.h>
 #include <linux/sizes.h>
 #include <memory.h>
 #include <progress.h>
@@ -50,6 +51,7 @@
 static unsigned int fastboot_max_download_size;
 static int fastboot_bbu;
 static char *fastboot_partitions;
+static char *fastboot_stream_target;
 
 struct fb_variable {
 	char *name;
@@ -344,12 +346,254 @@ static void cb_getvar(struct fastboot *fb, const char *cmd)
 	fastboot_free_variables(&partition_list);
 }
 
+static int fastboot_fill_write(int fd, uint32_t fill_val, uint64_t len,
+			       loff_t pos)
+{
+	uint32_t buf[SZ_1K];
+	size_t now;
+	int i, ret;
+
+	for (i = 0; i < ARRAY_SIZE(buf); i++)
+		buf[i] = fill_val;
+
+	while (len) {
+		now = min_t(uint64_t, len, sizeof(buf));
+
+		ret = pwrite_full(fd, buf, now, pos);
+		if (ret < 0)
+			return ret == -EINVAL ? -ENOSPC : ret;
+
+		len -= now;
+		pos += now;
+	}
+
+	return 0;
+}
+
+/*
+ * Sparse image fill chunks with the content of erased flash are erased
+ * instead of written. Block devices which can erase to zeroes have an
+ * @erasesize of 1, for MTD devices the parts of the range not covering
+ * whole eraseblocks are written. Returns -EOPNOTSUPP if the device can't
+ * do this and the range has to be written.
+ */
+static int fastboot_fill_erase(int fd, unsigned int erasesize,
+			       uint32_t fill_val, uint64_t len, loff_t pos)
+{
+	uint32_t erased = erasesize > 1 ? 0xffffffff : 0;
+	loff_t start, end;
+	int ret;
+
+	if (fill_val != erased)
+		return -EOPNOTSUPP;
+
+	start = div_u64(pos + erasesize - 1, erasesize) * erasesize;
+	end = div_u64(pos + len, erasesize) * erasesize;
+	if (start >= end)
+		return -EOPNOTSUPP;
+
+	ret = erase(fd, end - start, start);
+	if (ret == -ENOSYS || ret == -EOPNOTSUPP)
+		return -EOPNOTSUPP;
+	if (ret)
+		return ret;
+
+	ret = fastboot_fill_write(fd, fill_val, start - pos, pos);
+	if (ret)
+		return ret;
+
+	return fastboot_fill_write(fd, fill_val, pos + len - end, end);
+}
+
+static unsigned int fastboot_erasesize(int fd)
+{
+	struct mtd_info_user meminfo;
+
+	if (ioctl(fd, MEMGETINFO, &meminfo))
+		return 1;
+
+	return meminfo.erasesize;
+}
+
+/*
+ * With global.fastboot.stream set to a partition name, downloaded data is
+ * not staged in the temporary file, but written to that partition while it
+ * arrives. Sparse images are decoded on the fly. The following flash
+ * command only has to confirm the partition.
+ */
+struct fastboot_stream {
+	struct file_list_entry *fentry;
+	int fd;
+	bool regular;
+	loff_t devsize;
+	unsigned int erasesize;
+	struct sparse_image_stream *sparse;
+	int err;
+};
+
+static int fastboot_stream_write(void *ctx, const void *buf, size_t len,
+				 loff_t pos)
+{
+	struct fastboot_stream *st = ctx;
+	int ret;
+
+	discard_range(st->fd, len, pos);
+
+	ret = pwrite_full(st->fd, buf, len, pos);
+	if (ret < 0)
+		return ret == -EINVAL ? -ENOSPC : ret;
+
+	return 0;
+}
+
+static int fastboot_stream_fill(void *ctx, uint32_t fill_val, uint64_t len,
+				loff_t pos)
+{
+	struct fastboot_stream *st = ctx;
+
+	return fastboot_fill_erase(st->fd, st->erasesize, fill_val, len, pos);
+}
+
+static void fastboot_stream_free(struct fastboot *fb)
+{
+	struct fastboot_stream *st = fb->stream;
+
+	if (!st)
+		return;
+
+	if (IS_ENABLED(CONFIG_FASTBOOT_SPARSE))
+		sparse_image_stream_free(st->sparse);
+	close(st->fd);
+	free(st);
+
+	fb->stream = NULL;
+}
+
+static int fastboot_stream_open(struct fastboot *fb, const char *name)
+{
+	struct file_list_entry *fentry;
+	struct fastboot_stream *st;
+	unsigned int flags = O_WRONLY;
+	struct stat s;
+	int ret, fd;
+
+	fentry = file_list_entry_by_name(fb->files, name);
+	if (!fentry)
+		return -ENOENT;
+
+	/*
+	 * UBI images, barebox update handlers and board specific flash
+	 * handlers need to see the whole image before writing anything.
+	 */
+	if (fb->cmd_flash || (fentry->flags & FILE_LIST_FLAG_UBI) ||
+	    strstarts(fentry->name, "bbu-"))
+		return -EOPNOTSUPP;
+
+	ret = stat(fentry->filename, &s);
+	if (ret) {
+		if (fentry->flags & FILE_LIST_FLAG_CREATE)
+			flags |= O_CREAT;
+		else
+			return ret;
+	}
+
+	fd = open(fentry->filename, flags);
+	if (fd < 0)
+		return -errno;
+
+	ret = fstat(fd, &s);
+	if (ret) {
+		close(fd);
+		return ret;
+	}
+
+	st = xzalloc(sizeof(*st));
+	st->fentry = fentry;
+	st->fd = fd;
+	st->regular = S_ISREG(s.st_mode);
+	st->devsize = s.st_size;
+	st->erasesize = fastboot_erasesize(fd);
+
+	fb->stream = st;
+
+	return 0;
+}
+
+static int fastboot_stream_data(struct fastboot *fb, const void *buffer,
+				unsigned int len)
+{
+	struct fastboot_stream *st = fb->stream;
+	int ret;
+
+	if (st->err)
+		return st->err;
+
+	if (!fb->download_bytes) {
+		if (len >= sizeof(struct sparse_header) && is_sparse_image(buffer)) {
+			if (!IS_ENABLED(CONFIG_FASTBOOT_SPARSE)) {
+				ret = -EOPNOTSUPP;
+				goto out;
+			}
+
+			st->sparse = sparse_image_stream_new(fastboot_stream_write,
+							     st);
+			sparse_image_stream_set_fill(st->sparse,
+						     fastboot_stream_fill);
+		} else if (IS_ENABLED(CONFIG_BAREBOX_UPDATE) &&
+			   filetype_is_barebox_image(file_detect_type(buffer, len)) &&
+			   bbu_find_handler_by_device(st->fentry->filename)) {
+			/* flash would pass it to barebox_update(), not write it raw */
+			ret = -EOPNOTSUPP;
+			goto out;
+		} else if (!st->regular && fb->download_size > st->devsize) {
+			ret = -ENOSPC;
+			goto out;
+		} else {
+			discard_range(st->fd, fb->download_size, 0);
+		}
+	}
+
+	if (IS_ENABLED(CONFIG_FASTBOOT_SPARSE) && st->sparse)
+		ret = sparse_image_stream_write(st->sparse, buffer, len);
+	else
+		ret = fastboot_stream_write(st, buffer, len, fb->download_bytes);
+out:
+	st->err = ret;
+
+	return ret;
+}
+
+static int fastboot_stream_finish(struct fastboot *fb)
+{
+	struct fastboot_stream *st = fb->stream;
+	loff_t size = fb->download_bytes;
+	int ret;
+
+	if (st->err)
+		return st->err;
+
+	if (IS_ENABLED(CONFIG_FASTBOOT_SPARSE) && st->sparse) {
+		ret = sparse_image_stream_finish(st->sparse);
+		if (ret)
+			return ret;
+		size = sparse_image_stream_size(st->sparse);
+	}
+
+	if (st->regular)
+		return ftruncate(st->fd, size);
+
+	return 0;
+}
+
 int fastboot_handle_download_data(struct fastboot *fb, const void *buffer,
 				  unsigned int len)
 {
 	int ret;
 
-	ret = write(fb->download_fd, buffer, len);
+	if (fb->stream)
+		ret = fastboot_stream_data(fb, buffer, len);
+	else
+		ret = write(fb->download_fd, buffer, len);
 	if (ret < 0)
 		return ret;
 
@@ -360,11 +604,30 @@ int fastboot_handle_download_data(struct fastboot *fb, const void *buffer,
 
 void fastboot_download_finished(struct fastboot *fb)
 {
-	close(fb->download_fd);
-	fb->download_fd = 0;
+	int ret;
 
 	printf("\n");
 
+	if (fb->stream) {
+		ret = fastboot_stream_finish(fb);
+		if (ret) {
+			fastboot_tx_print(fb, FASTBOOT_MSG_FAIL,
+					  "writing %s: %s", fb->stream->fentry->name,
+					  strerror(-ret));
+			fastboot_stream_free(fb);
+			return;
+		}
+
+		fastboot_tx_print(fb, FASTBOOT_MSG_INFO,
+				  "Downloading %d bytes to %s finished",
+				  fb->download_bytes, fb->stream->fentry->name);
+		fastboot_tx_print(fb, FASTBOOT_MSG_OKAY, "");
+		return;
+	}
+
+	close(fb->download_fd);
+	fb->download_fd = 0;
+
 	fastboot_tx_print(fb, FASTBOOT_MSG_INFO, "Downloading %d bytes finished",
 			  fb->download_bytes);
 
@@ -378,6 +641,8 @@ void fastboot_abort(struct fastboot *fb)
 		fb->download_fd = 0;
 	}
 
+	fastboot_stream_free(fb);
+
 	fb->active = false;
 
 	unlink(fb->tempname);
@@ -398,12 +663,33 @@ static void cb_download(struct fastboot *fb, const char *cmd)
 		close(fb->download_fd);
 	}
 
+	fastboot_stream_free(fb);
+
+	if (fastboot_stream_target && *fastboot_stream_target) {
+		int ret = fastboot_stream_open(fb, fastboot_stream_target);
+
+		if (ret)
+			fastboot_tx_print(fb, FASTBOOT_MSG_FAIL,
+					  "streaming to %s: %s",
+					  fastboot_stream_target, strerror(-ret));
+		else if (!fb->download_size)
+			fastboot_tx_print(fb, FASTBOOT_MSG_FAIL,
+					  "data invalid size");
+		else
+			fb->start_download(fb);
+		return;
+	}
+
 	fb->download_fd = open(fb->tempname, O_WRONLY | O_CREAT | O_TRUNC);
 	if (fb->download_fd < 0) {
 		fastboot_tx_print(fb, FASTBOOT_MSG_FAIL, "internal error");
 			return;
 	}
 
+	/* size hint, lets ramfs store the image in one piece */
+	if (fb->download_size)
+		ftruncate(fb->download_fd, fb->download_size);
+
 	if (!fb->download_size)
 		fastboot_tx_print(fb, FASTBOOT_MSG_FAIL,
 					  "data invalid size");
@@ -424,6 +710,13 @@ static void __maybe_unused cb_boot(struct fastboot *fb, const char *opt)
 		.os_address = UIMAGE_SOME_ADDRESS,
 	};
 
+	if (fb->stream) {
+		fastboot_tx_print(fb, FASTBOOT_MSG_FAIL,
+				  "download was streamed to %s",
+				  fb->stream->fentry->name);
+		return;
+	}
+
 	fastboot_tx_print(fb, FASTBOOT_MSG_INFO, "Booting kernel..\n");
 
 	globalvar_set_match("linux.bootargs.dyn.", "");
@@ -540,6 +833,7 @@ static int fastboot_handle_sparse(struct fastboot *fb,
 	int bufsiz = SZ_128K;
 	struct stat s;
 	struct mtd_info *mtd = NULL;
+	unsigned int erasesize;
 
 	ret = stat(fentry->filename, &s);
 	if (ret) {
@@ -584,10 +878,31 @@ static int fastboot_handle_sparse(struct fastboot *fb,
 		}
 	}
 
+	erasesize = fastboot_erasesize(fd);
+
 	while (1) {
 		size_t retlen;
 		loff_t pos;
 
+		if (!(fentry->flags & FILE_LIST_FLAG_UBI)) {
+			uint32_t fill_val;
+			uint64_t len;
+
+			ret = sparse_image_read_fill(sparse, &fill_val, &pos, &len);
+			if (ret < 0)
+				goto out;
+			if (ret) {
+				ret = fastboot_fill_erase(fd, erasesize, fill_val,
+							  len, pos);
+				if (ret == -EOPNOTSUPP)
+					ret = fastboot_fill_write(fd, fill_val,
+								  len, pos);
+				if (ret)
+					goto out;
+				continue;
+			}
+		}
+
 		ret = sparse_image_read(sparse, buf, &pos, bufsiz, &retlen);
 		if (ret)
 			goto out;
@@ -648,6 +963,19 @@ static void cb_flash(struct fastboot *fb, const char *cmd)
 	const char *filename = NULL;
 	enum filetype filetype;
 
+	if (fb->stream) {
+		fentry = fb->stream->fentry;
+		if (strcmp(cmd, fentry->name))
+			fastboot_tx_print(fb, FASTBOOT_MSG_FAIL,
+					  "download was streamed to %s",
+					  fentry->name);
+		else
+			fastboot_tx_print(fb, FASTBOOT_MSG_OKAY, "");
+
+		fastboot_stream_free(fb);
+		return;
+	}
+
 	ret = file_name_detect_type(fb->tempname, &filetype);
 	if (ret) {
 		fastboot_tx_print(fb, FASTBOOT_MSG_FAIL, "internal error");
@@ -982,6 +1310,8 @@ static int fastboot_globalvars_init(void)
 	globalvar_add_simple_bool("fastboot.bbu", &fastboot_bbu);
 	globalvar_add_simple_string("fastboot.partitions",
 				    &fastboot_partitions);
+	globalvar_add_simple_string("fastboot.stream",
+				    &fastboot_stream_target);
 
 	globalvar_alias_deprecated("usbgadget.fastboot_function",
 				   "fastboot.partitions");
@@ -1001,3 +1331,5 @@ BAREBOX_MAGICVAR(global.fastboot.partitions,
 		       "Partitions exported for update via fastboot");
 BAREBOX_MAGICVAR(global.fastboot.bbu,
 		       "Export barebox update handlers via fastboot");
+BAREBOX_MAGICVAR(global.fastboot.stream,
+		       "Partition to write downloads to while they arrive");
@@ -18,6 +18,8 @@ void resched(void)
 	if (run_workqueues) {
 		wq_do_all_works();
 		bthread_reschedule();
+	} else {
+		bthread_reschedule_foreground();
 	}
 
 	poller_call();
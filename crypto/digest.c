@@ -245,11 +245,11 @@ static int digest_update_from_fd(struct digest *d, int fd,
 		if (!ret)
 			break;
 
+		size -= ret;
+
 		ret = digest_update_interruptible(d, buf, ret);
 		if (ret)
 			goto out_free;
-
-		size -= now;
 	}
 
 out_free:
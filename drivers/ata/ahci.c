@@ -32,6 +32,12 @@
  */
 #define MAX_SATA_BLOCKS_READ_WRITE	0x80
 
+/*
+ * Blocks per queued read command. Several of these are kept outstanding,
+ * each is described by a single PRD entry of the contiguous buffer.
+ */
+#define AHCI_NCQ_BLOCKS			0x800
+
 /* Maximum timeouts for each event */
 #define WAIT_SPINUP	(10 * SECOND)
 #define WAIT_DATAIO	(5 * SECOND)
@@ -112,20 +118,32 @@ static int ahci_link_ok(struct ahci_port *ahci_port, int verbose)
 	return false;
 }
 
-static void ahci_fill_cmd_slot(struct ahci_port *ahci_port, u32 opts)
+static inline void *ahci_cmd_tbl(struct ahci_port *ahci_port, int tag)
 {
-	ahci_port->cmd_slot->opts = cpu_to_le32(opts);
-	ahci_port->cmd_slot->status = 0;
-	ahci_port->cmd_slot->tbl_addr =
-		cpu_to_le32(lower_32_bits(ahci_port->cmd_tbl_dma));
+	return ahci_port->cmd_tbl + tag * AHCI_CMD_TBL_SZ;
+}
+
+static inline dma_addr_t ahci_cmd_tbl_dma(struct ahci_port *ahci_port, int tag)
+{
+	return ahci_port->cmd_tbl_dma + tag * AHCI_CMD_TBL_SZ;
+}
+
+static void ahci_fill_cmd_slot(struct ahci_port *ahci_port, int tag, u32 opts)
+{
+	struct ahci_cmd_hdr *cmd_slot = &ahci_port->cmd_slot[tag];
+	dma_addr_t tbl_dma = ahci_cmd_tbl_dma(ahci_port, tag);
+
+	cmd_slot->opts = cpu_to_le32(opts);
+	cmd_slot->status = 0;
+	cmd_slot->tbl_addr = cpu_to_le32(lower_32_bits(tbl_dma));
 	if (ahci_port->ahci->cap & HOST_CAP_64)
-		ahci_port->cmd_slot->tbl_addr_hi =
-			cpu_to_le32(upper_32_bits(ahci_port->cmd_tbl_dma));
+		cmd_slot->tbl_addr_hi = cpu_to_le32(upper_32_bits(tbl_dma));
 }
 
-static int ahci_fill_sg(struct ahci_port *ahci_port, dma_addr_t buf_dma, int buf_len)
+static int ahci_fill_sg(struct ahci_port *ahci_port, int tag, dma_addr_t buf_dma,
+			int buf_len)
 {
-	struct ahci_sg *ahci_sg = ahci_port->cmd_tbl_sg;
+	struct ahci_sg *ahci_sg = ahci_cmd_tbl(ahci_port, tag) + AHCI_CMD_TBL_HDR_SZ;
 	u32 sg_count;
 
 	sg_count = ((buf_len - 1) / AHCI_MAX_DATA_BYTE_COUNT) + 1;
@@ -148,11 +166,24 @@ static int ahci_fill_sg(struct ahci_port *ahci_port, dma_addr_t buf_dma, int buf
 	return sg_count;
 }
 
+static void ahci_setup_cmd(struct ahci_port *ahci_port, int tag, u8 *fis,
+			   int fis_len, dma_addr_t buf_dma, int buf_len, bool write)
+{
+	int sg_count;
+	u32 opts;
+
+	memcpy(ahci_cmd_tbl(ahci_port, tag), fis, fis_len);
+
+	sg_count = ahci_fill_sg(ahci_port, tag, buf_dma, buf_len);
+	opts = (fis_len >> 2) | (sg_count << 16);
+	if (write)
+		opts |= CMD_LIST_OPTS_WRITE;
+	ahci_fill_cmd_slot(ahci_port, tag, opts);
+}
+
 static int ahci_io(struct ahci_port *ahci_port, u8 *fis, int fis_len, void *rbuf,
 		const void *wbuf, int buf_len)
 {
-	u32 opts;
-	int sg_count;
 	int ret;
 	void *buf;
 	dma_addr_t buf_dma;
@@ -171,13 +202,7 @@ static int ahci_io(struct ahci_port *ahci_port, u8 *fis, int fis_len, void *rbuf
 
 	buf_dma = dma_map_single(ahci_port->ahci->dev, buf, buf_len, dma_dir);
 
-	memcpy(ahci_port->cmd_tbl, fis, fis_len);
-
-	sg_count = ahci_fill_sg(ahci_port, buf_dma, buf_len);
-	opts = (fis_len >> 2) | (sg_count << 16);
-	if (wbuf)
-		opts |= CMD_LIST_OPTS_WRITE;
-	ahci_fill_cmd_slot(ahci_port, opts);
+	ahci_setup_cmd(ahci_port, 0, fis, fis_len, buf_dma, buf_len, wbuf != NULL);
 
 	ahci_port_write_f(ahci_port, PORT_CMD_ISSUE, 1);
 
@@ -258,9 +283,187 @@ static int ahci_rw(struct ata_port *ata, void *rbuf, const void *wbuf,
 	return 0;
 }
 
+/*
+ * After a failed queued command the device has aborted all outstanding
+ * commands and only accepts new ones once the NCQ error log has been read.
+ * Restart the command list DMA engine, which clears SActive and CI, and
+ * read the log to bring the device back into a usable state.
+ */
+static int ahci_ncq_recover(struct ahci_port *ahci_port)
+{
+	u8 fis[20] = {
+		0x27,			/* Host to device FIS. */
+		1 << 7,			/* Command FIS. */
+		ATA_CMD_READ_LOG_EXT,	/* Command byte. */
+	};
+	u32 cmd, val;
+	u8 *log;
+	int ret;
+
+	cmd = ahci_port_read(ahci_port, PORT_CMD);
+	ahci_port_write_f(ahci_port, PORT_CMD, cmd & ~PORT_CMD_START);
+
+	ret = wait_on_timeout(500 * MSECOND,
+			!(ahci_port_read(ahci_port, PORT_CMD) & PORT_CMD_LIST_ON));
+	if (ret)
+		return ret;
+
+	val = ahci_port_read(ahci_port, PORT_SCR_ERR);
+	ahci_port_write(ahci_port, PORT_SCR_ERR, val);
+	val = ahci_port_read(ahci_port, PORT_IRQ_STAT);
+	ahci_port_write(ahci_port, PORT_IRQ_STAT, val);
+
+	ahci_port_write_f(ahci_port, PORT_CMD, cmd | PORT_CMD_START);
+
+	log = dma_alloc(SECTOR_SIZE);
+	if (!log)
+		return -ENOMEM;
+
+	fis[4] = 0x10;		/* log page: NCQ command error */
+	fis[7] = 1 << 6;
+	fis[12] = 1;		/* one sector */
+
+	ret = ahci_io(ahci_port, fis, sizeof(fis), log, NULL, SECTOR_SIZE);
+	if (!ret && !(log[0] & 0x80))
+		ahci_port_info(ahci_port, "NCQ error on tag %d, status 0x%02x error 0x%02x\n",
+			       log[0] & 0x1f, log[2], log[3]);
+
+	dma_free(log);
+
+	return ret;
+}
+
+static void ahci_queue_fpdma_read(struct ahci_port *ahci_port, int tag,
+				  sector_t block, int num_blocks, dma_addr_t buf_dma)
+{
+	u8 fis[20] = {
+		0x27,			/* Host to device FIS. */
+		1 << 7,			/* Command FIS. */
+		ATA_CMD_FPDMA_READ,	/* Command byte. */
+	};
+
+	/* the sector count goes to the features registers */
+	fis[3] = (num_blocks >> 0) & 0xff;
+	fis[11] = (num_blocks >> 8) & 0xff;
+
+	fis[4] = (block >> 0) & 0xff;
+	fis[5] = (block >> 8) & 0xff;
+	fis[6] = (block >> 16) & 0xff;
+	fis[7] = 1 << 6;	/* device reg: set LBA mode */
+	fis[8] = (block >> 24) & 0xff;
+	fis[9] = (block >> 32) & 0xff;
+	fis[10] = (block >> 40) & 0xff;
+
+	/* and the tag to the sector count register */
+	fis[12] = tag << 3;
+
+	ahci_setup_cmd(ahci_port, tag, fis, sizeof(fis), buf_dma,
+		       num_blocks * SECTOR_SIZE, false);
+}
+
+/*
+ * Read with READ FPDMA QUEUED, keeping up to @depth commands of
+ * AHCI_NCQ_BLOCKS each outstanding. The device completes them in any order,
+ * a tag is reused as soon as its bit in SActive is cleared.
+ */
+static int ahci_read_ncq(struct ahci_port *ahci_port, void *buf, sector_t block,
+			 blkcnt_t num_blocks, unsigned int depth)
+{
+	struct device *dev = ahci_port->ahci->dev;
+	size_t len = num_blocks * SECTOR_SIZE;
+	dma_addr_t buf_dma, pos;
+	u32 busy = 0, issue, done, irq;
+	u64 start;
+	int tag, ret = 0;
+
+	if (!ahci_link_ok(ahci_port, 1))
+		return -EIO;
+
+	buf_dma = dma_map_single(dev, buf, len, DMA_FROM_DEVICE);
+	if (dma_mapping_error(dev, buf_dma))
+		return -EFAULT;
+
+	pos = buf_dma;
+	start = get_time_ns();
+
+	while (num_blocks || busy) {
+		issue = 0;
+
+		while (num_blocks) {
+			int now = min_t(blkcnt_t, AHCI_NCQ_BLOCKS, num_blocks);
+
+			tag = ffs(~(busy | issue)) - 1;
+			if (tag < 0 || tag >= depth)
+				break;
+
+			ahci_queue_fpdma_read(ahci_port, tag, block, now, pos);
+
+			issue |= BIT(tag);
+			pos += now * SECTOR_SIZE;
+			block += now;
+			num_blocks -= now;
+		}
+
+		if (issue) {
+			ahci_port_write_f(ahci_port, PORT_SCR_ACT, issue);
+			ahci_port_write_f(ahci_port, PORT_CMD_ISSUE, issue);
+			busy |= issue;
+		}
+
+		irq = ahci_port_read(ahci_port, PORT_IRQ_STAT);
+		if (irq & (PORT_IRQ_TF_ERR | PORT_IRQ_HBUS_ERR |
+			   PORT_IRQ_HBUS_DATA_ERR | PORT_IRQ_IF_ERR)) {
+			ahci_port_info(ahci_port, "NCQ read failed, irq 0x%08x tfd 0x%08x\n",
+				       irq, ahci_port_read(ahci_port, PORT_TFDATA));
+			ret = -EIO;
+			break;
+		}
+
+		done = busy & ~(ahci_port_read(ahci_port, PORT_SCR_ACT) |
+				ahci_port_read(ahci_port, PORT_CMD_ISSUE));
+		if (done) {
+			busy &= ~done;
+			start = get_time_ns();
+		} else if (is_timeout(start, WAIT_DATAIO)) {
+			ahci_port_info(ahci_port, "NCQ read timeout, active 0x%08x\n",
+				       busy);
+			ret = -ETIMEDOUT;
+			break;
+		}
+	}
+
+	if (ret && ahci_ncq_recover(ahci_port)) {
+		/* device is stuck, keep using plain commands from now on */
+		ahci_port->no_ncq = true;
+	}
+
+	dma_unmap_single(dev, buf_dma, len, DMA_FROM_DEVICE);
+
+	return ret;
+}
+
+/* number of queued commands usable on this port, 0 if NCQ is not supported */
+static unsigned int ahci_ncq_depth(struct ahci_port *ahci_port)
+{
+	struct ata_port *ata = &ahci_port->ata;
+
+	if (!(ahci_port->ahci->cap & HOST_CAP_NCQ) || ahci_port->no_ncq)
+		return 0;
+	if (!ata->lba48 || !ata_id_has_ncq(ata->id))
+		return 0;
+
+	return min_t(unsigned int, ahci_port->n_slots, ata_id_queue_depth(ata->id));
+}
+
 static int ahci_read(struct ata_port *ata, void *buf, sector_t block,
 		blkcnt_t num_blocks)
 {
+	struct ahci_port *ahci_port = container_of(ata, struct ahci_port, ata);
+	unsigned int depth = ahci_ncq_depth(ahci_port);
+
+	if (depth)
+		return ahci_read_ncq(ahci_port, buf, block, num_blocks, depth);
+
 	return ahci_rw(ata, buf, NULL, block, num_blocks);
 }
 
@@ -292,7 +495,13 @@ static int ahci_init_port(struct ahci_port *ahci_port)
 		mdelay(500);
 	}
 
-	mem = dma_alloc_coherent(AHCI_PORT_PRIV_DMA_SZ, &mem_dma);
+	/* one command table per slot usable for queued commands */
+	if (ahci_port->ahci->cap & HOST_CAP_NCQ)
+		ahci_port->n_slots = ((ahci_port->ahci->cap & HOST_CAP_NCS) >> 8) + 1;
+	else
+		ahci_port->n_slots = 1;
+
+	mem = dma_alloc_coherent(AHCI_PORT_PRIV_DMA_SZ(ahci_port->n_slots), &mem_dma);
 	if (!mem) {
 		return -ENOMEM;
 	}
@@ -314,8 +523,8 @@ static int ahci_init_port(struct ahci_port *ahci_port)
 	ahci_port->rx_fis_dma = mem_dma + AHCI_CMD_LIST_SZ;
 
 	/*
-	 * Third item: data area for storing a single command
-	 * and its scatter-gather table
+	 * Third item: data area for storing the commands
+	 * and their scatter-gather tables, one per slot
 	 */
 	ahci_port->cmd_tbl = mem + AHCI_CMD_LIST_SZ + AHCI_RX_FIS_SZ;
 	ahci_port->cmd_tbl_dma = mem_dma + AHCI_CMD_LIST_SZ + AHCI_RX_FIS_SZ;
@@ -323,8 +532,6 @@ static int ahci_init_port(struct ahci_port *ahci_port)
 	ahci_port_debug(ahci_port, "cmd_tbl = 0x%p (0x%pad)\n",
 			ahci_port->cmd_tbl, &ahci_port->cmd_tbl_dma);
 
-	ahci_port->cmd_tbl_sg = ahci_port->cmd_tbl + AHCI_CMD_TBL_HDR_SZ;
-
 	ahci_port_write_f(ahci_port, PORT_LST_ADDR, lower_32_bits(ahci_port->cmd_slot_dma));
 	if (ahci_port->ahci->cap & HOST_CAP_64)
 		ahci_port_write_f(ahci_port, PORT_LST_ADDR_HI, upper_32_bits(ahci_port->cmd_slot_dma));
@@ -414,7 +621,7 @@ static int ahci_init_port(struct ahci_port *ahci_port)
 	ret = -ENODEV;
 
 err_init:
-	dma_free_coherent(mem, mem_dma, AHCI_PORT_PRIV_DMA_SZ);
+	dma_free_coherent(mem, mem_dma, AHCI_PORT_PRIV_DMA_SZ(ahci_port->n_slots));
 	return ret;
 }
 
@@ -17,7 +17,8 @@
 #define AHCI_CMD_TBL_CDB	0x40
 #define AHCI_CMD_TBL_ITM_SZ	16
 #define AHCI_CMD_TBL_SZ		(AHCI_CMD_TBL_HDR_SZ + (AHCI_MAX_SG * AHCI_CMD_TBL_ITM_SZ))
-#define AHCI_PORT_PRIV_DMA_SZ	(AHCI_CMD_LIST_SZ + AHCI_CMD_TBL_SZ + AHCI_RX_FIS_SZ)
+#define AHCI_PORT_PRIV_DMA_SZ(slots)	(AHCI_CMD_LIST_SZ + AHCI_RX_FIS_SZ + \
+					 (slots) * AHCI_CMD_TBL_SZ)
 
 #define AHCI_CMD_ATAPI		(1 << 5)
 #define AHCI_CMD_WRITE		(1 << 6)
@@ -176,9 +177,10 @@ struct ahci_port {
 	void __iomem		*port_mmio;
 	struct ahci_cmd_hdr	*cmd_slot;
 	dma_addr_t		cmd_slot_dma;
-	struct ahci_sg		*cmd_tbl_sg;
-	void			*cmd_tbl;
+	void			*cmd_tbl;	/* n_slots command tables */
 	dma_addr_t		cmd_tbl_dma;
+	unsigned int		n_slots;
+	bool			no_ncq;
 	void			*rx_fis;
 	dma_addr_t		rx_fis_dma;
 };
@@ -338,7 +338,9 @@ static int dwcmshc_probe(struct device *dev)
 
 	sdhci_setup_host(&host->sdhci);
 
-	mci->max_req_size = 0x8000;
+	/* with ADMA2 requests don't stop at SDMA boundaries */
+	if (!(host->sdhci.flags & SDHCI_USE_ADMA))
+		mci->max_req_size = 0x8000;
 	/*
 	 * Let's first initialize f_max to the DT clock freq
 	 * Then mci_of_parse can override if with the content
@@ -319,6 +319,8 @@ static int fsl_esdhc_probe(struct device *dev)
 	host->mci.ops = fsl_esdhc_ops;
 	host->mci.hw_dev = dev;
 	host->sdhci.mci = &host->mci;
+	/* the DMA select bits live in PROCTL[9:8] instead */
+	host->sdhci.quirks |= SDHCI_QUIRK_BROKEN_ADMA;
 
 	ret = sdhci_setup_host(&host->sdhci);
 	if (ret)
@@ -234,6 +234,21 @@ static int mci_poll_until_ready(struct mci *mci, int timeout_ms)
 }
 
 
+/**
+ * Maximum number of blocks a single read or write command may transfer
+ * @param mci MCI instance
+ * @param bl_len Block length of the transfer
+ */
+blkcnt_t mci_max_req_blocks(struct mci *mci, unsigned bl_len)
+{
+	blkcnt_t max = MAX_BUFFER_NUMBER;
+
+	if (mci->host->max_req_size)
+		max = mci->host->max_req_size / bl_len;
+
+	return max;
+}
+
 /**
  * Write one or several blocks of data to the card
  * @param mci_dev MCI instance
@@ -1804,12 +1819,9 @@ static int __maybe_unused mci_sd_write(struct block_device *blk,
 	struct mci *mci = part->mci;
 	struct mci_host *host = mci->host;
 	int rc;
-	blkcnt_t max_req_block = num_blocks;
+	blkcnt_t max_req_block = mci_max_req_blocks(mci, mci->write_bl_len);
 	blkcnt_t write_block;
 
-	if (mci->host->max_req_size)
-		max_req_block = mci->host->max_req_size / mci->write_bl_len;
-
 	mci_blk_part_switch(part);
 
 	if (!host->disable_wp &&
@@ -1848,6 +1860,126 @@ static int __maybe_unused mci_sd_write(struct block_device *blk,
 	return 0;
 }
 
+/* erase at most 1 GiB per command to keep the busy time bounded */
+#define MCI_ERASE_MAX_BLOCKS	SZ_2M
+
+static int mci_erase_blocks(struct mci *mci, sector_t block, blkcnt_t num_blocks)
+{
+	unsigned int start_cmd, end_cmd, arg, timeout_ms;
+	sector_t end = block + num_blocks - 1;
+	struct mci_cmd cmd;
+	int ret;
+
+	if (IS_SD(mci)) {
+		start_cmd = SD_CMD_ERASE_WR_BLK_START;
+		end_cmd = SD_CMD_ERASE_WR_BLK_END;
+		arg = 0;
+		/* no erase timeout from the SD status, assume 250ms per 4MiB */
+		timeout_ms = 1000 + 250 * (num_blocks >> 13);
+	} else {
+		unsigned int group = mci->ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE] << 10;
+
+		start_cmd = MMC_CMD_ERASE_GROUP_START;
+		end_cmd = MMC_CMD_ERASE_GROUP_END;
+		arg = MMC_TRIM_ARG;
+		timeout_ms = 300 * mci->ext_csd[EXT_CSD_TRIM_MULT] *
+			     (num_blocks / max(group, 1U) + 2);
+		timeout_ms = max(timeout_ms, 1000U);
+	}
+
+	if (!mci->high_capacity) {
+		block *= mci->write_bl_len;
+		end *= mci->write_bl_len;
+	}
+
+	ret = mci_poll_until_ready(mci, 1000);
+	if (ret)
+		return ret;
+
+	mci_setup_cmd(&cmd, start_cmd, block, MMC_RSP_R1);
+	ret = mci_send_cmd(mci, &cmd, NULL);
+	if (ret)
+		return ret;
+
+	mci_setup_cmd(&cmd, end_cmd, end, MMC_RSP_R1);
+	ret = mci_send_cmd(mci, &cmd, NULL);
+	if (ret)
+		return ret;
+
+	mci_setup_cmd(&cmd, MMC_CMD_ERASE, arg, MMC_RSP_R1b);
+	ret = mci_send_cmd(mci, &cmd, NULL);
+	if (ret)
+		return ret;
+
+	return mci_poll_until_ready(mci, timeout_ms);
+}
+
+/**
+ * Erase a range of sectors so that they read back as zeroes
+ * @param blk All info about the block device we need
+ * @param block Sector's LBA number to start erasing at
+ * @param num_blocks Sector count to erase
+ * @return 0 on success, -ENOSYS if the card can't erase to zeroes
+ *
+ * SD cards report in the SCR whether erased blocks read as zeroes. eMMCs
+ * report this in the extended CSD and are only used when they support TRIM,
+ * which works on single sectors rather than erase groups.
+ */
+static int __maybe_unused mci_sd_erase(struct block_device *blk,
+				       sector_t block, blkcnt_t num_blocks)
+{
+	struct mci_part *part = container_of(blk, struct mci_part, blk);
+	struct mci *mci = part->mci;
+	struct mci_host *host = mci->host;
+	blkcnt_t now;
+	int ret;
+
+	if (mmc_host_is_spi(host))
+		return -ENOSYS;
+
+	if (IS_SD(mci)) {
+		if (mci->scr[0] & SD_DATA_STAT_AFTER_ERASE)
+			return -ENOSYS;
+	} else {
+		if (!mci->ext_csd || mci->ext_csd[EXT_CSD_ERASED_MEM_CONT] ||
+		    !(mci->ext_csd[EXT_CSD_SEC_FEATURE_SUPPORT] & EXT_CSD_SEC_GB_CL_EN))
+			return -ENOSYS;
+	}
+
+	mci_blk_part_switch(part);
+
+	if (!host->disable_wp &&
+	    host->ops.card_write_protected && host->ops.card_write_protected(host)) {
+		dev_err(&mci->dev, "card write protected\n");
+		return -EPERM;
+	}
+
+	if (block + num_blocks - 1 > MAX_BUFFER_NUMBER) {
+		dev_dbg(&mci->dev, "Cannot handle block number %llu. Too large!\n",
+			block + num_blocks - 1);
+		return -EINVAL;
+	}
+
+	dev_dbg(&mci->dev, "%s: Erase %llu block(s), starting at %llu\n",
+		__func__, num_blocks, block);
+
+	while (num_blocks) {
+		now = min_t(blkcnt_t, num_blocks, MCI_ERASE_MAX_BLOCKS);
+
+		ret = mci_erase_blocks(mci, block, now);
+		if (ret) {
+			dev_dbg(&mci->dev, "Erasing block %llu failed with %d\n",
+				block, ret);
+			return ret;
+		}
+
+		num_blocks -= now;
+		block += now;
+	}
+
+	return 0;
+}
+
 /**
  * Read a chunk of sectors from the drive
  * @param blk All info about the block device we need
@@ -1863,13 +1995,10 @@ static int mci_sd_read(struct block_device *blk, void *buffer, sector_t block,
 {
 	struct mci_part *part = container_of(blk, struct mci_part, blk);
 	struct mci *mci = part->mci;
-	blkcnt_t max_req_block = num_blocks;
+	blkcnt_t max_req_block = mci_max_req_blocks(mci, mci->read_bl_len);
 	blkcnt_t read_block;
 	int rc;
 
-	if (mci->host->max_req_size)
-		max_req_block = mci->host->max_req_size / mci->read_bl_len;
-
 	mci_blk_part_switch(part);
 
 	dev_dbg(&mci->dev, "%s: Read %llu block(s), starting at %llu\n",
@@ -2102,6 +2231,7 @@ static struct block_device_ops mci_ops = {
 	.read = mci_sd_read,
 #ifdef CONFIG_BLOCK_WRITE
 	.write = mci_sd_write,
+	.erase = mci_sd_erase,
 #endif
 };
 
@@ -456,6 +456,12 @@ static void sdhci_config_dma(struct sdhci *host)
 	ctrl = sdhci_read8(host, SDHCI_HOST_CONTROL);
 	/* Note if DMA Select is zero then SDMA is selected */
 	ctrl &= ~SDHCI_CTRL_DMA_MASK;
+	if (host->adma_active) {
+		if (host->flags & SDHCI_USE_64_BIT_DMA && !host->v4_mode)
+			ctrl |= SDHCI_CTRL_ADMA64;
+		else
+			ctrl |= SDHCI_CTRL_ADMA32;
+	}
 	sdhci_write8(host, SDHCI_HOST_CONTROL, ctrl);
 
 	if (host->flags & SDHCI_USE_64_BIT_DMA) {
@@ -472,6 +478,61 @@ static void sdhci_config_dma(struct sdhci *host)
 	}
 }
 
+/*
+ * Describe the mapped buffer in the ADMA2 descriptor table, so the whole
+ * transfer runs without stopping at SDMA buffer boundaries. Descriptors
+ * don't cross 64KiB boundaries, which also keeps controllers happy which
+ * can't DMA across larger ones (like DWC MSHC at 128MiB). Returns false
+ * if the buffer can't be transferred with ADMA2.
+ */
+static bool sdhci_adma_table_pre(struct sdhci *host, dma_addr_t addr,
+				 unsigned int len)
+{
+	struct sdhci_adma2_desc *desc = NULL;
+	void *table = host->adma_table;
+	unsigned int now, desc_sz;
+
+	if (!(host->flags & SDHCI_USE_ADMA))
+		return false;
+
+	/* v4 mode may be enabled only after sdhci_setup_host() */
+	if (!(host->flags & SDHCI_USE_64_BIT_DMA))
+		desc_sz = 8;
+	else if (host->v4_mode)
+		desc_sz = 16;
+	else
+		desc_sz = 12;
+
+	/* descriptors hold 32-bit aligned addresses */
+	if (!IS_ALIGNED(addr, 4) ||
+	    DIV_ROUND_UP((addr & (SDHCI_ADMA2_MAX_LEN - 1)) + len,
+			 SDHCI_ADMA2_MAX_LEN) > SDHCI_ADMA2_MAX_DESCS)
+		return false;
+
+	if (!(host->flags & SDHCI_USE_64_BIT_DMA) && upper_32_bits(addr + len - 1))
+		return false;
+
+	while (len) {
+		now = min_t(unsigned int, len, SDHCI_ADMA2_MAX_LEN -
+			    (addr & (SDHCI_ADMA2_MAX_LEN - 1)));
+
+		desc = table;
+		desc->cmd = cpu_to_le16(ADMA2_TRAN_VALID);
+		desc->len = cpu_to_le16(now & 0xffff);
+		desc->addr_lo = cpu_to_le32(lower_32_bits(addr));
+		if (host->flags & SDHCI_USE_64_BIT_DMA)
+			desc->addr_hi = cpu_to_le32(upper_32_bits(addr));
+
+		table += desc_sz;
+		addr += now;
+		len -= now;
+	}
+
+	desc->cmd |= cpu_to_le16(ADMA2_END);
+
+	return true;
+}
+
 void sdhci_setup_data_dma(struct sdhci *sdhci, struct mci_data *data,
 			  dma_addr_t *dma)
 {
@@ -500,14 +561,28 @@ void sdhci_setup_data_dma(struct sdhci *sdhci, struct mci_data *data,
 		return;
 	}
 
+	sdhci->adma_active = sdhci_adma_table_pre(sdhci, *dma, nbytes);
+
 	sdhci_config_dma(sdhci);
-	sdhci_set_sdma_addr(sdhci, *dma);
+
+	if (sdhci->adma_active) {
+		u32 ier = sdhci_read32(sdhci, SDHCI_INT_ENABLE);
+
+		if (!(ier & SDHCI_INT_ADMA_ERROR))
+			sdhci_write32(sdhci, SDHCI_INT_ENABLE,
+				      ier | SDHCI_INT_ADMA_ERROR);
+
+		sdhci_set_adma_addr(sdhci, sdhci->adma_addr);
+	} else {
+		sdhci_set_sdma_addr(sdhci, *dma);
+	}
 }
 
 int sdhci_transfer_data_dma(struct sdhci *sdhci, struct mci_data *data,
 			    dma_addr_t dma)
 {
 	struct device *dev = sdhci_dev(sdhci);
+	dma_addr_t addr = dma;
 	u64 start;
 	int nbytes;
 	u32 irqstat;
@@ -538,10 +613,17 @@ int sdhci_transfer_data_dma(struct sdhci *sdhci, struct mci_data *data,
 			goto out;
 		}
 
+		if (irqstat & SDHCI_INT_ADMA_ERROR) {
+			dev_err(dev, "ADMA error: 0x%08x\n", irqstat);
+			ret = -EIO;
+			goto out;
+		}
+
 		/*
-		 * We currently don't do anything fancy with DMA
-		 * boundaries, but as we can't disable the feature
-		 * we need to at least restart the transfer.
+		 * SDMA stops at every buffer boundary, but as we can't
+		 * disable the feature we need to restart the transfer.
+		 * ADMA2 transfers don't stop until the end of the
+		 * descriptor table.
 		 *
 		 * According to the spec sdhci_readl(host, SDHCI_DMA_ADDRESS)
 		 * should return a valid address to continue from, but as
@@ -553,7 +635,9 @@ int sdhci_transfer_data_dma(struct sdhci *sdhci, struct mci_data *data,
 			 * the interrupt and kick the DMA engine again.
 			 */
 			sdhci_write32(sdhci, SDHCI_INT_STATUS, SDHCI_INT_DMA);
-			sdhci_set_sdma_addr(sdhci, ALIGN(dma, SDHCI_DEFAULT_BOUNDARY_SIZE));
+			addr = ALIGN_DOWN(addr, SDHCI_DEFAULT_BOUNDARY_SIZE) +
+			       SDHCI_DEFAULT_BOUNDARY_SIZE;
+			sdhci_set_sdma_addr(sdhci, addr);
 		}
 
 		if (irqstat & SDHCI_INT_XFER_COMPLETE)
@@ -928,6 +1012,22 @@ void __sdhci_read_caps(struct sdhci *host, const u16 *ver,
 	}
 }
 
+static void sdhci_setup_adma(struct sdhci *host)
+{
+	if (IN_PBL || host->quirks & SDHCI_QUIRK_BROKEN_ADMA ||
+	    host->version < SDHCI_SPEC_200 ||
+	    !(host->caps & SDHCI_CAN_DO_ADMA2))
+		return;
+
+	host->adma_table = dma_alloc_coherent(SDHCI_ADMA2_MAX_DESCS *
+					      sizeof(struct sdhci_adma2_desc),
+					      &host->adma_addr);
+	if (!host->adma_table)
+		return;
+
+	host->flags |= SDHCI_USE_ADMA;
+}
+
 int sdhci_setup_host(struct sdhci *host)
 {
 	struct mci_host *mci = host->mci;
@@ -978,6 +1078,12 @@ int sdhci_setup_host(struct sdhci *host)
 	if (sdhci_can_64bit_dma(host))
 		host->flags |= SDHCI_USE_64_BIT_DMA;
 
+	sdhci_setup_adma(host);
+
+	/* the block count register has 16 bits */
+	if (!mci->max_req_size)
+		mci->max_req_size = 0xffff * 512;
+
 	if ((mci->caps2 & (MMC_CAP2_HS200_1_8V_SDR | MMC_CAP2_HS400_1_8V)))
 		host->flags |= SDHCI_SIGNALING_180;
 
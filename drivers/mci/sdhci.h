@@ -102,6 +102,7 @@
 #define  SDHCI_RESET_DATA			BIT(2)
 #define SDHCI_INT_STATUS					0x30
 #define SDHCI_INT_NORMAL_STATUS					0x30
+#define  SDHCI_INT_ADMA_ERROR			BIT(25)
 #define  SDHCI_INT_DATA_END_BIT			BIT(22)
 #define  SDHCI_INT_DATA_CRC			BIT(21)
 #define  SDHCI_INT_DATA_TIMEOUT			BIT(20)
@@ -200,6 +201,25 @@
 #define SDHCI_MAX_DIV_SPEC_200	256
 #define SDHCI_MAX_DIV_SPEC_300	2046
 
+/* ADMA2 descriptor attributes */
+#define ADMA2_VALID		BIT(0)
+#define ADMA2_END		BIT(1)
+#define ADMA2_TRAN_VALID	(0x20 | ADMA2_VALID)
+
+/* length 0 means 64KiB */
+#define SDHCI_ADMA2_MAX_LEN	SZ_64K
+/* enough for the largest possible request (65535 blocks of 512 bytes) */
+#define SDHCI_ADMA2_MAX_DESCS	513
+
+/* 32-bit, 64-bit (12 byte) and v4 mode 64-bit (16 byte) descriptors */
+struct sdhci_adma2_desc {
+	__le16	cmd;
+	__le16	len;
+	__le32	addr_lo;
+	__le32	addr_hi;
+	__le32	reserved;
+} __packed __aligned(4);
+
 struct sdhci {
 	u32 (*read32)(struct sdhci *host, int reg);
 	u16 (*read16)(struct sdhci *host, int reg);
@@ -235,6 +255,7 @@ struct sdhci {
 	bool v4_mode;		/* Host Version 4 Enable */
 
 	unsigned int quirks;
+#define SDHCI_QUIRK_BROKEN_ADMA			BIT(6)
 #define SDHCI_QUIRK_MISSING_CAPS		BIT(27)
 	unsigned int quirks2;
 #define SDHCI_QUIRK2_CLOCK_DIV_ZERO_BROKEN	BIT(15)
@@ -244,6 +265,10 @@ struct sdhci {
 	bool read_caps;	/* Capability flags have been read */
 	u32 sdma_boundary;
 
+	void *adma_table;	/* ADMA2 descriptor table */
+	dma_addr_t adma_addr;	/* Mapped ADMA2 descriptor table */
+	bool adma_active;	/* Current request uses ADMA2 */
+
 	unsigned int		tuning_count;	/* Timer count for re-tuning */
 	unsigned int		tuning_mode;	/* Re-tuning mode supported by host */
 	unsigned int		tuning_err;	/* Error code for re-tuning */
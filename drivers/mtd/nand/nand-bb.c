@@ -65,7 +65,8 @@ static ssize_t nand_bb_read(struct cdev *cdev, void *buf, size_t count,
 			now = max;
 
 		ret = mtd_read(bb->mtd, bb->offset, now, &retlen, buf);
-		if (ret < 0)
+		/* corrected bitflips, the data is fine */
+		if (ret < 0 && ret != -EUCLEAN)
 			return ret;
 		buf += retlen;
 		count -= retlen;
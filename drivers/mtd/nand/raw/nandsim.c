@@ -0,0 +1,760 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * nandsim.c - RAM backed NAND flash simulator
+ *
+ * Simulates an ONFI compliant SLC NAND chip behind an ->exec_op()
+ * controller, so the raw NAND core, the software ECC engines, the bad block
+ * handling and everything stacked on top (UBI, UBIFS) run unmodified. The
+ * geometry is chosen when a simulator is created with the nandsim command,
+ * its contents can be loaded from a file, e.g. a host file in sandbox.
+ *
+ * Erase blocks are only allocated once they are programmed, erased blocks
+ * don't use memory. Programming can only clear bits like on real NAND.
+ *
+ * Array operations keep the chip busy for tR, tPROG and tBERS, data
+ * transfers take tRC per byte. These are device parameters, so throughput
+ * measured on top of the simulator resembles real hardware and can be
+ * compared between runs. Bitflips can be injected into the data read from
+ * the array to exercise ECC correction.
+ */
+
+#define pr_fmt(fmt) "nandsim: " fmt
+
+#include <common.h>
+#include <command.h>
+#include <clock.h>
+#include <driver.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fs.h>
+#include <getopt.h>
+#include <libfile.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include <linux/log2.h>
+#include <linux/sizes.h>
+#include <linux/mtd/mtd.h>
+#include <linux/mtd/rawnand.h>
+#include <linux/mtd/onfi.h>
+#include <mtd/nandsim.h>
+
+#include "internals.h"
+
+#define NANDSIM_MFR_ID		0x00
+#define NANDSIM_DEV_ID		0x01
+#define NANDSIM_PARAM_PAGES	3
+
+struct nandsim {
+	struct device dev;
+	struct nand_controller base;
+	struct nand_chip chip;
+
+	/* geometry */
+	unsigned int pagesize;
+	unsigned int oobsize;
+	unsigned int rawpagesize;	/* pagesize + oobsize */
+	unsigned int pages_per_block;
+	unsigned int nblocks;
+	unsigned int ecc_bits;
+	u8 **blocks;			/* NULL for erased blocks */
+
+	/* chip state */
+	u8 cmd;				/* last command cycle */
+	bool fail;			/* last program/erase failed */
+	unsigned int col;
+	unsigned int row;
+	u8 *reg;			/* page register */
+	const u8 *out;			/* what DATA_IN reads from */
+	unsigned int outlen;
+	u64 ready_at;
+
+	u8 id[8];
+	struct nand_onfi_params onfi[NANDSIM_PARAM_PAGES];
+
+	/* timing model and fault injection */
+	u32 t_r;			/* us */
+	u32 t_prog;			/* us */
+	u32 t_bers;			/* us */
+	u32 t_rc;			/* ns per byte */
+	u32 bitflips;
+	u32 bitflip_ratio;
+
+	/* statistics */
+	u64 nreads;
+	u64 nprogs;
+	u64 nerases;
+	u64 nbitflips;
+	u64 busy_ns;
+};
+
+static struct nandsim *chip_to_nandsim(struct nand_chip *chip)
+{
+	return container_of(chip, struct nandsim, chip);
+}
+
+static u8 *nandsim_page(struct nandsim *ns, unsigned int row)
+{
+	unsigned int block = row / ns->pages_per_block;
+	unsigned int page = row % ns->pages_per_block;
+
+	if (!ns->blocks[block])
+		return NULL;
+
+	return ns->blocks[block] + page * ns->rawpagesize;
+}
+
+/* Start an array operation, the chip is busy for @us */
+static void nandsim_start_busy(struct nandsim *ns, u32 us)
+{
+	ns->ready_at = get_time_ns() + us * NSEC_PER_USEC;
+	ns->busy_ns += us * NSEC_PER_USEC;
+}
+
+static bool nandsim_ready(struct nandsim *ns)
+{
+	return get_time_ns() >= ns->ready_at;
+}
+
+static void nandsim_wait_ready(struct nandsim *ns)
+{
+	while (!nandsim_ready(ns))
+		;
+}
+
+static void nandsim_transfer(struct nandsim *ns, unsigned int len)
+{
+	u64 ns_total = (u64)len * ns->t_rc;
+	u64 end = get_time_ns() + ns_total;
+
+	ns->busy_ns += ns_total;
+
+	while (get_time_ns() < end)
+		;
+}
+
+static u8 nandsim_status(struct nandsim *ns)
+{
+	u8 status = NAND_STATUS_WP;
+
+	if (nandsim_ready(ns))
+		status |= NAND_STATUS_READY | NAND_STATUS_TRUE_READY;
+	if (ns->fail)
+		status |= NAND_STATUS_FAIL;
+
+	return status;
+}
+
+static void nandsim_inject_bitflips(struct nandsim *ns)
+{
+	unsigned int flips;
+
+	if (!ns->bitflips || prandom_u32_max(ns->bitflip_ratio))
+		return;
+
+	/* only the data area, flipped bad block markers would be fatal */
+	flips = 1 + prandom_u32_max(ns->bitflips);
+	ns->nbitflips += flips;
+
+	while (flips--) {
+		unsigned int bit = prandom_u32_max(ns->pagesize * 8);
+
+		ns->reg[bit / 8] ^= 1 << (bit % 8);
+	}
+}
+
+static void nandsim_read_page(struct nandsim *ns)
+{
+	const u8 *page;
+
+	ns->out = ns->reg;
+	ns->outlen = ns->rawpagesize;
+
+	if (ns->row >= ns->nblocks * ns->pages_per_block) {
+		memset(ns->reg, 0xff, ns->rawpagesize);
+		return;
+	}
+
+	page = nandsim_page(ns, ns->row);
+	if (page)
+		memcpy(ns->reg, page, ns->rawpagesize);
+	else
+		memset(ns->reg, 0xff, ns->rawpagesize);
+
+	nandsim_inject_bitflips(ns);
+
+	ns->nreads++;
+	nandsim_start_busy(ns, ns->t_r);
+}
+
+static void nandsim_program_page(struct nandsim *ns)
+{
+	unsigned int block = ns->row / ns->pages_per_block;
+	unsigned int i;
+	u8 *page;
+
+	ns->fail = false;
+
+	if (block >= ns->nblocks) {
+		ns->fail = true;
+		return;
+	}
+
+	if (!ns->blocks[block]) {
+		ns->blocks[block] = malloc(ns->rawpagesize * ns->pages_per_block);
+		if (!ns->blocks[block]) {
+			ns->fail = true;
+			return;
+		}
+		memset(ns->blocks[block], 0xff, ns->rawpagesize * ns->pages_per_block);
+	}
+
+	/* programming can only clear bits */
+	page = nandsim_page(ns, ns->row);
+	for (i = 0; i < ns->rawpagesize; i++)
+		page[i] &= ns->reg[i];
+
+	ns->nprogs++;
+	nandsim_start_busy(ns, ns->t_prog);
+}
+
+static void nandsim_erase_block(struct nandsim *ns)
+{
+	unsigned int block = ns->row / ns->pages_per_block;
+
+	ns->fail = false;
+
+	if (block >= ns->nblocks) {
+		ns->fail = true;
+		return;
+	}
+
+	free(ns->blocks[block]);
+	ns->blocks[block] = NULL;
+
+	ns->nerases++;
+	nandsim_start_busy(ns, ns->t_bers);
+}
+
+static void nandsim_cmd(struct nandsim *ns, u8 cmd)
+{
+	switch (cmd) {
+	case NAND_CMD_RESET:
+		ns->fail = false;
+		ns->out = NULL;
+		break;
+	case NAND_CMD_SEQIN:
+		memset(ns->reg, 0xff, ns->rawpagesize);
+		break;
+	case NAND_CMD_READSTART:
+		nandsim_read_page(ns);
+		break;
+	case NAND_CMD_RNDOUTSTART:
+		break;
+	case NAND_CMD_PAGEPROG:
+		nandsim_program_page(ns);
+		break;
+	case NAND_CMD_ERASE2:
+		nandsim_erase_block(ns);
+		break;
+	case NAND_CMD_STATUS:
+		ns->out = NULL;
+		break;
+	case NAND_CMD_PARAM:
+		ns->out = (u8 *)ns->onfi;
+		ns->outlen = sizeof(ns->onfi);
+		ns->col = 0;
+		break;
+	}
+
+	/* the status command doesn't interrupt a running sequence */
+	if (cmd != NAND_CMD_STATUS)
+		ns->cmd = cmd;
+}
+
+static void nandsim_addr(struct nandsim *ns, const u8 *addrs, unsigned int naddrs)
+{
+	static const u8 onfi_sig[] = { 'O', 'N', 'F', 'I' };
+	unsigned int i, row = 0;
+
+	switch (ns->cmd) {
+	case NAND_CMD_READID:
+		if (addrs[0] == 0x20) {
+			ns->out = onfi_sig;
+			ns->outlen = sizeof(onfi_sig);
+		} else {
+			ns->out = ns->id;
+			ns->outlen = sizeof(ns->id);
+		}
+		ns->col = 0;
+		break;
+	case NAND_CMD_RNDOUT:
+	case NAND_CMD_RNDIN:
+		ns->col = addrs[0] | addrs[1] << 8;
+		break;
+	case NAND_CMD_READ0:
+	case NAND_CMD_SEQIN:
+		ns->col = addrs[0] | addrs[1] << 8;
+		for (i = 2; i < naddrs; i++)
+			row |= addrs[i] << (8 * (i - 2));
+		ns->row = row;
+		break;
+	case NAND_CMD_ERASE1:
+		for (i = 0; i < naddrs; i++)
+			row |= addrs[i] << (8 * i);
+		ns->row = row;
+		break;
+	}
+}
+
+static void nandsim_data_in(struct nandsim *ns, u8 *buf, unsigned int len)
+{
+	unsigned int i;
+
+	nandsim_transfer(ns, len);
+
+	if (!ns->out) {
+		memset(buf, nandsim_status(ns), len);
+		return;
+	}
+
+	for (i = 0; i < len; i++, ns->col++)
+		buf[i] = ns->col < ns->outlen ? ns->out[ns->col] : 0xff;
+}
+
+static void nandsim_data_out(struct nandsim *ns, const u8 *buf, unsigned int len)
+{
+	unsigned int n = 0;
+
+	nandsim_transfer(ns, len);
+
+	if (ns->col < ns->rawpagesize)
+		n = min(len, ns->rawpagesize - ns->col);
+
+	memcpy(ns->reg + ns->col, buf, n);
+	ns->col += len;
+}
+
+static int nandsim_exec_op(struct nand_chip *chip, const struct nand_operation *op,
+			   bool check_only)
+{
+	struct nandsim *ns = chip_to_nandsim(chip);
+	const struct nand_op_instr *instr;
+	unsigned int i;
+
+	if (check_only)
+		return 0;
+
+	for (i = 0; i < op->ninstrs; i++) {
+		instr = &op->instrs[i];
+
+		switch (instr->type) {
+		case NAND_OP_CMD_INSTR:
+			nandsim_cmd(ns, instr->ctx.cmd.opcode);
+			break;
+		case NAND_OP_ADDR_INSTR:
+			nandsim_addr(ns, instr->ctx.addr.addrs, instr->ctx.addr.naddrs);
+			break;
+		case NAND_OP_DATA_IN_INSTR:
+			nandsim_data_in(ns, instr->ctx.data.buf.in, instr->ctx.data.len);
+			break;
+		case NAND_OP_DATA_OUT_INSTR:
+			nandsim_data_out(ns, instr->ctx.data.buf.out, instr->ctx.data.len);
+			break;
+		case NAND_OP_WAITRDY_INSTR:
+			nandsim_wait_ready(ns);
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static int nandsim_attach_chip(struct nand_chip *chip)
+{
+	struct nandsim *ns = chip_to_nandsim(chip);
+
+	chip->ecc.engine_type = NAND_ECC_ENGINE_TYPE_SOFT;
+
+	if (ns->ecc_bits > 1) {
+		chip->ecc.algo = NAND_ECC_ALGO_BCH;
+		chip->ecc.size = 512;
+		chip->ecc.strength = ns->ecc_bits;
+	} else {
+		chip->ecc.algo = NAND_ECC_ALGO_HAMMING;
+	}
+
+	return 0;
+}
+
+static const struct nand_controller_ops nandsim_controller_ops = {
+	.attach_chip = nandsim_attach_chip,
+	.exec_op = nandsim_exec_op,
+};
+
+static void nandsim_init_onfi(struct nandsim *ns)
+{
+	struct nand_onfi_params *p = &ns->onfi[0];
+	unsigned int i, npages = ns->nblocks * ns->pages_per_block;
+
+	memcpy(p->sig, "ONFI", 4);
+	p->revision = cpu_to_le16(ONFI_VERSION_1_0);
+	memcpy(p->manufacturer, "BAREBOX     ", sizeof(p->manufacturer));
+	memcpy(p->model, "NANDSIM             ", sizeof(p->model));
+	p->jedec_id = NANDSIM_MFR_ID;
+	p->byte_per_page = cpu_to_le32(ns->pagesize);
+	p->spare_bytes_per_page = cpu_to_le16(ns->oobsize);
+	p->pages_per_block = cpu_to_le32(ns->pages_per_block);
+	p->blocks_per_lun = cpu_to_le32(ns->nblocks);
+	p->lun_count = 1;
+	p->addr_cycles = 2 << 4 | (npages > SZ_64K ? 3 : 2);
+	p->bits_per_cell = 1;
+	p->programs_per_page = 4;
+	p->ecc_bits = ns->ecc_bits;
+	p->sdr_timing_modes = cpu_to_le16(BIT(0));
+	p->t_prog = cpu_to_le16(min_t(u32, ns->t_prog, U16_MAX));
+	p->t_bers = cpu_to_le16(min_t(u32, ns->t_bers, U16_MAX));
+	p->t_r = cpu_to_le16(min_t(u32, ns->t_r, U16_MAX));
+	p->t_ccs = cpu_to_le16(1);
+	p->crc = cpu_to_le16(onfi_crc16(ONFI_CRC_BASE, (u8 *)p, 254));
+
+	for (i = 1; i < NANDSIM_PARAM_PAGES; i++)
+		ns->onfi[i] = *p;
+
+	ns->id[0] = NANDSIM_MFR_ID;
+	ns->id[1] = NANDSIM_DEV_ID;
+}
+
+/*
+ * Load a raw image as written by nanddump -o: each page followed by its OOB
+ * data. The image is copied to the array as is, including ECC and bad block
+ * markers.
+ */
+static int nandsim_load_raw(struct nandsim *ns, int fd)
+{
+	size_t blocksize = ns->rawpagesize * ns->pages_per_block;
+	unsigned int block;
+	u8 *buf;
+	int ret = 0;
+
+	buf = xmalloc(blocksize);
+
+	for (block = 0; block < ns->nblocks; block++) {
+		memset(buf, 0xff, blocksize);
+
+		ret = read_full(fd, buf, blocksize);
+		if (ret <= 0)
+			break;
+
+		if (memchr_inv(buf, 0xff, blocksize)) {
+			ns->blocks[block] = buf;
+			buf = xmalloc(blocksize);
+		}
+	}
+
+	free(buf);
+
+	return ret < 0 ? ret : 0;
+}
+
+/*
+ * Load an image containing the page data only. It is programmed through the
+ * NAND core, so that the ECC is generated, and bad blocks are skipped like
+ * nandwrite does. The timing model is disabled while loading.
+ */
+static int nandsim_load_data(struct nandsim *ns, int fd)
+{
+	struct mtd_info *mtd = nand_to_mtd(&ns->chip);
+	u32 t_r = ns->t_r, t_prog = ns->t_prog, t_rc = ns->t_rc;
+	loff_t ofs = 0;
+	size_t retlen;
+	u8 *buf;
+	int ret = 0;
+
+	buf = xmalloc(mtd->erasesize);
+
+	ns->t_r = ns->t_prog = ns->t_rc = 0;
+
+	for (ofs = 0; ofs < mtd->size; ofs += mtd->erasesize) {
+		if (mtd_block_isbad(mtd, ofs))
+			continue;
+
+		memset(buf, 0xff, mtd->erasesize);
+
+		ret = read_full(fd, buf, mtd->erasesize);
+		if (ret <= 0)
+			break;
+
+		if (!memchr_inv(buf, 0xff, mtd->erasesize))
+			continue;
+
+		ret = mtd_write(mtd, ofs, mtd->erasesize, &retlen, buf);
+		if (ret)
+			break;
+	}
+
+	ns->t_r = t_r;
+	ns->t_prog = t_prog;
+	ns->t_rc = t_rc;
+	ns->nreads = ns->nprogs = ns->busy_ns = 0;
+
+	free(buf);
+
+	return ret < 0 ? ret : 0;
+}
+
+/* Mark @block bad the way the factory does: in the OOB of its first pages */
+void nandsim_mark_bad(struct nandsim *ns, unsigned int block)
+{
+	unsigned int page;
+
+	if (!ns->blocks[block]) {
+		ns->blocks[block] = xmalloc(ns->rawpagesize * ns->pages_per_block);
+		memset(ns->blocks[block], 0xff, ns->rawpagesize * ns->pages_per_block);
+	}
+
+	for (page = 0; page < 2; page++)
+		memset(ns->blocks[block] + page * ns->rawpagesize + ns->pagesize, 0, 2);
+}
+
+struct nandsim *nandsim_create(unsigned int pagesize, unsigned int oobsize,
+			       unsigned int pages_per_block, unsigned int nblocks,
+			       unsigned int ecc_bits)
+{
+	struct nandsim *ns;
+
+	if (!is_power_of_2(pagesize) || pagesize < SZ_1K || pagesize > SZ_16K ||
+	    !is_power_of_2(pages_per_block) || pages_per_block > 1024 ||
+	    !is_power_of_2(nblocks) || oobsize < 16 || oobsize > pagesize / 4) {
+		pr_err("unsupported geometry\n");
+		return ERR_PTR(-EINVAL);
+	}
+
+	if (ecc_bits > 1 && !IS_ENABLED(CONFIG_MTD_NAND_ECC_SW_BCH)) {
+		pr_err("%u bit ECC needs the software BCH engine\n", ecc_bits);
+		return ERR_PTR(-ENOSYS);
+	}
+
+	ns = xzalloc(sizeof(*ns));
+
+	ns->pagesize = pagesize;
+	ns->oobsize = oobsize;
+	ns->rawpagesize = pagesize + oobsize;
+	ns->pages_per_block = pages_per_block;
+	ns->nblocks = nblocks;
+	ns->ecc_bits = ecc_bits ?: 1;
+	ns->blocks = xzalloc(nblocks * sizeof(*ns->blocks));
+	ns->reg = xmalloc(ns->rawpagesize);
+
+	/* typical SLC NAND, ONFI timing mode 0 */
+	ns->t_r = 25;
+	ns->t_prog = 200;
+	ns->t_bers = 2000;
+	ns->t_rc = 25;
+	ns->bitflip_ratio = 1;
+
+	return ns;
+}
+
+void nandsim_free(struct nandsim *ns)
+{
+	unsigned int block;
+
+	for (block = 0; block < ns->nblocks; block++)
+		free(ns->blocks[block]);
+
+	free(ns->blocks);
+	free(ns->reg);
+	free(ns);
+}
+
+int nandsim_register(struct nandsim *ns)
+{
+	struct nand_chip *chip = &ns->chip;
+	struct mtd_info *mtd = nand_to_mtd(chip);
+	struct device *dev = &ns->dev;
+	int ret;
+
+	nandsim_init_onfi(ns);
+
+	dev_set_name(dev, "nandsim");
+	dev->id = DEVICE_ID_DYNAMIC;
+	ret = register_device(dev);
+	if (ret)
+		return ret;
+
+	nand_controller_init(&ns->base);
+	ns->base.ops = &nandsim_controller_ops;
+	chip->controller = &ns->base;
+	mtd->dev.parent = dev;
+
+	ret = nand_scan(chip, 1);
+	if (ret)
+		goto err_unregister;
+
+	ret = add_mtd_nand_device(mtd, "nand");
+	if (ret)
+		goto err_cleanup;
+
+	dev_add_param_uint32(dev, "tR", NULL, NULL, &ns->t_r, "%u", NULL);
+	dev_add_param_uint32(dev, "tPROG", NULL, NULL, &ns->t_prog, "%u", NULL);
+	dev_add_param_uint32(dev, "tBERS", NULL, NULL, &ns->t_bers, "%u", NULL);
+	dev_add_param_uint32(dev, "tRC", NULL, NULL, &ns->t_rc, "%u", NULL);
+	dev_add_param_uint32(dev, "bitflips", NULL, NULL, &ns->bitflips, "%u", NULL);
+	dev_add_param_uint32(dev, "bitflip_ratio", NULL, NULL,
+			     &ns->bitflip_ratio, "%u", NULL);
+	dev_add_param_uint64_ro(dev, "reads", &ns->nreads, "%llu");
+	dev_add_param_uint64_ro(dev, "programs", &ns->nprogs, "%llu");
+	dev_add_param_uint64_ro(dev, "erases", &ns->nerases, "%llu");
+	dev_add_param_uint64_ro(dev, "injected_bitflips", &ns->nbitflips, "%llu");
+	dev_add_param_uint64_ro(dev, "busy_ns", &ns->busy_ns, "%llu");
+
+	dev_info(dev, "%s: %u blocks of %u pages of %u+%u bytes\n", mtd->cdev.name,
+		 ns->nblocks, ns->pages_per_block, ns->pagesize, ns->oobsize);
+
+	return 0;
+
+err_cleanup:
+	nand_cleanup(chip);
+err_unregister:
+	unregister_device(dev);
+
+	return ret;
+}
+
+/* Remove a registered simulator and free it */
+void nandsim_unregister(struct nandsim *ns)
+{
+	del_mtd_device(nand_to_mtd(&ns->chip));
+	nand_cleanup(&ns->chip);
+	unregister_device(&ns->dev);
+	nandsim_free(ns);
+}
+
+struct mtd_info *nandsim_mtd(struct nandsim *ns)
+{
+	return nand_to_mtd(&ns->chip);
+}
+
+static int do_nandsim(int argc, char *argv[])
+{
+	unsigned int pagesize = SZ_2K, oobsize = 64, pages_per_block = 64;
+	unsigned int nblocks = 256, ecc_bits = 1;
+	const char *filename = NULL, *badblocks = NULL;
+	bool with_oob = false;
+	struct nandsim *ns;
+	int opt, ret, fd = -1;
+
+	while ((opt = getopt(argc, argv, "p:s:b:n:e:f:oB:")) > 0) {
+		switch (opt) {
+		case 'p':
+			pagesize = simple_strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			oobsize = simple_strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			pages_per_block = simple_strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			nblocks = simple_strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			ecc_bits = simple_strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			filename = optarg;
+			break;
+		case 'o':
+			with_oob = true;
+			break;
+		case 'B':
+			badblocks = optarg;
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (optind != argc)
+		return COMMAND_ERROR_USAGE;
+
+	if (filename) {
+		fd = open(filename, O_RDONLY);
+		if (fd < 0) {
+			printf("Cannot open %s: %pe\n", filename, ERR_PTR(fd));
+			return fd;
+		}
+	}
+
+	ns = nandsim_create(pagesize, oobsize, pages_per_block, nblocks, ecc_bits);
+	if (IS_ERR(ns)) {
+		ret = PTR_ERR(ns);
+		goto out;
+	}
+
+	if (fd >= 0 && with_oob) {
+		ret = nandsim_load_raw(ns, fd);
+		if (ret)
+			goto err_load;
+	}
+
+	while (badblocks && *badblocks) {
+		char *end;
+		unsigned long block = simple_strtoul(badblocks, &end, 0);
+
+		if (end == badblocks || block >= nblocks) {
+			printf("invalid bad block list\n");
+			ret = -EINVAL;
+			goto err;
+		}
+
+		nandsim_mark_bad(ns, block);
+		badblocks = *end == ',' ? end + 1 : end;
+	}
+
+	ret = nandsim_register(ns);
+	if (ret)
+		goto err;
+
+	/* the simulator stays registered, with what could be loaded */
+	if (fd >= 0 && !with_oob) {
+		ret = nandsim_load_data(ns, fd);
+		if (ret)
+			printf("Cannot load %s: %pe\n", filename, ERR_PTR(ret));
+	}
+
+	goto out;
+
+err_load:
+	printf("Cannot load %s: %pe\n", filename, ERR_PTR(ret));
+err:
+	nandsim_free(ns);
+out:
+	if (fd >= 0)
+		close(fd);
+
+	return ret;
+}
+
+BAREBOX_CMD_HELP_START(nandsim)
+BAREBOX_CMD_HELP_TEXT("Create a RAM backed simulated NAND chip. Timing and bitflip injection")
+BAREBOX_CMD_HELP_TEXT("are controlled by the parameters of the nandsim device.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT("-p BYTES", "page size (default 2048)")
+BAREBOX_CMD_HELP_OPT("-s BYTES", "OOB size per page (default 64)")
+BAREBOX_CMD_HELP_OPT("-b PAGES", "pages per erase block (default 64)")
+BAREBOX_CMD_HELP_OPT("-n BLOCKS", "number of erase blocks (default 256)")
+BAREBOX_CMD_HELP_OPT("-e BITS", "ECC strength per 512 bytes, >1 uses BCH (default 1)")
+BAREBOX_CMD_HELP_OPT("-f FILE", "load contents from FILE")
+BAREBOX_CMD_HELP_OPT("-o", "FILE contains OOB data after each page (nanddump -o)")
+BAREBOX_CMD_HELP_OPT("-B LIST", "comma separated list of factory bad blocks")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(nandsim)
+	.cmd		= do_nandsim,
+	BAREBOX_CMD_DESC("create a simulated NAND chip")
+	BAREBOX_CMD_OPTS("[-psbnefoB]")
+	BAREBOX_CMD_GROUP(CMD_GRP_HWMANIP)
+	BAREBOX_CMD_HELP(cmd_nandsim_help)
+BAREBOX_CMD_END
@@ -189,13 +189,15 @@ static int fec_rbd_init(struct fec_priv *fec, int count, int size)
 	int ix;
 
 	for (ix = 0; ix < count; ix++) {
-		writew(FEC_RBD_EMPTY, &fec->rbd_base[ix].status);
+		u16 status = ix == count - 1 ? FEC_RBD_WRAP : 0;
+
+		/* the FEC stops at buffers which still have to be mapped */
+		if (fec->rx_dma[ix] != DMA_ERROR_CODE)
+			status |= FEC_RBD_EMPTY;
+
+		writew(status, &fec->rbd_base[ix].status);
 		writew(0, &fec->rbd_base[ix].data_length);
 	}
-	/*
-	 * mark the last RBD to close the ring
-	 */
-	writew(FEC_RBD_WRAP | FEC_RBD_EMPTY, &fec->rbd_base[ix - 1].status);
 	fec->rbd_index = 0;
 
 	return 0;
@@ -524,6 +526,73 @@ static int fec_send(struct eth_device *dev, void *eth_data, int data_length)
 	return 0;
 }
 
+static int fec_map_receive_packet(struct fec_priv *fec, int i)
+{
+	dma_addr_t dma;
+
+	/*
+	 * Make sure there are no outstanding writes to the
+	 * region of memory we are going to use as receive
+	 * buffers as well as check that DMA mapping is valid
+	 */
+	dma = dma_map_single(fec->dev, fec->rx_buf[i], FEC_MAX_PKT_SIZE,
+			     DMA_FROM_DEVICE);
+	if (dma_mapping_error(fec->dev, dma)) {
+		fec->rx_dma[i] = DMA_ERROR_CODE;
+		return -EFAULT;
+	}
+
+	fec->rx_dma[i] = dma;
+	writel(dma, &fec->rbd_base[i].data_pointer);
+
+	return 0;
+}
+
+static void fec_unmap_receive_packet(struct fec_priv *fec, int i)
+{
+	if (fec->rx_dma[i] == DMA_ERROR_CODE)
+		return;
+
+	dma_unmap_single(fec->dev, fec->rx_dma[i], FEC_MAX_PKT_SIZE,
+			 DMA_FROM_DEVICE);
+	fec->rx_dma[i] = DMA_ERROR_CODE;
+}
+
+/*
+ * Receive buffers are allocated one by one with net_alloc_packet(), so the
+ * network stack can keep a received frame and replace its buffer.
+ */
+static int fec_alloc_receive_packets(struct fec_priv *fec, int count)
+{
+	int i, ret;
+
+	ret = net_alloc_packets(fec->rx_buf, count);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < count; i++) {
+		ret = fec_map_receive_packet(fec, i);
+		if (ret) {
+			while (i--)
+				fec_unmap_receive_packet(fec, i);
+			net_free_packets(fec->rx_buf, count);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+static void fec_free_receive_packets(struct fec_priv *fec, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		fec_unmap_receive_packet(fec, i);
+
+	net_free_packets(fec->rx_buf, count);
+}
+
 /**
  * Pull one frame from the card
  * @param[in] dev Our ethernet device to handle
@@ -568,6 +637,16 @@ static int fec_recv(struct eth_device *dev)
 		}
 	}
 
+	/*
+	 * The buffer replacing a frame kept by the network stack couldn't be
+	 * mapped. The descriptor was not given back to the FEC, retry.
+	 */
+	if (fec->rx_dma[fec->rbd_index] == DMA_ERROR_CODE) {
+		if (fec_map_receive_packet(fec, fec->rbd_index))
+			return 0;
+		goto next;
+	}
+
 	/*
 	 * ensure reading the right buffer status
 	 */
@@ -583,15 +662,13 @@ static int fec_recv(struct eth_device *dev)
 		const uint16_t data_length = readw(&rbd->data_length);
 
 		if (data_length - 4 > 14) {
-			void *frame = phys_to_virt(readl(&rbd->data_pointer));
+			void *frame = fec->rx_buf[fec->rbd_index];
 			/*
-			 * Sync the data for CPU so that endianness
-			 * fixup and net_receive below would get
-			 * proper data
+			 * Unmap the buffer so that endianness fixup and
+			 * net_receive below get proper data and the stack
+			 * may keep it. It's mapped again when it's not kept.
 			 */
-			dma_sync_single_for_cpu(fec->dev, (unsigned long)frame,
-						data_length,
-						DMA_FROM_DEVICE);
+			fec_unmap_receive_packet(fec, fec->rbd_index);
 			if (fec_is_imx28(fec))
 				imx28_fix_endianess_rd(frame,
 						       (data_length + 3) >> 2);
@@ -600,12 +677,22 @@ static int fec_recv(struct eth_device *dev)
 			 * Get buffer address and size
 			 */
 			len = data_length - 4;
-			net_receive(dev, frame, len);
-			dma_sync_single_for_device(fec->dev, (unsigned long)frame,
-						   data_length,
-						   DMA_FROM_DEVICE);
+			net_receive_buf(dev, &fec->rx_buf[fec->rbd_index],
+					frame, len);
 		}
 	}
+
+	/*
+	 * Map the buffer again, or the new one if the stack kept the frame.
+	 * Without a mapping the descriptor must not be given back to the
+	 * FEC, it still points to the frame.
+	 */
+	if (fec->rx_dma[fec->rbd_index] == DMA_ERROR_CODE &&
+	    fec_map_receive_packet(fec, fec->rbd_index)) {
+		dev_warn(&dev->dev, "cannot map receive buffer\n");
+		return len;
+	}
+next:
 	/*
 	 * free the current buffer, restart the engine
 	 * and move forward to the next buffer
@@ -617,40 +704,6 @@ static int fec_recv(struct eth_device *dev)
 	return len;
 }
 
-static int fec_alloc_receive_packets(struct fec_priv *fec, int count, int size)
-{
-	void *p;
-	int i;
-
-
-	p = dma_alloc(size * count);
-	if (!p)
-		return -ENOMEM;
-
-	for (i = 0; i < count; i++) {
-		dma_addr_t dma;
-		/*
-		 * Make sure there are no outstanding writes to the
-		 * region of memory we are going to use as receive
-		 * buffers as well as check that DMA mapping is valid
-		 */
-		dma = dma_map_single(fec->dev, p, size, DMA_FROM_DEVICE);
-		if (dma_mapping_error(fec->dev, dma))
-			return -EFAULT;
-
-		writel(dma, &fec->rbd_base[i].data_pointer);
-		p += size;
-	}
-
-	return 0;
-}
-
-static void fec_free_receive_packets(struct fec_priv *fec, int count, int size)
-{
-	void *p = phys_to_virt(fec->rbd_base[0].data_pointer);
-	dma_free(p);
-}
-
 #ifdef CONFIG_OFDEVICE
 static int fec_probe_dt(struct device *dev, struct fec_priv *fec)
 {
@@ -870,7 +923,7 @@ static int fec_probe(struct device *dev)
 	base += FEC_RBD_NUM * sizeof(struct buffer_descriptor);
 	fec->tbd_base = base;
 
-	ret = fec_alloc_receive_packets(fec, FEC_RBD_NUM, FEC_MAX_PKT_SIZE);
+	ret = fec_alloc_receive_packets(fec, FEC_RBD_NUM);
 	if (ret < 0)
 		goto free_xbd;
 
@@ -908,7 +961,7 @@ static int fec_probe(struct device *dev)
 unregister_eth:
 	eth_unregister(edev);
 free_receive_packets:
-	fec_free_receive_packets(fec, FEC_RBD_NUM, FEC_MAX_PKT_SIZE);
+	fec_free_receive_packets(fec, FEC_RBD_NUM);
 free_xbd:
 	dma_free_coherent(fec->rbd_base, 0, FEC_XBD_SIZE);
 free_gpio:
@@ -137,12 +137,22 @@ enum fec_opt_clock {
 /**
  * @brief i.MX27-FEC private structure
  */
+/**
+ * @brief Numbers of buffer descriptors for receiving
+ *
+ * The number defines the stocked memory buffers for the receiving task.
+ * Larger values makes no sense in this limited environment.
+ */
+#define FEC_RBD_NUM		64
+
 struct fec_priv {
 	struct eth_device edev;
 	struct device *dev;
 	void __iomem *regs;
 	struct buffer_descriptor __iomem *rbd_base;	/* RBD ring                  */
 	int rbd_index;				/* next receive BD to read   */
+	void *rx_buf[FEC_RBD_NUM];		/* buffers of the RBD ring   */
+	dma_addr_t rx_dma[FEC_RBD_NUM];		/* their mappings or DMA_ERROR_CODE */
 	struct buffer_descriptor __iomem *tbd_base;	/* TBD ring                  */
 	int tbd_index;				/* next transmit BD to write */
 	int phy_addr;
@@ -171,14 +181,6 @@ static inline int fec_is_imx6(struct fec_priv *priv)
 	return priv->type == FEC_TYPE_IMX6;
 }
 
-/**
- * @brief Numbers of buffer descriptors for receiving
- *
- * The number defines the stocked memory buffers for the receiving task.
- * Larger values makes no sense in this limited environment.
- */
-#define FEC_RBD_NUM		64
-
 /**
  * @brief Define the ethernet packet size limit in memory
  *
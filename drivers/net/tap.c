@@ -15,7 +15,7 @@
 struct tap_priv {
 	int fd;
 	char *name;
-	char *rx_buf;
+	void *rx_buf;
 };
 
 static int tap_eth_send(struct eth_device *edev, void *packet, int length)
@@ -34,7 +34,7 @@ static int tap_eth_rx(struct eth_device *edev)
 	length = linux_read_nonblock(priv->fd, priv->rx_buf, PKTSIZE);
 
 	if (length > 0)
-		net_receive(edev, priv->rx_buf, length);
+		net_receive_buf(edev, &priv->rx_buf, priv->rx_buf, length);
 
 	return 0;
 }
@@ -74,7 +74,11 @@ static int tap_probe(struct device *dev)
 		goto out;
 	}
 
-	priv->rx_buf = xmalloc(PKTSIZE);
+	priv->rx_buf = net_alloc_packet();
+	if (!priv->rx_buf) {
+		ret = -ENOMEM;
+		goto out;
+	}
 
 	edev = xzalloc(sizeof(struct eth_device));
 	edev->priv = priv;
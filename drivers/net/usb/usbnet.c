@@ -6,6 +6,8 @@
 #include <errno.h>
 #include <malloc.h>
 #include <linux/phy.h>
+#include <linux/log2.h>
+#include <linux/sizes.h>
 #include <dma.h>
 
 /* handles CDC Ethernet and many other network "bulk data" interfaces */
@@ -115,14 +117,12 @@ static int usbnet_send(struct eth_device *edev, void *eth_data, int data_length)
 	return ret;
 }
 
-static int usbnet_recv(struct eth_device *edev)
+static int usbnet_recv_sync(struct eth_device *edev)
 {
 	struct usbnet		*dev = (struct usbnet*) edev->priv;
 	struct driver_info	*info = dev->driver_info;
 	int len, ret, alen = 0;
 
-	dev_dbg(&edev->dev, "%s\n",__func__);
-
 	len = dev->rx_urb_size;
 
 	ret = usb_bulk_msg(dev->udev, dev->in, dev->rx_buf, len, &alen, 2);
@@ -139,6 +139,79 @@ static int usbnet_recv(struct eth_device *edev)
         return 0;
 }
 
+static void usbnet_rx_complete(struct urb *urb)
+{
+	struct usbnet		*dev = urb->context;
+	struct driver_info	*info = dev->driver_info;
+
+	/* failed URBs are submitted again on the next poll */
+	if (urb->status) {
+		if (urb->status != -ENOENT)
+			dev_dbg(&dev->edev.dev, "rx urb: %pe\n",
+				ERR_PTR(urb->status));
+		return;
+	}
+
+	if (urb->actual_length) {
+		if (info->rx_fixup)
+			info->rx_fixup(dev, urb->transfer_buffer,
+				       urb->actual_length);
+		else
+			net_receive(&dev->edev, urb->transfer_buffer,
+				    urb->actual_length);
+	}
+
+	usb_submit_urb(urb);
+}
+
+static void usbnet_kill_rx_urbs(struct usbnet *dev)
+{
+	int i;
+
+	for (i = 0; i < USBNET_RX_URBS; i++)
+		usb_kill_urb(&dev->rx_urb[i]);
+}
+
+/*
+ * Keep all RX URBs queued, so frames arriving back to back are received
+ * while the previous ones are processed, and collect the completed ones.
+ * Falls back to a synchronous transfer per poll if the host controller
+ * can't queue the URBs.
+ */
+static int usbnet_recv(struct eth_device *edev)
+{
+	struct usbnet		*dev = (struct usbnet*) edev->priv;
+	int i, ret;
+
+	dev_dbg(&edev->dev, "%s\n",__func__);
+
+	if (dev->rx_sync)
+		return usbnet_recv_sync(edev);
+
+	for (i = 0; i < USBNET_RX_URBS; i++) {
+		struct urb *urb = &dev->rx_urb[i];
+
+		/* still queued or waiting for its completion handler */
+		if (!list_empty(&urb->list))
+			continue;
+
+		ret = usb_submit_urb(urb);
+		if (ret == -EOPNOTSUPP || ret == -EINVAL) {
+			dev_dbg(&edev->dev, "cannot queue rx urbs: %pe\n",
+				ERR_PTR(ret));
+			usbnet_kill_rx_urbs(dev);
+			dev->rx_sync = true;
+			return usbnet_recv_sync(edev);
+		}
+		if (ret)
+			break;
+	}
+
+	usb_poll_urbs(dev->udev);
+
+	return 0;
+}
+
 static int usbnet_init(struct eth_device *edev)
 {
 	struct usbnet		*dev = (struct usbnet*) edev->priv;
@@ -180,7 +253,24 @@ static int usbnet_open(struct eth_device *edev)
 
 static void usbnet_halt(struct eth_device *edev)
 {
+	struct usbnet		*dev = (struct usbnet*)edev->priv;
+
 	dev_dbg(&edev->dev, "%s\n",__func__);
+
+	usbnet_kill_rx_urbs(dev);
+}
+
+/*
+ * Align RX buffers to their size, so a buffer of up to 64KiB never crosses
+ * a 64KiB boundary, which xHCI can't do in a single TRB, and starts on a
+ * page if it is larger, which keeps EHCI within a single qTD.
+ */
+static void *usbnet_alloc_rx_buf(size_t size)
+{
+	size_t align = clamp_t(size_t, roundup_pow_of_two(size),
+			       DMA_ALIGNMENT, SZ_64K);
+
+	return memalign(align, ALIGN(size, DMA_ALIGNMENT));
 }
 
 int usbnet_probe(struct usb_device *usbdev, const struct usb_device_id *prod)
@@ -188,7 +278,7 @@ int usbnet_probe(struct usb_device *usbdev, const struct usb_device_id *prod)
 	struct usbnet *undev;
 	struct eth_device *edev;
 	struct driver_info *info;
-	int status;
+	int status, i;
 
 	dev_dbg(&usbdev->dev, "%s\n", __func__);
 
@@ -220,12 +310,20 @@ int usbnet_probe(struct usb_device *usbdev, const struct usb_device_id *prod)
 		undev->rx_urb_size = 1514; /* FIXME: What to put here? */
 	undev->maxpacket = usb_maxpacket(undev->udev, undev->out);
 
-	undev->rx_buf = dma_alloc(undev->rx_urb_size);
-	if (!undev->rx_buf) {
-		status = -ENOMEM;
-		goto out1;
+	for (i = 0; i < USBNET_RX_URBS; i++) {
+		void *buf = usbnet_alloc_rx_buf(undev->rx_urb_size);
+
+		if (!buf) {
+			status = -ENOMEM;
+			goto out1;
+		}
+
+		usb_fill_bulk_urb(&undev->rx_urb[i], usbdev, undev->in, buf,
+				  undev->rx_urb_size, usbnet_rx_complete, undev);
 	}
 
+	undev->rx_buf = undev->rx_urb[0].transfer_buffer;
+
 	undev->tx_buf = dma_alloc(4096);
 	if (!undev->tx_buf) {
 		status = -ENOMEM;
@@ -248,6 +346,9 @@ void usbnet_disconnect(struct usb_device *usbdev)
 	struct usbnet *undev = usbdev->drv_data;
 	struct eth_device *edev = &undev->edev;
 	struct driver_info *info;
+	int i;
+
+	usbnet_kill_rx_urbs(undev);
 
 	info = undev->driver_info;
 	if (info->unbind)
@@ -255,7 +356,8 @@ void usbnet_disconnect(struct usb_device *usbdev)
 
 	eth_unregister(edev);
 
-	free(undev->rx_buf);
+	for (i = 0; i < USBNET_RX_URBS; i++)
+		free(undev->rx_urb[i].transfer_buffer);
 	free(undev->tx_buf);
 	free(undev);
 }
@@ -31,7 +31,7 @@ struct virtio_net_priv {
 		};
 	};
 
-	char rx_buff[VIRTIO_NET_NUM_RX_BUFS][VIRTIO_NET_RX_BUF_SIZE];
+	void *rx_buff[VIRTIO_NET_NUM_RX_BUFS];
 	bool rx_running;
 	int net_hdr_len;
 	struct eth_device edev;
@@ -108,17 +108,25 @@ static int virtio_net_recv(struct eth_device *edev)
 	struct virtio_sg *sgs[] = { &sg };
 	unsigned int len;
 	void *buf;
+	int i;
 
-	sg.addr = virtqueue_get_buf(priv->rx_vq, &len);
-	if (!sg.addr)
+	buf = virtqueue_get_buf(priv->rx_vq, &len);
+	if (!buf)
 		return -EAGAIN;
 
+	sg.addr = buf;
 	sg.length = VIRTIO_NET_RX_BUF_SIZE;
 
-	buf = sg.addr + priv->net_hdr_len;
 	len -= priv->net_hdr_len;
 
-	net_receive(edev, buf, len);
+	net_receive_buf(edev, &sg.addr, buf + priv->net_hdr_len, len);
+
+	/* the stack kept the buffer, remember its replacement */
+	if (sg.addr != buf) {
+		for (i = 0; i < VIRTIO_NET_NUM_RX_BUFS; i++)
+			if (priv->rx_buff[i] == buf)
+				priv->rx_buff[i] = sg.addr;
+	}
 
 	/* Put the buffer back to the rx ring */
 	virtqueue_add(priv->rx_vq, sgs, 0, 1);
@@ -184,9 +192,15 @@ static int virtio_net_probe(struct virtio_device *vdev)
 	else
 		priv->net_hdr_len = sizeof(struct virtio_net_hdr);
 
+	ret = net_alloc_packets(priv->rx_buff, VIRTIO_NET_NUM_RX_BUFS);
+	if (ret)
+		return ret;
+
 	ret = virtio_find_vqs(vdev, 2, priv->vqs);
-	if (ret < 0)
+	if (ret < 0) {
+		net_free_packets(priv->rx_buff, VIRTIO_NET_NUM_RX_BUFS);
 		return ret;
+	}
 
 	priv->vdev = vdev;
 
@@ -212,6 +226,7 @@ static void virtio_net_remove(struct virtio_device *vdev)
 	eth_unregister(&priv->edev);
 	vdev->config->del_vqs(vdev);
 
+	net_free_packets(priv->rx_buff, VIRTIO_NET_NUM_RX_BUFS);
 	free(priv);
 }
 
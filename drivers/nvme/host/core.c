@@ -239,8 +239,11 @@ static void nvme_setup_flush(struct nvme_ns *ns, struct nvme_command *cmnd)
 	cmnd->common.nsid = cpu_to_le32(ns->head->ns_id);
 }
 
-static int nvme_submit_sync_rw(struct nvme_ns *ns, struct nvme_command *cmnd,
-			       void *buffer, sector_t block, blkcnt_t num_blocks)
+/* Commands per nvme_submit_rw() batch, the queue depth bounds those in flight */
+#define NVME_RW_BATCH	64
+
+static int nvme_submit_rw(struct nvme_ns *ns, u8 opcode, void *buffer,
+			  sector_t block, blkcnt_t num_blocks)
 {
 	/*
 	 * ns->ctrl->max_hw_sectors is in units of 512 bytes, so we
@@ -248,53 +251,71 @@ static int nvme_submit_sync_rw(struct nvme_ns *ns, struct nvme_command *cmnd,
 	 */
 	const u32 max_hw_sectors =
 		ns->ctrl->max_hw_sectors >> (ns->lba_shift - 9);
-	int ret;
+	struct nvme_ctrl *ctrl = ns->ctrl;
+	struct nvme_command *cmds;
+	struct nvme_request *reqs;
+	sector_t start = block;
+	blkcnt_t len = num_blocks;
+	unsigned i, nr;
+	int ret = 0;
 
-	if (num_blocks > max_hw_sectors) {
-		while (num_blocks) {
-			const u32 chunk = min_t(blkcnt_t, num_blocks,
-						max_hw_sectors);
+	cmds = kcalloc(NVME_RW_BATCH, sizeof(*cmds), GFP_KERNEL);
+	reqs = kcalloc(NVME_RW_BATCH, sizeof(*reqs), GFP_KERNEL);
+	if (!cmds || !reqs) {
+		ret = -ENOMEM;
+		goto out;
+	}
 
-			ret = nvme_submit_sync_rw(ns, cmnd, buffer, block,
-						  chunk);
-			if (ret)
-				break;
+	/* split at MDTS and submit the pieces in batches */
+	while (len && !ret) {
+		for (nr = 0; nr < NVME_RW_BATCH && len; nr++) {
+			const u32 chunk = min_t(blkcnt_t, len, max_hw_sectors);
 
-			num_blocks -= chunk;
-			buffer += chunk;
-			block += chunk;
-		}
+			memset(&cmds[nr], 0, sizeof(cmds[nr]));
+			cmds[nr].rw.opcode = opcode;
+			nvme_setup_rw(ns, &cmds[nr], start, chunk);
 
-		return ret;
-	}
+			reqs[nr].cmd = &cmds[nr];
+			reqs[nr].buffer = buffer;
+			reqs[nr].buffer_len = chunk << ns->lba_shift;
 
-	nvme_setup_rw(ns, cmnd, block, num_blocks);
+			buffer += chunk << ns->lba_shift;
+			start += chunk;
+			len -= chunk;
+		}
 
-	ret = __nvme_submit_sync_cmd(ns->ctrl, cmnd, NULL, buffer,
-				     num_blocks << ns->lba_shift,
-				     0, NVME_QID_IO);
+		if (ctrl->ops->submit_io_cmds) {
+			ret = ctrl->ops->submit_io_cmds(ctrl, reqs, nr, 0);
+			continue;
+		}
+
+		for (i = 0; i < nr && !ret; i++)
+			ret = __nvme_submit_sync_cmd(ctrl, reqs[i].cmd, NULL,
+						     reqs[i].buffer,
+						     reqs[i].buffer_len,
+						     0, NVME_QID_IO);
+	}
 
 	if (ret) {
-		dev_err(ns->ctrl->dev,
+		dev_err(ctrl->dev,
 			"I/O failed: block: %llu, num blocks: %llu, status code type: %xh, status code %02xh\n",
 			block, num_blocks, (ret >> 8) & 0xf,
 			ret & 0xff);
-		return -EIO;
+		ret = -EIO;
 	}
+out:
+	kfree(cmds);
+	kfree(reqs);
 
-	return 0;
+	return ret;
 }
 
-
 static int nvme_block_device_read(struct block_device *blk, void *buffer,
 				  sector_t block, blkcnt_t num_blocks)
 {
 	struct nvme_ns *ns = to_nvme_ns(blk);
-	struct nvme_command cmnd = { };
-
-	cmnd.rw.opcode = nvme_cmd_read;
 
-	return nvme_submit_sync_rw(ns, &cmnd, buffer, block, num_blocks);
+	return nvme_submit_rw(ns, nvme_cmd_read, buffer, block, num_blocks);
 }
 
 static int __maybe_unused
@@ -302,15 +323,12 @@ nvme_block_device_write(struct block_device *blk, const void *buffer,
 			sector_t block, blkcnt_t num_blocks)
 {
 	struct nvme_ns *ns = to_nvme_ns(blk);
-	struct nvme_command cmnd = { };
 
 	if (ns->readonly)
 		return -EINVAL;
 
-	cmnd.rw.opcode = nvme_cmd_write;
-
-	return nvme_submit_sync_rw(ns, &cmnd, (void *)buffer, block,
-				   num_blocks);
+	return nvme_submit_rw(ns, nvme_cmd_write, (void *)buffer, block,
+			      num_blocks);
 }
 
 static int __maybe_unused nvme_block_device_flush(struct block_device *blk)
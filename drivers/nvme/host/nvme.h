@@ -21,6 +21,7 @@ struct nvme_request {
 	struct nvme_command	*cmd;
 	union nvme_result	result;
 	u16			status;
+	bool			done;
 
 	void *buffer;
 	unsigned int buffer_len;
@@ -78,6 +79,10 @@ struct nvme_ctrl_ops {
 			       void *buffer,
 			       unsigned bufflen,
 			       unsigned timeout, int qid);
+	/* optional, submits several read/write requests to the I/O queue */
+	int (*submit_io_cmds)(struct nvme_ctrl *ctrl,
+			      struct nvme_request *reqs, unsigned nr,
+			      unsigned timeout);
 };
 
 static inline bool nvme_ctrl_ready(struct nvme_ctrl *ctrl)
@@ -99,6 +104,7 @@ static inline void nvme_end_request(struct nvme_request *rq, __le16 status,
 {
 	rq->status = le16_to_cpu(status) >> 1;
 	rq->result = result;
+	rq->done = true;
 }
 
 int nvme_disable_ctrl(struct nvme_ctrl *ctrl, u64 cap);
@@ -15,17 +15,28 @@
 
 #define NVME_MAX_KB_SZ	4096
 
-static int io_queue_depth = 2;
+static int io_queue_depth = 64;
+
+/* command id of a request we gave up on, reserved until it completes */
+#define NVME_REQ_ABANDONED	((struct nvme_request *)-1)
 
 struct nvme_dev;
 
+/* PRP list of one command slot, allocated on first use and grown on demand */
+struct nvme_prp_list {
+	__le64 *list;
+	dma_addr_t dma;
+	unsigned int size;
+};
+
 /*
  * An NVM Express queue.  Each device has at least two (one for admin
  * commands and one for I/O commands).
  */
 struct nvme_queue {
 	struct nvme_dev *dev;
-	struct nvme_request *req;
+	struct nvme_request **reqs;	/* in flight requests by command id */
+	struct nvme_prp_list *prps;	/* PRP lists by command id */
 	struct nvme_command *sq_cmds;
 	volatile struct nvme_completion *cqes;
 	dma_addr_t sq_dma_addr;
@@ -36,8 +47,6 @@ struct nvme_queue {
 	u16 cq_head;
 	u16 qid;
 	u8 cq_phase;
-
-	u16 counter;
 };
 
 /*
@@ -54,9 +63,6 @@ struct nvme_dev {
 	void __iomem *bar;
 	bool subsystem;
 	struct nvme_ctrl ctrl;
-	__le64 *prp_pool;
-	unsigned int prp_pool_size;
-	dma_addr_t prp_dma;
 };
 
 static inline struct nvme_dev *to_nvme_dev(struct nvme_ctrl *ctrl)
@@ -65,6 +71,7 @@ static inline struct nvme_dev *to_nvme_dev(struct nvme_ctrl *ctrl)
 }
 
 static int nvme_pci_setup_prps(struct nvme_dev *dev,
+			       struct nvme_prp_list *prps,
 			       const struct nvme_request *req,
 			       struct nvme_rw_command *cmnd)
 {
@@ -74,7 +81,7 @@ static int nvme_pci_setup_prps(struct nvme_dev *dev,
 	u32 offset = dma_addr & (page_size - 1);
 	u64 prp1 = dma_addr;
 	__le64 *prp_list;
-	int i, nprps;
+	int i, nprps, size;
 	dma_addr_t prp_dma;
 
 
@@ -91,17 +98,22 @@ static int nvme_pci_setup_prps(struct nvme_dev *dev,
 		goto done;
 	}
 
+	/* the last entry of each list page chains to the next one */
 	nprps = DIV_ROUND_UP(length, page_size);
-	if (nprps > dev->prp_pool_size) {
-		dma_free_coherent(dev->prp_pool, dev->prp_dma,
-				  dev->prp_pool_size * sizeof(u64));
-		dev->prp_pool_size = nprps;
-		dev->prp_pool = dma_alloc_coherent(nprps * sizeof(u64),
-						   &dev->prp_dma);
+	size = DIV_ROUND_UP(nprps, (page_size >> 3) - 1) * page_size;
+	if (size > prps->size) {
+		if (prps->list)
+			dma_free_coherent(prps->list, prps->dma, prps->size);
+		prps->list = dma_alloc_coherent(size, &prps->dma);
+		if (!prps->list) {
+			prps->size = 0;
+			return -ENOMEM;
+		}
+		prps->size = size;
 	}
 
-	prp_list = dev->prp_pool;
-	prp_dma  = dev->prp_dma;
+	prp_list = prps->list;
+	prp_dma  = prps->dma;
 
 	i = 0;
 	for (;;) {
@@ -128,8 +140,11 @@ static int nvme_pci_setup_prps(struct nvme_dev *dev,
 	return 0;
 }
 
-static int nvme_map_data(struct nvme_dev *dev, struct nvme_request *req)
+static int nvme_map_data(struct nvme_dev *dev, struct nvme_prp_list *prps,
+			 struct nvme_request *req)
 {
+	int ret;
+
 	if (!req->buffer || !req->buffer_len)
 		return 0;
 
@@ -138,7 +153,12 @@ static int nvme_map_data(struct nvme_dev *dev, struct nvme_request *req)
 	if (dma_mapping_error(dev->dev, req->buffer_dma_addr))
 		return -EFAULT;
 
-	return nvme_pci_setup_prps(dev, req, &req->cmd->rw);
+	ret = nvme_pci_setup_prps(dev, prps, req, &req->cmd->rw);
+	if (ret)
+		dma_unmap_single(dev->dev, req->buffer_dma_addr,
+				 req->buffer_len, req->dma_dir);
+
+	return ret;
 }
 
 static void nvme_unmap_data(struct nvme_dev *dev, struct nvme_request *req)
@@ -167,6 +187,9 @@ static int nvme_alloc_queue(struct nvme_dev *dev, int qid, int depth)
 	if (!nvmeq->sq_cmds)
 		goto free_cqdma;
 
+	nvmeq->reqs = xzalloc(depth * sizeof(*nvmeq->reqs));
+	nvmeq->prps = xzalloc(depth * sizeof(*nvmeq->prps));
+
 	nvmeq->dev = dev;
 	nvmeq->cq_head = 0;
 	nvmeq->cq_phase = 1;
@@ -279,20 +302,84 @@ static int nvme_create_queue(struct nvme_queue *nvmeq, int qid)
 	return result;
 }
 
+/*
+ * Give up on all commands in flight on the I/O queue. Deleting the
+ * submission queue aborts them, so their buffers and command ids can be
+ * reused once the queues are created again. Should that fail, the
+ * controller is disabled, it must not access the buffers anymore.
+ */
+static int nvme_reset_io_queue(struct nvme_dev *dev)
+{
+	struct nvme_queue *nvmeq = &dev->queues[NVME_QID_IO];
+	int i, ret;
+
+	for (i = 0; i < nvmeq->q_depth; i++)
+		if (nvmeq->reqs[i])
+			nvmeq->reqs[i] = NVME_REQ_ABANDONED;
+
+	dev->online_queues--;
+
+	ret = adapter_delete_queue(dev, nvme_admin_delete_sq, NVME_QID_IO);
+	if (!ret)
+		ret = adapter_delete_cq(dev, NVME_QID_IO);
+	if (ret) {
+		dev_err(dev->dev, "Failed to delete I/O queue, disabling controller\n");
+		nvme_disable_ctrl(&dev->ctrl, dev->ctrl.cap);
+		return ret < 0 ? ret : -EIO;
+	}
+
+	memset(nvmeq->reqs, 0, nvmeq->q_depth * sizeof(*nvmeq->reqs));
+	memset((void *)nvmeq->cqes, 0, CQ_SIZE(nvmeq->q_depth));
+
+	return nvme_create_queue(nvmeq, NVME_QID_IO);
+}
+
 /**
- * nvme_submit_cmd() - Copy a command into a queue and ring the doorbell
+ * nvme_queue_cmd() - Copy a command into a queue
  * @nvmeq: The queue to use
  * @cmd: The command to send
+ *
+ * The command is only started with the next nvme_ring_sq_doorbell().
  */
-static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+static void nvme_queue_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 {
 	memcpy(&nvmeq->sq_cmds[nvmeq->sq_tail], cmd, sizeof(*cmd));
 
 	if (++nvmeq->sq_tail == nvmeq->q_depth)
 		nvmeq->sq_tail = 0;
+}
+
+static inline void nvme_ring_sq_doorbell(struct nvme_queue *nvmeq)
+{
 	writel(nvmeq->sq_tail, nvmeq->q_db);
 }
 
+/**
+ * nvme_submit_cmd() - Copy a command into a queue and ring the doorbell
+ * @nvmeq: The queue to use
+ * @cmd: The command to send
+ */
+static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+{
+	nvme_queue_cmd(nvmeq, cmd);
+	nvme_ring_sq_doorbell(nvmeq);
+}
+
+/* Find a free command id, one less than the queue depth can be in flight */
+static int nvme_get_tag(struct nvme_queue *nvmeq)
+{
+	int tag, free = -EBUSY, busy = 0;
+
+	for (tag = nvmeq->q_depth - 1; tag >= 0; tag--) {
+		if (nvmeq->reqs[tag])
+			busy++;
+		else
+			free = tag;
+	}
+
+	return busy < nvmeq->q_depth - 1 ? free : -EBUSY;
+}
+
 /* We read the CQE phase first to check if the rest of the entry is valid */
 static inline bool nvme_cqe_pending(struct nvme_queue *nvmeq)
 {
@@ -310,7 +397,7 @@ static inline void nvme_ring_cq_doorbell(struct nvme_queue *nvmeq)
 static inline void nvme_handle_cqe(struct nvme_queue *nvmeq, u16 idx)
 {
 	volatile struct nvme_completion *cqe = &nvmeq->cqes[idx];
-	struct nvme_request *req = nvmeq->req;
+	struct nvme_request *req;
 
 	if (unlikely(cqe->command_id >= nvmeq->q_depth)) {
 		dev_warn(nvmeq->dev->ctrl.dev,
@@ -319,9 +406,16 @@ static inline void nvme_handle_cqe(struct nvme_queue *nvmeq, u16 idx)
 		return;
 	}
 
-	if (WARN_ON(cqe->command_id != req->cmd->common.command_id))
+	/* late completion of a request we gave up on */
+	req = nvmeq->reqs[cqe->command_id];
+	if (!req || req == NVME_REQ_ABANDONED) {
+		dev_dbg(nvmeq->dev->ctrl.dev, "stale id %d completed\n",
+			cqe->command_id);
+		nvmeq->reqs[cqe->command_id] = NULL;
 		return;
+	}
 
+	nvmeq->reqs[cqe->command_id] = NULL;
 	nvme_end_request(req, cqe->status, cqe->result);
 }
 
@@ -384,9 +478,8 @@ static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
 	struct nvme_dev *dev = to_nvme_dev(ctrl);
 	struct nvme_queue *nvmeq = &dev->queues[qid];
 	struct nvme_request req = { };
-	const u16 tag = nvmeq->counter++ & (nvmeq->q_depth - 1);
 	enum dma_data_direction dma_dir;
-	int ret;
+	int tag, ret;
 
 	switch (qid) {
 	case NVME_QID_ADMIN:
@@ -421,6 +514,10 @@ static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
 		return -EINVAL;
 	}
 
+	tag = nvme_get_tag(nvmeq);
+	if (tag < 0)
+		return tag;
+
 	cmd->common.command_id = tag;
 
 	timeout = timeout ?: ADMIN_TIMEOUT;
@@ -430,17 +527,20 @@ static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
 	req.buffer_len = buffer_len;
 	req.dma_dir    = dma_dir;
 
-	ret = nvme_map_data(dev, &req);
+	ret = nvme_map_data(dev, &nvmeq->prps[tag], &req);
 	if (ret) {
 		dev_err(dev->dev, "Failed to map request data\n");
 		return ret;
 	}
 
+	nvmeq->reqs[tag] = &req;
 	nvme_submit_cmd(nvmeq, cmd);
 
-	nvmeq->req = &req;
 	ret = wait_on_timeout(timeout, nvme_poll(nvmeq, tag));
-	nvmeq->req = NULL;
+	if (ret && qid == NVME_QID_IO)
+		nvme_reset_io_queue(dev);
+	else if (ret)
+		nvmeq->reqs[tag] = NVME_REQ_ABANDONED;
 
 	nvme_unmap_data(dev, &req);
 
@@ -450,6 +550,82 @@ static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
 	return ret ?: req.status;
 }
 
+/*
+ * Submit @nr read or write requests to the I/O queue, keeping as many of
+ * them in flight as the queue allows. New commands are queued as soon as
+ * completions free their slots and the doorbells are rung once for each
+ * batch. Returns after all submitted requests completed, with the status
+ * of the first failed one.
+ */
+static int nvme_pci_submit_io_cmds(struct nvme_ctrl *ctrl,
+				   struct nvme_request *reqs, unsigned nr,
+				   unsigned timeout)
+{
+	struct nvme_dev *dev = to_nvme_dev(ctrl);
+	struct nvme_queue *nvmeq = &dev->queues[NVME_QID_IO];
+	unsigned submitted = 0, completed = 0, queued, i;
+	int tag, ret = 0;
+	u16 start, end;
+
+	if (dev->online_queues <= NVME_QID_IO)
+		return -ENODEV;
+
+	timeout = timeout ?: ADMIN_TIMEOUT;
+
+	do {
+		queued = 0;
+
+		while (submitted < nr && !ret) {
+			struct nvme_request *req = &reqs[submitted];
+
+			tag = nvme_get_tag(nvmeq);
+			if (tag < 0)
+				break;
+
+			req->cmd->common.command_id = tag;
+			req->dma_dir = req->cmd->rw.opcode == nvme_cmd_write ?
+				       DMA_TO_DEVICE : DMA_FROM_DEVICE;
+			req->done = false;
+
+			ret = nvme_map_data(dev, &nvmeq->prps[tag], req);
+			if (ret)
+				break;
+
+			nvmeq->reqs[tag] = req;
+			nvme_queue_cmd(nvmeq, req->cmd);
+			submitted++;
+			queued++;
+		}
+
+		if (queued)
+			nvme_ring_sq_doorbell(nvmeq);
+
+		if (completed == submitted)
+			break;
+
+		if (wait_on_timeout(timeout, nvme_cqe_pending(nvmeq))) {
+			dev_err(dev->dev, "I/O timeout\n");
+			nvme_reset_io_queue(dev);
+			ret = -ETIMEDOUT;
+			break;
+		}
+
+		nvme_process_cq(nvmeq, &start, &end, -1);
+		nvme_complete_cqes(nvmeq, start, end);
+
+		for (; completed < submitted && reqs[completed].done; completed++) {
+			nvme_unmap_data(dev, &reqs[completed]);
+			if (reqs[completed].status && !ret)
+				ret = reqs[completed].status;
+		}
+	} while (completed < submitted || (submitted < nr && !ret));
+
+	for (i = completed; i < submitted; i++)
+		nvme_unmap_data(dev, &reqs[i]);
+
+	return ret;
+}
+
 static int nvme_pci_configure_admin_queue(struct nvme_dev *dev)
 {
 	int result;
@@ -608,6 +784,7 @@ static const struct nvme_ctrl_ops nvme_pci_ctrl_ops = {
 	.reg_write32		= nvme_pci_reg_write32,
 	.reg_read64		= nvme_pci_reg_read64,
 	.submit_sync_cmd	= nvme_pci_submit_sync_cmd,
+	.submit_io_cmds		= nvme_pci_submit_io_cmds,
 };
 
 static void nvme_dev_map(struct nvme_dev *dev)
@@ -732,6 +732,107 @@ int usb_bulk_msg(struct usb_device *dev, unsigned int pipe,
 	return (dev->status == 0) ? 0 : -1;
 }
 
+/**
+ * usb_submit_urb() - queue an asynchronous bulk transfer
+ * @urb: the transfer, set up with usb_fill_bulk_urb()
+ *
+ * Hand @urb to the host controller and return without waiting for it.
+ * Several URBs can be queued on one endpoint, they complete in order and
+ * are reported by usb_poll_urbs(). Endpoints with URBs queued must not be
+ * used with usb_bulk_msg() at the same time.
+ *
+ * Host controllers without support return -EOPNOTSUPP, those which can't
+ * transfer the buffer in a single piece -EINVAL. Callers should fall back
+ * to usb_bulk_msg() then.
+ */
+int usb_submit_urb(struct urb *urb)
+{
+	struct usb_host *host = urb->dev->host;
+	int ret;
+
+	if (!host->submit_urb)
+		return -EOPNOTSUPP;
+
+	if (usb_pipetype(urb->pipe) != PIPE_BULK)
+		return -EINVAL;
+
+	ret = usb_host_acquire(host);
+	if (ret)
+		return ret;
+
+	urb->actual_length = 0;
+	urb->status = -EINPROGRESS;
+
+	ret = host->submit_urb(urb);
+	if (ret)
+		urb->status = ret;
+
+	usb_host_release(host);
+
+	return ret;
+}
+
+/**
+ * usb_kill_urb() - cancel a queued transfer
+ * @urb: the transfer
+ *
+ * If @urb is still queued, remove it from the host controller and call its
+ * completion handler with -ENOENT. This includes URBs which have finished
+ * already, but whose completion handler hasn't run yet.
+ */
+int usb_kill_urb(struct urb *urb)
+{
+	struct usb_host *host = urb->dev->host;
+	int ret;
+
+	if (list_empty(&urb->list))
+		return 0;
+
+	ret = usb_host_acquire(host);
+	if (ret)
+		return ret;
+
+	host->kill_urb(urb);
+
+	usb_host_release(host);
+
+	urb->status = -ENOENT;
+	urb->complete(urb);
+
+	return 0;
+}
+
+/**
+ * usb_poll_urbs() - report completed transfers
+ * @dev: a device on the host controller to poll
+ *
+ * Call the completion handlers of all URBs that completed on the host
+ * controller @dev is connected to. The handlers run with the host released,
+ * so they can submit new transfers.
+ */
+void usb_poll_urbs(struct usb_device *dev)
+{
+	struct usb_host *host = dev->host;
+	struct urb *urb;
+	LIST_HEAD(done);
+
+	if (!host->poll_urbs)
+		return;
+
+	if (usb_host_acquire(host))
+		return;
+
+	host->poll_urbs(host, &done);
+
+	usb_host_release(host);
+
+	/* a completion handler may kill other URBs on the list */
+	while (!list_empty(&done)) {
+		urb = list_first_entry(&done, struct urb, list);
+		list_del_init(&urb->list);
+		urb->complete(urb);
+	}
+}
 
 /*-------------------------------------------------------------------
  * Max Packet stuff
@@ -167,14 +167,23 @@ static void fastboot_start_download_usb(struct fastboot *fb);
 struct fastboot_work {
 	struct work_struct work;
 	struct f_fastboot *f_fb;
+	struct usb_request *dl_req;
 	char command[FASTBOOT_MAX_CMD_LEN + 1];
 };
 
+static void fastboot_dl_data(struct f_fastboot *f_fb, struct usb_request *req);
+
 static void fastboot_do_work(struct work_struct *w)
 {
 	struct fastboot_work *fw = container_of(w, struct fastboot_work, work);
 	struct f_fastboot *f_fb = fw->f_fb;
 
+	if (fw->dl_req) {
+		fastboot_dl_data(f_fb, fw->dl_req);
+		free(fw);
+		return;
+	}
+
 	fastboot_exec_cmd(&f_fb->fastboot, fw->command);
 
 	memset(f_fb->out_req->buf, 0, EP_BUFFER_SIZE);
@@ -456,17 +465,12 @@ static int rx_bytes_expected(struct f_fastboot *f_fb)
 	return ALIGN(remaining, f_fb->out_ep->maxpacket);
 }
 
-static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
+static void fastboot_dl_data(struct f_fastboot *f_fb, struct usb_request *req)
 {
-	struct f_fastboot *f_fb = req->context;
+	struct usb_ep *ep = f_fb->out_ep;
 	const unsigned char *buffer = req->buf;
 	int ret;
 
-	if (req->status != 0) {
-		pr_err("Bad status: %d\n", req->status);
-		return;
-	}
-
 	ret = fastboot_handle_download_data(&f_fb->fastboot, buffer,
 					    req->actual);
 	if (ret < 0) {
@@ -489,6 +493,33 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 	usb_ep_queue(ep, req);
 }
 
+static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
+{
+	struct f_fastboot *f_fb = req->context;
+	struct fastboot_work *w;
+
+	if (req->status != 0) {
+		pr_err("Bad status: %d\n", req->status);
+		return;
+	}
+
+	if (!f_fb->fastboot.stream) {
+		fastboot_dl_data(f_fb, req);
+		return;
+	}
+
+	/*
+	 * Streamed data is written to the flash device, which must not be
+	 * accessed from the poller we are called from. The request is queued
+	 * again once the data has been written.
+	 */
+	w = xzalloc(sizeof(*w));
+	w->f_fb = f_fb;
+	w->dl_req = req;
+
+	wq_queue_work(&f_fb->wq, &w->work);
+}
+
 static void fastboot_start_download_usb(struct fastboot *fb)
 {
 	struct f_fastboot *f_fb = container_of(fb, struct f_fastboot, fastboot);
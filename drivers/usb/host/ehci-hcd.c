@@ -44,6 +44,7 @@ struct ehci_host {
 	int (*post_init)(void *drvdata);
 	void *drvdata;
 	int periodic_schedules;
+	struct list_head urb_eps;
 	struct QH *periodic_queue;
 	dma_addr_t periodic_queue_dma;
 	uint32_t *periodic_list;
@@ -65,7 +66,20 @@ struct int_queue {
 #define to_ehci(ptr) container_of(ptr, struct ehci_host, host)
 
 #define NUM_QH	2
-#define NUM_TD	3
+
+/*
+ * qTDs for a SETUP stage, up to EHCI_DATA_TDS data stage qTDs, a STATUS
+ * stage and a dummy that ends bulk IN transfers on a short packet.
+ */
+#define EHCI_DATA_TDS	16
+#define EHCI_TD_SETUP	0
+#define EHCI_TD_DATA	1
+#define EHCI_TD_STATUS	(EHCI_TD_DATA + EHCI_DATA_TDS)
+#define EHCI_TD_DUMMY	(EHCI_TD_STATUS + 1)
+#define NUM_TD		(EHCI_TD_DUMMY + 1)
+
+/* a qTD covers at least four pages, no matter how the buffer is aligned */
+#define EHCI_MAX_XFER_SIZE	(EHCI_DATA_TDS * 4 * SZ_4K)
 
 static struct descriptor {
 	struct usb_hub_descriptor hub;
@@ -290,40 +304,57 @@ static int ehci_enable_async_schedule(struct ehci_host *ehci, bool enable)
 	return handshake(&ehci->hcor->or_usbsts, STD_ASS, done, 100 * 1000);
 }
 
-static int
-ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
-		   int length, struct devrequest *req, int timeout_ms)
+/*
+ * The number of bytes a single qTD can transfer from @addr. Transfers
+ * that don't fit are split over several qTDs, all but the last one
+ * ending on a packet boundary.
+ */
+static size_t ehci_qtd_len(dma_addr_t addr, size_t len, unsigned int maxpacket)
 {
-	struct usb_host *host = dev->host;
-	struct ehci_host *ehci = to_ehci(host);
-	const bool dir_in = usb_pipein(pipe);
-	dma_addr_t buffer_dma = DMA_ERROR_CODE, req_dma;
-	struct QH *qh = &ehci->qh_list[1];
-	struct qTD *td;
-	volatile struct qTD *vtd;
-	uint32_t *tdp;
-	uint32_t endpt, token, usbsts;
-	uint32_t status;
-	uint32_t toggle;
-	bool c;
-	int ret;
-	uint64_t start, timeout_val;
+	size_t max = 5 * SZ_4K - (addr & (SZ_4K - 1));
 
+	if (len <= max)
+		return len;
 
-	dev_dbg(ehci->dev, "pipe=%lx, buffer=%p, length=%d, req=%p\n", pipe,
-	      buffer, length, req);
-	if (req != NULL)
-		dev_dbg(ehci->dev, "(req=%u (%#x), type=%u (%#x), value=%u (%#x), index=%u\n",
-		      req->request, req->request,
-		      req->requesttype, req->requesttype,
-		      le16_to_cpu(req->value), le16_to_cpu(req->value),
-		      le16_to_cpu(req->index));
+	return max - max % maxpacket;
+}
+
+/*
+ * Find the qTD that ended the transfer: the first one halted with an
+ * error, with @short_ends the first one that received a short packet,
+ * or the last one. Returns NULL while the transfer is still running.
+ */
+static struct qTD *ehci_done_qtd(struct qTD **chain, int num, bool short_ends)
+{
+	uint32_t token;
+	int i;
+
+	for (i = 0; i < num; i++) {
+		token = hc32_to_cpu(((volatile struct qTD *)chain[i])->qt_token);
+		if (token & QT_TOKEN_STATUS_ACTIVE)
+			return NULL;
+		if (token & QT_TOKEN_STATUS_HALTED)
+			return chain[i];
+		if (short_ends && QT_TOKEN_GET_TOTALBYTES(token))
+			return chain[i];
+	}
+
+	return chain[num - 1];
+}
+
+/* Set up the endpoint characteristics of @qh for @pipe */
+static int ehci_qh_endpt(struct usb_device *dev, unsigned long pipe,
+			 struct QH *qh, int dtc)
+{
+	const unsigned int maxpacket = usb_maxpacket(dev, pipe);
+	uint32_t endpt;
+	bool c;
 
 	c = dev->speed != USB_SPEED_HIGH && !usb_pipeendpoint(pipe);
 	endpt = QH_ENDPT1_RL(8) | QH_ENDPT1_C(c) |
-		QH_ENDPT1_MAXPKTLEN(usb_maxpacket(dev, pipe)) |
+		QH_ENDPT1_MAXPKTLEN(maxpacket) |
 		QH_ENDPT1_H(0) |
-		QH_ENDPT1_DTC(QH_ENDPT1_DTC_DT_FROM_QTD) |
+		QH_ENDPT1_DTC(dtc) |
 		QH_ENDPT1_ENDPT(usb_pipeendpoint(pipe)) | QH_ENDPT1_I(0) |
 		QH_ENDPT1_DEVADDR(usb_pipedevice(pipe));
 
@@ -348,6 +379,57 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		QH_ENDPT2_UFCMASK(0) |
 		QH_ENDPT2_UFSMASK(0);
 	qh->qh_endpt2 = cpu_to_hc32(endpt);
+
+	return 0;
+}
+
+static int
+ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
+		   int length, struct devrequest *req, int timeout_ms)
+{
+	struct usb_host *host = dev->host;
+	struct ehci_host *ehci = to_ehci(host);
+	const bool dir_in = usb_pipein(pipe);
+	const unsigned int maxpacket = usb_maxpacket(dev, pipe);
+	dma_addr_t buffer_dma = DMA_ERROR_CODE, req_dma = DMA_ERROR_CODE;
+	struct QH *qh = &ehci->qh_list[1];
+	struct qTD *chain[NUM_TD];
+	struct qTD *td, *done;
+	uint32_t *tdp;
+	uint32_t token, usbsts;
+	uint32_t status;
+	uint32_t toggle;
+	int ndata = 0, nchain = 0;
+	int i, act_len;
+	int ret;
+	uint64_t start, timeout_val;
+
+
+	dev_dbg(ehci->dev, "pipe=%lx, buffer=%p, length=%d, req=%p\n", pipe,
+	      buffer, length, req);
+	if (req != NULL)
+		dev_dbg(ehci->dev, "(req=%u (%#x), type=%u (%#x), value=%u (%#x), index=%u\n",
+		      req->request, req->request,
+		      req->requesttype, req->requesttype,
+		      le16_to_cpu(req->value), le16_to_cpu(req->value),
+		      le16_to_cpu(req->index));
+
+	if (length > EHCI_MAX_XFER_SIZE)
+		return -EINVAL;
+
+	/* URBs keep the schedule running, stop it to reuse the QH */
+	if (!list_empty(&ehci->urb_eps)) {
+		ret = ehci_enable_async_schedule(ehci, false);
+		if (ret < 0) {
+			dev_err(ehci->dev, "fail timeout STD_ASS reset\n");
+			return ret;
+		}
+	}
+
+	ret = ehci_qh_endpt(dev, pipe, qh, QH_ENDPT1_DTC_DT_FROM_QTD);
+	if (ret)
+		return ret;
+
 	qh->qh_curtd = 0;
 	qh->qt_token = 0;
 	memzero32(qh->qt_buffer, sizeof(qh->qt_buffer));
@@ -358,7 +440,7 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 	    usb_gettoggle(dev, usb_pipeendpoint(pipe), usb_pipeout(pipe));
 
 	if (req != NULL) {
-		td = &ehci->td[0];
+		td = &ehci->td[EHCI_TD_SETUP];
 
 		ret = ehci_prepare_qtd(ehci->dev,
 				       td, QT_TOKEN_DT(0) | QT_TOKEN_IOC(0) |
@@ -371,6 +453,7 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		}
 		*tdp = cpu_to_hc32(ehci_td_dma(ehci, td));
 		tdp = &td->qt_next;
+		chain[nchain++] = td;
 
 		toggle = 1;
 	}
@@ -378,8 +461,8 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 	if (length > 0 || req == NULL) {
 		enum dma_data_direction dir;
 		unsigned int pid;
-
-		td = &ehci->td[1];
+		uint32_t altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+		int pos = 0;
 
 		if (dir_in) {
 			dir = DMA_FROM_DEVICE;
@@ -389,31 +472,62 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 			pid = QT_TOKEN_PID_OUT;
 		}
 
-		ret = ehci_prepare_qtd(ehci->dev,
-				       td, QT_TOKEN_DT(toggle) |
-				       /*
-					* We only want this qTD to
-					* generate an interrupt if
-					* this is a BULK
-					* request. Otherwise, we'll
-					* rely on following status
-					* stage qTD's IOC to notify us
-					* that transfer is complete
-					*/
-				       QT_TOKEN_IOC(req == NULL) |
-				       QT_TOKEN_PID(pid),
-				       buffer, length,
-				       &buffer_dma, dir);
-		if (ret) {
-			dev_err(ehci->dev, "unable construct DATA td\n");
-			return ret;
+		if (length) {
+			buffer_dma = dma_map_single(ehci->dev, buffer, length,
+						    dir);
+			if (dma_mapping_error(ehci->dev, buffer_dma)) {
+				dev_err(ehci->dev, "unable construct DATA td\n");
+				return -EFAULT;
+			}
 		}
-		*tdp = cpu_to_hc32(ehci_td_dma(ehci, td));
-		tdp = &td->qt_next;
+
+		/*
+		 * A short packet in a bulk IN transfer ends it. Without an
+		 * alternate qTD the controller would go on with the next
+		 * data qTD and wait for data that never comes.
+		 */
+		if (dir_in && req == NULL)
+			altnext = cpu_to_hc32(ehci_td_dma(ehci,
+						&ehci->td[EHCI_TD_DUMMY]));
+
+		do {
+			size_t len = ehci_qtd_len(buffer_dma + pos,
+						  length - pos, maxpacket);
+			bool last = pos + len == length;
+
+			td = &ehci->td[EHCI_TD_DATA + ndata++];
+
+			td->qt_next = cpu_to_hc32(QT_NEXT_TERMINATE);
+			td->qt_altnext = altnext;
+			/*
+			 * We only want the last qTD to generate an interrupt
+			 * if this is a BULK request. Otherwise, we'll rely on
+			 * following status stage qTD's IOC to notify us that
+			 * transfer is complete
+			 */
+			td->qt_token = cpu_to_hc32(QT_TOKEN_DT(toggle) |
+				QT_TOKEN_IOC(req == NULL && last) |
+				QT_TOKEN_PID(pid) |
+				QT_TOKEN_TOTALBYTES(len) |
+				QT_TOKEN_CPAGE(0) | QT_TOKEN_CERR(3) |
+				QT_TOKEN_STATUS(QT_TOKEN_STATUS_ACTIVE));
+			if (len)
+				ehci_td_buffer(td, buffer_dma + pos, len);
+			else
+				memzero32(td->qt_buffer, sizeof(td->qt_buffer));
+
+			*tdp = cpu_to_hc32(ehci_td_dma(ehci, td));
+			tdp = &td->qt_next;
+			chain[nchain++] = td;
+
+			/* all but the last qTD hold whole packets */
+			toggle ^= DIV_ROUND_UP(len, maxpacket) & 1;
+			pos += len;
+		} while (pos < length);
 	}
 
 	if (req) {
-		td = &ehci->td[2];
+		td = &ehci->td[EHCI_TD_STATUS];
 
 		ehci_prepare_qtd(ehci->dev,
 				 td, QT_TOKEN_DT(1) | QT_TOKEN_IOC(1) |
@@ -424,6 +538,7 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 				 NULL, DMA_NONE);
 		*tdp = cpu_to_hc32(ehci_td_dma(ehci, td));
 		tdp = &td->qt_next;
+		chain[nchain++] = td;
 	}
 
 	usbsts = ehci_readl(&ehci->hcor->or_usbsts);
@@ -439,15 +554,16 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 	/* Wait for TDs to be processed. */
 	timeout_val = timeout_ms * MSECOND;
 	start = get_time_ns();
-	vtd = td;
 	do {
-		token = hc32_to_cpu(vtd->qt_token);
-		if (is_timeout_non_interruptible(start, timeout_val)) {
+		done = ehci_done_qtd(chain, nchain, dir_in && req == NULL);
+		if (!done && is_timeout_non_interruptible(start, timeout_val)) {
 			ehci_enable_async_schedule(ehci, false);
 			ehci_writel(&qh->qt_token, 0);
+			if (!list_empty(&ehci->urb_eps))
+				ehci_enable_async_schedule(ehci, true);
 			return -ETIMEDOUT;
 		}
-	} while (token & QT_TOKEN_STATUS_ACTIVE);
+	} while (!done);
 
 	if (req)
 		dma_unmap_single(ehci->dev, req_dma, sizeof(*req),
@@ -457,21 +573,15 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		dma_unmap_single(ehci->dev, buffer_dma, length,
 				 dir_in ? DMA_FROM_DEVICE : DMA_TO_DEVICE);
 
-	ret = ehci_enable_async_schedule(ehci, false);
-	if (ret < 0) {
-		dev_err(ehci->dev, "fail timeout STD_ASS reset\n");
-		return ret;
+	if (list_empty(&ehci->urb_eps)) {
+		ret = ehci_enable_async_schedule(ehci, false);
+		if (ret < 0) {
+			dev_err(ehci->dev, "fail timeout STD_ASS reset\n");
+			return ret;
+		}
 	}
 
-	token = hc32_to_cpu(qh->qt_token);
-	if (token & QT_TOKEN_STATUS_ACTIVE) {
-		dev->act_len = 0;
-		dev_dbg(ehci->dev, "dev=%u, usbsts=%#x, p[1]=%#x, p[2]=%#x\n",
-			dev->devnum, ehci_readl(&ehci->hcor->or_usbsts),
-			ehci_readl(&ehci->hcor->or_portsc[0]),
-			ehci_readl(&ehci->hcor->or_portsc[1]));
-		return -EIO;
-	}
+	token = hc32_to_cpu(done->qt_token);
 
 	dev_dbg(ehci->dev, "TOKEN=0x%08x\n", token);
 
@@ -504,7 +614,28 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 
 		break;
 	}
-	dev->act_len = length - QT_TOKEN_GET_TOTALBYTES(token);
+
+	if (req) {
+		dev->act_len = length - QT_TOKEN_GET_TOTALBYTES(token);
+		return 0;
+	}
+
+	act_len = 0;
+	for (i = 0; i < ndata; i++) {
+		uint32_t len, tok;
+
+		td = &ehci->td[EHCI_TD_DATA + i];
+		tok = hc32_to_cpu(td->qt_token);
+		if (tok & QT_TOKEN_STATUS_ACTIVE)
+			break;
+
+		len = ehci_qtd_len(buffer_dma + act_len, length - act_len,
+				   maxpacket);
+		act_len += len - QT_TOKEN_GET_TOTALBYTES(tok);
+		if (td == done)
+			break;
+	}
+	dev->act_len = act_len;
 
 	return 0;
 }
@@ -994,6 +1125,338 @@ submit_control_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
 	return ehci_submit_async(dev, pipe, buffer, length, setup, timeout);
 }
 
+/*
+ * Asynchronous bulk transfers get a QH per endpoint, linked into the async
+ * schedule behind the QH used for synchronous transfers. New URBs are
+ * appended to the running queue by turning its inactive dummy qTD into the
+ * URB's qTD and adding a new dummy behind it, so the schedule only has to
+ * be stopped to add or remove a QH and to recover from errors. The QH keeps
+ * the data toggle, the toggle bits of the qTDs are ignored.
+ */
+#define EHCI_URB_TDS	16
+
+struct ehci_urb_ep {
+	struct list_head list;
+	struct usb_device *dev;
+	unsigned long pipe;
+	struct list_head urbs;		/* queued URBs, in submission order */
+	struct QH *qh;			/* followed by EHCI_URB_TDS qTDs */
+	dma_addr_t qh_dma;
+	struct qTD *tds;
+	struct qTD *dummy;
+	unsigned long used;		/* bitmap of tds in use */
+};
+
+static inline uint32_t ehci_urb_td_dma(struct ehci_urb_ep *ep, struct qTD *td)
+{
+	return ep->qh_dma + sizeof(struct QH) + (td - ep->tds) * sizeof(*td);
+}
+
+static bool ehci_urb_ep_match(struct ehci_urb_ep *ep, struct urb *urb)
+{
+	return ep->dev == urb->dev &&
+	       usb_pipeendpoint(ep->pipe) == usb_pipeendpoint(urb->pipe) &&
+	       usb_pipein(ep->pipe) == usb_pipein(urb->pipe);
+}
+
+static struct ehci_urb_ep *ehci_urb_ep_find(struct ehci_host *ehci,
+					    struct urb *urb)
+{
+	struct ehci_urb_ep *ep;
+
+	list_for_each_entry(ep, &ehci->urb_eps, list)
+		if (ehci_urb_ep_match(ep, urb))
+			return ep;
+
+	return NULL;
+}
+
+static struct qTD *ehci_urb_td_alloc(struct ehci_urb_ep *ep)
+{
+	struct qTD *td;
+	int i;
+
+	i = ffz(ep->used);
+	if (i >= EHCI_URB_TDS)
+		return NULL;
+
+	ep->used |= BIT(i);
+	td = &ep->tds[i];
+
+	td->qt_next = cpu_to_hc32(QT_NEXT_TERMINATE);
+	td->qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+	td->qt_token = cpu_to_hc32(QT_TOKEN_STATUS(QT_TOKEN_STATUS_HALTED));
+
+	return td;
+}
+
+static void ehci_urb_td_free(struct ehci_urb_ep *ep, struct qTD *td)
+{
+	ep->used &= ~BIT(td - ep->tds);
+}
+
+static struct ehci_urb_ep *ehci_urb_ep_create(struct ehci_host *ehci,
+					      struct urb *urb)
+{
+	struct usb_device *dev = urb->dev;
+	struct ehci_urb_ep *ep;
+	struct QH *qh;
+	int toggle, ret;
+
+	ep = xzalloc(sizeof(*ep));
+	ep->dev = dev;
+	ep->pipe = urb->pipe;
+	INIT_LIST_HEAD(&ep->urbs);
+
+	ep->qh = dma_alloc_coherent(sizeof(struct QH) +
+				    EHCI_URB_TDS * sizeof(struct qTD),
+				    &ep->qh_dma);
+	ep->tds = (struct qTD *)(ep->qh + 1);
+	ep->dummy = ehci_urb_td_alloc(ep);
+
+	qh = ep->qh;
+	memzero32(qh, sizeof(*qh));
+
+	ret = ehci_qh_endpt(dev, urb->pipe, qh, QH_ENDPT1_DTC_IGNORE_QTD_TD);
+	if (ret)
+		goto err;
+
+	toggle = usb_gettoggle(dev, usb_pipeendpoint(urb->pipe),
+			       usb_pipeout(urb->pipe));
+	qh->qt_next = cpu_to_hc32(ehci_urb_td_dma(ep, ep->dummy));
+	qh->qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+	qh->qt_token = cpu_to_hc32(QT_TOKEN_DT(toggle));
+
+	if (!list_empty(&ehci->urb_eps)) {
+		ret = ehci_enable_async_schedule(ehci, false);
+		if (ret)
+			goto err;
+	}
+
+	qh->qh_link = ehci->qh_list[1].qh_link;
+	ehci->qh_list[1].qh_link = cpu_to_hc32(ep->qh_dma | QH_LINK_TYPE_QH);
+	list_add(&ep->list, &ehci->urb_eps);
+
+	ret = ehci_enable_async_schedule(ehci, true);
+	if (ret)
+		dev_err(ehci->dev, "fail timeout STD_ASS set\n");
+
+	return ep;
+err:
+	dma_free_coherent(ep->qh, ep->qh_dma, sizeof(struct QH) +
+			  EHCI_URB_TDS * sizeof(struct qTD));
+	free(ep);
+
+	return ERR_PTR(ret);
+}
+
+/* Unlink an endpoint without URBs. The async schedule must be stopped. */
+static void ehci_urb_ep_destroy(struct ehci_host *ehci, struct ehci_urb_ep *ep)
+{
+	struct QH *prev;
+	int toggle;
+
+	if (list_is_first(&ep->list, &ehci->urb_eps))
+		prev = &ehci->qh_list[1];
+	else
+		prev = list_prev_entry(ep, list)->qh;
+
+	prev->qh_link = ep->qh->qh_link;
+	list_del(&ep->list);
+
+	toggle = QT_TOKEN_GET_DT(hc32_to_cpu(ep->qh->qt_token));
+	usb_settoggle(ep->dev, usb_pipeendpoint(ep->pipe),
+		      usb_pipeout(ep->pipe), toggle);
+
+	dma_free_coherent(ep->qh, ep->qh_dma, sizeof(struct QH) +
+			  EHCI_URB_TDS * sizeof(struct qTD));
+	free(ep);
+}
+
+/*
+ * Restart the queue of an endpoint at the first URB that has not completed
+ * yet. Used after errors, which halt the QH, and after removing URBs. The
+ * async schedule must be stopped.
+ */
+static void ehci_urb_ep_reset(struct ehci_urb_ep *ep)
+{
+	struct QH *qh = ep->qh;
+	uint32_t next = cpu_to_hc32(ehci_urb_td_dma(ep, ep->dummy));
+	struct urb *urb;
+
+	list_for_each_entry_reverse(urb, &ep->urbs, list) {
+		struct qTD *td = urb->hcpriv;
+
+		if (!(hc32_to_cpu(td->qt_token) & QT_TOKEN_STATUS_ACTIVE))
+			continue;
+
+		td->qt_next = next;
+		next = cpu_to_hc32(ehci_urb_td_dma(ep, td));
+	}
+
+	qh->qh_curtd = 0;
+	qh->qt_next = next;
+	qh->qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+	qh->qt_token &= cpu_to_hc32(QT_TOKEN_DT(1));
+}
+
+static void ehci_urb_giveback(struct ehci_host *ehci, struct ehci_urb_ep *ep,
+			      struct urb *urb, struct list_head *done)
+{
+	struct qTD *td = urb->hcpriv;
+	uint32_t token = hc32_to_cpu(td->qt_token);
+	uint32_t status = QT_TOKEN_GET_STATUS(token);
+
+	dma_unmap_single(ehci->dev, urb->transfer_dma,
+			 urb->transfer_buffer_length,
+			 usb_pipein(urb->pipe) ? DMA_FROM_DEVICE : DMA_TO_DEVICE);
+
+	urb->actual_length = urb->transfer_buffer_length -
+			     QT_TOKEN_GET_TOTALBYTES(token);
+
+	if (!(status & QT_TOKEN_STATUS_HALTED))
+		urb->status = 0;
+	else if (status & QT_TOKEN_STATUS_BABBLEDET)
+		urb->status = -EOVERFLOW;
+	else if (status & (QT_TOKEN_STATUS_XACTERR |
+			   QT_TOKEN_STATUS_DATBUFERR))
+		urb->status = -EPROTO;
+	else
+		urb->status = -EPIPE;
+
+	ehci_urb_td_free(ep, td);
+	list_move_tail(&urb->list, done);
+}
+
+static int ehci_submit_urb(struct urb *urb)
+{
+	struct ehci_host *ehci = to_ehci(urb->dev->host);
+	u32 length = urb->transfer_buffer_length;
+	struct ehci_urb_ep *ep;
+	struct qTD *td, *dummy;
+	uint32_t token;
+	int ret;
+
+	if (!length)
+		return -EINVAL;
+
+	urb->transfer_dma = dma_map_single(ehci->dev, urb->transfer_buffer,
+					   length, usb_pipein(urb->pipe) ?
+					   DMA_FROM_DEVICE : DMA_TO_DEVICE);
+	if (dma_mapping_error(ehci->dev, urb->transfer_dma))
+		return -EFAULT;
+
+	/* one qTD per URB */
+	if (ehci_qtd_len(urb->transfer_dma, length, 1) != length) {
+		ret = -EINVAL;
+		goto err;
+	}
+
+	ep = ehci_urb_ep_find(ehci, urb);
+	if (!ep) {
+		ep = ehci_urb_ep_create(ehci, urb);
+		if (IS_ERR(ep)) {
+			ret = PTR_ERR(ep);
+			goto err;
+		}
+	}
+
+	dummy = ehci_urb_td_alloc(ep);
+	if (!dummy) {
+		ret = -EBUSY;
+		goto err;
+	}
+
+	/* the old dummy becomes the URB's qTD, the controller waits on it */
+	td = ep->dummy;
+	td->qt_next = cpu_to_hc32(ehci_urb_td_dma(ep, dummy));
+	td->qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+	ehci_td_buffer(td, urb->transfer_dma, length);
+
+	token = QT_TOKEN_IOC(1) |
+		QT_TOKEN_PID(usb_pipein(urb->pipe) ?
+			     QT_TOKEN_PID_IN : QT_TOKEN_PID_OUT) |
+		QT_TOKEN_TOTALBYTES(length) | QT_TOKEN_CPAGE(0) |
+		QT_TOKEN_CERR(3) | QT_TOKEN_STATUS(QT_TOKEN_STATUS_ACTIVE);
+
+	barrier();
+	td->qt_token = cpu_to_hc32(token);
+
+	ep->dummy = dummy;
+	urb->hcpriv = td;
+	list_add_tail(&urb->list, &ep->urbs);
+
+	return 0;
+err:
+	dma_unmap_single(ehci->dev, urb->transfer_dma, length,
+			 usb_pipein(urb->pipe) ? DMA_FROM_DEVICE : DMA_TO_DEVICE);
+	return ret;
+}
+
+static void ehci_kill_urb(struct urb *urb)
+{
+	struct ehci_host *ehci = to_ehci(urb->dev->host);
+	struct ehci_urb_ep *ep;
+
+	/* given back already, only its completion handler is pending */
+	if (urb->status != -EINPROGRESS) {
+		list_del_init(&urb->list);
+		return;
+	}
+
+	ep = ehci_urb_ep_find(ehci, urb);
+	if (!ep)
+		return;
+
+	ehci_enable_async_schedule(ehci, false);
+
+	list_del_init(&urb->list);
+	ehci_urb_td_free(ep, urb->hcpriv);
+	dma_unmap_single(ehci->dev, urb->transfer_dma,
+			 urb->transfer_buffer_length,
+			 usb_pipein(urb->pipe) ? DMA_FROM_DEVICE : DMA_TO_DEVICE);
+
+	if (list_empty(&ep->urbs))
+		ehci_urb_ep_destroy(ehci, ep);
+	else
+		ehci_urb_ep_reset(ep);
+
+	if (!list_empty(&ehci->urb_eps))
+		ehci_enable_async_schedule(ehci, true);
+}
+
+static void ehci_poll_urbs(struct usb_host *host, struct list_head *done)
+{
+	struct ehci_host *ehci = to_ehci(host);
+	struct ehci_urb_ep *ep;
+	struct urb *urb, *tmp;
+
+	list_for_each_entry(ep, &ehci->urb_eps, list) {
+		bool halted = false;
+
+		list_for_each_entry_safe(urb, tmp, &ep->urbs, list) {
+			volatile struct qTD *td = urb->hcpriv;
+			uint32_t token = hc32_to_cpu(td->qt_token);
+
+			if (token & QT_TOKEN_STATUS_ACTIVE)
+				break;
+
+			halted = token & QT_TOKEN_STATUS_HALTED;
+
+			ehci_urb_giveback(ehci, ep, urb, done);
+
+			if (halted)
+				break;
+		}
+
+		if (halted) {
+			ehci_enable_async_schedule(ehci, false);
+			ehci_urb_ep_reset(ep);
+			ehci_enable_async_schedule(ehci, true);
+		}
+	}
+}
+
 static int
 disable_periodic(struct ehci_host *ehci)
 {
@@ -1345,6 +1808,7 @@ struct ehci_host *ehci_register(struct device *dev, struct ehci_data *data)
 {
 	struct usb_host *host;
 	struct ehci_host *ehci;
+	struct qTD *dummy;
 	uint32_t reg;
 
 	ehci = xzalloc(sizeof(struct ehci_host));
@@ -1370,12 +1834,23 @@ struct ehci_host *ehci_register(struct device *dev, struct ehci_data *data)
 	ehci->td = dma_alloc_coherent(sizeof(struct qTD) * NUM_TD,
 				      &ehci->td_dma);
 
+	dummy = &ehci->td[EHCI_TD_DUMMY];
+	dummy->qt_next = cpu_to_hc32(QT_NEXT_TERMINATE);
+	dummy->qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+	dummy->qt_token = cpu_to_hc32(QT_TOKEN_STATUS(QT_TOKEN_STATUS_HALTED));
+
 	host->hw_dev = dev;
 	host->init = ehci_init;
 	host->usbphy = data->usbphy;
 	host->submit_int_msg = submit_int_msg;
 	host->submit_control_msg = submit_control_msg;
 	host->submit_bulk_msg = submit_bulk_msg;
+	host->submit_urb = ehci_submit_urb;
+	host->kill_urb = ehci_kill_urb;
+	host->poll_urbs = ehci_poll_urbs;
+	host->max_xfer_size = EHCI_MAX_XFER_SIZE;
+
+	INIT_LIST_HEAD(&ehci->urb_eps);
 
 	if (ehci->flags & EHCI_HAS_TT) {
 		ehci_reset(ehci);
@@ -448,6 +448,66 @@ static int event_ready(struct xhci_ctrl *ctrl)
 	return 1;
 }
 
+static enum dma_data_direction xhci_urb_dir(struct urb *urb)
+{
+	return usb_pipein(urb->pipe) ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
+}
+
+static int xhci_urb_status(xhci_comp_code comp)
+{
+	switch (comp) {
+	case COMP_SUCCESS:
+	case COMP_SHORT_TX:
+		return 0;
+	case COMP_STALL:
+		return -EPIPE;
+	case COMP_BABBLE:
+		return -EOVERFLOW;
+	default:
+		return -EPROTO;
+	}
+}
+
+/*
+ * Transfer events of URBs are consumed wherever events are polled, so they
+ * can't get lost while some other transfer or command is waited for. URBs
+ * on an endpoint complete in order, so the event belongs to the first URB
+ * queued on the endpoint it reports.
+ */
+static bool xhci_urb_event(struct xhci_ctrl *ctrl, union xhci_trb *event)
+{
+	u32 flags = le32_to_cpu(event->trans_event.flags);
+	u32 len = le32_to_cpu(event->trans_event.transfer_len);
+	xhci_comp_code comp = GET_COMP_CODE(len);
+	struct urb *urb;
+
+	if (TRB_FIELD_TO_TYPE(flags) != TRB_TRANSFER)
+		return false;
+
+	/* stopping an endpoint is handled by abort_td() */
+	if (comp == COMP_STOP || comp == COMP_STOP_INVAL)
+		return false;
+
+	list_for_each_entry(urb, &ctrl->urbs, list) {
+		if (urb->dev->slot_id != TRB_TO_SLOT_ID(flags) ||
+		    usb_pipe_ep_index(urb->pipe) != TRB_TO_EP_INDEX(flags))
+			continue;
+
+		dma_unmap_single(ctrl->host.hw_dev, urb->transfer_dma,
+				 urb->transfer_buffer_length, xhci_urb_dir(urb));
+
+		urb->actual_length = urb->transfer_buffer_length -
+				     min(EVENT_TRB_LEN(len),
+					 urb->transfer_buffer_length);
+		urb->status = xhci_urb_status(comp);
+		list_move_tail(&urb->list, &ctrl->urbs_done);
+
+		return true;
+	}
+
+	return false;
+}
+
 /**
  * Waits for a specific type of event and returns it. Discards unexpected
  * events. Caller *must* call xhci_acknowledge_event() after it is finished
@@ -469,6 +529,11 @@ union xhci_trb *xhci_wait_for_event(struct xhci_ctrl *ctrl, trb_type expected,
 		if (!event_ready(ctrl))
 			continue;
 
+		if (xhci_urb_event(ctrl, event)) {
+			xhci_acknowledge_event(ctrl);
+			continue;
+		}
+
 		type = TRB_FIELD_TO_TYPE(le32_to_cpu(event->event_cmd.flags));
 		if (type == expected ||
 		    (expected == TRB_NONE && type != TRB_PORT_STATUS))
@@ -1076,3 +1141,189 @@ int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 	dma_unmap_single(ctrl->host.hw_dev, map, length, direction);
 	return -ETIMEDOUT;
 }
+
+/**** Asynchronous bulk transfers ****/
+
+static u32 xhci_ep_state(struct usb_device *udev, int ep_index)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	struct xhci_virt_device *virt_dev = ctrl->devs[udev->slot_id];
+	struct xhci_ep_ctx *ep_ctx;
+
+	xhci_inval_cache((uintptr_t)virt_dev->out_ctx->bytes,
+			 virt_dev->out_ctx->size);
+
+	ep_ctx = xhci_get_ep_ctx(ctrl, virt_dev->out_ctx, ep_index);
+
+	return le32_to_cpu(ep_ctx->ep_info) & EP_STATE_MASK;
+}
+
+/*
+ * Queue the TD of an URB. The buffer doesn't cross a 64KiB boundary, so a
+ * single TRB is enough and each URB occupies exactly one TRB of the ring.
+ */
+static int xhci_queue_urb(struct xhci_ctrl *ctrl, struct urb *urb)
+{
+	struct usb_device *udev = urb->dev;
+	int ep_index = usb_pipe_ep_index(urb->pipe);
+	struct xhci_ring *ring = ctrl->devs[udev->slot_id]->eps[ep_index].ring;
+	struct xhci_generic_trb *start_trb;
+	u32 length = urb->transfer_buffer_length;
+	u32 trb_fields[4];
+	u32 field, remainder = 0;
+	int start_cycle, ret;
+
+	ret = prepare_ring(ctrl, ring, xhci_ep_state(udev, ep_index));
+	if (ret < 0)
+		return ret;
+
+	start_trb = &ring->enqueue->generic;
+	start_cycle = ring->cycle_state;
+
+	/* Don't give the TRB to the hardware before it is complete */
+	field = TRB_IOC | TRB_TYPE(TRB_NORMAL);
+	if (start_cycle == 0)
+		field |= TRB_CYCLE;
+	if (usb_pipein(urb->pipe))
+		field |= TRB_ISP;
+
+	if (HC_VERSION(xhci_readl(&ctrl->hccr->cr_capbase)) < 0x100)
+		remainder = xhci_td_remainder(length);
+
+	trb_fields[0] = lower_32_bits(urb->transfer_dma);
+	trb_fields[1] = upper_32_bits(urb->transfer_dma);
+	trb_fields[2] = TRB_LEN(length) | remainder | TRB_INTR_TARGET(0);
+	trb_fields[3] = field;
+
+	queue_trb(ctrl, ring, false, trb_fields);
+
+	giveback_first_trb(udev, ep_index, start_cycle, start_trb);
+
+	return 0;
+}
+
+/*
+ * Throw away all TDs queued on an endpoint, resetting it when it halted,
+ * and queue the URBs still pending on it again.
+ */
+static void xhci_restart_ep(struct usb_device *udev, int ep_index)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	struct urb *urb, *tmp;
+	int ret;
+
+	if (xhci_ep_state(udev, ep_index) == EP_STATE_HALTED)
+		reset_ep(udev, ep_index, XHCI_TIMEOUT_DEFAULT);
+	else
+		abort_td(udev, ep_index);
+
+	list_for_each_entry_safe(urb, tmp, &ctrl->urbs, list) {
+		if (urb->dev != udev || usb_pipe_ep_index(urb->pipe) != ep_index)
+			continue;
+
+		ret = xhci_queue_urb(ctrl, urb);
+		if (ret) {
+			dma_unmap_single(ctrl->host.hw_dev, urb->transfer_dma,
+					 urb->transfer_buffer_length,
+					 xhci_urb_dir(urb));
+			urb->status = ret;
+			list_move_tail(&urb->list, &ctrl->urbs_done);
+		}
+	}
+}
+
+int xhci_submit_urb(struct urb *urb)
+{
+	struct usb_device *udev = urb->dev;
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	int ep_index = usb_pipe_ep_index(urb->pipe);
+	u32 length = urb->transfer_buffer_length;
+	unsigned int queued = 0;
+	struct urb *tmp;
+	int ret;
+
+	list_for_each_entry(tmp, &ctrl->urbs, list)
+		if (tmp->dev == udev && usb_pipe_ep_index(tmp->pipe) == ep_index)
+			queued++;
+
+	/* one TRB per URB, leave room for the link TRB */
+	if (queued >= TRBS_PER_SEGMENT - 2)
+		return -EBUSY;
+
+	urb->transfer_dma = dma_map_single(ctrl->host.hw_dev,
+					   urb->transfer_buffer, length,
+					   xhci_urb_dir(urb));
+
+	if (!length || length > TRB_MAX_BUFF_SIZE ||
+	    (lower_32_bits(urb->transfer_dma) & (TRB_MAX_BUFF_SIZE - 1)) +
+	    length > TRB_MAX_BUFF_SIZE) {
+		ret = -EINVAL;
+		goto err;
+	}
+
+	if (xhci_ep_state(udev, ep_index) == EP_STATE_HALTED)
+		xhci_restart_ep(udev, ep_index);
+
+	ret = xhci_queue_urb(ctrl, urb);
+	if (ret)
+		goto err;
+
+	list_add_tail(&urb->list, &ctrl->urbs);
+
+	return 0;
+err:
+	dma_unmap_single(ctrl->host.hw_dev, urb->transfer_dma, length,
+			 xhci_urb_dir(urb));
+	return ret;
+}
+
+void xhci_kill_urb(struct urb *urb)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(urb->dev);
+
+	/* given back already, only its completion handler is pending */
+	if (urb->status != -EINPROGRESS) {
+		list_del_init(&urb->list);
+		return;
+	}
+
+	list_del_init(&urb->list);
+
+	dma_unmap_single(ctrl->host.hw_dev, urb->transfer_dma,
+			 urb->transfer_buffer_length, xhci_urb_dir(urb));
+
+	xhci_restart_ep(urb->dev, usb_pipe_ep_index(urb->pipe));
+}
+
+void xhci_poll_urbs(struct usb_host *host, struct list_head *done)
+{
+	struct xhci_ctrl *ctrl = to_xhci(host);
+	struct urb *urb;
+
+	while (event_ready(ctrl)) {
+		union xhci_trb *event = ctrl->event_ring->dequeue;
+
+		if (!xhci_urb_event(ctrl, event))
+			dev_dbg(ctrl->dev, "Unexpected XHCI event TRB, skipping... "
+				"(%08x %08x %08x %08x)\n",
+				le32_to_cpu(event->generic.field[0]),
+				le32_to_cpu(event->generic.field[1]),
+				le32_to_cpu(event->generic.field[2]),
+				le32_to_cpu(event->generic.field[3]));
+
+		xhci_acknowledge_event(ctrl);
+	}
+
+	/* a failed transfer halts its endpoint, get the others going again */
+again:
+	list_for_each_entry(urb, &ctrl->urbs, list) {
+		int ep_index = usb_pipe_ep_index(urb->pipe);
+
+		if (xhci_ep_state(urb->dev, ep_index) == EP_STATE_HALTED) {
+			xhci_restart_ep(urb->dev, ep_index);
+			goto again;
+		}
+	}
+
+	list_splice_tail_init(&ctrl->urbs_done, done);
+}
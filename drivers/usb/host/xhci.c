@@ -24,6 +24,7 @@
 #include <init.h>
 #include <io.h>
 #include <linux/err.h>
+#include <linux/sizes.h>
 #include <linux/usb/usb.h>
 #include <linux/usb/xhci.h>
 #include <asm/unaligned.h>
@@ -1124,12 +1125,34 @@ static int _xhci_submit_int_msg(struct usb_device *udev, unsigned long pipe,
 static int _xhci_submit_bulk_msg(struct usb_device *udev, unsigned long pipe,
 				 void *buffer, int length, int timeout_ms)
 {
+	int done = 0;
+	int ret;
+
 	if (usb_pipetype(pipe) != PIPE_BULK) {
 		dev_err(&udev->dev, "non-bulk pipe (type=%lu)", usb_pipetype(pipe));
 		return -EINVAL;
 	}
 
-	return xhci_bulk_tx(udev, pipe, length, buffer, timeout_ms);
+	/*
+	 * xhci_bulk_tx() is limited to the size of its bounce buffer. Larger
+	 * transfers are split into pieces of whole packets, so the device
+	 * still sees a single transfer.
+	 */
+	do {
+		int len = min(length - done, SZ_64K);
+
+		ret = xhci_bulk_tx(udev, pipe, len, buffer + done, timeout_ms);
+		if (ret)
+			return ret;
+
+		done += udev->act_len;
+		if (udev->status || udev->act_len < len)
+			break;
+	} while (done < length);
+
+	udev->act_len = done;
+
+	return 0;
 }
 
 /**
@@ -1387,9 +1410,16 @@ int xhci_register(struct xhci_ctrl *ctrl)
 	host->submit_int_msg = xhci_submit_int_msg;
 	host->submit_control_msg = xhci_submit_control_msg;
 	host->submit_bulk_msg = xhci_submit_bulk_msg;
+	host->submit_urb = xhci_submit_urb;
+	host->kill_urb = xhci_kill_urb;
+	host->poll_urbs = xhci_poll_urbs;
+	host->max_xfer_size = SZ_1M;
 	host->alloc_device = xhci_alloc_device;
 	host->update_hub_device = xhci_update_hub_device;
 
+	INIT_LIST_HEAD(&ctrl->urbs);
+	INIT_LIST_HEAD(&ctrl->urbs_done);
+
 	ret = xhci_reset(ctrl);
 	if (ret)
 		goto err;
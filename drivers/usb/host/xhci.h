@@ -1228,6 +1228,8 @@ struct xhci_ctrl {
 	struct usb_hub_descriptor hub_desc;
 	void *bounce_buffer;
 	int rootdev;
+	struct list_head urbs;		/* queued URBs, in submission order */
+	struct list_head urbs_done;	/* completed, not yet reported URBs */
 };
 
 static inline struct xhci_ctrl *to_xhci(struct usb_host *host)
@@ -1262,6 +1264,9 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		 int length, void *buffer, unsigned int timeout_ms);
 int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 		 struct devrequest *req, int length, void *buffer, unsigned int timeout_ms);
+int xhci_submit_urb(struct urb *urb);
+void xhci_kill_urb(struct urb *urb);
+void xhci_poll_urbs(struct usb_host *host, struct list_head *done);
 int xhci_check_maxpacket(struct usb_device *udev);
 void xhci_flush_cache(uintptr_t addr, u32 type_len);
 void xhci_inval_cache(uintptr_t addr, u32 type_len);
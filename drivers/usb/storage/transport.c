@@ -129,8 +129,6 @@ int usb_stor_Bulk_transport(struct us_blk_dev *usb_blkdev,
 	/* DATA STAGE */
 	/* send/receive data payload, if there is any */
 
-	mdelay(1);
-
 	data_actlen = 0;
 	if (datalen) {
 		unsigned int pipe = dir_in ? pipein : pipeout;
@@ -266,7 +266,33 @@ static int usb_stor_io_10(struct us_blk_dev *usb_blkdev, u8 opcode,
  * Disk driver interface
  ***********************************************************************/
 
-#define US_MAX_IO_BLK 32
+/*
+ * Blocks per READ/WRITE command. Like Linux we don't ask USB devices for
+ * their Block Limits VPD page, many of them don't cope with it, but use
+ * sizes that are known to work: 120KiB for high speed devices and 1MiB for
+ * SuperSpeed ones. Hosts that don't tell their maximum transfer size get
+ * 16KiB, which fits into a single transfer everywhere.
+ */
+#define US_MAX_IO_BLK		32
+#define US_MAX_IO_BLK_HS	240
+#define US_MAX_IO_BLK_SS	2048
+
+static unsigned int usb_stor_max_io_blocks(struct us_data *us)
+{
+	struct usb_device *usbdev = us->pusb_dev;
+	size_t max_xfer = usbdev->host->max_xfer_size;
+	unsigned int blocks;
+
+	if (!max_xfer)
+		return US_MAX_IO_BLK;
+
+	if (usbdev->speed >= USB_SPEED_SUPER)
+		blocks = US_MAX_IO_BLK_SS;
+	else
+		blocks = US_MAX_IO_BLK_HS;
+
+	return min_t(size_t, blocks, max_xfer / SECTOR_SIZE);
+}
 
 /* Read / write a chunk of sectors on media */
 static int usb_stor_blk_io(struct block_device *disk_dev,
@@ -280,12 +306,11 @@ static int usb_stor_blk_io(struct block_device *disk_dev,
 	struct device *dev = &us->pusb_dev->dev;
 	int result;
 
-	/* ensure unit ready */
-	dev_dbg(dev, "Testing for unit ready\n");
-	if (usb_stor_test_unit_ready(pblk_dev, 0)) {
-		dev_dbg(dev, "Device NOT ready\n");
-		return -EIO;
-	}
+	/*
+	 * The unit was found ready when it was registered. Should it have
+	 * become unready since, the command fails and usb_stor_transport()
+	 * retries it after a REQUEST SENSE.
+	 */
 
 	/* read / write the requested data */
 	dev_dbg(dev, "%s %llu block(s), starting from %llu\n",
@@ -293,7 +318,7 @@ static int usb_stor_blk_io(struct block_device *disk_dev,
 		sector_count, sector_start);
 
 	while (sector_count > 0) {
-		u16 n = min_t(blkcnt_t, sector_count, US_MAX_IO_BLK);
+		u16 n = min_t(blkcnt_t, sector_count, us->max_io_blocks);
 
 		if (disk_dev->num_blocks > 0xffffffff) {
 			result = usb_stor_io_16(pblk_dev,
@@ -571,6 +596,9 @@ static int usb_stor_probe(struct usb_device *usbdev,
 	if (result)
 		goto BadDevice;
 
+	us->max_io_blocks = usb_stor_max_io_blocks(us);
+	dev_dbg(dev, "Up to %u blocks per command\n", us->max_io_blocks);
+
 	/* register a disk device for each LUN */
 	usb_stor_scan(usbdev, us);
 
@@ -50,6 +50,7 @@ struct us_data {
 	unsigned char		protocol;
 
 	unsigned char		max_lun;
+	unsigned int		max_io_blocks;	/* per READ/WRITE command */
 
 	char			*transport_name;
 
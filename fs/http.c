@@ -0,0 +1,490 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/*
+ * http.c - read only HTTP/1.1 file system
+ *
+ * Files are read with ranged GET requests starting at the current file
+ * position and reaching to the end of the file. As long as a file is read
+ * sequentially the same response keeps being consumed, a seek elsewhere
+ * drops the connection and issues a new request. File sizes are taken
+ * from the Content-Length of a HEAD request. Names the server answers
+ * with a redirect or an error, but accepts with a trailing slash, are
+ * treated as directories. Directories can't be listed.
+ *
+ * Mount with:
+ *
+ *   mount -t http server[:port] /mnt/http
+ */
+
+#define pr_fmt(fmt) "http: " fmt
+
+#include <common.h>
+#include <driver.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fs.h>
+#include <init.h>
+#include <malloc.h>
+#include <net.h>
+#include <xfuncs.h>
+#include <linux/ctype.h>
+#include <linux/err.h>
+#include <linux/stat.h>
+
+#define HTTP_PORT		80
+#define HTTP_LINE_MAX		1024
+
+struct http_priv {
+	IPaddr_t server;
+	uint16_t port;
+	char *host;
+};
+
+struct http_response {
+	int status;
+	loff_t content_length;
+	bool chunked;
+};
+
+struct file_priv {
+	struct tcp_sock *sk;
+	char *path;
+	loff_t pos;		/* file position of the next byte from sk */
+};
+
+/* percent-encode everything but unreserved characters and '/' */
+static char *http_encode_path(const char *path)
+{
+	char *encoded = xmalloc(strlen(path) * 3 + 1);
+	char *p = encoded;
+
+	for (; *path; path++) {
+		if (isalnum(*path) || strchr("/-._~", *path))
+			*p++ = *path;
+		else
+			p += sprintf(p, "%%%02X", (unsigned char)*path);
+	}
+	*p = '\0';
+
+	return encoded;
+}
+
+static int http_getline(struct tcp_sock *sk, char *line, size_t size)
+{
+	size_t len = 0;
+	ssize_t ret;
+	char c;
+
+	while (1) {
+		ret = tcp_recv(sk, &c, 1);
+		if (ret < 0)
+			return ret;
+		if (!ret)
+			return -EPROTO;
+		if (c == '\n')
+			break;
+		if (len < size - 1)
+			line[len++] = c;
+	}
+
+	if (len && line[len - 1] == '\r')
+		len--;
+	line[len] = '\0';
+
+	return len;
+}
+
+static int http_parse_response(struct tcp_sock *sk, struct http_response *resp)
+{
+	char *line = xmalloc(HTTP_LINE_MAX);
+	int ret;
+
+	resp->content_length = -1;
+	resp->chunked = false;
+
+	ret = http_getline(sk, line, HTTP_LINE_MAX);
+	if (ret < 0)
+		goto out;
+
+	if (strncmp(line, "HTTP/1.", 7) || !isdigit(line[9])) {
+		ret = -EPROTO;
+		goto out;
+	}
+
+	resp->status = simple_strtoul(line + 9, NULL, 10);
+
+	while (1) {
+		char *val;
+
+		ret = http_getline(sk, line, HTTP_LINE_MAX);
+		if (ret <= 0)
+			break;
+
+		val = strchr(line, ':');
+		if (!val)
+			continue;
+		*val++ = '\0';
+		val = skip_spaces(val);
+
+		if (!strcasecmp(line, "Content-Length"))
+			resp->content_length = simple_strtoull(val, NULL, 10);
+		else if (!strcasecmp(line, "Transfer-Encoding"))
+			resp->chunked = !!strstr(val, "chunked");
+	}
+out:
+	free(line);
+
+	return ret;
+}
+
+/*
+ * Send a request for @path and parse the response header. With @offset >= 0
+ * the content is requested from there on. The body is left to be read from
+ * the returned socket.
+ */
+static struct tcp_sock *http_request(struct http_priv *priv, const char *method,
+				     const char *path, loff_t offset,
+				     struct http_response *resp)
+{
+	struct tcp_sock *sk;
+	char *encoded, *req, *range = NULL;
+	int ret;
+
+	sk = tcp_connect(priv->server, priv->port);
+	if (IS_ERR(sk))
+		return sk;
+
+	encoded = http_encode_path(path);
+	if (offset >= 0)
+		range = xasprintf("Range: bytes=%lld-\r\n", offset);
+	req = xasprintf("%s %s HTTP/1.1\r\n"
+			"Host: %s\r\n"
+			"%s"
+			"Connection: close\r\n"
+			"\r\n",
+			method, encoded, priv->host, range ?: "");
+	free(encoded);
+	free(range);
+
+	ret = tcp_send(sk, req, strlen(req));
+	free(req);
+	if (ret < 0)
+		goto err;
+
+	ret = http_parse_response(sk, resp);
+	if (ret < 0)
+		goto err;
+
+	pr_debug("%s %s @%lld: %d\n", method, path, offset, resp->status);
+
+	return sk;
+err:
+	tcp_close(sk);
+
+	return ERR_PTR(ret);
+}
+
+static int http_head(struct http_priv *priv, const char *path,
+		     struct http_response *resp)
+{
+	struct tcp_sock *sk;
+
+	sk = http_request(priv, "HEAD", path, -1, resp);
+	if (IS_ERR(sk))
+		return PTR_ERR(sk);
+
+	tcp_close(sk);
+
+	return 0;
+}
+
+static int http_status_to_errno(int status)
+{
+	switch (status) {
+	case 401:
+	case 403:
+		return -EACCES;
+	case 404:
+	case 410:
+		return -ENOENT;
+	default:
+		return -EIO;
+	}
+}
+
+/* discard @len bytes of the response */
+static int http_skip(struct tcp_sock *sk, loff_t len)
+{
+	char buf[256];
+	ssize_t ret;
+
+	while (len) {
+		ret = tcp_recv(sk, buf, min_t(loff_t, len, sizeof(buf)));
+		if (ret <= 0)
+			return ret ?: -EPROTO;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+static int http_open_stream(struct http_priv *hpriv, struct file_priv *priv,
+			    loff_t pos)
+{
+	struct http_response resp;
+	struct tcp_sock *sk;
+	int ret;
+
+	sk = http_request(hpriv, "GET", priv->path, pos, &resp);
+	if (IS_ERR(sk))
+		return PTR_ERR(sk);
+
+	if (resp.chunked) {
+		ret = -ENOTSUPP;
+		goto err;
+	}
+
+	switch (resp.status) {
+	case 206:
+		break;
+	case 200:
+		/* server ignored the range, skip what we don't want */
+		ret = http_skip(sk, pos);
+		if (ret)
+			goto err;
+		break;
+	default:
+		ret = http_status_to_errno(resp.status);
+		goto err;
+	}
+
+	priv->sk = sk;
+	priv->pos = pos;
+
+	return 0;
+err:
+	tcp_close(sk);
+
+	return ret;
+}
+
+static void http_close_stream(struct file_priv *priv)
+{
+	if (priv->sk)
+		tcp_close(priv->sk);
+	priv->sk = NULL;
+}
+
+static int http_open(struct device *dev, FILE *file, const char *filename)
+{
+	struct file_priv *priv;
+
+	if ((file->flags & O_ACCMODE) != O_RDONLY)
+		return -EROFS;
+
+	priv = xzalloc(sizeof(*priv));
+	priv->path = xstrdup(filename);
+	file->priv = priv;
+
+	return 0;
+}
+
+static int http_close(struct device *dev, FILE *file)
+{
+	struct file_priv *priv = file->priv;
+
+	http_close_stream(priv);
+	free(priv->path);
+	free(priv);
+
+	return 0;
+}
+
+static int http_read(struct device *dev, FILE *file, void *buf, size_t insize)
+{
+	struct http_priv *hpriv = dev->priv;
+	struct file_priv *priv = file->priv;
+	size_t outsize = 0;
+	ssize_t ret;
+
+	if (priv->sk && priv->pos != file->pos)
+		http_close_stream(priv);
+
+	while (outsize < insize) {
+		if (!priv->sk) {
+			ret = http_open_stream(hpriv, priv, file->pos + outsize);
+			if (ret)
+				return ret;
+		}
+
+		ret = tcp_recv(priv->sk, buf + outsize, insize - outsize);
+		if (ret < 0) {
+			http_close_stream(priv);
+			return ret;
+		}
+		if (!ret) {
+			http_close_stream(priv);
+			break;
+		}
+
+		outsize += ret;
+		priv->pos += ret;
+	}
+
+	return outsize;
+}
+
+static int http_lseek(struct device *dev, FILE *file, loff_t pos)
+{
+	/* a stream not starting at pos is dropped on the next read */
+	return 0;
+}
+
+static const struct inode_operations http_file_inode_operations;
+static const struct inode_operations http_dir_inode_operations;
+static const struct file_operations http_file_operations;
+
+static struct inode *http_get_inode(struct super_block *sb, umode_t mode)
+{
+	struct inode *inode = new_inode(sb);
+
+	if (!inode)
+		return NULL;
+
+	inode->i_ino = get_next_ino();
+	inode->i_mode = mode;
+
+	switch (mode & S_IFMT) {
+	default:
+		return NULL;
+	case S_IFREG:
+		inode->i_op = &http_file_inode_operations;
+		inode->i_fop = &http_file_operations;
+		break;
+	case S_IFDIR:
+		inode->i_op = &http_dir_inode_operations;
+		inode->i_fop = &simple_dir_operations;
+		inc_nlink(inode);
+		break;
+	}
+
+	return inode;
+}
+
+static struct dentry *http_lookup(struct inode *dir, struct dentry *dentry,
+				  unsigned int flags)
+{
+	struct super_block *sb = dir->i_sb;
+	struct fs_device *fsdev = container_of(sb, struct fs_device, sb);
+	struct http_priv *priv = fsdev->dev.priv;
+	struct http_response resp;
+	struct inode *inode;
+	char *path, *dirpath;
+	int ret;
+
+	path = dpath(dentry, fsdev->vfsmount.mnt_root);
+
+	ret = http_head(priv, path, &resp);
+	if (ret)
+		goto out;
+
+	if (resp.status == 200 && resp.content_length >= 0) {
+		inode = http_get_inode(sb, S_IFREG | S_IRWXUGO);
+		if (!inode)
+			goto out;
+		inode->i_size = resp.content_length;
+		d_add(dentry, inode);
+		goto out;
+	}
+
+	dirpath = xasprintf("%s/", path);
+	ret = http_head(priv, dirpath, &resp);
+	free(dirpath);
+	if (ret || resp.status != 200)
+		goto out;
+
+	inode = http_get_inode(sb, S_IFDIR | S_IRWXUGO);
+	if (!inode)
+		goto out;
+	d_add(dentry, inode);
+out:
+	free(path);
+
+	return NULL;
+}
+
+static const struct inode_operations http_dir_inode_operations = {
+	.lookup = http_lookup,
+};
+
+static const struct super_operations http_ops;
+
+static int http_probe(struct device *dev)
+{
+	struct fs_device *fsdev = dev_to_fs_device(dev);
+	struct http_priv *priv = xzalloc(sizeof(struct http_priv));
+	struct super_block *sb = &fsdev->sb;
+	struct inode *inode;
+	char *host, *port;
+	int ret;
+
+	priv->host = xstrdup(fsdev->backingstore);
+	priv->port = HTTP_PORT;
+
+	host = xstrdup(fsdev->backingstore);
+	port = strchr(host, ':');
+	if (port) {
+		*port++ = '\0';
+		priv->port = simple_strtoul(port, NULL, 10);
+	}
+
+	ret = resolv(host, &priv->server);
+	free(host);
+	if (ret) {
+		pr_err("Cannot resolve \"%s\": %pe\n", fsdev->backingstore,
+		       ERR_PTR(ret));
+		goto err;
+	}
+
+	sb->s_op = &http_ops;
+	sb->s_d_op = &no_revalidate_d_ops;
+
+	inode = http_get_inode(sb, S_IFDIR);
+	sb->s_root = d_make_root(inode);
+
+	dev->priv = priv;
+
+	return 0;
+err:
+	free(priv->host);
+	free(priv);
+
+	return ret;
+}
+
+static void http_remove(struct device *dev)
+{
+	struct http_priv *priv = dev->priv;
+
+	free(priv->host);
+	free(priv);
+}
+
+static struct fs_driver http_driver = {
+	.open      = http_open,
+	.close     = http_close,
+	.read      = http_read,
+	.lseek     = http_lseek,
+	.flags     = 0,
+	.drv = {
+		.probe  = http_probe,
+		.remove = http_remove,
+		.name = "http",
+	}
+};
+
+static int http_init(void)
+{
+	return register_fs_driver(&http_driver);
+}
+coredevice_initcall(http_init);
@@ -93,7 +93,7 @@ static inline int jffs2_flash_read(struct jffs2_sb_info *c, loff_t ofs, size_t l
 #define jffs2_wbuf_dirty(c) (0)
 #define jffs2_is_writebuffered(c) (0)
 
-#ifdef CONFIG_JFFS2_SUMMARY
+#ifdef CONFIG_FS_JFFS2_SUMMARY
 #define jffs2_can_mark_obsolete(c) (0)
 #else
 #define jffs2_can_mark_obsolete(c) (1)
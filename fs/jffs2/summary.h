@@ -166,23 +166,9 @@ struct jffs2_sum_marker
 
 #define JFFS2_SUMMARY_FRAME_SIZE (sizeof(struct jffs2_raw_summary) + sizeof(struct jffs2_sum_marker))
 
-#ifdef CONFIG_JFFS2_SUMMARY	/* SUMMARY SUPPORT ENABLED */
+#ifdef CONFIG_FS_JFFS2_SUMMARY	/* SUMMARY SUPPORT ENABLED */
 
 #define jffs2_sum_active() (1)
-int jffs2_sum_init(struct jffs2_sb_info *c);
-void jffs2_sum_exit(struct jffs2_sb_info *c);
-void jffs2_sum_disable_collecting(struct jffs2_summary *s);
-int jffs2_sum_is_disabled(struct jffs2_summary *s);
-void jffs2_sum_reset_collected(struct jffs2_summary *s);
-void jffs2_sum_move_collected(struct jffs2_sb_info *c, struct jffs2_summary *s);
-int jffs2_sum_add_kvec(struct jffs2_sb_info *c, const struct kvec *invecs,
-			unsigned long count,  uint32_t to);
-int jffs2_sum_write_sumnode(struct jffs2_sb_info *c);
-int jffs2_sum_add_padding_mem(struct jffs2_summary *s, uint32_t size);
-int jffs2_sum_add_inode_mem(struct jffs2_summary *s, struct jffs2_raw_inode *ri, uint32_t ofs);
-int jffs2_sum_add_dirent_mem(struct jffs2_summary *s, struct jffs2_raw_dirent *rd, uint32_t ofs);
-int jffs2_sum_add_xattr_mem(struct jffs2_summary *s, struct jffs2_raw_xattr *rx, uint32_t ofs);
-int jffs2_sum_add_xref_mem(struct jffs2_summary *s, struct jffs2_raw_xref *rr, uint32_t ofs);
 int jffs2_sum_scan_sumnode(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb,
 			   struct jffs2_raw_summary *summary, uint32_t sumlen,
 			   uint32_t *pseudo_random);
@@ -190,6 +176,11 @@ int jffs2_sum_scan_sumnode(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb
 #else				/* SUMMARY DISABLED */
 
 #define jffs2_sum_active() (0)
+#define jffs2_sum_scan_sumnode(a,b,c,d,e) (0)
+
+#endif /* CONFIG_FS_JFFS2_SUMMARY */
+
+/* barebox doesn't write, so there is no summary information to collect */
 #define jffs2_sum_init(a) (0)
 #define jffs2_sum_exit(a)
 #define jffs2_sum_disable_collecting(a)
@@ -203,8 +194,5 @@ int jffs2_sum_scan_sumnode(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb
 #define jffs2_sum_add_dirent_mem(a,b,c)
 #define jffs2_sum_add_xattr_mem(a,b,c)
 #define jffs2_sum_add_xref_mem(a,b,c)
-#define jffs2_sum_scan_sumnode(a,b,c,d,e) (0)
-
-#endif /* CONFIG_JFFS2_SUMMARY */
 
 #endif /* JFFS2_SUMMARY_H */
@@ -107,7 +107,7 @@ static int __init init_jffs2_fs(void)
 
 	pr_info("JFFS version 2.2."
 	       " (NAND ro)"
-#ifdef CONFIG_JFFS2_SUMMARY
+#ifdef CONFIG_FS_JFFS2_SUMMARY
 	       " (SUMMARY) "
 #endif
 	       " © 2001-2006 Red Hat, Inc.\n");
@@ -121,6 +121,18 @@ struct rpc_reply {
 #define NFS_TIMEOUT	(100 * MSECOND)
 #define NFS_MAX_RESEND	100
 
+/*
+ * READ requests are limited to what fits into a single reply packet,
+ * unless fragmented replies are reassembled. Then NFS_READ_SIZE_IPFRAG is
+ * used, which can be changed with the "rsize" mount option up to
+ * NFS_READ_SIZE_MAX. Up to NFS_READ_WINDOW requests are kept in flight
+ * while reading a file sequentially.
+ */
+#define NFS_READ_SIZE		1024
+#define NFS_READ_SIZE_IPFRAG	8192
+#define NFS_READ_SIZE_MAX	32768
+#define NFS_READ_WINDOW		16
+
 struct nfs_fh {
 	unsigned short size;
 	unsigned char data[NFS3_FHSIZE];
@@ -141,15 +153,33 @@ struct nfs_priv {
 	uint16_t nfs_port;
 	unsigned manual_nfs_port:1;
 	uint32_t rpc_id;
+	uint16_t rsize;
 	struct nfs_fh rootfh;
 	struct list_head packets;
+	struct list_head files;		/* open files, for their READs in flight */
+};
+
+struct nfs_read_slot {
+	uint32_t xid;
+	uint64_t offset;
+	uint32_t count;
+	uint64_t sent;
+	int tries;
+	struct packet *reply;
 };
 
 struct file_priv {
+	struct list_head list;
 	struct kfifo *fifo;
 	void *buf;
 	struct nfs_priv *npriv;
 	struct nfs_fh fh;
+
+	loff_t pos;		/* file position of the data in the fifo */
+	uint64_t next;		/* offset of the next READ to send */
+	unsigned int head;	/* oldest READ in flight */
+	unsigned int inflight;
+	struct nfs_read_slot slots[NFS_READ_WINDOW];
 };
 
 struct nfs_inode {
@@ -456,23 +486,83 @@ static void nfs_free_packet(struct packet *packet)
 	free(packet);
 }
 
+static uint32_t rpc_reply_xid(struct packet *packet)
+{
+	struct rpc_reply rpc;
+
+	memcpy(&rpc, packet->data, sizeof(rpc));
+
+	return ntoh32(rpc.id);
+}
+
 /*
- * rpc_req - synchronous RPC request
+ * nfs_read_find_slot - Find the READ in flight still waiting for @xid
  */
-static struct packet *rpc_req(struct nfs_priv *npriv, int rpc_prog,
-			      int rpc_proc, uint32_t *data, int datalen)
+static struct nfs_read_slot *nfs_read_find_slot(struct file_priv *priv,
+						uint32_t xid)
+{
+	unsigned int i;
+
+	for (i = 0; i < priv->inflight; i++) {
+		struct nfs_read_slot *s;
+
+		s = &priv->slots[(priv->head + i) % NFS_READ_WINDOW];
+		if (s->xid == xid && !s->reply)
+			return s;
+	}
+
+	return NULL;
+}
+
+/*
+ * nfs_reply_wanted - Check whether an open file waits for a reply
+ *
+ * Replies are queued on npriv->packets for everyone. Those to the READs in
+ * flight of other open files are left there until that file claims them,
+ * or until the READ is dropped and the reply is thrown away as well.
+ */
+static bool nfs_reply_wanted(struct nfs_priv *npriv, struct packet *packet)
+{
+	uint32_t xid = rpc_reply_xid(packet);
+	struct file_priv *priv;
+
+	list_for_each_entry(priv, &npriv->files, list)
+		if (nfs_read_find_slot(priv, xid))
+			return true;
+
+	return false;
+}
+
+/*
+ * rpc_find_reply - Find the reply to @xid among the received packets
+ *
+ * Replies nobody waits for anymore are thrown away on the way.
+ */
+static struct packet *rpc_find_reply(struct nfs_priv *npriv, uint32_t xid)
+{
+	struct packet *packet, *tmp;
+
+	list_for_each_entry_safe(packet, tmp, &npriv->packets, list) {
+		if (rpc_reply_xid(packet) == xid)
+			return packet;
+		if (!nfs_reply_wanted(npriv, packet))
+			nfs_free_packet(packet);
+	}
+
+	return NULL;
+}
+
+/*
+ * rpc_send - send an RPC call without waiting for the reply
+ */
+static int rpc_send(struct nfs_priv *npriv, int rpc_prog, int rpc_proc,
+		    uint32_t rpc_id, uint32_t *data, int datalen)
 {
 	struct rpc_call pkt;
 	unsigned short dport;
-	int ret;
 	unsigned char *payload = net_udp_get_payload(npriv->con);
-	int nfserr;
-	int tries = 0;
-	struct packet *packet;
 
-	npriv->rpc_id++;
-
-	pkt.id = hton32(npriv->rpc_id);
+	pkt.id = hton32(rpc_id);
 	pkt.type = hton32(MSG_CALL);
 	pkt.rpcvers = hton32(2);	/* use RPC version 2 */
 	pkt.prog = hton32(rpc_prog);
@@ -496,11 +586,28 @@ static struct packet *rpc_req(struct nfs_priv *npriv, int rpc_prog,
 
 	npriv->con->udp->uh_dport = hton16(dport);
 
+	return net_udp_send(npriv->con,
+			sizeof(pkt) + datalen * sizeof(uint32_t));
+}
+
+/*
+ * rpc_req - synchronous RPC request
+ */
+static struct packet *rpc_req(struct nfs_priv *npriv, int rpc_prog,
+			      int rpc_proc, uint32_t *data, int datalen)
+{
+	int ret;
+	int nfserr;
+	int tries = 0;
+	struct packet *packet;
+
+	npriv->rpc_id++;
+
 	nfs_timer_start = get_time_ns();
 
 again:
-	ret = net_udp_send(npriv->con,
-			sizeof(pkt) + datalen * sizeof(uint32_t));
+	ret = rpc_send(npriv, rpc_prog, rpc_proc, npriv->rpc_id,
+		       data, datalen);
 	if (ret) {
 		if (is_timeout(nfs_timer_start, NFS_TIMEOUT)) {
 			tries++;
@@ -523,17 +630,13 @@ static struct packet *rpc_req(struct nfs_priv *npriv, int rpc_prog,
 			goto again;
 		}
 
-		if (list_empty(&npriv->packets))
+		packet = rpc_find_reply(npriv, npriv->rpc_id);
+		if (!packet)
 			continue;
 
-		packet = list_first_entry(&npriv->packets, struct packet, list);
-
 		ret = rpc_check_reply(packet, rpc_prog,
 				      npriv->rpc_id, &nfserr);
-		if (ret == -EAGAIN) {
-			nfs_free_packet(packet);
-			continue;
-		} else if (ret) {
+		if (ret) {
 			nfs_free_packet(packet);
 			return ERR_PTR(ret);
 		} else {
@@ -969,16 +1072,12 @@ static void *nfs_readdirattr_req(struct nfs_priv *npriv, struct nfs_dir *dir)
 }
 
 /*
- * nfs_read_req - Read File on NFS Server
+ * nfs_read_send - (re)send the READ request of a slot
  */
-static int nfs_read_req(struct file_priv *priv, uint64_t offset,
-		uint32_t readlen)
+static void nfs_read_send(struct file_priv *priv, struct nfs_read_slot *slot)
 {
 	uint32_t data[1024];
-	uint32_t *p, status;
-	int len, ret;
-	struct packet *nfs_packet;
-	uint32_t rlen, eof;
+	uint32_t *p;
 
 	/*
 	 * struct READ3args {
@@ -986,7 +1085,34 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	 * 	offset3 offset;
 	 * 	count3 count;
 	 * };
-	 *
+	 */
+	p = &(data[0]);
+	p = rpc_add_credentials(p);
+
+	p = nfs_add_fh3(p, &priv->fh);
+	p = nfs_add_uint64(p, slot->offset);
+	p = nfs_add_uint32(p, slot->count);
+
+	/* a failed send is handled like a lost reply */
+	rpc_send(priv->npriv, PROG_NFS, NFSPROC3_READ, slot->xid,
+		 data, p - &(data[0]));
+
+	slot->sent = get_time_ns();
+}
+
+/*
+ * nfs_read_reply - Queue the data of a READ reply
+ *
+ * Returns the number of bytes queued or a negative error code.
+ */
+static int nfs_read_reply(struct file_priv *priv, struct nfs_read_slot *slot)
+{
+	struct packet *nfs_packet = slot->reply;
+	uint32_t *p, status;
+	uint32_t rlen, eof;
+	int nfserr, ret;
+
+	/*
 	 * struct READ3resok {
 	 * 	post_op_attr file_attributes;
 	 * 	count3 count;
@@ -1005,18 +1131,9 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	 * 	READ3resfail resfail;
 	 * };
 	 */
-	p = &(data[0]);
-	p = rpc_add_credentials(p);
-
-	p = nfs_add_fh3(p, &priv->fh);
-	p = nfs_add_uint64(p, offset);
-	p = nfs_add_uint32(p, readlen);
-
-	len = p - &(data[0]);
-
-	nfs_packet = rpc_req(priv->npriv, PROG_NFS, NFSPROC3_READ, data, len);
-	if (IS_ERR(nfs_packet))
-		return PTR_ERR(nfs_packet);
+	ret = rpc_check_reply(nfs_packet, PROG_NFS, slot->xid, &nfserr);
+	if (ret)
+		return ret;
 
 	p = (void *)nfs_packet->data + sizeof(struct rpc_reply);
 	status = ntoh32(net_read_uint32(p++));
@@ -1040,16 +1157,156 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	 */
 	p += 2;
 
-	if (readlen && !rlen && !eof) {
-		nfs_free_packet(nfs_packet);
+	if (rlen > slot->count ||
+	    (void *)p + rlen > (void *)nfs_packet->data + nfs_packet->len)
+		return -EIO;
+
+	if (slot->count && !rlen && !eof)
 		return -EIO;
-	}
 
 	kfifo_put(priv->fifo, (char *)p, rlen);
 
-	nfs_free_packet(nfs_packet);
+	return rlen;
+}
 
-	return 0;
+static void nfs_read_free_slot(struct file_priv *priv)
+{
+	struct nfs_read_slot *slot = &priv->slots[priv->head];
+
+	free(slot->reply);
+	slot->reply = NULL;
+
+	priv->head = (priv->head + 1) % NFS_READ_WINDOW;
+	priv->inflight--;
+}
+
+/*
+ * nfs_read_drop - Drop all READs in flight
+ *
+ * Replies to the dropped requests may still arrive or be queued already,
+ * they don't match any request anymore and are thrown away.
+ */
+static void nfs_read_drop(struct file_priv *priv)
+{
+	while (priv->inflight)
+		nfs_read_free_slot(priv);
+
+	priv->next = priv->pos + kfifo_len(priv->fifo);
+}
+
+static void nfs_read_reset(struct file_priv *priv, loff_t pos)
+{
+	kfifo_reset(priv->fifo);
+	priv->pos = pos;
+	nfs_read_drop(priv);
+}
+
+/*
+ * nfs_read_dispatch - Assign received packets to the READs in flight
+ */
+static void nfs_read_dispatch(struct file_priv *priv)
+{
+	struct nfs_priv *npriv = priv->npriv;
+	struct packet *packet, *tmp;
+
+	list_for_each_entry_safe(packet, tmp, &npriv->packets, list) {
+		struct nfs_read_slot *slot;
+
+		slot = nfs_read_find_slot(priv, rpc_reply_xid(packet));
+		if (!slot) {
+			/* for another file, late duplicate or dropped request */
+			if (!nfs_reply_wanted(npriv, packet))
+				nfs_free_packet(packet);
+			continue;
+		}
+
+		list_del(&packet->list);
+		slot->reply = packet;
+	}
+}
+
+/*
+ * nfs_read_window - Read File on NFS Server
+ *
+ * Keeps up to NFS_READ_WINDOW READ requests for consecutive chunks of
+ * the file in flight, so that the round trip time is spent only once
+ * per window instead of once per request. Replies are matched by XID,
+ * only requests whose reply is overdue are sent again.
+ *
+ * Returns the number of bytes added to the fifo, 0 at the end of the
+ * file or a negative error code.
+ */
+static int nfs_read_window(struct file_priv *priv, loff_t size)
+{
+	struct nfs_priv *npriv = priv->npriv;
+	struct nfs_read_slot *slot;
+	uint32_t count;
+	unsigned int i;
+	int newest, ret;
+
+	while (priv->inflight < NFS_READ_WINDOW && priv->next < size) {
+		slot = &priv->slots[(priv->head + priv->inflight) % NFS_READ_WINDOW];
+
+		slot->xid = ++npriv->rpc_id;
+		slot->offset = priv->next;
+		slot->count = min_t(uint64_t, npriv->rsize, size - priv->next);
+		slot->tries = 0;
+		slot->reply = NULL;
+
+		nfs_read_send(priv, slot);
+
+		priv->next += slot->count;
+		priv->inflight++;
+	}
+
+	if (!priv->inflight)
+		return 0;
+
+	slot = &priv->slots[priv->head];
+	count = slot->count;
+
+	while (!slot->reply) {
+		net_poll();
+		nfs_read_dispatch(priv);
+
+		/*
+		 * Replies usually arrive in order. A missing one followed
+		 * by others was most likely lost, send it again right away
+		 * the first time instead of waiting for the timeout.
+		 */
+		newest = -1;
+		for (i = 0; i < priv->inflight; i++)
+			if (priv->slots[(priv->head + i) % NFS_READ_WINDOW].reply)
+				newest = i;
+
+		for (i = 0; i < priv->inflight; i++) {
+			struct nfs_read_slot *s;
+
+			s = &priv->slots[(priv->head + i) % NFS_READ_WINDOW];
+			if (s->reply)
+				continue;
+			if (((int)i > newest || s->tries) &&
+			    !is_timeout(s->sent, NFS_TIMEOUT))
+				continue;
+
+			if (++s->tries == NFS_MAX_RESEND)
+				return -ETIMEDOUT;
+
+			nfs_read_send(priv, s);
+		}
+	}
+
+	ret = nfs_read_reply(priv, slot);
+	nfs_read_free_slot(priv);
+
+	/*
+	 * After an error or a short read the requests in flight don't
+	 * continue where the data ends, start over from there.
+	 */
+	if (ret < count)
+		nfs_read_drop(priv);
+
+	return ret;
 }
 
 static void nfs_handler(void *ctx, char *p, unsigned len)
@@ -1072,6 +1329,11 @@ static int nfs_truncate(struct device *dev, FILE *f, loff_t size)
 
 static void nfs_do_close(struct file_priv *priv)
 {
+	list_del(&priv->list);
+
+	while (priv->inflight)
+		nfs_read_free_slot(priv);
+
 	if (priv->fifo)
 		kfifo_free(priv->fifo);
 
@@ -1169,12 +1431,14 @@ static int nfs_open(struct device *dev, FILE *file, const char *filename)
 	file->priv = priv;
 	file->size = inode->i_size;
 
-	priv->fifo = kfifo_alloc(1024);
+	priv->fifo = kfifo_alloc(npriv->rsize);
 	if (!priv->fifo) {
 		free(priv);
 		return -ENOMEM;
 	}
 
+	list_add(&priv->list, &npriv->files);
+
 	return 0;
 }
 
@@ -1196,24 +1460,30 @@ static int nfs_write(struct device *_dev, FILE *file, const void *inbuf,
 static int nfs_read(struct device *dev, FILE *file, void *buf, size_t insize)
 {
 	struct file_priv *priv = file->priv;
+	int ret;
 
-	if (insize > 1024)
-		insize = 1024;
+	/* pread() changes the position without calling lseek() */
+	if (file->pos != priv->pos)
+		nfs_read_reset(priv, file->pos);
 
-	if (insize && !kfifo_len(priv->fifo)) {
-		int ret = nfs_read_req(priv, file->pos, insize);
-		if (ret)
+	while (!kfifo_len(priv->fifo)) {
+		ret = nfs_read_window(priv, file->size);
+		if (ret <= 0)
 			return ret;
 	}
 
-	return kfifo_get(priv->fifo, buf, insize);
+	ret = kfifo_get(priv->fifo, buf, insize);
+	priv->pos += ret;
+
+	return ret;
 }
 
 static int nfs_lseek(struct device *dev, FILE *file, loff_t pos)
 {
 	struct file_priv *priv = file->priv;
 
-	kfifo_reset(priv->fifo);
+	if (pos != priv->pos)
+		nfs_read_reset(priv, pos);
 
 	return 0;
 }
@@ -1438,6 +1708,7 @@ static int nfs_probe(struct device *dev)
 	dev->priv = npriv;
 
 	INIT_LIST_HEAD(&npriv->packets);
+	INIT_LIST_HEAD(&npriv->files);
 
 	debug("nfs: mount: %s\n", fsdev->backingstore);
 
@@ -1468,6 +1739,15 @@ static int nfs_probe(struct device *dev)
 	/* Need a priviliged source port */
 	net_udp_bind(npriv->con, 1000);
 
+	if (IS_ENABLED(CONFIG_NET_IP_REASSEMBLY)) {
+		npriv->rsize = NFS_READ_SIZE_IPFRAG;
+		parseopt_hu(fsdev->options, "rsize", &npriv->rsize);
+		npriv->rsize = clamp_t(uint16_t, npriv->rsize, NFS_READ_SIZE,
+				       NFS_READ_SIZE_MAX);
+	} else {
+		npriv->rsize = NFS_READ_SIZE;
+	}
+
 	parseopt_hu(fsdev->options, "mountport", &npriv->mount_port);
 	if (!npriv->mount_port) {
 		ret = rpc_lookup_req(npriv, PROG_MOUNT, 3);
@@ -21,16 +21,20 @@
 #include <fs.h>
 #include <command.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <linux/stat.h>
 #include <xfuncs.h>
 #include <linux/sizes.h>
 
-#define CHUNK_SIZE	(4096 * 2)
-
+/*
+ * File data is stored in extents of arbitrary size. Growing a file first
+ * tries to enlarge its last extent, so files written sequentially or sized
+ * with ftruncate() up front usually end up in a single extent which can be
+ * memmapped. Only when that fails further extents are added.
+ */
 struct ramfs_chunk {
 	unsigned long ofs;
-	int size;
-	struct list_head list;
+	unsigned long size;
 	char data[];
 };
 
@@ -45,9 +49,12 @@ struct ramfs_inode {
 	/* bytes currently allocated for this inode */
 	unsigned long alloc_size;
 
-	struct list_head data;
+	/* extents sorted by offset, together covering alloc_size bytes */
+	struct ramfs_chunk **chunks;
+	unsigned int nr_chunks;
 
-	struct ramfs_chunk *current_chunk;
+	/* index of the extent last accessed */
+	unsigned int current_chunk;
 };
 
 static inline struct ramfs_inode *to_ramfs_inode(struct inode *inode)
@@ -103,7 +110,7 @@ static struct ramfs_chunk *ramfs_get_chunk(unsigned long size)
 	if (size < MIN_SIZE)
 		size = MIN_SIZE;
 
-	data = calloc(struct_size(data, data, size), 1);
+	data = malloc(struct_size(data, data, size));
 	if (!data)
 		return NULL;
 
@@ -189,30 +196,52 @@ static const struct inode_operations ramfs_dir_inode_operations =
 	.create = ramfs_create,
 };
 
+static bool ramfs_chunk_has(struct ramfs_chunk *data, unsigned long pos)
+{
+	return pos >= data->ofs && pos - data->ofs < data->size;
+}
+
 static struct ramfs_chunk *ramfs_find_chunk(struct ramfs_inode *node,
-					    unsigned long pos, int *ofs, int *len)
+					    unsigned long pos,
+					    unsigned long *ofs,
+					    unsigned long *len)
 {
-	struct ramfs_chunk *data, *cur = node->current_chunk;
+	unsigned int cur = node->current_chunk;
+	unsigned int lo = 0, hi = node->nr_chunks;
+	struct ramfs_chunk *data;
 
-	if (cur && pos >= cur->ofs)
-		data = cur;
-	else
-		data = list_first_entry(&node->data, struct ramfs_chunk, list);
+	/* sequential access stays in the current extent or moves to the next */
+	if (cur < hi && ramfs_chunk_has(node->chunks[cur], pos))
+		goto found;
 
-	list_for_each_entry_from(data, &node->data, list) {
-		if (data->ofs + data->size > pos) {
-			*ofs = pos - data->ofs;
-			*len = data->ofs + data->size - pos;
+	if (cur + 1 < hi && ramfs_chunk_has(node->chunks[cur + 1], pos)) {
+		cur++;
+		goto found;
+	}
 
-			node->current_chunk = data;
+	while (lo < hi) {
+		cur = lo + (hi - lo) / 2;
+		data = node->chunks[cur];
 
-			return data;
-		}
+		if (pos < data->ofs)
+			hi = cur;
+		else if (pos - data->ofs >= data->size)
+			lo = cur + 1;
+		else
+			goto found;
 	}
 
 	pr_err("%s: no chunk for pos %ld found\n", __func__, pos);
 
 	return NULL;
+found:
+	data = node->chunks[cur];
+	*ofs = pos - data->ofs;
+	*len = data->size - *ofs;
+
+	node->current_chunk = cur;
+
+	return data;
 }
 
 static int ramfs_read(struct device *_dev, FILE *f, void *buf, size_t insize)
@@ -220,9 +249,9 @@ static int ramfs_read(struct device *_dev, FILE *f, void *buf, size_t insize)
 	struct inode *inode = f->f_inode;
 	struct ramfs_inode *node = to_ramfs_inode(inode);
 	struct ramfs_chunk *data;
-	int ofs, len, now;
+	unsigned long ofs, len, now;
 	unsigned long pos = f->pos;
-	int size = insize;
+	size_t size = insize;
 
 	debug("%s: %p %zu @ %lld\n", __func__, node, insize, f->pos);
 
@@ -231,9 +260,9 @@ static int ramfs_read(struct device *_dev, FILE *f, void *buf, size_t insize)
 		if (!data)
 			return -EINVAL;
 
-		debug("%s: pos: %lu ofs: %d len: %d\n", __func__, pos, ofs, len);
+		debug("%s: pos: %lu ofs: %lu len: %lu\n", __func__, pos, ofs, len);
 
-		now = min(size, len);
+		now = min_t(unsigned long, size, len);
 
 		memcpy(buf, data->data + ofs, now);
 
@@ -251,9 +280,9 @@ static int ramfs_write(struct device *_dev, FILE *f, const void *buf,
 	struct inode *inode = f->f_inode;
 	struct ramfs_inode *node = to_ramfs_inode(inode);
 	struct ramfs_chunk *data;
-	int ofs, len, now;
+	unsigned long ofs, len, now;
 	unsigned long pos = f->pos;
-	int size = insize;
+	size_t size = insize;
 
 	debug("%s: %p %zu @ %lld\n", __func__, node, insize, f->pos);
 
@@ -262,9 +291,9 @@ static int ramfs_write(struct device *_dev, FILE *f, const void *buf,
 		if (!data)
 			return -EINVAL;
 
-		debug("%s: pos: %lu ofs: %d len: %d\n", __func__, pos, ofs, len);
+		debug("%s: pos: %lu ofs: %lu len: %lu\n", __func__, pos, ofs, len);
 
-		now = min(size, len);
+		now = min_t(unsigned long, size, len);
 
 		memcpy(data->data + ofs, buf, now);
 
@@ -278,38 +307,95 @@ static int ramfs_write(struct device *_dev, FILE *f, const void *buf,
 
 static void ramfs_truncate_down(struct ramfs_inode *node, unsigned long size)
 {
-	struct ramfs_chunk *data, *tmp;
+	struct ramfs_chunk *data;
 
-	list_for_each_entry_safe(data, tmp, &node->data, list) {
-		if (data->ofs >= size) {
-			list_del(&data->list);
-			node->alloc_size -= data->size;
-			ramfs_put_chunk(data);
-		}
+	while (node->nr_chunks) {
+		data = node->chunks[node->nr_chunks - 1];
+		if (data->ofs < size)
+			break;
+
+		node->nr_chunks--;
+		node->alloc_size -= data->size;
+		ramfs_put_chunk(data);
+	}
+
+	if (!node->nr_chunks) {
+		free(node->chunks);
+		node->chunks = NULL;
 	}
 
-	node->current_chunk = NULL;
+	node->current_chunk = 0;
+}
+
+/*
+ * Resize the last extent to cover up to @size bytes of the file. realloc()
+ * may have to move the data, but keeps the file in one piece.
+ */
+static int ramfs_resize_last_chunk(struct ramfs_inode *node, unsigned long size)
+{
+	struct ramfs_chunk *data = node->chunks[node->nr_chunks - 1];
+
+	size = max_t(unsigned long, size - data->ofs, MIN_SIZE);
+
+	data = realloc(data, struct_size(data, data, size));
+	if (!data)
+		return -ENOMEM;
+
+	node->alloc_size = node->alloc_size - data->size + size;
+	data->size = size;
+	node->chunks[node->nr_chunks - 1] = data;
+
+	return 0;
+}
+
+static int ramfs_add_chunk(struct ramfs_inode *node, struct ramfs_chunk *data)
+{
+	struct ramfs_chunk **chunks;
+
+	chunks = realloc(node->chunks, (node->nr_chunks + 1) * sizeof(*chunks));
+	if (!chunks)
+		return -ENOMEM;
+
+	data->ofs = node->alloc_size;
+	chunks[node->nr_chunks++] = data;
+	node->chunks = chunks;
+	node->alloc_size += data->size;
+
+	return 0;
 }
 
 static int ramfs_truncate_up(struct ramfs_inode *node, unsigned long size)
 {
-	struct ramfs_chunk *data, *tmp;
-	LIST_HEAD(list);
+	struct ramfs_chunk *data;
+	unsigned int nr_chunks = node->nr_chunks;
+	unsigned long alloc_size = node->alloc_size;
 	unsigned long add = size - node->alloc_size;
 	unsigned long chunksize = add;
-	unsigned long alloc_size = 0;
 
 	if (node->alloc_size >= size)
 		return 0;
 
+	if (node->nr_chunks) {
+		/*
+		 * Reserve twice the current size when appending, so files
+		 * written in small pieces are only moved a few times.
+		 */
+		if (add < node->alloc_size &&
+		    !ramfs_resize_last_chunk(node, 2 * node->alloc_size))
+			return 0;
+
+		if (!ramfs_resize_last_chunk(node, size))
+			return 0;
+	}
+
 	/*
 	 * We first try to allocate all space we need in a single chunk.
 	 * This may fail because of fragmented memory, so in case we cannot
 	 * allocate memory we successively decrease the chunk size until
 	 * we have enough allocations made.
 	 */
-	while (1) {
-		unsigned long now = min(chunksize, add);
+	while (node->alloc_size < size) {
+		unsigned long now = min(chunksize, size - node->alloc_size);
 
 		data = ramfs_get_chunk(now);
 		if (!data) {
@@ -323,29 +409,19 @@ static int ramfs_truncate_up(struct ramfs_inode *node, unsigned long size)
 			continue;
 		}
 
-		data->ofs = node->alloc_size + alloc_size;
-
-		alloc_size += data->size;
-
-		list_add_tail(&data->list, &list);
-
-		if (add <= data->size)
-			break;
-
-		add -= data->size;
+		if (ramfs_add_chunk(node, data)) {
+			ramfs_put_chunk(data);
+			goto out;
+		}
 	}
 
-	list_splice_tail(&list, &node->data);
-
-	node->alloc_size += alloc_size;
-
 	return 0;
 
 out:
-	list_for_each_entry_safe(data, tmp, &list, list) {
-		list_del(&data->list);
-		ramfs_put_chunk(data);
-	}
+	while (node->nr_chunks > nr_chunks)
+		ramfs_put_chunk(node->chunks[--node->nr_chunks]);
+
+	node->alloc_size = alloc_size;
 
 	return -ENOSPC;
 }
@@ -372,9 +448,22 @@ static int ramfs_truncate(struct device *dev, FILE *f, loff_t size)
 	if (size < node->size) {
 		ramfs_truncate_down(node, size);
 	} else {
+		unsigned long pos = node->size;
+
 		ret = ramfs_truncate_up(node, size);
 		if (ret)
 			return ret;
+
+		/* the new space, and what truncate_down kept, must read as 0 */
+		while (pos < size) {
+			struct ramfs_chunk *data;
+			unsigned long ofs, len;
+
+			data = ramfs_find_chunk(node, pos, &ofs, &len);
+			len = min_t(unsigned long, len, size - pos);
+			memset(data->data + ofs, 0, len);
+			pos += len;
+		}
 	}
 
 	node->size = size;
@@ -382,21 +471,69 @@ static int ramfs_truncate(struct device *dev, FILE *f, loff_t size)
 	return 0;
 }
 
+/*
+ * Copy a file stored in several extents into a single one, so that it
+ * can be mapped. Needs memory for a second copy of the file.
+ */
+static int ramfs_merge_chunks(struct ramfs_inode *node)
+{
+	struct ramfs_chunk *data, *merged;
+	unsigned int i;
+
+	merged = ramfs_get_chunk(node->size);
+	if (!merged)
+		return -ENOMEM;
+
+	for (i = 0; i < node->nr_chunks; i++) {
+		data = node->chunks[i];
+
+		if (data->ofs < node->size)
+			memcpy(merged->data + data->ofs, data->data,
+			       min(data->size, node->size - data->ofs));
+
+		ramfs_put_chunk(data);
+	}
+
+	merged->ofs = 0;
+	node->chunks[0] = merged;
+	node->nr_chunks = 1;
+	node->alloc_size = merged->size;
+	node->current_chunk = 0;
+
+	return 0;
+}
+
+/*
+ * Drop the space reserved for appending when a file written to is closed,
+ * most files are not written again.
+ */
+static int ramfs_close(struct device *dev, FILE *f)
+{
+	struct ramfs_inode *node = to_ramfs_inode(f->f_inode);
+
+	if ((f->flags & O_ACCMODE) != O_RDONLY && node->nr_chunks &&
+	    node->alloc_size > node->size)
+		ramfs_resize_last_chunk(node, node->size);
+
+	return 0;
+}
+
 static int ramfs_memmap(struct device *_dev, FILE *f, void **map, int flags)
 {
 	struct inode *inode = f->f_inode;
 	struct ramfs_inode *node = to_ramfs_inode(inode);
-	struct ramfs_chunk *data;
-
-	if (list_empty(&node->data))
-		return -EINVAL;
+	int ret;
 
-	if (!list_is_singular(&node->data))
+	if (!node->nr_chunks)
 		return -EINVAL;
 
-	data = list_first_entry(&node->data, struct ramfs_chunk, list);
+	if (node->nr_chunks > 1) {
+		ret = ramfs_merge_chunks(node);
+		if (ret)
+			return ret;
+	}
 
-	*map = data->data;
+	*map = node->chunks[0]->data;
 
 	return 0;
 }
@@ -407,8 +544,6 @@ static struct inode *ramfs_alloc_inode(struct super_block *sb)
 
 	node = xzalloc(sizeof(*node));
 
-	INIT_LIST_HEAD(&node->data);
-
 	return &node->inode;
 }
 
@@ -445,6 +580,7 @@ static void ramfs_remove(struct device *dev)
 }
 
 static struct fs_driver ramfs_driver = {
+	.close     = ramfs_close,
 	.read      = ramfs_read,
 	.write     = ramfs_write,
 	.memmap    = ramfs_memmap,
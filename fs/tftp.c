@@ -73,11 +73,15 @@
 
 #define TFTP_BLOCK_SIZE		512	/* default TFTP block size */
 #define TFTP_MTU_SIZE		1432	/* MTU based block size */
+#define TFTP_MAX_BLOCK_SIZE	65464	/* RFC 2348 maximum, needs IP reassembly */
 #define TFTP_MAX_WINDOW_SIZE	CONFIG_FS_TFTP_MAX_WINDOW_SIZE
 
 /* allocate this number of blocks more than needed in the fifo */
 #define TFTP_EXTRA_BLOCKS	2
 
+/* memory for blocks received ahead of the reader in multicast mode */
+#define TFTP_MC_CACHE_SIZE	SZ_4M
+
 /* marker for an emtpy 'tftp_cache' */
 #define TFTP_CACHE_NO_ID	(-1)
 
@@ -93,13 +97,18 @@
 #endif
 
 static int g_tftp_window_size = DIV_ROUND_UP(TFTP_MAX_WINDOW_SIZE, 2);
+static int g_tftp_block_size = TFTP_MTU_SIZE;
+static int g_tftp_multicast;
 
 struct tftp_block {
 	uint16_t id;
 	uint16_t len;
+	/* received packet kept by net_rx_keep(), NULL if data was copied */
+	void *rxbuf;
+	uint8_t const *data;
 
 	struct list_head list;
-	uint8_t data[];
+	uint8_t copy[];
 };
 
 struct tftp_cache {
@@ -119,11 +128,20 @@ struct file_priv {
 	uint64_t resend_timeout;
 	uint64_t progress_timeout;
 	struct kfifo *fifo;
+	/* blocks received in order, not yet consumed by tftp_read() */
+	struct list_head rx_blocks;
+	size_t rx_len;
+	size_t rx_offset;
 	void *buf;
 	int blocksize;
 	unsigned int windowsize;
 	bool is_getattr;
 	struct tftp_cache cache;
+	/* RFC 2090 multicast transfer, mc_con is NULL for unicast */
+	struct net_connection *mc_con;
+	IPaddr_t mc_group;
+	uint16_t mc_port;
+	bool mc_master;
 };
 
 struct tftp_priv {
@@ -147,12 +165,51 @@ static bool in_window(uint16_t block, uint16_t start, uint16_t end)
 		(end   <= start && start <= block));
 }
 
-static void tftp_window_cache_free(struct tftp_cache *cache)
+/*
+ * Take over the received packet holding @data when the network driver
+ * allows it, copy the data otherwise.
+ */
+static struct tftp_block *tftp_block_new(uint16_t id, void const *data,
+					 size_t len)
+{
+	struct tftp_block *block;
+	void *rxbuf;
+
+	rxbuf = net_rx_keep(data);
+	if (rxbuf) {
+		block = xzalloc(sizeof(*block));
+		block->rxbuf = rxbuf;
+		block->data = data;
+	} else {
+		block = xzalloc(sizeof(*block) + len);
+		memcpy(block->copy, data, len);
+		block->data = block->copy;
+	}
+
+	block->id = id;
+	block->len = len;
+
+	return block;
+}
+
+static void tftp_block_free(struct tftp_block *block)
+{
+	if (block->rxbuf)
+		net_rx_release(block->rxbuf);
+	free(block);
+}
+
+static void tftp_block_list_free(struct list_head *blocks)
 {
 	struct tftp_block *block, *tmp;
 
-	list_for_each_entry_safe(block, tmp, &cache->blocks, list)
-		free(block);
+	list_for_each_entry_safe(block, tmp, blocks, list)
+		tftp_block_free(block);
+}
+
+static void tftp_window_cache_free(struct tftp_cache *cache)
+{
+	tftp_block_list_free(&cache->blocks);
 }
 
 static int tftp_window_cache_insert(struct tftp_cache *cache, uint16_t id,
@@ -169,10 +226,7 @@ static int tftp_window_cache_insert(struct tftp_cache *cache, uint16_t id,
 		break;
 	}
 
-	new = xzalloc(sizeof(*new) + len);
-	memcpy(new->data, data, len);
-	new->id = id;
-	new->len = len;
+	new = tftp_block_new(id, data, len);
 	list_add_tail(&new->list, &block->list);
 
 	return 0;
@@ -195,13 +249,41 @@ static char const * const tftp_states[] = {
 	[STATE_START] = "START",
 };
 
+/*
+ * Blocks larger than TFTP_MTU_SIZE arrive fragmented, so they can only be
+ * requested when fragments are reassembled. They are never used for WRQ
+ * as we can't send fragmented packets, nor for getattr operations.
+ */
+static unsigned int tftp_request_blocksize(struct file_priv *priv)
+{
+	if (priv->is_getattr)
+		return TFTP_BLOCK_SIZE;
+
+	if (priv->push || !IS_ENABLED(CONFIG_NET_IP_REASSEMBLY))
+		return TFTP_MTU_SIZE;
+
+	return clamp_t(int, g_tftp_block_size, TFTP_BLOCK_SIZE,
+		       TFTP_MAX_BLOCK_SIZE);
+}
+
+static bool tftp_want_multicast(struct file_priv *priv)
+{
+	return g_tftp_multicast && !priv->push && !priv->is_getattr;
+}
+
+/* in multicast mode only the master client acknowledges blocks */
+static bool tftp_may_ack(struct file_priv *priv)
+{
+	return !priv->mc_con || priv->mc_master;
+}
+
 static int tftp_send(struct file_priv *priv)
 {
 	unsigned char *xp;
 	int len = 0;
 	uint16_t *s;
 	unsigned char *pkt = net_udp_get_payload(priv->tftp_con);
-	unsigned int window_size;
+	unsigned int window_size, blocksize;
 	int ret;
 
 	pr_vdebug("%s: state %s\n", __func__, tftp_states[priv->state]);
@@ -209,14 +291,23 @@ static int tftp_send(struct file_priv *priv)
 	switch (priv->state) {
 	case STATE_RRQ:
 	case STATE_WRQ:
-		if (priv->push || priv->is_getattr)
+		blocksize = tftp_request_blocksize(priv);
+
+		if (priv->push || priv->is_getattr || tftp_want_multicast(priv))
 			/* atm, windowsize is supported only for RRQ and there
 			   is no need to request a full window when we are
-			   just looking up file attributes */
+			   just looking up file attributes. RFC 2090 transfers
+			   are acknowledged block by block. */
 			window_size = 1;
 		else
-			window_size = min_t(unsigned int, g_tftp_window_size,
-					    TFTP_MAX_WINDOW_SIZE);
+			/* don't let large blocks grow the window memory
+			   beyond what the maximum window takes with MTU
+			   sized blocks */
+			window_size = clamp_t(unsigned int, g_tftp_window_size, 1,
+					      min_t(unsigned int,
+						    TFTP_MAX_WINDOW_SIZE,
+						    TFTP_MAX_WINDOW_SIZE *
+						    TFTP_MTU_SIZE / blocksize));
 
 		xp = pkt;
 		s = (uint16_t *)pkt;
@@ -237,9 +328,7 @@ static int tftp_send(struct file_priv *priv)
 				'\0',	/* "timeout" */
 				TIMEOUT, '\0',
 				'\0',	/* "blksize" */
-				/* use only a minimal blksize for getattr
-				   operations, */
-				priv->is_getattr ? TFTP_BLOCK_SIZE : TFTP_MTU_SIZE);
+				blocksize);
 		pkt++;
 
 		if (!priv->push)
@@ -256,6 +345,10 @@ static int tftp_send(struct file_priv *priv)
 				       '\0', window_size,
 				       '\0');
 
+		if (tftp_want_multicast(priv))
+			pkt += sprintf((unsigned char *)pkt,
+				       "multicast%c%c", '\0', '\0');
+
 		len = pkt - xp;
 		break;
 
@@ -322,6 +415,30 @@ static int tftp_poll(struct file_priv *priv)
 	return 0;
 }
 
+/* RFC 2090 option value "addr,port,mc", addr and port may be empty */
+static int tftp_parse_multicast(struct file_priv *priv, char *val)
+{
+	char *port, *mc;
+
+	port = strchr(val, ',');
+	if (!port)
+		return -EINVAL;
+	*port++ = '\0';
+
+	mc = strchr(port, ',');
+	if (!mc)
+		return -EINVAL;
+	*mc++ = '\0';
+
+	if (*val && string_to_ip(val, &priv->mc_group))
+		return -EINVAL;
+	if (*port)
+		priv->mc_port = simple_strtoul(port, NULL, 10);
+	priv->mc_master = simple_strtoul(mc, NULL, 10) == 1;
+
+	return 0;
+}
+
 static int tftp_parse_oack(struct file_priv *priv, unsigned char *pkt, int len)
 {
 	unsigned char *opt, *val, *s;
@@ -347,12 +464,19 @@ static int tftp_parse_oack(struct file_priv *priv, unsigned char *pkt, int len)
 		if (!strcmp(opt, "windowsize"))
 			priv->windowsize = simple_strtoul(val, NULL, 10);
 		pr_debug("OACK opt: %s val: %s\n", opt, val);
+		if (!strcmp(opt, "multicast") &&
+		    tftp_parse_multicast(priv, val) < 0) {
+			pr_warn("tftp: invalid multicast option\n");
+			return -EINVAL;
+		}
 		s = val + strlen(val) + 1;
 	}
 
-	if (priv->blocksize > TFTP_MTU_SIZE ||
+	if (priv->blocksize > tftp_request_blocksize(priv) ||
 	    priv->windowsize > TFTP_MAX_WINDOW_SIZE ||
-	    priv->windowsize == 0) {
+	    priv->windowsize == 0 ||
+	    (priv->mc_group && (!ip_is_multicast(priv->mc_group) ||
+				!priv->mc_port))) {
 		pr_warn("tftp: invalid oack response\n");
 		return -EINVAL;
 	}
@@ -370,14 +494,14 @@ static int tftp_allocate_transfer(struct file_priv *priv)
 	debug_assert(!priv->fifo);
 	debug_assert(!priv->buf);
 
-	/* multiplication is safe; both operands were checked in tftp_parse_oack()
-	   and are small integers */
-	priv->fifo = kfifo_alloc(priv->blocksize *
-				 (priv->windowsize + TFTP_EXTRA_BLOCKS));
-	if (!priv->fifo)
-		goto err;
-
 	if (priv->push) {
+		/* multiplication is safe; both operands were checked in
+		   tftp_parse_oack() and are small integers */
+		priv->fifo = kfifo_alloc(priv->blocksize *
+					 (priv->windowsize + TFTP_EXTRA_BLOCKS));
+		if (!priv->fifo)
+			goto err;
+
 		priv->buf = xmalloc(priv->blocksize);
 		if (!priv->buf) {
 			kfifo_free(priv->fifo);
@@ -397,33 +521,83 @@ static int tftp_allocate_transfer(struct file_priv *priv)
 	return priv->err;
 }
 
-static void tftp_put_data(struct file_priv *priv, uint16_t block,
-			  void const *pkt, size_t len)
+/* received data is buffered for one window plus some extra blocks */
+static size_t tftp_rx_room(struct file_priv *priv)
 {
-	unsigned int sz;
+	size_t size = priv->blocksize * (priv->windowsize + TFTP_EXTRA_BLOCKS);
+
+	return size - min(size, priv->rx_len);
+}
+
+/*
+ * Queue the next block for tftp_read(). Takes over @new, which is either
+ * freshly received or taken from the window cache.
+ */
+static void tftp_queue_block(struct file_priv *priv, struct tftp_block *new)
+{
+	size_t len = new->len;
 
 	if (len > priv->blocksize) {
 		pr_warn("tftp: oversized packet (%zu > %d) received\n",
 			len, priv->blocksize);
+		tftp_block_free(new);
 		return;
 	}
 
-	priv->last_block = block;
+	priv->last_block = new->id;
 
-	sz = kfifo_put(priv->fifo, pkt, len);
-
-	if (sz != len) {
-		pr_err("tftp: not enough room in kfifo (only %u out of %zu written)\n",
-		       sz, len);
+	if (len > tftp_rx_room(priv)) {
+		pr_err("tftp: not enough room for block %u (%zu bytes queued)\n",
+		       new->id, priv->rx_len);
+		tftp_block_free(new);
 		priv->err = -ENOMEM;
 		priv->state = STATE_DONE;
-	} else if (len < priv->blocksize) {
+		return;
+	}
+
+	list_add_tail(&new->list, &priv->rx_blocks);
+	priv->rx_len += len;
+
+	if (len < priv->blocksize) {
 		tftp_send(priv);
 		priv->err = 0;
 		priv->state = STATE_DONE;
 	}
 }
 
+static void tftp_put_data(struct file_priv *priv, uint16_t block,
+			  void const *pkt, size_t len)
+{
+	tftp_queue_block(priv, tftp_block_new(block, pkt, len));
+}
+
+/* copy queued data to @buf, straight from the received packets if kept */
+static size_t tftp_rx_get(struct file_priv *priv, void *buf, size_t size)
+{
+	struct tftp_block *block, *tmp;
+	size_t done = 0, now;
+
+	list_for_each_entry_safe(block, tmp, &priv->rx_blocks, list) {
+		if (done == size)
+			break;
+
+		now = min(size - done, block->len - priv->rx_offset);
+		memcpy(buf + done, block->data + priv->rx_offset, now);
+		done += now;
+		priv->rx_offset += now;
+
+		if (priv->rx_offset == block->len) {
+			list_del(&block->list);
+			tftp_block_free(block);
+			priv->rx_offset = 0;
+		}
+	}
+
+	priv->rx_len -= done;
+
+	return done;
+}
+
 static void tftp_apply_window_cache(struct file_priv *priv)
 {
 	struct tftp_cache *cache = &priv->cache;
@@ -451,11 +625,36 @@ static void tftp_apply_window_cache(struct file_priv *priv)
 		if (block->id != (uint16_t)(priv->last_block + 1))
 			return;
 
-		tftp_put_data(priv, block->id, block->data, block->len);
+		/* a multicast stream doesn't wait for the reader */
+		if (tftp_rx_room(priv) < block->len)
+			return;
 
 		list_del(&block->list);
 
-		free(block);
+		tftp_queue_block(priv, block);
+	}
+}
+
+/*
+ * A multicast stream is paced by the master client. Blocks the reader can't
+ * take yet, or which arrive ahead of missing ones, are cached up to
+ * TFTP_MC_CACHE_SIZE. Anything else is dropped and received again later,
+ * once we become master and acknowledge the last block we have in order.
+ */
+static void tftp_handle_mc_data(struct file_priv *priv, uint16_t block,
+				void const *data, size_t len)
+{
+	uint16_t exp_block = priv->last_block + 1;
+	unsigned int ahead = (uint16_t)(block - exp_block);
+
+	/* the server is still sending, even if not what we need */
+	tftp_timer_reset(priv);
+
+	if (ahead == 0 && tftp_rx_room(priv) >= len) {
+		tftp_put_data(priv, block, data, len);
+		tftp_apply_window_cache(priv);
+	} else if (ahead < TFTP_MC_CACHE_SIZE / priv->blocksize) {
+		tftp_window_cache_insert(&priv->cache, block, data, len);
 	}
 }
 
@@ -467,6 +666,11 @@ static void tftp_handle_data(struct file_priv *priv, uint16_t block,
 
 	exp_block = priv->last_block + 1;
 
+	if (priv->mc_con) {
+		tftp_handle_mc_data(priv, block, data, len);
+		return;
+	}
+
 	if (exp_block == block) {
 		/* datagram over network is the expected one; put it in the
 		   fifo directly and try to apply cached items then */
@@ -554,6 +758,20 @@ static void tftp_recv(struct file_priv *priv,
 		break;
 
 	case TFTP_OACK:
+		if (priv->mc_con && priv->state == STATE_RDATA) {
+			/* the server selects a new master client */
+			if (tftp_parse_oack(priv, pkt, len) < 0)
+				break;
+
+			pr_debug("multicast master: %d\n", priv->mc_master);
+
+			if (priv->mc_master) {
+				tftp_timer_reset(priv);
+				tftp_send(priv);
+			}
+			break;
+		}
+
 		if (priv->state != STATE_RRQ && priv->state != STATE_WRQ) {
 			pr_warn("OACK packet in %s state\n",
 				tftp_states[priv->state]);
@@ -625,6 +843,42 @@ static void tftp_handler(void *ctx, char *packet, unsigned len)
 	tftp_recv(priv, pkt, net_eth_to_udplen(packet), udp->uh_sport);
 }
 
+static int tftp_multicast_join(struct file_priv *priv)
+{
+	struct eth_device *edev = priv->tftp_con->edev;
+	IPaddr_t server = net_read_ip(&priv->tftp_con->ip->daddr);
+	int ret;
+
+	ret = net_multicast_join(edev, priv->mc_group);
+	if (ret)
+		return ret;
+
+	priv->mc_con = net_udp_eth_new(edev, server, 0, tftp_handler, priv);
+	if (IS_ERR(priv->mc_con)) {
+		ret = PTR_ERR(priv->mc_con);
+		priv->mc_con = NULL;
+		net_multicast_leave(edev, priv->mc_group);
+		return ret;
+	}
+
+	net_udp_bind(priv->mc_con, priv->mc_port);
+
+	pr_debug("receiving from %pI4:%u as %s\n", &priv->mc_group,
+		 priv->mc_port, priv->mc_master ? "master" : "slave");
+
+	return 0;
+}
+
+static void tftp_multicast_leave(struct file_priv *priv)
+{
+	if (!priv->mc_con)
+		return;
+
+	net_unregister(priv->mc_con);
+	net_multicast_leave(priv->tftp_con->edev, priv->mc_group);
+	priv->mc_con = NULL;
+}
+
 static int tftp_start_transfer(struct file_priv *priv)
 {
 	int rc;
@@ -640,10 +894,23 @@ static int tftp_start_transfer(struct file_priv *priv)
 		priv->state = STATE_WDATA;
 		priv->block = 1;
 	} else {
-		/* send ACK */
 		priv->state = STATE_RDATA;
 		priv->last_block = 0;
-		tftp_send(priv);
+
+		if (priv->mc_group) {
+			rc = tftp_multicast_join(priv);
+			if (rc < 0) {
+				priv->err = rc;
+				priv->state = STATE_DONE;
+				return rc;
+			}
+		}
+
+		/* send ACK */
+		if (tftp_may_ack(priv))
+			tftp_send(priv);
+		else
+			priv->ack_block = priv->windowsize;
 	}
 
 	return 0;
@@ -660,6 +927,7 @@ static struct file_priv *tftp_do_open(struct device *dev,
 	unsigned short port = TFTP_PORT;
 
 	priv = xzalloc(sizeof(*priv));
+	INIT_LIST_HEAD(&priv->rx_blocks);
 
 	switch (accmode & O_ACCMODE) {
 	case O_RDONLY:
@@ -743,10 +1011,12 @@ static struct file_priv *tftp_do_open(struct device *dev,
 
 	return priv;
 out1:
+	tftp_multicast_leave(priv);
 	net_unregister(priv->tftp_con);
 out:
 	if (priv->fifo)
 		kfifo_free(priv->fifo);
+	tftp_block_list_free(&priv->rx_blocks);
 
 	free(priv->filename);
 	free(priv->buf);
@@ -798,9 +1068,12 @@ static int tftp_do_close(struct file_priv *priv)
 		net_udp_send(priv->tftp_con, 6);
 	}
 
+	tftp_multicast_leave(priv);
 	net_unregister(priv->tftp_con);
 	tftp_window_cache_free(&priv->cache);
-	kfifo_free(priv->fifo);
+	tftp_block_list_free(&priv->rx_blocks);
+	if (priv->fifo)
+		kfifo_free(priv->fifo);
 	free(priv->filename);
 	free(priv->buf);
 	free(priv);
@@ -860,26 +1133,31 @@ static int tftp_read(struct device *dev, FILE *f, void *buf, size_t insize)
 	pr_vdebug("%s %zu\n", __func__, insize);
 
 	while (insize) {
-		now = kfifo_get(priv->fifo, buf, insize);
+		now = tftp_rx_get(priv, buf, insize);
 		outsize += now;
 		buf += now;
 		insize -= now;
 
+		if (priv->mc_con)
+			tftp_apply_window_cache(priv);
+
 		if (priv->state == STATE_DONE) {
 			ret = priv->err;
 			break;
 		}
 
-		/* send the ACK only when fifo has been nearly depleted; else,
-		   when tftp_read() is called with small 'insize' values, it
-		   is possible that there is read more data from the network
-		   than consumed by kfifo_get() and the fifo overflows */
-		if (priv->last_block == priv->ack_block &&
-		    kfifo_len(priv->fifo) <= TFTP_EXTRA_BLOCKS * priv->blocksize)
+		/* send the ACK only when the queue has been nearly depleted;
+		   else, when tftp_read() is called with small 'insize'
+		   values, it is possible that there is read more data from
+		   the network than consumed by tftp_rx_get() and the queue
+		   overflows */
+		if (tftp_may_ack(priv) &&
+		    !is_block_before(priv->last_block, priv->ack_block) &&
+		    priv->rx_len <= TFTP_EXTRA_BLOCKS * priv->blocksize)
 			tftp_send(priv);
 
 		ret = tftp_poll(priv);
-		if (ret == TFTP_ERR_RESEND)
+		if (ret == TFTP_ERR_RESEND && tftp_may_ack(priv))
 			tftp_send(priv);
 		if (ret < 0)
 			break;
@@ -1071,6 +1349,10 @@ static struct fs_driver tftp_driver = {
 static int tftp_init(void)
 {
 	globalvar_add_simple_int("tftp.windowsize", &g_tftp_window_size, "%u");
+	globalvar_add_simple_bool("tftp.multicast", &g_tftp_multicast);
+	if (IS_ENABLED(CONFIG_NET_IP_REASSEMBLY))
+		globalvar_add_simple_int("tftp.blocksize", &g_tftp_block_size,
+					 "%u");
 
 	return register_fs_driver(&tftp_driver);
 }
@@ -29,6 +29,8 @@
 #define ATA_CMD_WRITE		0x30
 #define ATA_CMD_PIO_WRITE_EXT	0x34
 #define ATA_CMD_WRITE_EXT	0x35
+#define ATA_CMD_READ_LOG_EXT	0x2F
+#define ATA_CMD_FPDMA_READ	0x60
 
 /* drive's status flags */
 #define ATA_STATUS_BUSY		(1 << 7)
@@ -93,6 +95,18 @@ static inline int ata_id_has_lba48(const uint16_t *id)
 	return id[ATA_ID_COMMAND_SET_2] & (1 << 10);
 }
 
+static inline int ata_id_has_ncq(const uint16_t *id)
+{
+	if (id[ATA_ID_SATA_CAPAB_1] == 0x0000 || id[ATA_ID_SATA_CAPAB_1] == 0xffff)
+		return 0;
+	return id[ATA_ID_SATA_CAPAB_1] & (1 << 8);
+}
+
+static inline int ata_id_queue_depth(const uint16_t *id)
+{
+	return (id[ATA_ID_QUEUE_DEPTH] & 0x1f) + 1;
+}
+
 /** addresses of each individual IDE drive register */
 struct ata_ioports {
 	void __iomem *cmd_addr;
@@ -13,6 +13,8 @@ struct block_device_ops {
 	int (*read)(struct block_device *, void *buf, sector_t block, blkcnt_t num_blocks);
 	int (*write)(struct block_device *, const void *buf, sector_t block, blkcnt_t num_blocks);
 	int (*flush)(struct block_device *);
+	/* optional, erase blocks so that they read back as zeroes */
+	int (*erase)(struct block_device *, sector_t block, blkcnt_t num_blocks);
 };
 
 struct chunk;
@@ -30,6 +32,23 @@ enum blk_type {
 
 const char *blk_type_str(enum blk_type);
 
+/* bucket n counts latencies from 2^n to 2^(n+1) - 1 us, the last one all above */
+#define BLOCK_STATS_BUCKETS	20
+
+struct block_io_stats {
+	u64 requests;
+	u64 bytes;
+	u64 ns;
+	u32 hist[BLOCK_STATS_BUCKETS];
+};
+
+struct block_stats {
+	struct block_io_stats read;
+	struct block_io_stats write;
+	u64 cache_hits;
+	u64 cache_misses;
+};
+
 struct block_device {
 	struct device *dev;
 	struct list_head list;
@@ -37,6 +56,11 @@ struct block_device {
 	u8 blockbits;
 	u8 type; /* holds enum blk_type */
 	blkcnt_t num_blocks;
+	/*
+	 * Largest number of blocks the driver takes in a single read or
+	 * write request. Optional, also limited by the block layer.
+	 */
+	blkcnt_t max_blocks;
 	int rdbufsize;
 	int blkmask;
 
@@ -49,6 +73,10 @@ struct block_device {
 	struct cdev cdev;
 
 	bool need_reparse;
+
+	/* requests are only accounted with CONFIG_BLOCK_STATS */
+	struct block_stats stats;
+	struct device *stats_dev;
 };
 
 #define BLOCKSIZE(blk)	(1u << (blk)->blockbits)
@@ -14,6 +14,7 @@ extern struct bthread *current;
 
 struct bthread *bthread_create(void (*threadfn)(void *), void *data, const char *namefmt, ...);
 void bthread_cancel(struct bthread *bthread);
+void bthread_set_foreground(struct bthread *bthread);
 
 void bthread_schedule(struct bthread *);
 void bthread_wake(struct bthread *bthread);
@@ -45,10 +46,14 @@ bool bthread_is_main(struct bthread *bthread);
 
 #ifdef CONFIG_BTHREAD
 void bthread_reschedule(void);
+void bthread_reschedule_foreground(void);
 #else
 static inline void bthread_reschedule(void)
 {
 }
+static inline void bthread_reschedule_foreground(void)
+{
+}
 #endif
 
 #endif
@@ -19,6 +19,8 @@
  */
 #define FASTBOOT_CMD_FALLTHROUGH	1
 
+struct fastboot_stream;
+
 struct fastboot {
 	int (*write)(struct fastboot *fb, const char *buf, unsigned int n);
 	void (*start_download)(struct fastboot *fb);
@@ -29,6 +31,7 @@ struct fastboot {
 			 const char *filename, size_t len);
 	int download_fd;
 	char *tempname;
+	struct fastboot_stream *stream;
 
 	bool active;
 
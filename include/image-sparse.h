@@ -61,7 +61,21 @@ struct sparse_image_ctx;
 struct sparse_image_ctx *sparse_image_open(const char *path);
 int sparse_image_read(struct sparse_image_ctx *si, void *buf,
 		      loff_t *pos, size_t len, size_t *retlen);
+int sparse_image_read_fill(struct sparse_image_ctx *si, uint32_t *fill_val,
+			   loff_t *pos, uint64_t *len);
 void sparse_image_close(struct sparse_image_ctx *si);
 loff_t sparse_image_size(struct sparse_image_ctx *si);
 
+struct sparse_image_stream;
+
+struct sparse_image_stream *sparse_image_stream_new(int (*write)(void *ctx,
+		const void *buf, size_t len, loff_t pos), void *ctx);
+void sparse_image_stream_set_fill(struct sparse_image_stream *ss,
+		int (*fill)(void *ctx, uint32_t fill_val, uint64_t len, loff_t pos));
+int sparse_image_stream_write(struct sparse_image_stream *ss, const void *buf,
+			      size_t len);
+int sparse_image_stream_finish(struct sparse_image_stream *ss);
+loff_t sparse_image_stream_size(struct sparse_image_stream *ss);
+void sparse_image_stream_free(struct sparse_image_stream *ss);
+
 #endif /* _IMAGE_SPARSE_H */
@@ -128,6 +128,45 @@ struct usb_device {
 	unsigned int slot_id;
 };
 
+struct urb;
+typedef void (*usb_complete_t)(struct urb *);
+
+/*
+ * An asynchronous bulk transfer. @status is -EINPROGRESS while the URB is
+ * queued. Once it completed it holds 0 or a negative error code and
+ * @complete is called from usb_poll_urbs().
+ */
+struct urb {
+	struct usb_device *dev;
+	unsigned int pipe;
+	void *transfer_buffer;
+	u32 transfer_buffer_length;
+	u32 actual_length;
+	int status;
+	usb_complete_t complete;
+	void *context;
+
+	/* private to the host controller driver */
+	struct list_head list;
+	dma_addr_t transfer_dma;
+	void *hcpriv;
+};
+
+static inline void usb_fill_bulk_urb(struct urb *urb, struct usb_device *dev,
+				     unsigned int pipe, void *transfer_buffer,
+				     int buffer_length, usb_complete_t complete,
+				     void *context)
+{
+	urb->dev = dev;
+	urb->pipe = pipe;
+	urb->transfer_buffer = transfer_buffer;
+	urb->transfer_buffer_length = buffer_length;
+	urb->complete = complete;
+	urb->context = context;
+	urb->status = 0;
+	INIT_LIST_HEAD(&urb->list);
+}
+
 struct usb_device_id;
 
 struct usb_driver {
@@ -156,8 +195,15 @@ struct usb_host {
 	void (*usb_event_poll)(void);
 	int (*alloc_device)(struct usb_device *dev);
 	int (*update_hub_device)(struct usb_device *dev);
+	/* asynchronous bulk transfers, optional */
+	int (*submit_urb)(struct urb *urb);
+	void (*kill_urb)(struct urb *urb);
+	/* move URBs that completed to @done */
+	void (*poll_urbs)(struct usb_host *host, struct list_head *done);
 
 	bool no_desc_before_addr;
+	/* largest transfer submit_bulk_msg() accepts, 0 if not known */
+	size_t max_xfer_size;
 
 	struct list_head list;
 
@@ -189,6 +235,9 @@ int usb_bulk_msg(struct usb_device *dev, unsigned int pipe,
 			void *data, int len, int *actual_length, int timeout_ms);
 int usb_submit_int_msg(struct usb_device *dev, unsigned long pipe,
 			void *buffer, int transfer_len, int interval);
+int usb_submit_urb(struct urb *urb);
+int usb_kill_urb(struct urb *urb);
+void usb_poll_urbs(struct usb_device *dev);
 int usb_maxpacket(struct usb_device *dev, unsigned long pipe);
 int usb_get_configuration_no(struct usb_device *dev, unsigned char *buffer,
 				int cfgno);
@@ -21,6 +21,9 @@
 
 #include <net.h>
 #include <linux/phy.h>
+#include <linux/usb/usb.h>
+
+#define USBNET_RX_URBS	4
 
 /* interface from usbnet core to each USB networking link we handle */
 struct usbnet {
@@ -47,6 +50,8 @@ struct usbnet {
 	size_t			rx_urb_size;	/* size for rx urbs */
 	void			*rx_buf;
 	void			*tx_buf;
+	struct urb		rx_urb[USBNET_RX_URBS];
+	bool			rx_sync;	/* host can't queue rx_urb */
 
 	unsigned long		flags;
 #		define EVENT_TX_HALT	0
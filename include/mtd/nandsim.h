@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#ifndef __MTD_NANDSIM_H
+#define __MTD_NANDSIM_H
+
+#include <linux/mtd/mtd.h>
+
+struct nandsim;
+
+struct nandsim *nandsim_create(unsigned int pagesize, unsigned int oobsize,
+			       unsigned int pages_per_block, unsigned int nblocks,
+			       unsigned int ecc_bits);
+void nandsim_mark_bad(struct nandsim *ns, unsigned int block);
+int nandsim_register(struct nandsim *ns);
+void nandsim_unregister(struct nandsim *ns);
+void nandsim_free(struct nandsim *ns);
+struct mtd_info *nandsim_mtd(struct nandsim *ns);
+
+#endif /* __MTD_NANDSIM_H */
@@ -147,6 +147,8 @@ struct ethernet {
 #define PROT_VLAN	0x8100		/* IEEE 802.1q protocol		*/
 
 #define IPPROTO_ICMP	 1	/* Internet Control Message Protocol	*/
+#define IPPROTO_IGMP	 2	/* Internet Group Management Protocol	*/
+#define IPPROTO_TCP	 6	/* Transmission Control Protocol	*/
 #define IPPROTO_UDP	17	/* User Datagram Protocol		*/
 
 #define IP_BROADCAST    0xffffffff /* Broadcast IP aka 255.255.255.255 */
@@ -175,6 +177,24 @@ struct udphdr {
 	uint16_t	uh_sum;		/* udp checksum */
 } __attribute__ ((packed));
 
+struct tcphdr {
+	uint16_t	th_sport;	/* source port */
+	uint16_t	th_dport;	/* destination port */
+	uint32_t	th_seq;		/* sequence number */
+	uint32_t	th_ack;		/* acknowledgement number */
+	uint8_t		th_off;		/* data offset in upper 4 bits */
+	uint8_t		th_flags;
+#define TH_FIN		0x01
+#define TH_SYN		0x02
+#define TH_RST		0x04
+#define TH_PUSH		0x08
+#define TH_ACK		0x10
+#define TH_URG		0x20
+	uint16_t	th_win;		/* window */
+	uint16_t	th_sum;		/* checksum */
+	uint16_t	th_urp;		/* urgent pointer */
+} __attribute__ ((packed));
+
 /*
  *	Address Resolution Protocol (ARP) header.
  */
@@ -282,6 +302,11 @@ static inline struct icmphdr *net_eth_to_icmphdr(char *pkt)
 	return (struct icmphdr *)(net_eth_to_iphdr(pkt) + 1);
 }
 
+static inline struct tcphdr *net_eth_to_tcphdr(char *pkt)
+{
+	return (struct tcphdr *)(net_eth_to_iphdr(pkt) + 1);
+}
+
 static inline char *net_eth_to_icmp_payload(char *pkt)
 {
 	return (char *)(net_eth_to_icmphdr(pkt) + 1);
@@ -531,12 +556,31 @@ struct eth_device *eth_get_byname(const char *name);
  */
 int net_receive(struct eth_device *edev, unsigned char *pkt, int len);
 
+/**
+ * net_receive_buf - Pass a received packet, allowing the stack to keep it
+ * @buf: in: buffer from net_alloc_packet() holding the packet, out: buffer
+ *       to receive the next packet into
+ * @pkt: Pointer to the packet inside @buf
+ * @len: length of the packet
+ *
+ * Like net_receive(), but protocol handlers may take over @buf with
+ * net_rx_keep() instead of copying the data out. In this case @buf is
+ * replaced by a new buffer which the driver must hand to the hardware
+ * instead.
+ */
+int net_receive_buf(struct eth_device *edev, void **buf, unsigned char *pkt,
+		    int len);
+
+void *net_rx_keep(const void *data);
+void net_rx_release(void *buf);
+
 struct net_connection {
 	struct ethernet *et;
 	struct iphdr *ip;
 	struct udphdr *udp;
 	struct eth_device *edev;
 	struct icmphdr *icmp;
+	struct tcphdr *tcp;
 	unsigned char *packet;
 	struct list_head list;
 	rx_handler_f *handler;
@@ -567,8 +611,19 @@ struct net_connection *net_udp_eth_new(struct eth_device *edev, IPaddr_t dest,
 struct net_connection *net_icmp_new(IPaddr_t dest, rx_handler_f *handler,
 		void *ctx);
 
+struct net_connection *net_tcp_new(IPaddr_t dest, uint16_t dport,
+		rx_handler_f *handler, void *ctx);
+
 void net_unregister(struct net_connection *con);
 
+static inline bool ip_is_multicast(IPaddr_t ip)
+{
+	return (ntohl(ip) & 0xf0000000) == 0xe0000000;
+}
+
+int net_multicast_join(struct eth_device *edev, IPaddr_t group);
+void net_multicast_leave(struct eth_device *edev, IPaddr_t group);
+
 static inline int net_udp_bind(struct net_connection *con, uint16_t sport)
 {
 	con->udp->uh_sport = ntohs(sport);
@@ -583,6 +638,33 @@ static inline void *net_udp_get_payload(struct net_connection *con)
 
 int net_udp_send(struct net_connection *con, int len);
 int net_icmp_send(struct net_connection *con, int len);
+int net_tcp_send(struct net_connection *con, int len);
+
+static inline void *net_tcp_get_payload(struct net_connection *con)
+{
+	return con->tcp + 1;
+}
+
+struct tcp_sock;
+
+struct tcp_sock *tcp_connect(IPaddr_t dest, uint16_t dport);
+ssize_t tcp_send(struct tcp_sock *sk, const void *buf, size_t len);
+ssize_t tcp_recv(struct tcp_sock *sk, void *buf, size_t len);
+void tcp_close(struct tcp_sock *sk);
+
+#ifdef CONFIG_NET_IP_REASSEMBLY
+unsigned char *net_ip_defrag(unsigned char *pkt, int *len);
+void net_ip_defrag_release(unsigned char *pkt);
+#else
+static inline unsigned char *net_ip_defrag(unsigned char *pkt, int *len)
+{
+	return NULL;
+}
+
+static inline void net_ip_defrag_release(unsigned char *pkt)
+{
+}
+#endif
 
 void led_trigger_network(enum led_trigger trigger);
 
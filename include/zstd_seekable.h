@@ -0,0 +1,21 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef __ZSTD_SEEKABLE_H
+#define __ZSTD_SEEKABLE_H
+
+#include <linux/types.h>
+
+struct zstd_seekable;
+struct cdev;
+
+struct zstd_seekable *zstd_seekable_open(int fd);
+void zstd_seekable_close(struct zstd_seekable *zs);
+
+loff_t zstd_seekable_size(struct zstd_seekable *zs);
+unsigned int zstd_seekable_num_frames(struct zstd_seekable *zs);
+ssize_t zstd_seekable_read(struct zstd_seekable *zs, void *buf, size_t count,
+			   loff_t offset);
+
+struct cdev *zstd_seekable_cdev_create(const char *path);
+int zstd_seekable_cdev_remove(struct cdev *cdev);
+
+#endif /* __ZSTD_SEEKABLE_H */
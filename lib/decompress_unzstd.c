@@ -97,6 +97,25 @@ static int INIT handle_zstd_error(size_t ret, void (*error)(char *x))
 	return -1;
 }
 
+/*
+ * Return the size of the zstd and skippable frames at the start of
+ * @in_buf. A .zst file consists of more than one frame when it was
+ * written in seekable format or by concatenating compressed files.
+ */
+static size_t INIT zstd_frames_size(const u8 *in_buf, size_t in_len)
+{
+	size_t pos = 0, ret;
+
+	do {
+		ret = ZSTD_findFrameCompressedSize(in_buf + pos, in_len - pos);
+		if (ZSTD_isError(ret))
+			return pos ?: ret;
+		pos += ret;
+	} while (in_len - pos >= 4 && ZSTD_isFrame(in_buf + pos, in_len - pos));
+
+	return pos;
+}
+
 /*
  * Handle the case where we have the entire input and output in one segment.
  * We can allocate less memory (no circular buffer for the sliding window),
@@ -118,10 +137,10 @@ static int INIT decompress_single(const u8 *in_buf, long in_len, u8 *out_buf,
 		goto out;
 	}
 	/*
-	 * Find out how large the frame actually is, there may be junk at
-	 * the end of the frame that ZSTD_decompressDCtx() can't handle.
+	 * Find out how large the frames actually are, there may be junk at
+	 * the end that ZSTD_decompressDCtx() can't handle.
 	 */
-	ret = ZSTD_findFrameCompressedSize(in_buf, in_len);
+	ret = zstd_frames_size(in_buf, in_len);
 	err = handle_zstd_error(ret, error);
 	if (err)
 		goto out;
@@ -142,6 +161,85 @@ static int INIT decompress_single(const u8 *in_buf, long in_len, u8 *out_buf,
 	return err;
 }
 
+/*
+ * Check whether another frame follows the one just finished. Refills the
+ * input buffer if needed so that the header of the next frame is
+ * available.
+ */
+static bool INIT zstd_next_frame(ZSTD_inBuffer *in, u8 *in_buf,
+				 long (*fill)(void*, unsigned long),
+				 long *in_pos)
+{
+	size_t left = in->size - in->pos;
+	long len;
+
+	if (left < ZSTD_FRAMEHEADERSIZE_MAX && fill != NULL) {
+		if (in_pos != NULL)
+			*in_pos += in->pos;
+		memmove(in_buf, in_buf + in->pos, left);
+		len = fill(in_buf + left, ZSTD_IOBUF_SIZE - left);
+		if (len > 0)
+			left += len;
+		in->pos = 0;
+		in->size = left;
+	}
+
+	return left >= 4 && ZSTD_isFrame(in_buf + in->pos, left);
+}
+
+/*
+ * Set up *@dstream for the frame starting at @in. A new ZSTD_DStream is
+ * only allocated when there is none yet or the frame has a larger window
+ * than the previous ones, the frames of a file needn't all be the same.
+ */
+static int INIT zstd_frame_dstream(const ZSTD_inBuffer *in,
+				   ZSTD_DStream **dstream, void **wksp,
+				   size_t *window_size, void (*error)(char *x))
+{
+	ZSTD_frameParams params;
+	size_t wksp_size, ret;
+
+	/*
+	 * We need to know the window size to allocate the ZSTD_DStream.
+	 * Since we are streaming, we need to allocate a buffer for the sliding
+	 * window. The window size varies from 1 KB to ZSTD_WINDOWSIZE_MAX
+	 * (8 MB), so it is important to use the actual value so as not to
+	 * waste memory when it is smaller.
+	 */
+	ret = ZSTD_getFrameParams(&params, (const u8 *)in->src + in->pos,
+				  in->size - in->pos);
+	if (handle_zstd_error(ret, error))
+		return -1;
+	if (ret != 0) {
+		error("ZSTD-compressed data has an incomplete frame header");
+		return -1;
+	}
+	if (params.windowSize > ZSTD_WINDOWSIZE_MAX) {
+		error("ZSTD-compressed data has too large a window size");
+		return -1;
+	}
+
+	if (*dstream && params.windowSize <= *window_size)
+		return 0;
+
+	/*
+	 * Allocate the ZSTD_DStream now that we know how much memory is
+	 * required.
+	 */
+	if (*wksp != NULL)
+		large_free(*wksp);
+	wksp_size = ZSTD_DStreamWorkspaceBound(params.windowSize);
+	*wksp = large_malloc(wksp_size);
+	*dstream = ZSTD_initDStream(params.windowSize, *wksp, wksp_size);
+	if (*dstream == NULL) {
+		error("Out of memory while allocating ZSTD_DStream");
+		return -1;
+	}
+	*window_size = params.windowSize;
+
+	return 0;
+}
+
 static int INIT __unzstd(unsigned char *in_buf, long in_len,
 			 long (*fill)(void*, unsigned long),
 			 long (*flush)(void*, unsigned long),
@@ -151,12 +249,11 @@ static int INIT __unzstd(unsigned char *in_buf, long in_len,
 {
 	ZSTD_inBuffer in;
 	ZSTD_outBuffer out;
-	ZSTD_frameParams params;
 	void *in_allocated = NULL;
 	void *out_allocated = NULL;
 	void *wksp = NULL;
-	size_t wksp_size;
-	ZSTD_DStream *dstream;
+	size_t window_size = 0;
+	ZSTD_DStream *dstream = NULL;
 	int err;
 	size_t ret;
 
@@ -219,40 +316,9 @@ static int INIT __unzstd(unsigned char *in_buf, long in_len,
 	out.pos = 0;
 	out.size = out_len;
 
-	/*
-	 * We need to know the window size to allocate the ZSTD_DStream.
-	 * Since we are streaming, we need to allocate a buffer for the sliding
-	 * window. The window size varies from 1 KB to ZSTD_WINDOWSIZE_MAX
-	 * (8 MB), so it is important to use the actual value so as not to
-	 * waste memory when it is smaller.
-	 */
-	ret = ZSTD_getFrameParams(&params, in.src, in.size);
-	err = handle_zstd_error(ret, error);
+	err = zstd_frame_dstream(&in, &dstream, &wksp, &window_size, error);
 	if (err)
 		goto out;
-	if (ret != 0) {
-		error("ZSTD-compressed data has an incomplete frame header");
-		err = -1;
-		goto out;
-	}
-	if (params.windowSize > ZSTD_WINDOWSIZE_MAX) {
-		error("ZSTD-compressed data has too large a window size");
-		err = -1;
-		goto out;
-	}
-
-	/*
-	 * Allocate the ZSTD_DStream now that we know how much memory is
-	 * required.
-	 */
-	wksp_size = ZSTD_DStreamWorkspaceBound(params.windowSize);
-	wksp = large_malloc(wksp_size);
-	dstream = ZSTD_initDStream(params.windowSize, wksp, wksp_size);
-	if (dstream == NULL) {
-		error("Out of memory while allocating ZSTD_DStream");
-		err = -1;
-		goto out;
-	}
 
 	/*
 	 * Decompression loop:
@@ -293,7 +359,21 @@ static int INIT __unzstd(unsigned char *in_buf, long in_len,
 			}
 			out.pos = 0;
 		}
-	} while (ret != 0);
+		/*
+		 * When the frame is complete, continue with the next one, if
+		 * any. ZSTD_decompressStream() resets itself for a new frame,
+		 * only a larger window needs a new ZSTD_DStream.
+		 */
+		if (ret == 0) {
+			if (!zstd_next_frame(&in, in_buf, fill, in_pos))
+				break;
+
+			err = zstd_frame_dstream(&in, &dstream, &wksp,
+						 &window_size, error);
+			if (err)
+				goto out;
+		}
+	} while (1);
 
 	if (in_pos != NULL)
 		*in_pos += in.pos;
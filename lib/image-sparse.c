@@ -52,7 +52,7 @@ struct sparse_image_ctx {
 	int processed_chunks;
 	struct chunk_header chunk;
 	loff_t pos;
-	size_t remaining;
+	uint64_t remaining;
 	uint32_t fill_val;
 };
 
@@ -204,7 +204,7 @@ int sparse_image_read(struct sparse_image_ctx *si, void *buf, loff_t *pos,
 
 	*pos = si->pos;
 
-	now = min(si->remaining, len);
+	now = min_t(uint64_t, si->remaining, len);
 
 	switch (si->chunk.chunk_type) {
 	case CHUNK_TYPE_RAW:
@@ -239,8 +239,372 @@ int sparse_image_read(struct sparse_image_ctx *si, void *buf, loff_t *pos,
 	return 0;
 }
 
+/**
+ * sparse_image_read_fill - skip over the next data if it is a fill chunk
+ * @si: the sparse image context
+ * @fill_val: returns the 32bit fill pattern
+ * @pos: returns the position of the chunk data in the output image
+ * @len: returns the length of the chunk data
+ *
+ * This allows callers to handle fill chunks without having them expanded
+ * by sparse_image_read(). Returns 1 if the next data is from a fill chunk,
+ * which is then consumed, 0 if it is not or the image is finished or a
+ * negative error code.
+ */
+int sparse_image_read_fill(struct sparse_image_ctx *si, uint32_t *fill_val,
+			   loff_t *pos, uint64_t *len)
+{
+	int ret;
+
+	if (si->remaining == 0) {
+		ret = sparse_seek(si);
+		if (ret <= 0)
+			return ret;
+	}
+
+	if (si->chunk.chunk_type != CHUNK_TYPE_FILL)
+		return 0;
+
+	*fill_val = si->fill_val;
+	*pos = si->pos;
+	*len = si->remaining;
+
+	si->pos += si->remaining;
+	si->remaining = 0;
+
+	return 1;
+}
+
 void sparse_image_close(struct sparse_image_ctx *si)
 {
 	close(si->fd);
 	free(si);
 }
+
+/*
+ * Push interface: the image is passed in as it arrives, in pieces of any
+ * size, and the expanded data is handed to a write callback together with
+ * its position in the output image. Headers split across pieces are
+ * collected in the context, so no part of the image has to be buffered.
+ */
+enum sparse_stream_state {
+	SPARSE_STREAM_FILE_HDR,
+	SPARSE_STREAM_CHUNK_HDR,
+	SPARSE_STREAM_RAW,
+	SPARSE_STREAM_FILL,
+	SPARSE_STREAM_DONE,
+};
+
+#define SPARSE_STREAM_FILL_SIZE	SZ_64K
+
+struct sparse_image_stream {
+	int (*write)(void *ctx, const void *buf, size_t len, loff_t pos);
+	int (*fill)(void *ctx, uint32_t fill_val, uint64_t len, loff_t pos);
+	void *ctx;
+	enum sparse_stream_state state;
+	struct sparse_header sparse;
+	struct chunk_header chunk;
+	size_t have;		/* bytes of the current header collected */
+	size_t skip;		/* input bytes to drop before the next state */
+	unsigned int processed_chunks;
+	uint64_t remaining;
+	loff_t pos;
+	uint32_t fill_val;
+	uint32_t *fill_buf;
+};
+
+struct sparse_image_stream *sparse_image_stream_new(int (*write)(void *ctx,
+		const void *buf, size_t len, loff_t pos), void *ctx)
+{
+	struct sparse_image_stream *ss;
+
+	ss = xzalloc(sizeof(*ss));
+	ss->write = write;
+	ss->ctx = ctx;
+
+	return ss;
+}
+
+/**
+ * sparse_image_stream_set_fill - handle fill chunks in a callback
+ * @ss: the stream context
+ * @fill: the callback
+ *
+ * Instead of passing the expanded data of fill chunks to the write callback
+ * they are passed to @fill first. It returns 0 if it has handled the chunk,
+ * -EOPNOTSUPP if the chunk shall be expanded or another negative error code.
+ */
+void sparse_image_stream_set_fill(struct sparse_image_stream *ss,
+		int (*fill)(void *ctx, uint32_t fill_val, uint64_t len, loff_t pos))
+{
+	ss->fill = fill;
+}
+
+/*
+ * Collect @size bytes into @dst from the input. Returns true once all bytes
+ * are there.
+ */
+static bool sparse_stream_collect(struct sparse_image_stream *ss, void *dst,
+				  size_t size, const void **buf, size_t *len)
+{
+	size_t now = min(size - ss->have, *len);
+
+	memcpy(dst + ss->have, *buf, now);
+	ss->have += now;
+	*buf += now;
+	*len -= now;
+
+	if (ss->have < size)
+		return false;
+
+	ss->have = 0;
+
+	return true;
+}
+
+static void sparse_stream_next_chunk(struct sparse_image_stream *ss)
+{
+	if (ss->processed_chunks == ss->sparse.total_chunks)
+		ss->state = SPARSE_STREAM_DONE;
+	else
+		ss->state = SPARSE_STREAM_CHUNK_HDR;
+}
+
+static int sparse_stream_file_hdr(struct sparse_image_stream *ss)
+{
+	struct sparse_header *sparse = &ss->sparse;
+
+	if (!is_sparse_image(sparse) ||
+	    sparse->file_hdr_sz < sizeof(struct sparse_header) ||
+	    sparse->chunk_hdr_sz < sizeof(struct chunk_header) ||
+	    !sparse->blk_sz || sparse->blk_sz % 4) {
+		pr_err("Invalid sparse image header\n");
+		return -EINVAL;
+	}
+
+	ss->skip = sparse->file_hdr_sz - sizeof(struct sparse_header);
+	sparse_stream_next_chunk(ss);
+
+	return 0;
+}
+
+static int sparse_stream_chunk_hdr(struct sparse_image_stream *ss)
+{
+	struct chunk_header *chunk = &ss->chunk;
+	uint64_t chunk_data_sz;
+	uint32_t payload;
+
+	pr_debug("chunk 0x%04x: %u blocks, %u bytes\n", chunk->chunk_type,
+		 chunk->chunk_sz, chunk->total_sz);
+
+	if (chunk->total_sz < ss->sparse.chunk_hdr_sz)
+		return -EINVAL;
+
+	ss->skip = ss->sparse.chunk_hdr_sz - sizeof(struct chunk_header);
+	ss->processed_chunks++;
+
+	chunk_data_sz = (uint64_t)ss->sparse.blk_sz * chunk->chunk_sz;
+	payload = chunk->total_sz - ss->sparse.chunk_hdr_sz;
+
+	if (chunk->chunk_type != CHUNK_TYPE_CRC32 &&
+	    ss->pos + chunk_data_sz > sparse_image_stream_size(ss)) {
+		pr_err("Chunk exceeds image size\n");
+		return -EINVAL;
+	}
+
+	switch (chunk->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (payload != chunk_data_sz)
+			return -EINVAL;
+
+		ss->remaining = payload;
+		ss->state = SPARSE_STREAM_RAW;
+		if (!payload)
+			sparse_stream_next_chunk(ss);
+
+		return 0;
+
+	case CHUNK_TYPE_FILL:
+		if (payload != sizeof(uint32_t))
+			return -EINVAL;
+
+		ss->remaining = chunk_data_sz;
+		ss->state = SPARSE_STREAM_FILL;
+
+		return 0;
+
+	case CHUNK_TYPE_DONT_CARE:
+		ss->pos += chunk_data_sz;
+		ss->skip += payload;
+		sparse_stream_next_chunk(ss);
+
+		return 0;
+
+	case CHUNK_TYPE_CRC32:
+		if (payload != sizeof(uint32_t))
+			return -EINVAL;
+
+		ss->skip += payload;
+		sparse_stream_next_chunk(ss);
+
+		return 0;
+
+	default:
+		pr_err("Unknown chunk type 0x%04x\n", chunk->chunk_type);
+		return -EINVAL;
+	}
+}
+
+static int sparse_stream_fill(struct sparse_image_stream *ss)
+{
+	size_t now;
+	int i, ret;
+
+	if (ss->fill) {
+		ret = ss->fill(ss->ctx, ss->fill_val, ss->remaining, ss->pos);
+		if (!ret) {
+			ss->pos += ss->remaining;
+			ss->remaining = 0;
+			sparse_stream_next_chunk(ss);
+			return 0;
+		}
+		if (ret != -EOPNOTSUPP)
+			return ret;
+	}
+
+	if (!ss->fill_buf) {
+		ss->fill_buf = malloc(SPARSE_STREAM_FILL_SIZE);
+		if (!ss->fill_buf)
+			return -ENOMEM;
+	}
+
+	for (i = 0; i < SPARSE_STREAM_FILL_SIZE / sizeof(uint32_t); i++)
+		ss->fill_buf[i] = ss->fill_val;
+
+	while (ss->remaining) {
+		now = min_t(uint64_t, ss->remaining, SPARSE_STREAM_FILL_SIZE);
+
+		ret = ss->write(ss->ctx, ss->fill_buf, now, ss->pos);
+		if (ret)
+			return ret;
+
+		ss->pos += now;
+		ss->remaining -= now;
+	}
+
+	sparse_stream_next_chunk(ss);
+
+	return 0;
+}
+
+/**
+ * sparse_image_stream_write - feed the next piece of a sparse image
+ * @ss: the stream context
+ * @buf: image data
+ * @len: length of @buf
+ *
+ * Decodes @buf and passes the expanded data to the write callback. Returns
+ * 0 on success or a negative error code if the image is invalid or the
+ * callback failed.
+ */
+int sparse_image_stream_write(struct sparse_image_stream *ss, const void *buf,
+			      size_t len)
+{
+	size_t now;
+	int ret;
+
+	while (len) {
+		if (ss->skip) {
+			now = min(ss->skip, len);
+			ss->skip -= now;
+			buf += now;
+			len -= now;
+			continue;
+		}
+
+		switch (ss->state) {
+		case SPARSE_STREAM_FILE_HDR:
+			if (!sparse_stream_collect(ss, &ss->sparse,
+						   sizeof(ss->sparse), &buf, &len))
+				return 0;
+
+			ret = sparse_stream_file_hdr(ss);
+			break;
+
+		case SPARSE_STREAM_CHUNK_HDR:
+			if (!sparse_stream_collect(ss, &ss->chunk,
+						   sizeof(ss->chunk), &buf, &len))
+				return 0;
+
+			ret = sparse_stream_chunk_hdr(ss);
+			break;
+
+		case SPARSE_STREAM_RAW:
+			now = min_t(uint64_t, ss->remaining, len);
+
+			ret = ss->write(ss->ctx, buf, now, ss->pos);
+			if (ret)
+				break;
+
+			ss->pos += now;
+			ss->remaining -= now;
+			buf += now;
+			len -= now;
+
+			if (!ss->remaining)
+				sparse_stream_next_chunk(ss);
+			break;
+
+		case SPARSE_STREAM_FILL:
+			if (!sparse_stream_collect(ss, &ss->fill_val,
+						   sizeof(ss->fill_val), &buf, &len))
+				return 0;
+
+			ret = sparse_stream_fill(ss);
+			break;
+
+		case SPARSE_STREAM_DONE:
+		default:
+			pr_err("Trailing data after sparse image\n");
+			ret = -EINVAL;
+			break;
+		}
+
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/**
+ * sparse_image_stream_finish - check that a sparse image is complete
+ * @ss: the stream context
+ *
+ * Returns 0 if all chunks announced in the file header have been decoded,
+ * -EINVAL otherwise.
+ */
+int sparse_image_stream_finish(struct sparse_image_stream *ss)
+{
+	if (ss->state != SPARSE_STREAM_DONE || ss->skip) {
+		pr_err("Sparse image truncated\n");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/* Size of the expanded image, valid once the file header has been decoded */
+loff_t sparse_image_stream_size(struct sparse_image_stream *ss)
+{
+	return (loff_t)ss->sparse.blk_sz * ss->sparse.total_blks;
+}
+
+void sparse_image_stream_free(struct sparse_image_stream *ss)
+{
+	if (!ss)
+		return;
+
+	free(ss->fill_buf);
+	free(ss);
+}
@@ -18,9 +18,11 @@
 #include <fcntl.h>
 #include <malloc.h>
 #include <libfile.h>
+#include <ioctl.h>
 #include <progress.h>
 #include <stdlib.h>
 #include <linux/stat.h>
+#include <linux/mtd/mtd-abi.h>
 
 /*
  * pwrite_full - write to filedescriptor at offset
@@ -92,6 +94,7 @@ int pread_full(int fd, void *buf, size_t size, loff_t offset)
 			return now;
 		size -= now;
 		buf += now;
+		offset += now;
 	}
 
 	return insize - size;
@@ -395,12 +398,116 @@ int write_file(const char *filename, const void *buf, size_t size)
 }
 EXPORT_SYMBOL(write_file);
 
+/*
+ * Erase, program and verify the erase blocks from @start to @end, where
+ * @end may lie within the last block.
+ */
+static int write_flash_blocks(int fd, const void *buf, void *rbuf, size_t erasesize,
+			      loff_t start, loff_t end)
+{
+	loff_t ofs;
+	size_t len;
+	int ret;
+
+	ret = erase(fd, end - start, start);
+	if (ret)
+		return ret;
+
+	ret = pwrite_full(fd, buf + start, end - start, start);
+	if (ret < 0)
+		return ret;
+
+	for (ofs = start; ofs < end; ofs += erasesize) {
+		len = min_t(loff_t, end - ofs, erasesize);
+
+		ret = pread_full(fd, rbuf, len, ofs);
+		if (ret < 0)
+			return ret;
+
+		if (ret != len || memcmp(rbuf, buf + ofs, len))
+			return -EIO;
+	}
+
+	return 0;
+}
+
+/**
+ * write_full_flash - write a buffer to the start of a flash device
+ * @fd:		The file descriptor, opened for reading and writing
+ * @buf:	The buffer to write
+ * @size:	The size of the buffer
+ *
+ * On NOR type flashes the current contents are read back first and only
+ * erase blocks which differ from @buf are erased, programmed and verified.
+ * Erasing takes most of the time there, so this makes writing an image
+ * which only changed in parts much faster. Other files are erased, if
+ * supported, and written as a whole.
+ *
+ * Return: 0 for success or negative error value
+ */
+int write_full_flash(int fd, const void *buf, size_t size)
+{
+	struct mtd_info_user meminfo;
+	loff_t ofs, start = -1;
+	size_t len;
+	void *rbuf;
+	int ret;
+
+	/* NAND erases fast, reading it back first doesn't pay off */
+	if (ioctl(fd, MEMGETINFO, &meminfo) ||
+	    (meminfo.type != MTD_NORFLASH && meminfo.type != MTD_DATAFLASH)) {
+		ret = erase(fd, size, 0);
+		if (ret && ret != -ENOSYS)
+			return ret;
+
+		ret = pwrite_full(fd, buf, size, 0);
+
+		return ret < 0 ? ret : 0;
+	}
+
+	rbuf = xmalloc(meminfo.erasesize);
+
+	for (ofs = 0; ofs < size; ofs += meminfo.erasesize) {
+		len = min_t(size_t, size - ofs, meminfo.erasesize);
+
+		ret = pread_full(fd, rbuf, len, ofs);
+		if (ret < 0)
+			goto out;
+
+		if (ret != len || memcmp(rbuf, buf + ofs, len)) {
+			if (start < 0)
+				start = ofs;
+			continue;
+		}
+
+		/* unchanged, write out the changed blocks before it in one go */
+		if (start >= 0) {
+			ret = write_flash_blocks(fd, buf, rbuf, meminfo.erasesize,
+						 start, ofs);
+			if (ret)
+				goto out;
+			start = -1;
+		}
+	}
+
+	if (start >= 0)
+		ret = write_flash_blocks(fd, buf, rbuf, meminfo.erasesize, start, size);
+	else
+		ret = 0;
+out:
+	free(rbuf);
+
+	return ret;
+}
+EXPORT_SYMBOL(write_full_flash);
+
 /**
  * write_file_flash - write a buffer to a file backed by flash
  * @filename:    The filename to write
  * @size:        The size of the buffer
  *
- * Functional this is identical to write_file but calls erase() before writing.
+ * Functional this is identical to write_file, but erases the flash before
+ * writing. See write_full_flash() for how unchanged erase blocks are skipped.
  *
  * Return: 0 for success or negative error value
  */
@@ -408,23 +515,15 @@ int write_file_flash(const char *filename, const void *buf, size_t size)
 {
 	int fd, ret;
 
-	fd = open(filename, O_WRONLY);
+	fd = open(filename, O_RDWR);
 	if (fd < 0)
 		return fd;
 
-	ret = erase(fd, size, 0);
-	if (ret < 0)
-		goto out_close;
+	ret = write_full_flash(fd, buf, size);
 
-	ret = write_full(fd, buf, size);
-
-out_close:
 	close(fd);
 
-	if (ret < 0)
-		return ret;
-
-	return 0;
+	return ret;
 }
 EXPORT_SYMBOL(write_file_flash);
 
@@ -666,16 +666,12 @@ void *mempcpy(void *dest, const void *src, size_t count)
 }
 EXPORT_SYMBOL(mempcpy);
 
-#ifndef __HAVE_ARCH_MEMMOVE
-/**
- * memmove - Copy one area of memory to another
- * @dest: Where to copy to
- * @src: Where to copy from
- * @count: The size of the area.
- *
- * Unlike memcpy(), memmove() copes with overlapping areas.
+/*
+ * Shared by the instrumented and the KASAN-free variant, the body is
+ * instrumented according to the function it's inlined into
  */
-void * memmove(void * dest,const void *src,size_t count)
+static __always_inline void *__memmove_generic(void *dest, const void *src,
+					       size_t count)
 {
 	char *tmp, *s;
 
@@ -684,16 +680,42 @@ void * memmove(void * dest,const void *src,size_t count)
 		s = (char *) src;
 		while (count--)
 			*tmp++ = *s++;
-		}
-	else {
+	} else {
 		tmp = (char *) dest + count;
 		s = (char *) src + count;
 		while (count--)
 			*--tmp = *--s;
-		}
+	}
 
 	return dest;
 }
+
+/**
+ * memmove - Copy one area of memory to another
+ * @dest: Where to copy to
+ * @src: Where to copy from
+ * @count: The size of the area.
+ *
+ * Unlike memcpy(), memmove() copes with overlapping areas.
+ */
+void *__default_memmove(void * dest,const void *src,size_t count)
+{
+	return __memmove_generic(dest, src, count);
+}
+EXPORT_SYMBOL(__default_memmove);
+
+void __no_sanitize_address *__nokasan_default_memmove(void * dest,
+						      const void *src, size_t count)
+{
+	return __memmove_generic(dest, src, count);
+}
+EXPORT_SYMBOL(__nokasan_default_memmove);
+
+#ifndef __HAVE_ARCH_MEMMOVE
+void *memmove(void * dest, const void *src, size_t count)
+	__alias(__default_memmove);
+void *__memmove(void * dest, const void *src, size_t count)
+	__alias(__default_memmove);
 #endif
 EXPORT_SYMBOL(memmove);
 
@@ -26,6 +26,8 @@
 #include <malloc.h>
 #include <fs.h>
 #include <libfile.h>
+#include <bthread.h>
+#include <linux/sizes.h>
 
 static void *uncompress_buf;
 static unsigned long uncompress_size;
@@ -159,26 +161,216 @@ static long flush_fd(void *buf, unsigned long len)
 	return write(uncompress_outfd, buf, len);
 }
 
-int uncompress_fd_to_fd(int infd, int outfd,
-	   void(*error_fn)(char *x))
+/*
+ * Read-ahead: a bthread reads the compressed input into a ring of buffers
+ * while the decompressor consumes them in the main thread. bthreads are
+ * cooperative, so the two overlap while the reader waits for the hardware
+ * in a driver delay loop, which reschedules to the decompressor. The
+ * filesystem and driver stack is never entered twice: reads and writes
+ * of the output wait for each other.
+ */
+#define UNCOMPRESS_RA_BUFS	4
+#define UNCOMPRESS_RA_BUFSIZE	SZ_64K
+
+struct uncompress_ra_buf {
+	void *data;
+	size_t len;
+	size_t pos;
+};
+
+struct uncompress_readahead {
+	int fd;
+	struct uncompress_ra_buf bufs[UNCOMPRESS_RA_BUFS];
+	unsigned int head;	/* first filled buffer */
+	unsigned int count;	/* number of filled buffers */
+	bool reading;
+	bool writing;
+	bool eof;
+	bool stop;
+	bool stopped;
+	int err;
+	struct bthread *thread;
+};
+
+static struct uncompress_readahead *uncompress_ra;
+
+static void uncompress_readahead_thread(void *data)
+{
+	struct uncompress_readahead *ra = data;
+	struct uncompress_ra_buf *b;
+	int ret;
+
+	while (!ra->stop) {
+		if (ra->eof || ra->writing || ra->count == UNCOMPRESS_RA_BUFS) {
+			bthread_reschedule_foreground();
+			continue;
+		}
+
+		/*
+		 * The consumer may drain buffers while we are reading, but
+		 * head + count, i.e. the slot we fill, stays the same.
+		 */
+		b = &ra->bufs[(ra->head + ra->count) % UNCOMPRESS_RA_BUFS];
+
+		ra->reading = true;
+		ret = read_full(ra->fd, b->data, UNCOMPRESS_RA_BUFSIZE);
+		ra->reading = false;
+
+		if (ret < 0) {
+			ra->err = ret;
+			ra->eof = true;
+			continue;
+		}
+
+		b->len = ret;
+		b->pos = 0;
+		ra->count++;
+
+		if (ret < UNCOMPRESS_RA_BUFSIZE)
+			ra->eof = true;
+	}
+
+	ra->stopped = true;
+}
+
+static long fill_readahead(void *buf, unsigned long len)
+{
+	struct uncompress_readahead *ra = uncompress_ra;
+	long total = 0;
+
+	while (len) {
+		struct uncompress_ra_buf *b;
+		size_t now;
+
+		if (!ra->count) {
+			if (ra->eof)
+				break;
+			bthread_reschedule_foreground();
+			continue;
+		}
+
+		b = &ra->bufs[ra->head];
+		now = min_t(size_t, len, b->len - b->pos);
+
+		memcpy(buf, b->data + b->pos, now);
+		b->pos += now;
+		buf += now;
+		len -= now;
+		total += now;
+
+		if (b->pos == b->len) {
+			ra->head = (ra->head + 1) % UNCOMPRESS_RA_BUFS;
+			ra->count--;
+		}
+	}
+
+	/* a read error is reported once all data before it is consumed */
+	if (!total && ra->err)
+		return ra->err;
+
+	/* let the reader start on a buffer we have freed */
+	if (!ra->eof && ra->count < UNCOMPRESS_RA_BUFS)
+		bthread_reschedule_foreground();
+
+	return total;
+}
+
+static long flush_fd_readahead(void *buf, unsigned long len)
+{
+	struct uncompress_readahead *ra = uncompress_ra;
+	long ret;
+
+	while (ra->reading)
+		bthread_reschedule_foreground();
+
+	ra->writing = true;
+	ret = flush_fd(buf, len);
+	ra->writing = false;
+
+	return ret;
+}
+
+static void uncompress_readahead_free(struct uncompress_readahead *ra)
 {
+	int i;
+
+	if (ra->thread) {
+		ra->stop = true;
+		while (!ra->stopped)
+			bthread_reschedule_foreground();
+		__bthread_stop(ra->thread);
+	}
+
+	for (i = 0; i < UNCOMPRESS_RA_BUFS; i++)
+		free(ra->bufs[i].data);
+
+	free(ra);
+}
+
+static struct uncompress_readahead *uncompress_readahead_start(int fd)
+{
+	struct uncompress_readahead *ra;
+	int i;
+
+	if (!IS_ENABLED(CONFIG_UNCOMPRESS_READAHEAD))
+		return NULL;
+
+	ra = xzalloc(sizeof(*ra));
+	ra->fd = fd;
+
+	for (i = 0; i < UNCOMPRESS_RA_BUFS; i++) {
+		ra->bufs[i].data = malloc(UNCOMPRESS_RA_BUFSIZE);
+		if (!ra->bufs[i].data)
+			goto err;
+	}
+
+	ra->thread = bthread_create(uncompress_readahead_thread, ra,
+				    "uncompress-readahead");
+	if (!ra->thread)
+		goto err;
+
+	bthread_set_foreground(ra->thread);
+	bthread_wake(ra->thread);
+
+	return ra;
+err:
+	uncompress_readahead_free(ra);
+	return NULL;
+}
+
+static int uncompress_fd(int infd, int outfd, void *output,
+			 void(*error_fn)(char *x))
+{
+	int ret;
+
 	uncompress_infd = infd;
 	uncompress_outfd = outfd;
 
-	return uncompress(NULL, 0,
-	   fill_fd,
-	   flush_fd,
-	   NULL,
-	   NULL,
-	   error_fn);
+	uncompress_ra = uncompress_readahead_start(infd);
+	if (!uncompress_ra)
+		return uncompress(NULL, 0, fill_fd, output ? NULL : flush_fd,
+				  output, NULL, error_fn);
+
+	ret = uncompress(NULL, 0, fill_readahead,
+			 output ? NULL : flush_fd_readahead,
+			 output, NULL, error_fn);
+
+	uncompress_readahead_free(uncompress_ra);
+	uncompress_ra = NULL;
+
+	return ret;
+}
+
+int uncompress_fd_to_fd(int infd, int outfd,
+	   void(*error_fn)(char *x))
+{
+	return uncompress_fd(infd, outfd, NULL, error_fn);
 }
 
 int uncompress_fd_to_buf(int infd, void *output,
 		void(*error_fn)(char *x))
 {
-	uncompress_infd = infd;
-
-	return uncompress(NULL, 0, fill_fd, NULL, output, NULL, error_fn);
+	return uncompress_fd(infd, -1, output, error_fn);
 }
 
 int uncompress_buf_to_fd(const void *input, size_t input_len,
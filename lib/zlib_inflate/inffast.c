@@ -4,49 +4,82 @@
  */
 
 #include <linux/zutil.h>
+#include <asm/unaligned.h>
 #include "inftrees.h"
 #include "inflate.h"
 #include "inffast.h"
 
 #ifndef ASMINF
 
-/* Allow machine dependent optimization for post-increment or pre-increment.
-   Based on testing to date,
-   Pre-increment preferred for:
-   - PowerPC G3 (Adler)
-   - MIPS R5000 (Randers-Pehrson)
-   Post-increment preferred for:
-   - none
-   No measurable difference:
-   - Pentium III (Anderson)
-   - M68060 (Nikl)
+/*
+ * The bit accumulator is a full machine word. It is refilled without
+ * branches: a whole word is loaded from the input and shifted in above
+ * the bits already held, then the input pointer is advanced by the number
+ * of whole bytes that fitted. Bits of the partially fitting byte are
+ * present in hold already but not counted in bits, they are loaded again
+ * by the next refill. Or-ing them in a second time does no harm.
+ *
+ * After a refill at least HOLD_MIN bits are available: 56 with a 64-bit
+ * accumulator, which is enough for a complete length/distance pair
+ * (15 + 5 + 15 + 13 = 48 bits), 24 with a 32-bit one, which needs to be
+ * refilled before the distance code and before the distance extra bits.
  */
-union uu {
-	unsigned short us;
-	unsigned char b[2];
-};
+#if BITS_PER_LONG == 64
+#define HOLD_MIN	56
+#define REFILL() do {                                                  \
+        hold |= (unsigned long)get_unaligned_le64(in) << bits;         \
+        in += (63 - bits) >> 3;                                        \
+        bits |= HOLD_MIN;                                              \
+    } while (0)
+#else
+#define HOLD_MIN	24
+#define REFILL() do {                                                  \
+        hold |= (unsigned long)get_unaligned_le32(in) << bits;         \
+        in += (31 - bits) >> 3;                                        \
+        bits |= HOLD_MIN;                                              \
+    } while (0)
+#endif
 
-/* Endian independed version */
-static inline unsigned short
-get_unaligned16(const unsigned short *p)
+/*
+ * Copy a match of len bytes from dist bytes back in the output. With
+ * efficient unaligned access this is done in words. Matches at least a
+ * word away never read bytes that are not yet written, closer ones are
+ * copied bytewise. Word copies may write up to a word - 1 bytes past the
+ * end of the match, inflate_fast() keeps that much output space spare.
+ */
+static inline unsigned char *copy_match(unsigned char *out, unsigned dist,
+                                        unsigned len)
 {
-	union uu  mm;
-	unsigned char *b = (unsigned char *)p;
-
-	mm.b[0] = b[0];
-	mm.b[1] = b[1];
-	return mm.us;
-}
+    const unsigned char *from = out - dist;
+    unsigned char *end = out + len;
 
-#ifdef POSTINC
-#  define OFF 0
-#  define PUP(a) *(a)++
-#  define UP_UNALIGNED(a) get_unaligned16((a)++)
+#ifdef CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS
+    if (dist >= sizeof(unsigned long)) {
+        do {
+            put_unaligned(get_unaligned((const unsigned long *)from),
+                          (unsigned long *)out);
+            from += sizeof(unsigned long);
+            out += sizeof(unsigned long);
+        } while (out < end);
+        return end;
+    }
 #else
-#  define OFF 1
-#  define PUP(a) *++(a)
-#  define UP_UNALIGNED(a) get_unaligned16(++(a))
+    if (dist >= len) {
+        memcpy(out, from, len);
+        return end;
+    }
 #endif
+    if (dist == 1) {
+        memset(out, out[-1], len);
+        return end;
+    }
+
+    do {
+        *out++ = *from++;
+    } while (out < end);
+
+    return end;
+}
 
 /*
    Decode literal, length, and distance codes and write out the resulting
@@ -59,8 +92,8 @@ get_unaligned16(const unsigned short *p)
    Entry assumptions:
 
         state->mode == LEN
-        strm->avail_in >= 6
-        strm->avail_out >= 258
+        strm->avail_in >= INFLATE_FAST_MIN_INPUT
+        strm->avail_out >= INFLATE_FAST_MIN_OUTPUT
         start >= strm->avail_out
         state->bits < 8
 
@@ -72,16 +105,16 @@ get_unaligned16(const unsigned short *p)
 
    Notes:
 
-    - The maximum input bits used by a length/distance pair is 15 bits for the
-      length code, 5 bits for the length extra, 15 bits for the distance code,
-      and 13 bits for the distance extra.  This totals 48 bits, or six bytes.
-      Therefore if strm->avail_in >= 6, then there is enough input to avoid
-      checking for available input while decoding.
+    - A length/distance pair takes at most 48 bits of input. With
+      INFLATE_FAST_MIN_INPUT bytes left, all refills of a loop iteration,
+      including the bytes they load but don't consume, stay within the
+      input.
 
     - The maximum bytes that a single length/distance pair can output is 258
-      bytes, which is the maximum length that can be coded.  inflate_fast()
-      requires strm->avail_out >= 258 for each loop to avoid checking for
-      output space.
+      bytes, which is the maximum length that can be coded. Together with
+      the overshoot of copy_match() this is INFLATE_FAST_MIN_OUTPUT, which
+      inflate_fast() requires for each loop to avoid checking for output
+      space.
 
     - @start:	inflate()'s starting value for strm->avail_out
  */
@@ -90,9 +123,11 @@ void inflate_fast(z_streamp strm, unsigned start)
     struct inflate_state *state;
     const unsigned char *in;    /* local strm->next_in */
     const unsigned char *last;  /* while in < last, enough input available */
+    const unsigned char *in_end;/* end of input */
     unsigned char *out;         /* local strm->next_out */
     unsigned char *beg;         /* inflate()'s initial strm->next_out */
     unsigned char *end;         /* while out < end, enough space available */
+    unsigned char *out_end;     /* end of output */
 #ifdef INFLATE_STRICT
     unsigned dmax;              /* maximum distance from zlib header */
 #endif
@@ -115,11 +150,13 @@ void inflate_fast(z_streamp strm, unsigned start)
 
     /* copy state to local variables */
     state = (struct inflate_state *)strm->state;
-    in = strm->next_in - OFF;
-    last = in + (strm->avail_in - 5);
-    out = strm->next_out - OFF;
+    in = strm->next_in;
+    in_end = in + strm->avail_in;
+    last = in_end - (INFLATE_FAST_MIN_INPUT - 1);
+    out = strm->next_out;
+    out_end = out + strm->avail_out;
     beg = out - (start - strm->avail_out);
-    end = out + (strm->avail_out - 257);
+    end = out_end - (INFLATE_FAST_MIN_OUTPUT - 1);
 #ifdef INFLATE_STRICT
     dmax = state->dmax;
 #endif
@@ -137,12 +174,7 @@ void inflate_fast(z_streamp strm, unsigned start)
     /* decode literals and length/distances until end-of-block or not enough
        input data or output space */
     do {
-        if (bits < 15) {
-            hold += (unsigned long)(PUP(in)) << bits;
-            bits += 8;
-            hold += (unsigned long)(PUP(in)) << bits;
-            bits += 8;
-        }
+        REFILL();
         this = lcode[hold & lmask];
       dolen:
         op = (unsigned)(this.bits);
@@ -150,214 +182,111 @@ void inflate_fast(z_streamp strm, unsigned start)
         bits -= op;
         op = (unsigned)(this.op);
         if (op == 0) {                          /* literal */
-            PUP(out) = (unsigned char)(this.val);
+            *out++ = (unsigned char)(this.val);
+            continue;
         }
-        else if (op & 16) {                     /* length base */
-            len = (unsigned)(this.val);
-            op &= 15;                           /* number of extra bits */
-            if (op) {
-                if (bits < op) {
-                    hold += (unsigned long)(PUP(in)) << bits;
-                    bits += 8;
-                }
-                len += (unsigned)hold & ((1U << op) - 1);
-                hold >>= op;
-                bits -= op;
+        if (!(op & 16)) {
+            if ((op & 64) == 0) {               /* 2nd level length code */
+                this = lcode[this.val + (hold & ((1U << op) - 1))];
+                goto dolen;
             }
-            if (bits < 15) {
-                hold += (unsigned long)(PUP(in)) << bits;
-                bits += 8;
-                hold += (unsigned long)(PUP(in)) << bits;
-                bits += 8;
+            if (op & 32) {                      /* end-of-block */
+                state->mode = TYPE;
+                break;
             }
-            this = dcode[hold & dmask];
-          dodist:
-            op = (unsigned)(this.bits);
-            hold >>= op;
-            bits -= op;
-            op = (unsigned)(this.op);
-            if (op & 16) {                      /* distance base */
-                dist = (unsigned)(this.val);
-                op &= 15;                       /* number of extra bits */
-                if (bits < op) {
-                    hold += (unsigned long)(PUP(in)) << bits;
-                    bits += 8;
-                    if (bits < op) {
-                        hold += (unsigned long)(PUP(in)) << bits;
-                        bits += 8;
-                    }
-                }
-                dist += (unsigned)hold & ((1U << op) - 1);
-#ifdef INFLATE_STRICT
-                if (dist > dmax) {
-                    strm->msg = (char *)"invalid distance too far back";
-                    state->mode = BAD;
-                    break;
-                }
-#endif
-                hold >>= op;
-                bits -= op;
-                op = (unsigned)(out - beg);     /* max distance in output */
-                if (dist > op) {                /* see if copy from window */
-                    op = dist - op;             /* distance back in window */
-                    if (op > whave) {
-                        strm->msg = (char *)"invalid distance too far back";
-                        state->mode = BAD;
-                        break;
-                    }
-                    from = window - OFF;
-                    if (write == 0) {           /* very common case */
-                        from += wsize - op;
-                        if (op < len) {         /* some from window */
-                            len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
-                            from = out - dist;  /* rest from output */
-                        }
-                    }
-                    else if (write < op) {      /* wrap around window */
-                        from += wsize + write - op;
-                        op -= write;
-                        if (op < len) {         /* some from end of window */
-                            len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
-                            from = window - OFF;
-                            if (write < len) {  /* some from start of window */
-                                op = write;
-                                len -= op;
-                                do {
-                                    PUP(out) = PUP(from);
-                                } while (--op);
-                                from = out - dist;      /* rest from output */
-                            }
-                        }
-                    }
-                    else {                      /* contiguous in window */
-                        from += write - op;
-                        if (op < len) {         /* some from window */
-                            len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
-                            from = out - dist;  /* rest from output */
-                        }
-                    }
-                    while (len > 2) {
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        len -= 3;
-                    }
-                    if (len) {
-                        PUP(out) = PUP(from);
-                        if (len > 1)
-                            PUP(out) = PUP(from);
-                    }
-                }
-                else {
-		    unsigned short *sout;
-		    unsigned long loops;
-
-                    from = out - dist;          /* copy direct from output */
-		    /* minimum length is three */
-		    /* Align out addr */
-		    if (!((long)(out - 1 + OFF) & 1)) {
-			PUP(out) = PUP(from);
-			len--;
-		    }
-		    sout = (unsigned short *)(out - OFF);
-		    if (dist > 2) {
-			unsigned short *sfrom;
+            strm->msg = (char *)"invalid literal/length code";
+            state->mode = BAD;
+            break;
+        }
 
-			sfrom = (unsigned short *)(from - OFF);
-			loops = len >> 1;
-			do
-#ifdef CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS
-			    PUP(sout) = PUP(sfrom);
-#else
-			    PUP(sout) = UP_UNALIGNED(sfrom);
-#endif
-			while (--loops);
-			out = (unsigned char *)sout + OFF;
-			from = (unsigned char *)sfrom + OFF;
-		    } else { /* dist == 1 or dist == 2 */
-			unsigned short pat16;
+        /* length base, up to 5 extra bits fit after a refill */
+        len = (unsigned)(this.val);
+        op &= 15;
+        len += (unsigned)hold & ((1U << op) - 1);
+        hold >>= op;
+        bits -= op;
 
-			pat16 = *(sout-1+OFF);
-			if (dist == 1) {
-				union uu mm;
-				/* copy one char pattern to both bytes */
-				mm.us = pat16;
-				mm.b[0] = mm.b[1];
-				pat16 = mm.us;
-			}
-			loops = len >> 1;
-			do
-			    PUP(sout) = pat16;
-			while (--loops);
-			out = (unsigned char *)sout + OFF;
-		    }
-		    if (len & 1)
-			PUP(out) = PUP(from);
-                }
-            }
-            else if ((op & 64) == 0) {          /* 2nd level distance code */
+        if (HOLD_MIN < 48 && bits < 15)
+            REFILL();
+        this = dcode[hold & dmask];
+      dodist:
+        op = (unsigned)(this.bits);
+        hold >>= op;
+        bits -= op;
+        op = (unsigned)(this.op);
+        if (!(op & 16)) {
+            if ((op & 64) == 0) {               /* 2nd level distance code */
                 this = dcode[this.val + (hold & ((1U << op) - 1))];
                 goto dodist;
             }
-            else {
-                strm->msg = (char *)"invalid distance code";
-                state->mode = BAD;
-                break;
-            }
-        }
-        else if ((op & 64) == 0) {              /* 2nd level length code */
-            this = lcode[this.val + (hold & ((1U << op) - 1))];
-            goto dolen;
-        }
-        else if (op & 32) {                     /* end-of-block */
-            state->mode = TYPE;
+            strm->msg = (char *)"invalid distance code";
+            state->mode = BAD;
             break;
         }
-        else {
-            strm->msg = (char *)"invalid literal/length code";
+
+        dist = (unsigned)(this.val);            /* distance base */
+        op &= 15;                               /* number of extra bits */
+        if (HOLD_MIN < 48 && bits < op)
+            REFILL();
+        dist += (unsigned)hold & ((1U << op) - 1);
+#ifdef INFLATE_STRICT
+        if (dist > dmax) {
+            strm->msg = (char *)"invalid distance too far back";
             state->mode = BAD;
             break;
         }
+#endif
+        hold >>= op;
+        bits -= op;
+
+        op = (unsigned)(out - beg);             /* max distance in output */
+        if (dist > op) {                        /* see if copy from window */
+            op = dist - op;                     /* distance back in window */
+            if (op > whave) {
+                strm->msg = (char *)"invalid distance too far back";
+                state->mode = BAD;
+                break;
+            }
+            if (write >= op) {                  /* contiguous in window */
+                from = window + write - op;
+            } else {                            /* wrap around window */
+                from = window + wsize + write - op;
+                op -= write;
+                if (op < len) {                 /* some from end of window */
+                    memcpy(out, from, op);
+                    out += op;
+                    len -= op;
+                    from = window;              /* rest from start */
+                    op = write;
+                }
+            }
+            if (op >= len) {                    /* all from window */
+                memcpy(out, from, len);
+                out += len;
+                continue;
+            }
+            memcpy(out, from, op);              /* some from window */
+            out += op;
+            len -= op;                          /* rest from output */
+        }
+
+        out = copy_match(out, dist, len);
     } while (in < last && out < end);
 
     /* return unused bytes (on entry, bits < 8, so in won't go too far back) */
     len = bits >> 3;
     in -= len;
     bits -= len << 3;
-    hold &= (1U << bits) - 1;
+    hold &= (1UL << bits) - 1;
 
     /* update state and return */
-    strm->next_in = in + OFF;
-    strm->next_out = out + OFF;
-    strm->avail_in = (unsigned)(in < last ? 5 + (last - in) : 5 - (in - last));
-    strm->avail_out = (unsigned)(out < end ?
-                                 257 + (end - out) : 257 - (out - end));
+    strm->next_in = in;
+    strm->next_out = out;
+    strm->avail_in = (unsigned)(in_end - in);
+    strm->avail_out = (unsigned)(out_end - out);
     state->hold = hold;
     state->bits = bits;
     return;
 }
 
-/*
-   inflate_fast() speedups that turned out slower (on a PowerPC G3 750CXe):
-   - Using bit fields for code structure
-   - Different op definition to avoid & for extra bits (do & for table bits)
-   - Three separate decoding do-loops for direct, window, and write == 0
-   - Special case for distance > 1 copies to do overlapped load and store copy
-   - Explicit branch predictions (based on measured branch probabilities)
-   - Deferring match copy and interspersed it with decoding subsequent codes
-   - Swapping literal/length else
-   - Swapping window/direct else
-   - Larger unrolled copy loops (three is about right)
-   - Moving len -= 3 statement into middle of loop
- */
-
 #endif /* !ASMINF */
@@ -8,4 +8,12 @@
    subject to change. Applications should only use zlib.h.
  */
 
+/*
+ * inflate_fast() is used while at least this much input and output space
+ * is available: the input for word sized refills of the bit buffer, the
+ * output for a maximum length match plus the overshoot of word copies.
+ */
+#define INFLATE_FAST_MIN_INPUT	16
+#define INFLATE_FAST_MIN_OUTPUT	(258 + 8)
+
 void inflate_fast (z_streamp strm, unsigned start);
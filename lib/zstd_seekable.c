@@ -0,0 +1,405 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Random read access to zstd files in seekable format
+ *
+ * A seekable .zst file is a sequence of independently compressed frames
+ * followed by a skippable frame holding the seek table: compressed and
+ * decompressed size of every frame. With that table a read only needs
+ * to decompress the frames covering the requested range instead of the
+ * whole file from the start.
+ *
+ * Format: https://github.com/facebook/zstd/blob/dev/contrib/seekable_format/zstd_seekable_compression_format.md
+ */
+
+#define pr_fmt(fmt) "zstd-seekable: " fmt
+
+#include <common.h>
+#include <driver.h>
+#include <fcntl.h>
+#include <fs.h>
+#include <libfile.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <zstd_seekable.h>
+#include <asm/unaligned.h>
+#include <linux/sizes.h>
+#include <linux/xxhash.h>
+#include <linux/zstd.h>
+
+#define ZSTD_SEEKABLE_MAGIC		0x8F92EAB1
+#define ZSTD_SEEKTABLE_MAGIC		(ZSTD_MAGIC_SKIPPABLE_START | 0xe)
+#define ZSTD_SEEKTABLE_FOOTER_SIZE	9
+#define ZSTD_SEEKTABLE_CHECKSUM_FLAG	BIT(7)
+#define ZSTD_SEEKTABLE_RESERVED		0x7c
+
+/* Frames are decompressed as a whole, so limit their size */
+#define ZSTD_SEEKABLE_FRAME_MAX		SZ_16M
+
+struct zstd_seek_entry {
+	loff_t coff;		/* offset of the frame in the file */
+	loff_t doff;		/* offset of its data in the decompressed stream */
+	u32 checksum;
+};
+
+struct zstd_seekable {
+	int fd;
+	unsigned int nframes;
+	/* nframes + 1 entries, the last one marks the end of the data */
+	struct zstd_seek_entry *index;
+	bool has_checksum;
+
+	void *cbuf;		/* compressed frame */
+	void *dbuf;		/* decompressed frame */
+	int cached;		/* frame held in dbuf, or -1 */
+
+	void *dctx_wksp;
+	ZSTD_DCtx *dctx;
+};
+
+static int zstd_seekable_read_index(struct zstd_seekable *zs)
+{
+	u8 footer[ZSTD_SEEKTABLE_FOOTER_SIZE];
+	size_t entry_size, table_size, cmax = 0, dmax = 0;
+	loff_t fsize, table_off, coff = 0, doff = 0;
+	u8 *table;
+	unsigned int i;
+	u8 desc;
+	int ret;
+
+	fsize = lseek(zs->fd, 0, SEEK_END);
+	if (fsize < 0)
+		return fsize;
+	if (fsize < ZSTD_skippableHeaderSize + ZSTD_SEEKTABLE_FOOTER_SIZE)
+		return -EINVAL;
+
+	ret = pread_full(zs->fd, footer, sizeof(footer), fsize - sizeof(footer));
+	if (ret < 0)
+		return ret;
+	if (ret != sizeof(footer))
+		return -ENODATA;
+
+	if (get_unaligned_le32(footer + 5) != ZSTD_SEEKABLE_MAGIC)
+		return -EINVAL;
+
+	desc = footer[4];
+	if (desc & ZSTD_SEEKTABLE_RESERVED)
+		return -EINVAL;
+
+	zs->nframes = get_unaligned_le32(footer);
+	zs->has_checksum = desc & ZSTD_SEEKTABLE_CHECKSUM_FLAG;
+	entry_size = zs->has_checksum ? 12 : 8;
+
+	if (zs->nframes == 0 ||
+	    (u64)zs->nframes * entry_size > fsize - ZSTD_SEEKTABLE_FOOTER_SIZE)
+		return -EINVAL;
+
+	table_size = zs->nframes * entry_size + ZSTD_SEEKTABLE_FOOTER_SIZE;
+	table_off = fsize - table_size - ZSTD_skippableHeaderSize;
+	if (table_off < 0)
+		return -EINVAL;
+
+	table = malloc(table_size + ZSTD_skippableHeaderSize);
+	if (!table)
+		return -ENOMEM;
+
+	ret = pread_full(zs->fd, table, table_size + ZSTD_skippableHeaderSize,
+			 table_off);
+	if (ret < 0)
+		goto out;
+	if (ret != table_size + ZSTD_skippableHeaderSize) {
+		ret = -ENODATA;
+		goto out;
+	}
+
+	if (get_unaligned_le32(table) != ZSTD_SEEKTABLE_MAGIC ||
+	    get_unaligned_le32(table + 4) != table_size) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	zs->index = calloc(zs->nframes + 1, sizeof(*zs->index));
+	if (!zs->index) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < zs->nframes; i++) {
+		const u8 *e = table + ZSTD_skippableHeaderSize + i * entry_size;
+		u32 csize = get_unaligned_le32(e);
+		u32 dsize = get_unaligned_le32(e + 4);
+
+		if (dsize > ZSTD_SEEKABLE_FRAME_MAX ||
+		    csize > ZSTD_SEEKABLE_FRAME_MAX + SZ_128K) {
+			pr_err("frame %u too large: %u bytes\n", i, dsize);
+			ret = -EFBIG;
+			goto out;
+		}
+
+		zs->index[i].coff = coff;
+		zs->index[i].doff = doff;
+		if (zs->has_checksum)
+			zs->index[i].checksum = get_unaligned_le32(e + 8);
+
+		coff += csize;
+		doff += dsize;
+		cmax = max_t(size_t, cmax, csize);
+		dmax = max_t(size_t, dmax, dsize);
+	}
+
+	zs->index[i].coff = coff;
+	zs->index[i].doff = doff;
+
+	if (coff > table_off) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	zs->cbuf = malloc(cmax);
+	zs->dbuf = malloc(dmax);
+	ret = zs->cbuf && zs->dbuf ? 0 : -ENOMEM;
+out:
+	free(table);
+
+	return ret;
+}
+
+/**
+ * zstd_seekable_open - prepare random access to a seekable zstd file
+ * @fd: file descriptor of the compressed file, owned by the caller
+ *
+ * Reads the seek table at the end of the file.
+ *
+ * Return: the new handle or an ERR_PTR(), -EINVAL if the file has no
+ * valid seek table
+ */
+struct zstd_seekable *zstd_seekable_open(int fd)
+{
+	struct zstd_seekable *zs;
+	size_t wksp_size;
+	int ret;
+
+	zs = xzalloc(sizeof(*zs));
+	zs->fd = fd;
+	zs->cached = -1;
+
+	ret = zstd_seekable_read_index(zs);
+	if (ret)
+		goto err;
+
+	wksp_size = ZSTD_DCtxWorkspaceBound();
+	zs->dctx_wksp = malloc(wksp_size);
+	zs->dctx = ZSTD_initDCtx(zs->dctx_wksp, wksp_size);
+	if (!zs->dctx) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	return zs;
+err:
+	zstd_seekable_close(zs);
+
+	return ERR_PTR(ret);
+}
+
+void zstd_seekable_close(struct zstd_seekable *zs)
+{
+	free(zs->dctx_wksp);
+	free(zs->dbuf);
+	free(zs->cbuf);
+	free(zs->index);
+	free(zs);
+}
+
+loff_t zstd_seekable_size(struct zstd_seekable *zs)
+{
+	return zs->index[zs->nframes].doff;
+}
+
+unsigned int zstd_seekable_num_frames(struct zstd_seekable *zs)
+{
+	return zs->nframes;
+}
+
+static int zstd_seekable_find_frame(struct zstd_seekable *zs, loff_t offset)
+{
+	unsigned int lo = 0, hi = zs->nframes;
+
+	/* last frame starting at or before offset, skipping empty ones */
+	while (hi - lo > 1) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (zs->index[mid].doff <= offset)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static int zstd_seekable_load_frame(struct zstd_seekable *zs, int frame)
+{
+	const struct zstd_seek_entry *e = &zs->index[frame];
+	size_t csize = e[1].coff - e->coff;
+	size_t dsize = e[1].doff - e->doff;
+	size_t ret;
+	int err;
+
+	if (zs->cached == frame)
+		return 0;
+
+	zs->cached = -1;
+
+	err = pread_full(zs->fd, zs->cbuf, csize, e->coff);
+	if (err < 0)
+		return err;
+	if (err != csize)
+		return -ENODATA;
+
+	ret = ZSTD_decompressDCtx(zs->dctx, zs->dbuf, dsize, zs->cbuf, csize);
+	if (ZSTD_isError(ret) || ret != dsize) {
+		pr_err("frame %d: decompression failed\n", frame);
+		return -EILSEQ;
+	}
+
+	if (zs->has_checksum && (u32)xxh64(zs->dbuf, dsize, 0) != e->checksum) {
+		pr_err("frame %d: checksum mismatch\n", frame);
+		return -EILSEQ;
+	}
+
+	zs->cached = frame;
+
+	return 0;
+}
+
+/**
+ * zstd_seekable_read - read from the decompressed data
+ * @zs: handle from zstd_seekable_open()
+ * @buf: buffer to read into
+ * @count: number of bytes to read
+ * @offset: offset in the decompressed data
+ *
+ * Only the frames covering the range are decompressed. The last one is
+ * kept, so sequential reads decompress every frame once.
+ *
+ * Return: number of bytes read, less than @count at the end of the data,
+ * or a negative error code
+ */
+ssize_t zstd_seekable_read(struct zstd_seekable *zs, void *buf, size_t count,
+			   loff_t offset)
+{
+	loff_t size = zstd_seekable_size(zs);
+	size_t done = 0;
+	int frame, ret;
+
+	if (offset >= size)
+		return 0;
+
+	count = min_t(loff_t, count, size - offset);
+	frame = zstd_seekable_find_frame(zs, offset);
+
+	while (done < count) {
+		const struct zstd_seek_entry *e = &zs->index[frame];
+		size_t now;
+
+		ret = zstd_seekable_load_frame(zs, frame);
+		if (ret)
+			return ret;
+
+		now = min_t(loff_t, count - done, e[1].doff - offset);
+		memcpy(buf + done, zs->dbuf + (offset - e->doff), now);
+
+		done += now;
+		offset += now;
+		frame++;
+	}
+
+	return done;
+}
+
+struct zstd_seekable_cdev {
+	struct cdev cdev;
+	struct zstd_seekable *zs;
+	int fd;
+};
+
+static ssize_t zstd_seekable_cdev_read(struct cdev *cdev, void *buf,
+				       size_t count, loff_t offset, ulong flags)
+{
+	struct zstd_seekable_cdev *zc = container_of(cdev, struct zstd_seekable_cdev, cdev);
+
+	return zstd_seekable_read(zc->zs, buf, count, offset);
+}
+
+static const struct cdev_operations zstd_seekable_cdev_ops = {
+	.read = zstd_seekable_cdev_read,
+};
+
+/**
+ * zstd_seekable_cdev_create - create a device for a seekable zstd file
+ * @path: the compressed file
+ *
+ * The device reads the decompressed data, for example to mount a file
+ * system image without decompressing it completely.
+ *
+ * Return: the new cdev, named zstdN, or an ERR_PTR()
+ */
+struct cdev *zstd_seekable_cdev_create(const char *path)
+{
+	struct zstd_seekable_cdev *zc;
+	static unsigned int zstdno;
+	int ret;
+
+	zc = xzalloc(sizeof(*zc));
+
+	zc->fd = open(path, O_RDONLY);
+	if (zc->fd < 0) {
+		ret = zc->fd;
+		goto err_free;
+	}
+
+	zc->zs = zstd_seekable_open(zc->fd);
+	if (IS_ERR(zc->zs)) {
+		ret = PTR_ERR(zc->zs);
+		goto err_close;
+	}
+
+	zc->cdev.name = basprintf("zstd%u", zstdno++);
+	zc->cdev.ops = &zstd_seekable_cdev_ops;
+	zc->cdev.size = zstd_seekable_size(zc->zs);
+	zc->cdev.flags = DEVFS_PARTITION_READONLY;
+
+	ret = devfs_create(&zc->cdev);
+	if (ret)
+		goto err_seekable;
+
+	return &zc->cdev;
+
+err_seekable:
+	free(zc->cdev.name);
+	zstd_seekable_close(zc->zs);
+err_close:
+	close(zc->fd);
+err_free:
+	free(zc);
+
+	return ERR_PTR(ret);
+}
+
+int zstd_seekable_cdev_remove(struct cdev *cdev)
+{
+	struct zstd_seekable_cdev *zc = container_of(cdev, struct zstd_seekable_cdev, cdev);
+
+	if (cdev->ops != &zstd_seekable_cdev_ops)
+		return -EINVAL;
+	if (cdev->open)
+		return -EBUSY;
+
+	devfs_remove(cdev);
+	zstd_seekable_close(zc->zs);
+	close(zc->fd);
+	free(cdev->name);
+	free(zc);
+
+	return 0;
+}
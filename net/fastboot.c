@@ -285,6 +285,8 @@ struct fastboot_work {
 	struct work_struct work;
 	struct fastboot_net *fbn;
 	bool download_finished;
+	void *data;
+	unsigned int data_len;
 	char command[FASTBOOT_MAX_CMD_LEN + 1];
 };
 
@@ -311,6 +313,18 @@ static void fastboot_handle_type_fastboot(struct fastboot_net *fbn,
 			w->fbn = fbn;
 			w->download_finished = true;
 
+			wq_queue_work(&fbn->wq, &w->work);
+		} else if (fbn->fastboot.stream && fastboot_data_len) {
+			/*
+			 * Streamed data goes to the flash device, which must
+			 * not be accessed from the poller we are called from.
+			 * The host waits for the ACK sent after writing.
+			 */
+			w = xzalloc(sizeof(*w));
+			w->fbn = fbn;
+			w->data = memdup(fastboot_data, fastboot_data_len);
+			w->data_len = fastboot_data_len;
+
 			wq_queue_work(&fbn->wq, &w->work);
 		} else {
 			fastboot_data_download(fbn, fastboot_data,
@@ -444,6 +458,11 @@ static void fastboot_do_work(struct work_struct *w)
 		goto out;
 	}
 
+	if (fw->data) {
+		fastboot_data_download(fbn, fw->data, fw->data_len);
+		goto out;
+	}
+
 	fbn->reinit = false;
 	fastboot_tx_print(&fbn->fastboot, FASTBOOT_MSG_NONE, "");
 
@@ -452,6 +471,7 @@ static void fastboot_do_work(struct work_struct *w)
 	fastboot_exec_cmd(&fbn->fastboot, fw->command);
 	fbn->send_keep_alive = false;
 out:
+	free(fw->data);
 	free(fw);
 }
 
@@ -459,6 +479,7 @@ static void fastboot_work_cancel(struct work_struct *w)
 {
 	struct fastboot_work *fw = container_of(w, struct fastboot_work, work);
 
+	free(fw->data);
 	free(fw);
 }
 
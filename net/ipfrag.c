@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/*
+ * ipfrag.c - IPv4 fragment reassembly
+ *
+ * Fragments are collected in a small number of queues, one per datagram,
+ * keyed by source, destination, protocol and IP ID. Each queue holds a
+ * buffer large enough for the biggest possible datagram, prefixed with the
+ * Ethernet and IP header of the first fragment, so the reassembled
+ * datagram can be passed to the protocol handlers like a received frame.
+ *
+ * Received data is tracked in units of 8 bytes, the granularity of the
+ * fragment offset, so duplicated and overlapping fragments are accounted
+ * only once. Datagrams that are not complete within IPFRAG_TIMEOUT are
+ * dropped, when all queues are busy the oldest one is reused.
+ */
+
+#define pr_fmt(fmt) "ipfrag: " fmt
+
+#include <common.h>
+#include <clock.h>
+#include <malloc.h>
+#include <net.h>
+#include <linux/bitmap.h>
+
+#define IPFRAG_QUEUES		4
+#define IPFRAG_TIMEOUT		(2 * SECOND)
+#define IPFRAG_MAX_PAYLOAD	(0xffff - sizeof(struct iphdr))
+#define IPFRAG_BLOCKS		DIV_ROUND_UP(IPFRAG_MAX_PAYLOAD, 8)
+#define IPFRAG_HDR_SIZE		(ETHER_HDR_SIZE + sizeof(struct iphdr))
+
+#define IP_MF			0x2000
+#define IP_OFFSET		0x1fff
+
+struct ipfrag_queue {
+	unsigned char *buf;
+	uint64_t start;
+	uint32_t saddr;
+	uint32_t daddr;
+	uint16_t id;
+	uint8_t protocol;
+	unsigned int total;	/* payload length, 0 until the last fragment */
+	unsigned int received;	/* payload bytes received so far */
+	DECLARE_BITMAP(blocks, IPFRAG_BLOCKS);
+};
+
+static struct ipfrag_queue ipfrag_queues[IPFRAG_QUEUES];
+
+static void ipfrag_free(struct ipfrag_queue *q)
+{
+	free(q->buf);
+	q->buf = NULL;
+}
+
+static struct ipfrag_queue *ipfrag_find(struct iphdr *ip)
+{
+	struct ipfrag_queue *q, *oldest = NULL;
+	int i;
+
+	for (i = 0; i < IPFRAG_QUEUES; i++) {
+		q = &ipfrag_queues[i];
+
+		if (q->buf && is_timeout(q->start, IPFRAG_TIMEOUT)) {
+			pr_debug("timeout on id 0x%04x\n", ntohs(q->id));
+			ipfrag_free(q);
+		}
+
+		if (!q->buf)
+			continue;
+
+		if (q->id == ip->id && q->protocol == ip->protocol &&
+		    q->saddr == net_read_ip(&ip->saddr) &&
+		    q->daddr == net_read_ip(&ip->daddr))
+			return q;
+
+		if (!oldest || q->start < oldest->start)
+			oldest = q;
+	}
+
+	for (i = 0; i < IPFRAG_QUEUES; i++) {
+		if (!ipfrag_queues[i].buf) {
+			q = &ipfrag_queues[i];
+			goto init;
+		}
+	}
+
+	pr_debug("dropping incomplete id 0x%04x\n", ntohs(oldest->id));
+	q = oldest;
+	ipfrag_free(q);
+init:
+	/* one spare byte for net_checksum() on odd lengths */
+	q->buf = malloc(IPFRAG_HDR_SIZE + IPFRAG_MAX_PAYLOAD + 1);
+	if (!q->buf)
+		return NULL;
+
+	q->start = get_time_ns();
+	q->saddr = net_read_ip(&ip->saddr);
+	q->daddr = net_read_ip(&ip->daddr);
+	q->id = ip->id;
+	q->protocol = ip->protocol;
+	q->total = 0;
+	q->received = 0;
+	bitmap_zero(q->blocks, IPFRAG_BLOCKS);
+
+	return q;
+}
+
+/**
+ * net_ip_defrag - Add a fragment to its datagram
+ * @pkt: the received frame holding the fragment
+ * @len: in: length of the frame, out: length of the reassembled frame
+ *
+ * The IP header must have been verified by the caller. Return the frame
+ * with the complete datagram once the last missing fragment arrived, NULL
+ * otherwise. The datagram must be released with net_ip_defrag_release()
+ * after it has been processed.
+ */
+unsigned char *net_ip_defrag(unsigned char *pkt, int *len)
+{
+	struct iphdr *ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
+	unsigned int frag_off = ntohs(ip->frag_off);
+	unsigned int offset = (frag_off & IP_OFFSET) * 8;
+	unsigned int plen = ntohs(ip->tot_len) - sizeof(struct iphdr);
+	unsigned int end = offset + plen;
+	struct ipfrag_queue *q;
+	unsigned char *buf;
+	unsigned int block;
+
+	/* nobody else handles IP options either */
+	if (ip->hl_v != 0x45)
+		return NULL;
+
+	/* all but the last fragment carry a multiple of 8 bytes */
+	if (!plen || end > IPFRAG_MAX_PAYLOAD ||
+	    ((frag_off & IP_MF) && (plen & 7)))
+		return NULL;
+
+	q = ipfrag_find(ip);
+	if (!q)
+		return NULL;
+
+	if (!(frag_off & IP_MF)) {
+		if (q->total && q->total != end)
+			goto bad;
+		q->total = end;
+	}
+
+	if (q->total && end > q->total)
+		goto bad;
+
+	if (!offset)
+		memcpy(q->buf, pkt, IPFRAG_HDR_SIZE);
+
+	memcpy(q->buf + IPFRAG_HDR_SIZE + offset, ip + 1, plen);
+
+	for (block = offset / 8; block * 8 < end; block++)
+		if (!__test_and_set_bit(block, q->blocks))
+			q->received += min(8U, end - block * 8);
+
+	if (!q->total || q->received != q->total)
+		return NULL;
+
+	ip = (struct iphdr *)(q->buf + ETHER_HDR_SIZE);
+	ip->tot_len = htons(sizeof(struct iphdr) + q->total);
+	ip->frag_off = 0;
+	ip->check = 0;
+	ip->check = ~net_checksum((unsigned char *)ip, sizeof(struct iphdr));
+
+	*len = IPFRAG_HDR_SIZE + q->total;
+
+	buf = q->buf;
+	q->buf = NULL;
+
+	return buf;
+bad:
+	pr_debug("inconsistent fragments for id 0x%04x\n", ntohs(q->id));
+	ipfrag_free(q);
+	return NULL;
+}
+
+void net_ip_defrag_release(unsigned char *pkt)
+{
+	free(pkt);
+}
@@ -22,6 +22,7 @@
 #include <driver.h>
 #include <errno.h>
 #include <malloc.h>
+#include <stdlib.h>
 #include <init.h>
 #include <globalvar.h>
 #include <magicvar.h>
@@ -258,16 +259,16 @@ static void __net_poll(struct poller_struct *poller)
 	static uint64_t last;
 
 	/*
-	 * USB network controllers take a long time in the receive path,
-	 * so limit the polling rate to once per 10ms. This is due to
-	 * deficiencies in the barebox USB stack: We can't queue URBs and
-	 * receive a callback when they are done. Instead, we always
-	 * synchronously queue an URB and wait for its completion. In case
-	 * of USB network adapters the only way to detect if packets have
-	 * been received is to queue a RX URB and see if it completes (in
-	 * which case we have received data) or if it timeouts (no data
-	 * available). The timeout can't be arbitrarily small, 2ms is the
-	 * smallest we can do with the 1ms USB frame size.
+	 * USB network controllers can take a long time in the receive path,
+	 * so limit the polling rate to once per 10ms. On host controllers
+	 * that can queue URBs usbnet keeps its RX URBs queued and only
+	 * collects the completed ones here. Elsewhere it has to fall back
+	 * to synchronously queueing an URB and waiting for its completion:
+	 * the only way to detect if packets have been received is then to
+	 * see if the URB completes (in which case we have received data) or
+	 * if it timeouts (no data available). The timeout can't be
+	 * arbitrarily small, 2ms is the smallest we can do with the 1ms USB
+	 * frame size.
 	 *
 	 * Given that we do a mixture of polling-as-fast-as-possible when
 	 * we are waiting for network traffic (tftp, nfs and other users
@@ -306,6 +307,26 @@ static uint16_t net_udp_new_localport(void)
 	return localport;
 }
 
+/*
+ * TCP connections are closed by the server first in most cases, which then
+ * keeps the connection in TIME_WAIT state for a while. Start at a random
+ * port so that a rebooted barebox doesn't reuse the same ports again.
+ */
+static uint16_t net_tcp_new_localport(void)
+{
+	static uint16_t localport;
+
+	if (!localport)
+		localport = 32768 + prandom_u32_max(16384);
+
+	localport++;
+
+	if (localport < 32768)
+		localport = 32768;
+
+	return localport;
+}
+
 IPaddr_t net_get_serverip(void)
 {
 	IPaddr_t ip;
@@ -441,6 +462,7 @@ static struct net_connection *net_new(struct eth_device *edev, IPaddr_t dest,
 	con->ip = (struct iphdr *)(con->packet + ETHER_HDR_SIZE);
 	con->udp = (struct udphdr *)(con->packet + ETHER_HDR_SIZE + sizeof(struct iphdr));
 	con->icmp = (struct icmphdr *)(con->packet + ETHER_HDR_SIZE + sizeof(struct iphdr));
+	con->tcp = (struct tcphdr *)(con->packet + ETHER_HDR_SIZE + sizeof(struct iphdr));
 	con->handler = handler;
 
 	if (dest == IP_BROADCAST) {
@@ -507,6 +529,22 @@ struct net_connection *net_icmp_new(IPaddr_t dest, rx_handler_f *handler,
 	return con;
 }
 
+struct net_connection *net_tcp_new(IPaddr_t dest, uint16_t dport,
+		rx_handler_f *handler, void *ctx)
+{
+	struct net_connection *con = net_new(NULL, dest, handler, ctx);
+
+	if (IS_ERR(con))
+		return con;
+
+	con->proto = IPPROTO_TCP;
+	con->tcp->th_dport = htons(dport);
+	con->tcp->th_sport = htons(net_tcp_new_localport());
+	con->ip->protocol = IPPROTO_TCP;
+
+	return con;
+}
+
 void net_unregister(struct net_connection *con)
 {
 	list_del(&con->list);
@@ -514,6 +552,142 @@ void net_unregister(struct net_connection *con)
 	free(con);
 }
 
+/*
+ * Multicast groups joined on an interface. Datagrams addressed to them are
+ * accepted like unicast ones. Joining and leaving is announced with IGMPv2
+ * reports, so switches doing IGMP snooping forward the group.
+ */
+struct net_mc_group {
+	struct list_head list;
+	struct eth_device *edev;
+	IPaddr_t group;
+	int users;
+};
+
+static LIST_HEAD(net_mc_groups);
+
+#define IGMP_V2_MEMBERSHIP_REPORT	0x16
+#define IGMP_LEAVE_GROUP		0x17
+#define IGMP_ALL_ROUTERS		htonl(0xe0000002)
+
+static struct net_mc_group *net_multicast_find(struct eth_device *edev,
+					       IPaddr_t group)
+{
+	struct net_mc_group *mc;
+
+	list_for_each_entry(mc, &net_mc_groups, list)
+		if (mc->edev == edev && mc->group == group)
+			return mc;
+
+	return NULL;
+}
+
+static bool net_multicast_member(struct eth_device *edev, IPaddr_t ip)
+{
+	return ip_is_multicast(ip) && net_multicast_find(edev, ip);
+}
+
+static void net_igmp_send(struct eth_device *edev, uint8_t type,
+			  IPaddr_t group, IPaddr_t dest)
+{
+	/* IP header with Router Alert option, followed by the IGMP message */
+	const int iplen = sizeof(struct iphdr) + 4;
+	unsigned char *packet, *igmp;
+	struct ethernet *et;
+	struct iphdr *ip;
+	uint32_t d = ntohl(dest);
+
+	packet = net_alloc_packet();
+	if (!packet)
+		return;
+
+	memset(packet, 0, ETHER_HDR_SIZE + iplen + 8);
+
+	et = (struct ethernet *)packet;
+	et->et_dest[0] = 0x01;
+	et->et_dest[1] = 0x00;
+	et->et_dest[2] = 0x5e;
+	et->et_dest[3] = (d >> 16) & 0x7f;
+	et->et_dest[4] = d >> 8;
+	et->et_dest[5] = d;
+	memcpy(et->et_src, edev->ethaddr, 6);
+	et->et_protlen = htons(PROT_IP);
+
+	ip = (struct iphdr *)(packet + ETHER_HDR_SIZE);
+	ip->hl_v = 0x40 | (iplen / 4);
+	ip->tos = 0xc0;
+	ip->tot_len = htons(iplen + 8);
+	ip->id = htons(net_ip_id++);
+	ip->ttl = 1;
+	ip->protocol = IPPROTO_IGMP;
+	net_copy_ip(&ip->saddr, &edev->ipaddr);
+	net_copy_ip(&ip->daddr, &dest);
+
+	/* Router Alert */
+	packet[ETHER_HDR_SIZE + sizeof(struct iphdr)] = 0x94;
+	packet[ETHER_HDR_SIZE + sizeof(struct iphdr) + 1] = 4;
+	ip->check = ~net_checksum((unsigned char *)ip, iplen);
+
+	igmp = packet + ETHER_HDR_SIZE + iplen;
+	igmp[0] = type;
+	net_copy_ip(igmp + 4, &group);
+	*(uint16_t *)(igmp + 2) = ~net_checksum(igmp, 8);
+
+	eth_send(edev, packet, ETHER_HDR_SIZE + iplen + 8);
+
+	net_free_packet(packet);
+}
+
+/**
+ * net_multicast_join - receive datagrams sent to a multicast group
+ * @edev: the interface to receive on
+ * @group: the group address
+ *
+ * Joins are counted, every successful call must be balanced by
+ * net_multicast_leave().
+ */
+int net_multicast_join(struct eth_device *edev, IPaddr_t group)
+{
+	struct net_mc_group *mc;
+
+	if (!ip_is_multicast(group))
+		return -EINVAL;
+
+	mc = net_multicast_find(edev, group);
+	if (mc) {
+		mc->users++;
+		return 0;
+	}
+
+	mc = xzalloc(sizeof(*mc));
+	mc->edev = edev;
+	mc->group = group;
+	mc->users = 1;
+	list_add_tail(&mc->list, &net_mc_groups);
+
+	pr_debug("joining %pI4 on %s\n", &group, eth_name(edev));
+
+	net_igmp_send(edev, IGMP_V2_MEMBERSHIP_REPORT, group, group);
+
+	return 0;
+}
+
+void net_multicast_leave(struct eth_device *edev, IPaddr_t group)
+{
+	struct net_mc_group *mc;
+
+	mc = net_multicast_find(edev, group);
+	if (!mc || --mc->users)
+		return;
+
+	pr_debug("leaving %pI4 on %s\n", &group, eth_name(edev));
+
+	net_igmp_send(edev, IGMP_LEAVE_GROUP, group, IGMP_ALL_ROUTERS);
+
+	list_del(&mc->list);
+	free(mc);
+}
+
 static int net_ip_send(struct net_connection *con, int len)
 {
 	con->ip->tot_len = htons(sizeof(struct iphdr) + len);
@@ -532,6 +706,51 @@ int net_udp_send(struct net_connection *con, int len)
 	return net_ip_send(con, sizeof(struct udphdr) + len);
 }
 
+/*
+ * Sum up the TCP header and data of length @len together with the pseudo
+ * header taken from @ip.
+ */
+static uint16_t net_tcp_checksum(struct iphdr *ip, struct tcphdr *tcp, int len)
+{
+	struct {
+		uint32_t saddr;
+		uint32_t daddr;
+		uint8_t zero;
+		uint8_t protocol;
+		uint16_t len;
+	} __attribute__ ((packed)) ph;
+	uint32_t xsum;
+
+	net_copy_ip(&ph.saddr, &ip->saddr);
+	net_copy_ip(&ph.daddr, &ip->daddr);
+	ph.zero = 0;
+	ph.protocol = IPPROTO_TCP;
+	ph.len = htons(len);
+
+	xsum = net_checksum((unsigned char *)&ph, sizeof(ph));
+	xsum += net_checksum((unsigned char *)tcp, len);
+	xsum = (xsum & 0xffff) + (xsum >> 16);
+
+	return xsum;
+}
+
+/**
+ * net_tcp_send - send a TCP segment
+ * @con: the connection
+ * @len: length of the TCP options and data following the header
+ *
+ * All header fields but the checksum must have been set up by the caller.
+ */
+int net_tcp_send(struct net_connection *con, int len)
+{
+	len += sizeof(struct tcphdr);
+
+	con->tcp->th_sum = 0;
+	con->tcp->th_sum = ~net_tcp_checksum(con->ip, con->tcp, len);
+
+	return net_ip_send(con, len);
+}
+
 int net_icmp_send(struct net_connection *con, int len)
 {
 	con->icmp->checksum = ~net_checksum((unsigned char *)con->icmp,
@@ -645,6 +864,29 @@ static int net_handle_udp(unsigned char *pkt, int len)
 	return -EINVAL;
 }
 
+static int net_handle_tcp(unsigned char *pkt, int len)
+{
+	struct iphdr *ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
+	struct tcphdr *tcp = (struct tcphdr *)(ip + 1);
+	int tcplen = len - ETHER_HDR_SIZE - sizeof(struct iphdr);
+	struct net_connection *con;
+
+	if (tcplen < sizeof(struct tcphdr) ||
+	    net_tcp_checksum(ip, tcp, tcplen) != 0xffff)
+		return -EINVAL;
+
+	list_for_each_entry(con, &connection_list, list) {
+		if (con->proto == IPPROTO_TCP &&
+		    tcp->th_dport == con->tcp->th_sport &&
+		    tcp->th_sport == con->tcp->th_dport &&
+		    net_read_ip(&ip->saddr) == net_read_ip(&con->ip->daddr)) {
+			con->handler(con->priv, pkt, len);
+			return 0;
+		}
+	}
+	return -EINVAL;
+}
+
 static struct iphdr *ip_verify_size(unsigned char *pkt, int *total_len_nic)
 {
 	struct iphdr *ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
@@ -700,6 +942,10 @@ static int ping_reply(struct eth_device *edev, unsigned char *pkt, int len)
 	if (!ip)
 		return -EILSEQ;
 
+	/* we can't fragment the reply to a reassembled request */
+	if (len > PKTSIZE)
+		return -EMSGSIZE;
+
 	icmp->type = ICMP_ECHO_REPLY;
 	icmp->checksum = 0;
 	icmp->checksum = ~net_checksum((unsigned char *)icmp,
@@ -744,10 +990,29 @@ static int net_handle_icmp(struct eth_device *edev, unsigned char *pkt, int len)
 	return 0;
 }
 
+static int net_handle_ip_proto(struct eth_device *edev, unsigned char *pkt,
+			       int len)
+{
+	struct iphdr *ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
+
+	switch (ip->protocol) {
+	case IPPROTO_ICMP:
+		return net_handle_icmp(edev, pkt, len);
+	case IPPROTO_UDP:
+		return net_handle_udp(pkt, len);
+	case IPPROTO_TCP:
+		if (IS_ENABLED(CONFIG_NET_TCP))
+			return net_handle_tcp(pkt, len);
+	}
+
+	return 0;
+}
+
 static int net_handle_ip(struct eth_device *edev, unsigned char *pkt, int len)
 {
 	struct iphdr *ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
 	IPaddr_t tmp;
+	int ret;
 
 	pr_debug("%s\n", __func__);
 
@@ -760,28 +1025,34 @@ static int net_handle_ip(struct eth_device *edev, unsigned char *pkt, int len)
 	if ((ip->hl_v & 0xf0) != 0x40)
 		goto bad;
 
-	/* Can't deal w/ fragments.
-	 * Either a fragment offset (13 bits), or
-	 * MF (More Fragments) from fragment flags (3 bits).
-	 * MF - because first fragment has fragment offset 0
-	 */
-	if (ip->frag_off & htons(0x3fff))
-		goto bad;
 	if (!net_checksum_ok((unsigned char *)ip, sizeof(struct iphdr)))
 		goto bad;
 
 	tmp = net_read_ip(&ip->daddr);
-	if (edev->ipaddr && tmp != edev->ipaddr && tmp != IP_BROADCAST)
+	if (edev->ipaddr && tmp != edev->ipaddr && tmp != IP_BROADCAST &&
+	    !net_multicast_member(edev, tmp))
 		return 0;
 
-	switch (ip->protocol) {
-	case IPPROTO_ICMP:
-		return net_handle_icmp(edev, pkt, len);
-	case IPPROTO_UDP:
-		return net_handle_udp(pkt, len);
+	/*
+	 * A fragment has either a fragment offset (13 bits) or MF (More
+	 * Fragments) from fragment flags (3 bits) set. MF - because the
+	 * first fragment has fragment offset 0.
+	 */
+	if (ip->frag_off & htons(0x3fff)) {
+		if (!IS_ENABLED(CONFIG_NET_IP_REASSEMBLY))
+			goto bad;
+
+		pkt = net_ip_defrag(pkt, &len);
+		if (!pkt)
+			return 0;
+
+		ret = net_handle_ip_proto(edev, pkt, len);
+		net_ip_defrag_release(pkt);
+
+		return ret;
 	}
 
-	return 0;
+	return net_handle_ip_proto(edev, pkt, len);
 bad:
 	net_bad_packet(pkt, len);
 	return 0;
@@ -830,6 +1101,78 @@ int net_receive(struct eth_device *edev, unsigned char *pkt, int len)
 	return ret;
 }
 
+/*
+ * Buffer of the packet currently passed up by net_receive_buf() and the
+ * replacement handed back to the driver once a handler kept it. Released
+ * buffers are collected in a small pool to refill drivers from.
+ */
+static void *net_rx_buf;
+static void *net_rx_replacement;
+
+#define NET_RX_POOL_SIZE	32
+
+static void *net_rx_pool[NET_RX_POOL_SIZE];
+static int net_rx_pool_cnt;
+
+int net_receive_buf(struct eth_device *edev, void **buf, unsigned char *pkt,
+		    int len)
+{
+	int ret;
+
+	net_rx_buf = *buf;
+	net_rx_replacement = NULL;
+
+	ret = net_receive(edev, pkt, len);
+
+	if (net_rx_replacement)
+		*buf = net_rx_replacement;
+
+	net_rx_buf = NULL;
+	net_rx_replacement = NULL;
+
+	return ret;
+}
+
+/**
+ * net_rx_keep - Take over the buffer of the packet being received
+ * @data: pointer into the packet passed to the rx handler
+ *
+ * Allows an rx handler to keep received data instead of copying it. This
+ * only works for packets of drivers using net_receive_buf(), and not for
+ * reassembled IP datagrams.
+ *
+ * Return: the buffer to release with net_rx_release() when done with the
+ * data, NULL if the data must be copied.
+ */
+void *net_rx_keep(const void *data)
+{
+	void *buf = net_rx_buf;
+	void *new;
+
+	if (!buf || data < buf || data >= buf + PKTSIZE)
+		return NULL;
+
+	if (net_rx_pool_cnt)
+		new = net_rx_pool[--net_rx_pool_cnt];
+	else
+		new = net_alloc_packet();
+	if (!new)
+		return NULL;
+
+	net_rx_buf = NULL;
+	net_rx_replacement = new;
+
+	return buf;
+}
+
+void net_rx_release(void *buf)
+{
+	if (net_rx_pool_cnt < NET_RX_POOL_SIZE)
+		net_rx_pool[net_rx_pool_cnt++] = buf;
+	else
+		net_free_packet(buf);
+}
+
 void net_free_packets(void **packets, unsigned count)
 {
 	while (count-- > 0)
@@ -1,7 +1,14 @@
 // SPDX-License-Identifier: GPL-2.0-only
 // SPDX-FileCopyrightText: 2010 Sascha Hauer <s.hauer@pengutronix.de>, Pengutronix
 
-/* netconsole.c - network console support */
+/*
+ * netconsole.c - network console support
+ *
+ * Output is collected in a ring buffer instead of being sent character by
+ * character. A poller sends it once a line is complete, a packet is full or
+ * the oldest character waited for NC_TX_DELAY. Only a full ring or a
+ * console flush sends from the writer's context.
+ */
 
 #define pr_fmt(fmt) "netconsole: " fmt
 
@@ -16,11 +23,21 @@
 #include <net.h>
 #include <kfifo.h>
 #include <init.h>
+#include <clock.h>
+#include <poller.h>
 #include <linux/err.h>
 
+#define NC_TX_RING_SIZE		16384
+#define NC_TX_PACKET_SIZE	1024
+#define NC_TX_DELAY		(10 * MSECOND)
+
 struct nc_priv {
 	struct console_device cdev;
 	struct kfifo *fifo;
+	struct kfifo *tx_fifo;
+	uint64_t tx_start;	/* time the oldest pending character was queued */
+	bool tx_line;		/* a complete line is pending */
+	struct poller_struct poller;
 	int busy;
 	struct net_connection *con;
 
@@ -71,11 +88,24 @@ static int nc_tstc(struct console_device *cdev)
 	return kfifo_len(priv->fifo) ? 1 : 0;
 }
 
+static void nc_tx(struct nc_priv *priv)
+{
+	unsigned char *packet = net_udp_get_payload(priv->con);
+	unsigned int len;
+
+	priv->busy = 1;
+
+	while ((len = kfifo_get(priv->tx_fifo, packet, NC_TX_PACKET_SIZE)))
+		net_udp_send(priv->con, len);
+
+	priv->tx_line = false;
+	priv->busy = 0;
+}
+
 static void nc_putc(struct console_device *cdev, char c)
 {
 	struct nc_priv *priv = container_of(cdev,
 					struct nc_priv, cdev);
-	unsigned char *packet;
 
 	if (!priv->con)
 		return;
@@ -83,12 +113,42 @@ static void nc_putc(struct console_device *cdev, char c)
 	if (priv->busy)
 		return;
 
-	packet = net_udp_get_payload(priv->con);
-	*packet = c;
+	if (!kfifo_len(priv->tx_fifo))
+		priv->tx_start = get_time_ns();
 
-	priv->busy = 1;
-	net_udp_send(priv->con, 1);
-	priv->busy = 0;
+	kfifo_putc(priv->tx_fifo, c);
+
+	if (c == '\n')
+		priv->tx_line = true;
+
+	if (kfifo_len(priv->tx_fifo) == NC_TX_RING_SIZE)
+		nc_tx(priv);
+}
+
+static void nc_flush(struct console_device *cdev)
+{
+	struct nc_priv *priv = container_of(cdev,
+					struct nc_priv, cdev);
+
+	if (priv->con && !priv->busy)
+		nc_tx(priv);
+}
+
+static void nc_poller(struct poller_struct *poller)
+{
+	struct nc_priv *priv = container_of(poller, struct nc_priv, poller);
+	unsigned int len;
+
+	if (!priv->con || priv->busy)
+		return;
+
+	len = kfifo_len(priv->tx_fifo);
+	if (!len)
+		return;
+
+	if (priv->tx_line || len >= NC_TX_PACKET_SIZE ||
+	    is_timeout_non_interruptible(priv->tx_start, NC_TX_DELAY))
+		nc_tx(priv);
 }
 
 static int nc_open(struct console_device *cdev)
@@ -126,6 +186,7 @@ static int nc_close(struct console_device *cdev)
 					struct nc_priv, cdev);
 
 	if (priv->con) {
+		nc_tx(priv);
 		net_unregister(priv->con);
 		priv->con = NULL;
 		return 0;
@@ -144,6 +205,7 @@ static int netconsole_init(void)
 	cdev = &priv->cdev;
 	cdev->tstc = nc_tstc;
 	cdev->putc = nc_putc;
+	cdev->flush = nc_flush;
 	cdev->getc = nc_getc;
 	cdev->devname = "netconsole";
 	cdev->devid = DEVICE_ID_SINGLE;
@@ -153,6 +215,7 @@ static int netconsole_init(void)
 	g_priv = priv;
 
 	priv->fifo = kfifo_alloc(1024);
+	priv->tx_fifo = kfifo_alloc(NC_TX_RING_SIZE);
 
 	ret = console_register(cdev);
 	if (ret) {
@@ -163,6 +226,9 @@ static int netconsole_init(void)
 
 	priv->port = 6666;
 
+	priv->poller.func = nc_poller;
+	poller_register(&priv->poller, "netconsole");
+
 	dev_add_param_ip(&cdev->class_dev, "ip", NULL, NULL, &priv->ip, NULL);
 	dev_add_param_int(&cdev->class_dev, "port", NULL, NULL, &priv->port, "%u", NULL);
 
@@ -0,0 +1,521 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/*
+ * tcp.c - minimal TCP client
+ *
+ * Just enough TCP to fetch data from a server: active open only, no
+ * options but MSS. Received data is collected in a TCP_RCV_BUF sized fifo
+ * whose free space is advertised as window, so the server can keep a full
+ * window of segments in flight. Segments arriving out of order are stored
+ * in the free part of the fifo right where they belong and remembered in
+ * up to TCP_OOO_MAX ranges. They are answered with a duplicate ACK which
+ * makes the server retransmit the missing segment quickly, once it arrives
+ * the whole range becomes readable.
+ *
+ * Sending is meant for requests, tcp_send() waits until all data has been
+ * acknowledged.
+ */
+
+#define pr_fmt(fmt) "tcp: " fmt
+
+#include <common.h>
+#include <clock.h>
+#include <errno.h>
+#include <kfifo.h>
+#include <malloc.h>
+#include <net.h>
+#include <stdlib.h>
+#include <asm/unaligned.h>
+#include <linux/err.h>
+#include <linux/sizes.h>
+
+#define TCP_RCV_BUF		SZ_64K
+#define TCP_MSS			1460	/* Ethernet MTU minus IP and TCP headers */
+#define TCP_RTO			(200 * MSECOND)
+#define TCP_RTO_MAX		(3 * SECOND)
+#define TCP_RETRIES		8
+#define TCP_TIMEOUT		(10 * SECOND)
+
+#define TCP_OOO_MAX		4
+
+#define TCPOPT_EOL		0
+#define TCPOPT_NOP		1
+#define TCPOPT_MSS		2
+
+enum tcp_state {
+	TCP_SYN_SENT,
+	TCP_ESTABLISHED,
+	TCP_CLOSED,
+};
+
+struct tcp_sock {
+	struct net_connection *con;
+	enum tcp_state state;
+	int err;
+	bool fin;		/* peer has closed its side */
+	uint32_t snd_una;	/* oldest unacknowledged sequence number */
+	uint32_t snd_nxt;	/* next sequence number to send */
+	uint32_t snd_wnd;	/* window advertised by the peer */
+	uint32_t rcv_nxt;	/* next sequence number expected */
+	uint32_t rcv_wnd;	/* window last advertised to the peer */
+	unsigned int mss;	/* largest segment the peer accepts */
+	unsigned int unacked;	/* segments received but not yet acked */
+	uint32_t fin_seq;	/* sequence number of a FIN received early */
+	bool fin_early;
+	struct kfifo *rx;
+	struct {
+		uint32_t start;
+		uint32_t end;
+	} ooo[TCP_OOO_MAX];	/* data received beyond rcv_nxt */
+	int num_ooo;
+};
+
+static inline bool seq_before(uint32_t a, uint32_t b)
+{
+	return (int32_t)(a - b) < 0;
+}
+
+static inline bool seq_after(uint32_t a, uint32_t b)
+{
+	return seq_before(b, a);
+}
+
+static uint32_t tcp_rcv_space(struct tcp_sock *sk)
+{
+	return min_t(uint32_t, TCP_RCV_BUF - kfifo_len(sk->rx), 0xffff);
+}
+
+/* copy data for sequence number @seq into the free part of the fifo */
+static unsigned int tcp_rx_store(struct tcp_sock *sk, uint32_t seq,
+				 const unsigned char *data, unsigned int len)
+{
+	struct kfifo *rx = sk->rx;
+	unsigned int off = seq - sk->rcv_nxt;
+	unsigned int space = rx->size - kfifo_len(rx);
+	unsigned int pos, l;
+
+	if (off >= space)
+		return 0;
+
+	len = min(len, space - off);
+	pos = (rx->in + off) & (rx->size - 1);
+	l = min(len, rx->size - pos);
+
+	memcpy(rx->buffer + pos, data, l);
+	memcpy(rx->buffer, data + l, len - l);
+
+	return len;
+}
+
+/* remember the out of order range [start, end), merging overlapping ones */
+static void tcp_ooo_add(struct tcp_sock *sk, uint32_t start, uint32_t end)
+{
+	int i;
+
+	for (i = 0; i < sk->num_ooo; i++) {
+		if (seq_after(start, sk->ooo[i].end) ||
+		    seq_before(end, sk->ooo[i].start))
+			continue;
+
+		if (seq_before(sk->ooo[i].start, start))
+			start = sk->ooo[i].start;
+		if (seq_after(sk->ooo[i].end, end))
+			end = sk->ooo[i].end;
+
+		sk->ooo[i] = sk->ooo[--sk->num_ooo];
+		i = -1;
+	}
+
+	if (sk->num_ooo == TCP_OOO_MAX)
+		return;
+
+	sk->ooo[sk->num_ooo].start = start;
+	sk->ooo[sk->num_ooo].end = end;
+	sk->num_ooo++;
+}
+
+/* make everything up to @end plus adjacent out of order data readable */
+static void tcp_rcv_advance(struct tcp_sock *sk, uint32_t end)
+{
+	int i;
+
+	for (i = 0; i < sk->num_ooo; i++) {
+		if (seq_after(sk->ooo[i].start, end))
+			continue;
+
+		if (seq_after(sk->ooo[i].end, end))
+			end = sk->ooo[i].end;
+
+		sk->ooo[i] = sk->ooo[--sk->num_ooo];
+		i = -1;
+	}
+
+	sk->rx->in += end - sk->rcv_nxt;
+	sk->rcv_nxt = end;
+
+	if (sk->fin_early && sk->rcv_nxt == sk->fin_seq) {
+		sk->rcv_nxt++;
+		sk->fin = true;
+	}
+}
+
+static int tcp_xmit(struct tcp_sock *sk, uint8_t flags, uint32_t seq,
+		    const void *data, int len)
+{
+	struct tcphdr *tcp = sk->con->tcp;
+	uint8_t *opt = net_tcp_get_payload(sk->con);
+	int optlen = 0;
+
+	if (flags & TH_SYN) {
+		opt[0] = TCPOPT_MSS;
+		opt[1] = 4;
+		put_unaligned_be16(TCP_MSS, &opt[2]);
+		optlen = 4;
+	}
+
+	if (len)
+		memcpy(opt + optlen, data, len);
+
+	sk->rcv_wnd = tcp_rcv_space(sk);
+	sk->unacked = 0;
+
+	tcp->th_seq = htonl(seq);
+	tcp->th_ack = (flags & TH_ACK) ? htonl(sk->rcv_nxt) : 0;
+	tcp->th_off = ((sizeof(*tcp) + optlen) / 4) << 4;
+	tcp->th_flags = flags;
+	tcp->th_win = htons(sk->rcv_wnd);
+	tcp->th_urp = 0;
+
+	return net_tcp_send(sk->con, optlen + len);
+}
+
+static void tcp_send_ack(struct tcp_sock *sk)
+{
+	tcp_xmit(sk, TH_ACK, sk->snd_nxt, NULL, 0);
+}
+
+static void tcp_parse_options(struct tcp_sock *sk, struct tcphdr *tcp)
+{
+	uint8_t *opt = (uint8_t *)(tcp + 1);
+	uint8_t *end = (uint8_t *)tcp + (tcp->th_off >> 4) * 4;
+
+	while (opt < end) {
+		if (*opt == TCPOPT_EOL)
+			break;
+		if (*opt == TCPOPT_NOP) {
+			opt++;
+			continue;
+		}
+		if (opt + 1 >= end || opt[1] < 2 || opt + opt[1] > end)
+			break;
+		if (opt[0] == TCPOPT_MSS && opt[1] == 4)
+			sk->mss = min_t(unsigned int, TCP_MSS,
+					get_unaligned_be16(&opt[2]));
+		opt += opt[1];
+	}
+}
+
+static void tcp_reset(struct tcp_sock *sk, int err)
+{
+	sk->state = TCP_CLOSED;
+	sk->err = err;
+}
+
+static void tcp_handler(void *ctx, char *pkt, unsigned len)
+{
+	struct tcp_sock *sk = ctx;
+	struct tcphdr *tcp = net_eth_to_tcphdr(pkt);
+	unsigned int hlen = (tcp->th_off >> 4) * 4;
+	uint32_t seq = ntohl(tcp->th_seq);
+	uint32_t ack = ntohl(tcp->th_ack);
+	unsigned char *data = (unsigned char *)tcp + hlen;
+	unsigned int dlen, now;
+
+	len -= ETHER_HDR_SIZE + sizeof(struct iphdr);
+	if (hlen < sizeof(*tcp) || hlen > len)
+		return;
+	dlen = len - hlen;
+
+	switch (sk->state) {
+	case TCP_SYN_SENT:
+		if ((tcp->th_flags & TH_ACK) && ack != sk->snd_nxt) {
+			/* reset a stale connection the peer still knows about */
+			if (!(tcp->th_flags & TH_RST))
+				tcp_xmit(sk, TH_RST, ack, NULL, 0);
+			return;
+		}
+		if (tcp->th_flags & TH_RST) {
+			if (tcp->th_flags & TH_ACK)
+				tcp_reset(sk, -ECONNREFUSED);
+			return;
+		}
+		if ((tcp->th_flags & (TH_SYN | TH_ACK)) != (TH_SYN | TH_ACK))
+			return;
+
+		tcp_parse_options(sk, tcp);
+		sk->rcv_nxt = seq + 1;
+		sk->snd_una = ack;
+		sk->snd_wnd = ntohs(tcp->th_win);
+		sk->state = TCP_ESTABLISHED;
+		tcp_send_ack(sk);
+		return;
+	case TCP_ESTABLISHED:
+		break;
+	default:
+		return;
+	}
+
+	if (tcp->th_flags & TH_RST) {
+		if (seq == sk->rcv_nxt)
+			tcp_reset(sk, -ECONNRESET);
+		return;
+	}
+
+	if (tcp->th_flags & TH_ACK) {
+		if (seq_after(ack, sk->snd_una) && !seq_after(ack, sk->snd_nxt))
+			sk->snd_una = ack;
+		sk->snd_wnd = ntohs(tcp->th_win);
+	}
+
+	if (sk->fin)
+		goto dup_ack;
+
+	/* skip what we have already */
+	if (seq_before(seq, sk->rcv_nxt)) {
+		now = sk->rcv_nxt - seq;
+		if (now > dlen || (now == dlen && !(tcp->th_flags & TH_FIN)))
+			goto dup_ack;
+		seq += now;
+		data += now;
+		dlen -= now;
+	}
+
+	now = tcp_rx_store(sk, seq, data, dlen);
+
+	if (tcp->th_flags & TH_FIN && now == dlen) {
+		sk->fin_seq = seq + dlen;
+		sk->fin_early = true;
+	}
+
+	if (seq != sk->rcv_nxt) {
+		if (now)
+			tcp_ooo_add(sk, seq, seq + now);
+		goto dup_ack;
+	}
+
+	tcp_rcv_advance(sk, seq + now);
+	if (now)
+		sk->unacked++;
+
+	/* ack every second segment, see tcp_recv() for the others */
+	if (sk->fin || (dlen && (now < dlen || sk->num_ooo || sk->unacked >= 2)))
+		tcp_send_ack(sk);
+
+	return;
+
+dup_ack:
+	if (dlen || (tcp->th_flags & (TH_SYN | TH_FIN)))
+		tcp_send_ack(sk);
+}
+
+static uint64_t tcp_rto(int tries)
+{
+	return min_t(uint64_t, TCP_RTO << tries, TCP_RTO_MAX);
+}
+
+/**
+ * tcp_connect - open a TCP connection
+ * @dest: IP address of the server
+ * @dport: port on the server
+ *
+ * Return the connected socket or an error pointer.
+ */
+struct tcp_sock *tcp_connect(IPaddr_t dest, uint16_t dport)
+{
+	struct tcp_sock *sk;
+	uint64_t start;
+	uint32_t iss;
+	int tries = 0, ret;
+
+	sk = xzalloc(sizeof(*sk));
+
+	sk->rx = kfifo_alloc(TCP_RCV_BUF);
+	if (!sk->rx) {
+		ret = -ENOMEM;
+		goto err_free;
+	}
+
+	sk->con = net_tcp_new(dest, dport, tcp_handler, sk);
+	if (IS_ERR(sk->con)) {
+		ret = PTR_ERR(sk->con);
+		goto err_fifo;
+	}
+
+	iss = random32() + (get_time_ns() >> 12);
+	sk->state = TCP_SYN_SENT;
+	sk->snd_una = iss;
+	sk->snd_nxt = iss + 1;
+	sk->mss = 536;
+
+	tcp_xmit(sk, TH_SYN, iss, NULL, 0);
+	start = get_time_ns();
+
+	while (sk->state == TCP_SYN_SENT) {
+		if (ctrlc()) {
+			ret = -EINTR;
+			goto err_con;
+		}
+
+		net_poll();
+
+		if (is_timeout(start, tcp_rto(tries))) {
+			if (++tries > TCP_RETRIES) {
+				ret = -ETIMEDOUT;
+				goto err_con;
+			}
+			tcp_xmit(sk, TH_SYN, iss, NULL, 0);
+			start = get_time_ns();
+		}
+	}
+
+	if (sk->state != TCP_ESTABLISHED) {
+		ret = sk->err;
+		goto err_con;
+	}
+
+	return sk;
+
+err_con:
+	net_unregister(sk->con);
+err_fifo:
+	kfifo_free(sk->rx);
+err_free:
+	free(sk);
+
+	return ERR_PTR(ret);
+}
+
+/**
+ * tcp_send - send data
+ * @sk: the socket
+ * @buf: the data
+ * @len: length of the data
+ *
+ * Return @len once all data has been acknowledged by the peer, a negative
+ * error code otherwise.
+ */
+ssize_t tcp_send(struct tcp_sock *sk, const void *buf, size_t len)
+{
+	uint32_t start_seq = sk->snd_nxt;
+	uint32_t end_seq = start_seq + len;
+	uint64_t start = 0;
+	int tries = -1;
+
+	while (seq_before(sk->snd_una, end_seq)) {
+		if (sk->state != TCP_ESTABLISHED)
+			return sk->err ?: -ENOTCONN;
+
+		if (ctrlc())
+			return -EINTR;
+
+		/* (re)send everything unacknowledged the peer has room for */
+		if (tries < 0 || is_timeout(start, tcp_rto(tries))) {
+			uint32_t seq = sk->snd_una;
+			uint32_t wnd_end = sk->snd_una + max(sk->snd_wnd, 1U);
+
+			if (++tries > TCP_RETRIES) {
+				tcp_reset(sk, -ETIMEDOUT);
+				continue;
+			}
+
+			while (seq_before(seq, end_seq) && seq_before(seq, wnd_end)) {
+				uint32_t now = min3(end_seq - seq, wnd_end - seq,
+						    (uint32_t)sk->mss);
+
+				tcp_xmit(sk, TH_ACK | TH_PUSH, seq,
+					 buf + (seq - start_seq), now);
+				seq += now;
+				if (seq_after(seq, sk->snd_nxt))
+					sk->snd_nxt = seq;
+			}
+
+			start = get_time_ns();
+		}
+
+		net_poll();
+	}
+
+	return len;
+}
+
+/**
+ * tcp_recv - receive data
+ * @sk: the socket
+ * @buf: buffer for the data
+ * @len: size of the buffer
+ *
+ * Wait for data to arrive and return up to @len bytes of it. Return 0 once
+ * the peer closed the connection and all data has been read, a negative
+ * error code otherwise.
+ */
+ssize_t tcp_recv(struct tcp_sock *sk, void *buf, size_t len)
+{
+	uint64_t start = get_time_ns();
+	unsigned int now;
+
+	while (!kfifo_len(sk->rx)) {
+		if (sk->fin)
+			return 0;
+		if (sk->state != TCP_ESTABLISHED)
+			return sk->err ?: -ENOTCONN;
+		if (ctrlc())
+			return -EINTR;
+		if (is_timeout(start, TCP_TIMEOUT))
+			return -ETIMEDOUT;
+
+		/* all data consumed, ack what is left before waiting */
+		if (sk->unacked)
+			tcp_send_ack(sk);
+
+		net_poll();
+	}
+
+	now = kfifo_get(sk->rx, buf, len);
+
+	/* open the window again when it has fallen below half the buffer */
+	if (!sk->fin && sk->state == TCP_ESTABLISHED &&
+	    sk->rcv_wnd < TCP_RCV_BUF / 2 &&
+	    tcp_rcv_space(sk) >= TCP_RCV_BUF / 2)
+		tcp_send_ack(sk);
+
+	return now;
+}
+
+/**
+ * tcp_close - close a connection and free the socket
+ * @sk: the socket
+ *
+ * A connection the peer has closed already is closed gracefully, otherwise
+ * it is reset, which also discards data that is still in flight.
+ */
+void tcp_close(struct tcp_sock *sk)
+{
+	uint64_t start;
+
+	if (sk->state == TCP_ESTABLISHED && sk->fin) {
+		tcp_xmit(sk, TH_FIN | TH_ACK, sk->snd_nxt++, NULL, 0);
+
+		/* give the peer a chance to see it, it retransmits its FIN otherwise */
+		start = get_time_ns();
+		while (seq_before(sk->snd_una, sk->snd_nxt) &&
+		       sk->state == TCP_ESTABLISHED &&
+		       !is_timeout(start, TCP_RTO))
+			net_poll();
+	} else if (sk->state != TCP_CLOSED) {
+		tcp_xmit(sk, TH_RST | TH_ACK, sk->snd_nxt, NULL, 0);
+	}
+
+	net_unregister(sk->con);
+	kfifo_free(sk->rx);
+	free(sk);
+}
@@ -0,0 +1,304 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <common.h>
+#include <block.h>
+#include <bselftest.h>
+#include <disks.h>
+#include <driver.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include <linux/sizes.h>
+
+BSELFTEST_GLOBALS();
+
+#define BLK_TEST_SIZE	SZ_4M
+#define BLK_TEST_BLOCKS	(BLK_TEST_SIZE / SECTOR_SIZE)
+/* 224KiB, not a multiple of the cache chunk size */
+#define BLK_TEST_MAX_BLOCKS	448
+
+struct blk_test {
+	struct block_device blk;
+	struct device dev;
+	u8 *disk;
+	u8 *ref;
+	unsigned int writes;
+	unsigned int too_large;
+};
+
+/* like drivers which can't split requests themselves */
+static int blk_test_check_size(struct blk_test *t, blkcnt_t num_blocks)
+{
+	if (num_blocks <= BLK_TEST_MAX_BLOCKS)
+		return 0;
+
+	t->too_large++;
+
+	return -EINVAL;
+}
+
+static int blk_test_read(struct block_device *blk, void *buf, sector_t block,
+			 blkcnt_t num_blocks)
+{
+	struct blk_test *t = container_of(blk, struct blk_test, blk);
+	int ret;
+
+	ret = blk_test_check_size(t, num_blocks);
+	if (ret)
+		return ret;
+
+	memcpy(buf, t->disk + block * SECTOR_SIZE, num_blocks * SECTOR_SIZE);
+
+	return 0;
+}
+
+static int blk_test_write(struct block_device *blk, const void *buf,
+			  sector_t block, blkcnt_t num_blocks)
+{
+	struct blk_test *t = container_of(blk, struct blk_test, blk);
+	int ret;
+
+	ret = blk_test_check_size(t, num_blocks);
+	if (ret)
+		return ret;
+
+	memcpy(t->disk + block * SECTOR_SIZE, buf, num_blocks * SECTOR_SIZE);
+	t->writes++;
+
+	return 0;
+}
+
+static struct block_device_ops blk_test_ops = {
+	.read = blk_test_read,
+	.write = blk_test_write,
+};
+
+static void blk_test_fill(u8 *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = random32();
+}
+
+/* write through the cdev and to the reference buffer */
+static void blk_test_write_ref(struct blk_test *t, const u8 *buf, size_t len,
+			       loff_t ofs)
+{
+	ssize_t ret;
+
+	total_tests++;
+
+	ret = cdev_write(&t->blk.cdev, buf, len, ofs, 0);
+	if (ret != len) {
+		failed_tests++;
+		printf("writing %zu bytes at %lld failed: %pe\n", len, ofs,
+		       ERR_PTR(ret < 0 ? ret : -EIO));
+		return;
+	}
+
+	memcpy(t->ref + ofs, buf, len);
+}
+
+static void blk_test_check(struct blk_test *t, const char *what)
+{
+	int ret;
+
+	total_tests++;
+
+	ret = cdev_flush(&t->blk.cdev);
+	if (ret) {
+		failed_tests++;
+		printf("%s: flush failed: %pe\n", what, ERR_PTR(ret));
+		return;
+	}
+
+	if (memcmp(t->disk, t->ref, BLK_TEST_SIZE)) {
+		failed_tests++;
+		printf("%s: device content differs\n", what);
+	}
+
+	total_tests++;
+
+	if (t->too_large) {
+		failed_tests++;
+		printf("%s: %u requests above %u blocks\n", what, t->too_large,
+		       BLK_TEST_MAX_BLOCKS);
+		t->too_large = 0;
+	}
+}
+
+/*
+ * Small sequential writes, as done by cp, are written back in large
+ * pieces made of adjacent chunks.
+ */
+static void test_block_merge(struct blk_test *t, u8 *buf)
+{
+	loff_t ofs;
+
+	cdev_discard_range(&t->blk.cdev, SZ_1M, 0);
+	t->writes = 0;
+
+	for (ofs = 0; ofs < SZ_1M; ofs += SZ_4K)
+		blk_test_write_ref(t, buf + ofs, SZ_4K, ofs);
+
+	blk_test_check(t, "merge");
+
+	/* three 64KiB chunks fit into BLK_TEST_MAX_BLOCKS */
+	total_tests++;
+	if (t->writes > DIV_ROUND_UP(SZ_1M, 3 * SZ_64K)) {
+		failed_tests++;
+		printf("merge: %u writes for 1MiB in 4KiB pieces\n", t->writes);
+	}
+}
+
+/*
+ * Large writes bypass the cache, also when not aligned to blocks or
+ * chunks. The partial block at the end is read through the cache, which
+ * must not take the blocks just written for discarded ones.
+ */
+static void test_block_stream(struct blk_test *t, u8 *buf)
+{
+	size_t len = SZ_2M - 100;
+
+	cdev_discard_range(&t->blk.cdev, SZ_2M, SZ_1M);
+	t->writes = 0;
+
+	blk_test_write_ref(t, buf + 1, len, SZ_1M);
+
+	blk_test_check(t, "stream");
+
+	/* the partial block at the end is written back separately */
+	total_tests++;
+	if (t->writes > DIV_ROUND_UP(len, BLK_TEST_MAX_BLOCKS * SECTOR_SIZE) + 1) {
+		failed_tests++;
+		printf("stream: %u writes for a single 2MiB write\n", t->writes);
+	}
+
+	/* overlapping partial and large writes */
+	blk_test_write_ref(t, buf + 3, 1000, SZ_1M + 300);
+	blk_test_write_ref(t, buf + 5, SZ_512K + 7, SZ_1M + 200);
+	blk_test_write_ref(t, buf, SZ_256K, SZ_1M - SZ_128K);
+
+	blk_test_check(t, "overlap");
+}
+
+/* random writes must end up on the device like in the reference buffer */
+static void test_block_random(struct blk_test *t, u8 *buf)
+{
+	int i;
+
+	for (i = 0; i < 300; i++) {
+		size_t len;
+		loff_t ofs;
+
+		if (i & 1)
+			len = 1 + prandom_u32_max(SZ_8K);
+		else
+			len = 1 + prandom_u32_max(SZ_512K);
+
+		ofs = prandom_u32_max(BLK_TEST_SIZE - len);
+
+		blk_test_write_ref(t, buf + prandom_u32_max(64), len, ofs);
+
+		if (!prandom_u32_max(50))
+			blk_test_check(t, "random");
+	}
+
+	blk_test_check(t, "random");
+}
+
+/* large reads bypass the cache and must be split like writes */
+static void test_block_read(struct blk_test *t, u8 *buf, unsigned int align,
+			    loff_t ofs)
+{
+	size_t len = SZ_2M;
+	ssize_t ret;
+
+	total_tests++;
+
+	ret = cdev_read(&t->blk.cdev, buf + align, len, ofs, 0);
+	if (ret != len) {
+		failed_tests++;
+		printf("reading %zu bytes at %lld failed: %pe\n", len, ofs,
+		       ERR_PTR(ret < 0 ? ret : -EIO));
+		return;
+	}
+
+	total_tests++;
+
+	if (memcmp(buf + align, t->ref + ofs, len)) {
+		failed_tests++;
+		printf("read: data at %lld differs\n", ofs);
+	}
+
+	total_tests++;
+
+	if (t->too_large) {
+		failed_tests++;
+		printf("read: %u requests above %u blocks\n", t->too_large,
+		       BLK_TEST_MAX_BLOCKS);
+		t->too_large = 0;
+	}
+}
+
+static void test_block(void)
+{
+	struct blk_test *t;
+	u8 *buf;
+	int ret;
+
+	t = xzalloc(sizeof(*t));
+	t->disk = malloc(BLK_TEST_SIZE);
+	t->ref = malloc(BLK_TEST_SIZE);
+	buf = malloc(SZ_2M + SZ_4K);
+	if (!t->disk || !t->ref || !buf) {
+		skipped_tests++;
+		goto out;
+	}
+
+	/* no partition table */
+	memset(t->disk, 0, BLK_TEST_SIZE);
+	memset(t->ref, 0, BLK_TEST_SIZE);
+	blk_test_fill(buf, SZ_2M + SZ_4K);
+
+	dev_set_name(&t->dev, "blktest");
+	t->dev.id = DEVICE_ID_SINGLE;
+	ret = register_device(&t->dev);
+	if (ret) {
+		skipped_tests++;
+		goto out;
+	}
+
+	t->blk.dev = &t->dev;
+	t->blk.cdev.name = xstrdup("blktest");
+	t->blk.ops = &blk_test_ops;
+	t->blk.blockbits = SECTOR_SHIFT;
+	t->blk.num_blocks = BLK_TEST_BLOCKS;
+	t->blk.type = BLK_TYPE_VIRTUAL;
+	t->blk.max_blocks = BLK_TEST_MAX_BLOCKS;
+
+	ret = blockdevice_register(&t->blk);
+	if (ret) {
+		skipped_tests++;
+		goto out_unregister;
+	}
+
+	test_block_merge(t, buf);
+	test_block_stream(t, buf);
+	test_block_random(t, buf);
+	/* overwrites buf */
+	test_block_read(t, buf, 0, SZ_512K);
+	test_block_read(t, buf, 1, SZ_1M + 3);
+
+	blockdevice_unregister(&t->blk);
+out_unregister:
+	unregister_device(&t->dev);
+out:
+	free(buf);
+	free(t->ref);
+	free(t->disk);
+	free(t);
+}
+bselftest(core, test_block);
@@ -6,6 +6,7 @@
 #include <bselftest.h>
 #include <clock.h>
 #include <digest.h>
+#include <linux/sizes.h>
 
 BSELFTEST_GLOBALS();
 
@@ -196,6 +197,101 @@ static void test_digests_sha35(const char *suffix)
 				   "60a5a68aa0017e3446433349b42592b74713d7787628a58e400b7f588b9bd69b"));
 }
 
+static int digest_compare_one(struct digest *d, struct digest *ref,
+			      const u8 *buf, size_t len, size_t chunk)
+{
+	u8 out[64], out_ref[64];
+	size_t done;
+	int ret;
+
+	ret = digest_digest(ref, buf, len, out_ref);
+	if (ret)
+		return ret;
+
+	ret = digest_init(d);
+	if (ret)
+		return ret;
+
+	for (done = 0; done < len; done += chunk) {
+		ret = digest_update(d, buf + done, min(chunk, len - done));
+		if (ret)
+			return ret;
+	}
+
+	ret = digest_final(d, out);
+	if (ret)
+		return ret;
+
+	return memcmp(out, out_ref, digest_length(d)) ? -EILSEQ : 0;
+}
+
+/*
+ * Compare the highest priority implementation of @algo, which may be an
+ * accelerated one selected at runtime, against the generic one, using
+ * different lengths, alignments and update() chunk sizes.
+ */
+static void test_digest_vs_generic(bool option, const char *algo)
+{
+	static const size_t chunks[] = { 1, 3, 64, 65, SZ_4K };
+	struct digest *d = NULL, *ref = NULL;
+	size_t len, off;
+	u8 *buf;
+	int i, ret;
+
+	total_tests++;
+
+	if (!option) {
+		skipped_tests++;
+		return;
+	}
+
+	d = digest_alloc(algo);
+	ref = digest_alloc(digest_suffix(algo, "generic"));
+	if (!d || !ref) {
+		printf("%s: failed to allocate digests\n", algo);
+		goto fail;
+	}
+
+	if (d->algo == ref->algo) {
+		/* nothing to compare against */
+		skipped_tests++;
+		goto out;
+	}
+
+	buf = malloc(SZ_16K + 8);
+	if (WARN_ON(!buf))
+		goto fail;
+
+	for (i = 0; i < SZ_16K + 8; i++)
+		buf[i] = i * 7 + (i >> 8);
+
+	for (off = 0; off < 4; off++) {
+		for (len = 0; len <= SZ_16K; len = len < 256 ? len + 1 : len * 2 + 1) {
+			for (i = 0; i < ARRAY_SIZE(chunks); i++) {
+				ret = digest_compare_one(d, ref, buf + off, len, chunks[i]);
+				if (!ret)
+					continue;
+
+				printf("%s: %s differs from %s-generic: len=%zu off=%zu chunk=%zu: %pe\n",
+				       algo, d->algo->base.driver_name, algo,
+				       len, off, chunks[i], ERR_PTR(ret));
+				free(buf);
+				goto fail;
+			}
+		}
+	}
+
+	free(buf);
+out:
+	digest_free(d);
+	digest_free(ref);
+	return;
+fail:
+	digest_free(d);
+	digest_free(ref);
+	failed_tests++;
+}
+
 static void test_digests(void)
 {
 	int i;
@@ -215,5 +311,7 @@ static void test_digests(void)
 	test_digests_sha12("");
 	test_digests_sha35("");
 
+	test_digest_vs_generic(IS_ENABLED(CONFIG_DIGEST_SHA224_GENERIC), "sha224");
+	test_digest_vs_generic(IS_ENABLED(CONFIG_DIGEST_SHA256_GENERIC), "sha256");
 }
 bselftest(core, test_digests);
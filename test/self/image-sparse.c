@@ -0,0 +1,229 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <common.h>
+#include <bselftest.h>
+#include <image-sparse.h>
+#include <malloc.h>
+
+BSELFTEST_GLOBALS();
+
+#define SPARSE_TEST_BLK_SZ	1024
+#define SPARSE_TEST_BLKS	9
+#define SPARSE_TEST_SIZE	(SPARSE_TEST_BLK_SZ * SPARSE_TEST_BLKS)
+#define SPARSE_TEST_FILL	0x12345678
+#define SPARSE_TEST_UNTOUCHED	0xa5
+
+struct sparse_test_out {
+	u8 *buf;
+	int calls;
+	int fills;
+};
+
+static int sparse_test_write(void *ctx, const void *buf, size_t len, loff_t pos)
+{
+	struct sparse_test_out *out = ctx;
+
+	if (pos + len > SPARSE_TEST_SIZE)
+		return -ENOSPC;
+
+	memcpy(out->buf + pos, buf, len);
+	out->calls++;
+
+	return 0;
+}
+
+static int sparse_test_fill(void *ctx, uint32_t fill_val, uint64_t len,
+			    loff_t pos)
+{
+	struct sparse_test_out *out = ctx;
+	uint64_t i;
+
+	if (pos + len > SPARSE_TEST_SIZE)
+		return -ENOSPC;
+
+	for (i = 0; i < len; i += 4)
+		memcpy(out->buf + pos + i, &fill_val, 4);
+	out->fills++;
+
+	return 0;
+}
+
+static u8 *sparse_test_put_chunk(u8 *p, unsigned int hdr_sz, u16 type,
+				 u32 blocks, u32 payload)
+{
+	struct chunk_header chunk = {
+		.chunk_type = cpu_to_le16(type),
+		.chunk_sz = cpu_to_le32(blocks),
+		.total_sz = cpu_to_le32(hdr_sz + payload),
+	};
+
+	memset(p, 0, hdr_sz);
+	memcpy(p, &chunk, sizeof(chunk));
+
+	return p + hdr_sz;
+}
+
+/*
+ * Build a sparse image with headers of @file_hdr_sz and @chunk_hdr_sz bytes
+ * covering all chunk types. The expanded image goes to @expected, blocks
+ * not covered by the image are left at SPARSE_TEST_UNTOUCHED.
+ */
+static size_t sparse_test_build(u8 *image, u8 *expected,
+				unsigned int file_hdr_sz,
+				unsigned int chunk_hdr_sz)
+{
+	struct sparse_header sparse = {
+		.magic = cpu_to_le32(SPARSE_HEADER_MAGIC),
+		.major_version = cpu_to_le16(1),
+		.file_hdr_sz = cpu_to_le16(file_hdr_sz),
+		.chunk_hdr_sz = cpu_to_le16(chunk_hdr_sz),
+		.blk_sz = cpu_to_le32(SPARSE_TEST_BLK_SZ),
+		.total_blks = cpu_to_le32(SPARSE_TEST_BLKS),
+		.total_chunks = cpu_to_le32(6),
+	};
+	u32 fill = cpu_to_le32(SPARSE_TEST_FILL);
+	u8 *p = image;
+	int i;
+
+	memset(expected, SPARSE_TEST_UNTOUCHED, SPARSE_TEST_SIZE);
+
+	memset(p, 0, file_hdr_sz);
+	memcpy(p, &sparse, sizeof(sparse));
+	p += file_hdr_sz;
+
+	/* blocks 0-1 raw */
+	p = sparse_test_put_chunk(p, chunk_hdr_sz, CHUNK_TYPE_RAW, 2,
+				  2 * SPARSE_TEST_BLK_SZ);
+	for (i = 0; i < 2 * SPARSE_TEST_BLK_SZ; i++)
+		*p++ = expected[i] = i * 13 + 1;
+
+	/* blocks 2-4 filled */
+	p = sparse_test_put_chunk(p, chunk_hdr_sz, CHUNK_TYPE_FILL, 3, 4);
+	memcpy(p, &fill, 4);
+	p += 4;
+	for (i = 2 * SPARSE_TEST_BLK_SZ; i < 5 * SPARSE_TEST_BLK_SZ; i += 4)
+		memcpy(expected + i, &fill, 4);
+
+	/* blocks 5-6 not written */
+	p = sparse_test_put_chunk(p, chunk_hdr_sz, CHUNK_TYPE_DONT_CARE, 2, 0);
+
+	p = sparse_test_put_chunk(p, chunk_hdr_sz, CHUNK_TYPE_CRC32, 0, 4);
+	memset(p, 0xee, 4);
+	p += 4;
+
+	/* block 7 raw, block 8 not written */
+	p = sparse_test_put_chunk(p, chunk_hdr_sz, CHUNK_TYPE_RAW, 1,
+				  SPARSE_TEST_BLK_SZ);
+	for (i = 7 * SPARSE_TEST_BLK_SZ; i < 8 * SPARSE_TEST_BLK_SZ; i++)
+		*p++ = expected[i] = i * 3;
+
+	p = sparse_test_put_chunk(p, chunk_hdr_sz, CHUNK_TYPE_DONT_CARE, 1, 0);
+
+	return p - image;
+}
+
+static int sparse_test_feed(const u8 *image, size_t size, size_t step,
+			    u8 *out, bool fill)
+{
+	struct sparse_test_out ctx = { .buf = out };
+	struct sparse_image_stream *ss;
+	size_t pos, now;
+	int ret = 0;
+
+	memset(out, SPARSE_TEST_UNTOUCHED, SPARSE_TEST_SIZE);
+
+	ss = sparse_image_stream_new(sparse_test_write, &ctx);
+	if (fill)
+		sparse_image_stream_set_fill(ss, sparse_test_fill);
+
+	for (pos = 0; pos < size; pos += now) {
+		now = min(step, size - pos);
+		ret = sparse_image_stream_write(ss, image + pos, now);
+		if (ret)
+			goto out;
+	}
+
+	ret = sparse_image_stream_finish(ss);
+	if (!ret && sparse_image_stream_size(ss) != SPARSE_TEST_SIZE)
+		ret = -EINVAL;
+	/* the fill chunk must not have been expanded */
+	if (!ret && fill && ctx.fills != 1)
+		ret = -EINVAL;
+out:
+	sparse_image_stream_free(ss);
+
+	return ret;
+}
+
+static void test_image_sparse_stream(void)
+{
+	static const size_t steps[] = { 1, 3, 12, 28, 1000, 4096, SIZE_MAX };
+	static const struct {
+		unsigned int file_hdr_sz;
+		unsigned int chunk_hdr_sz;
+	} formats[] = {
+		{ sizeof(struct sparse_header), sizeof(struct chunk_header) },
+		{ sizeof(struct sparse_header) + 4, sizeof(struct chunk_header) + 8 },
+	};
+	u8 *image, *expected, *out;
+	size_t size;
+	int i, j, ret;
+
+	image = malloc(2 * SPARSE_TEST_SIZE);
+	expected = malloc(SPARSE_TEST_SIZE);
+	out = malloc(SPARSE_TEST_SIZE);
+	if (WARN_ON(!image || !expected || !out))
+		goto out;
+
+	for (i = 0; i < ARRAY_SIZE(formats); i++) {
+		size = sparse_test_build(image, expected, formats[i].file_hdr_sz,
+					 formats[i].chunk_hdr_sz);
+
+		for (j = 0; j < ARRAY_SIZE(steps); j++) {
+			total_tests++;
+			ret = sparse_test_feed(image, size, steps[j], out, false);
+			if (ret || memcmp(out, expected, SPARSE_TEST_SIZE)) {
+				printf("format %d, %zu byte pieces: wrong output (%pe)\n",
+				       i, steps[j], ERR_PTR(ret));
+				failed_tests++;
+			}
+		}
+	}
+
+	total_tests++;
+	ret = sparse_test_feed(image, size, 1000, out, true);
+	if (ret || memcmp(out, expected, SPARSE_TEST_SIZE)) {
+		printf("fill callback: wrong output (%pe)\n", ERR_PTR(ret));
+		failed_tests++;
+	}
+
+	size = sparse_test_build(image, expected, sizeof(struct sparse_header),
+				 sizeof(struct chunk_header));
+
+	total_tests++;
+	if (sparse_test_feed(image, size - 1, 100, out, false) != -EINVAL) {
+		printf("truncated image not detected\n");
+		failed_tests++;
+	}
+
+	total_tests++;
+	image[size] = 0;
+	if (sparse_test_feed(image, size + 1, 100, out, false) != -EINVAL) {
+		printf("trailing data not detected\n");
+		failed_tests++;
+	}
+
+	total_tests++;
+	image[0] ^= 1;
+	if (sparse_test_feed(image, size, 100, out, false) != -EINVAL) {
+		printf("bad magic not detected\n");
+		failed_tests++;
+	}
+out:
+	free(image);
+	free(expected);
+	free(out);
+}
+bselftest(core, test_image_sparse_stream);
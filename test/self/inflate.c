@@ -0,0 +1,620 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <common.h>
+#include <bselftest.h>
+#include <clock.h>
+#include <crc.h>
+#include <malloc.h>
+#include <asm/unaligned.h>
+#include <linux/limits.h>
+#include <linux/math64.h>
+#include <linux/sizes.h>
+#include <linux/zlib.h>
+
+BSELFTEST_GLOBALS();
+
+/*
+ * There is no deflate implementation in barebox, so the test data is
+ * compressed here with a minimal greedy LZ77 encoder emitting a single
+ * fixed Huffman block. That is enough to run inflate_fast() through
+ * literals, all match lengths and distances and the window handling.
+ */
+#define LZ_WSIZE	SZ_32K
+#define LZ_HASH_BITS	15
+#define LZ_CHAIN	16
+
+struct bitwriter {
+	u8 *p;
+	u64 acc;
+	unsigned int bits;
+};
+
+static void bw_put(struct bitwriter *bw, u32 val, unsigned int n)
+{
+	bw->acc |= (u64)val << bw->bits;
+	bw->bits += n;
+
+	while (bw->bits >= 8) {
+		*bw->p++ = bw->acc;
+		bw->acc >>= 8;
+		bw->bits -= 8;
+	}
+}
+
+/* Huffman codes are sent starting with the most significant bit */
+static void bw_put_code(struct bitwriter *bw, u32 code, unsigned int n)
+{
+	u32 rev = 0;
+	int i;
+
+	for (i = 0; i < n; i++)
+		rev |= ((code >> i) & 1) << (n - 1 - i);
+
+	bw_put(bw, rev, n);
+}
+
+static void deflate_fixed_litlen(struct bitwriter *bw, unsigned int sym)
+{
+	if (sym < 144)
+		bw_put_code(bw, 0x30 + sym, 8);
+	else if (sym < 256)
+		bw_put_code(bw, 0x190 + sym - 144, 9);
+	else if (sym < 280)
+		bw_put_code(bw, sym - 256, 7);
+	else
+		bw_put_code(bw, 0xc0 + sym - 280, 8);
+}
+
+static const u16 len_base[] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+
+static const u16 dist_base[] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+	8193, 12289, 16385, 24577,
+};
+
+static unsigned int deflate_extra_bits(unsigned int code, bool dist)
+{
+	if (dist)
+		return code < 4 ? 0 : code / 2 - 1;
+
+	return code < 8 || code == 28 ? 0 : code / 4 - 1;
+}
+
+static void deflate_match(struct bitwriter *bw, unsigned int len,
+			  unsigned int dist)
+{
+	int code;
+
+	for (code = ARRAY_SIZE(len_base) - 1; len_base[code] > len; code--)
+		;
+	deflate_fixed_litlen(bw, 257 + code);
+	bw_put(bw, len - len_base[code], deflate_extra_bits(code, false));
+
+	for (code = ARRAY_SIZE(dist_base) - 1; dist_base[code] > dist; code--)
+		;
+	bw_put_code(bw, code, 5);
+	bw_put(bw, dist - dist_base[code], deflate_extra_bits(code, true));
+}
+
+static inline u32 lz_hash(const u8 *p)
+{
+	return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+/* Returns the size of the raw deflate stream, @out needs len * 9 / 8 + 8 */
+static size_t deflate_fixed(const u8 *in, size_t len, u8 *out)
+{
+	struct bitwriter bw = { .p = out };
+	s32 *head, *prev;
+	size_t pos = 0;
+
+	head = malloc(sizeof(*head) << LZ_HASH_BITS);
+	prev = malloc(sizeof(*prev) * LZ_WSIZE);
+	memset(head, 0xff, sizeof(*head) << LZ_HASH_BITS);	/* all -1 */
+
+	bw_put(&bw, 1, 1);	/* BFINAL */
+	bw_put(&bw, 1, 2);	/* BTYPE: fixed Huffman */
+
+	while (pos < len) {
+		unsigned int best_len = 0, best_dist = 0;
+		size_t max = min_t(size_t, len - pos, 258);
+
+		if (max >= 3) {
+			u32 h = lz_hash(in + pos);
+			s32 cand = head[h];
+			int chain;
+
+			for (chain = 0; chain < LZ_CHAIN && cand >= 0 &&
+			     pos - cand <= LZ_WSIZE; chain++) {
+				unsigned int l = 0;
+
+				while (l < max && in[cand + l] == in[pos + l])
+					l++;
+
+				if (l > best_len) {
+					best_len = l;
+					best_dist = pos - cand;
+				}
+
+				cand = prev[cand % LZ_WSIZE];
+			}
+
+			prev[pos % LZ_WSIZE] = head[h];
+			head[h] = pos;
+		}
+
+		if (best_len >= 3) {
+			deflate_match(&bw, best_len, best_dist);
+
+			/* insert the skipped positions into the hash chains */
+			while (--best_len) {
+				pos++;
+				if (len - pos >= 3) {
+					u32 h = lz_hash(in + pos);
+
+					prev[pos % LZ_WSIZE] = head[h];
+					head[h] = pos;
+				}
+			}
+			pos++;
+		} else {
+			deflate_fixed_litlen(&bw, in[pos++]);
+		}
+	}
+
+	deflate_fixed_litlen(&bw, 256);
+	bw_put(&bw, 0, 7);	/* flush */
+
+	free(head);
+	free(prev);
+
+	return bw.p - out;
+}
+
+/*
+ * Test data resembling a kernel image: mostly 32-bit instruction words
+ * built from a few templates with varying register fields, string tables,
+ * repeats of earlier sequences and runs of short patterns as found in
+ * padding and tables.
+ */
+static void inflate_make_corpus(u8 *buf, size_t len)
+{
+	static const u32 insn[] = {
+		0xe92d4ff0, 0xe8bd8ff0, 0xe59f0000, 0xe5900000, 0xe5800000,
+		0xe1a00000, 0xe3a00000, 0xe2800000, 0xe3500000, 0x0a000000,
+		0x1a000000, 0xeb000000, 0xe12fff1e, 0xe0800000, 0xe2400000,
+	};
+	static const char * const words[] = {
+		"barebox", "device", "driver", "probe", "failed", "memory",
+		"partition", "%s: ", "\n", "error", "reset", "clock", "\0",
+	};
+	u32 seed = 0x12345678;
+	size_t pos = 0;
+
+	while (pos < len) {
+		unsigned int r, n, i;
+
+		seed = seed * 1103515245 + 12345;
+		r = seed >> 8;
+
+		switch (r % 20) {
+		case 0 ... 12:	/* instructions */
+			for (n = 4 + r % 12; n && pos + 4 <= len; n--) {
+				u32 w;
+
+				seed = seed * 1103515245 + 12345;
+				w = insn[(seed >> 16) % ARRAY_SIZE(insn)];
+				w |= ((seed >> 4) & 0xf) << 12;
+				w |= (seed >> 12) & ((seed & 1) ? 0xff : 0xf);
+				put_unaligned_le32(w, buf + pos);
+				pos += 4;
+			}
+			break;
+		case 13 ... 15:	/* strings */
+			for (n = 1 + r % 6; n; n--) {
+				const char *w = words[(r >> 8) % ARRAY_SIZE(words)];
+
+				r = r * 7 + 3;
+				for (i = 0; i < strlen(w) + 1 && pos < len; i++)
+					buf[pos++] = w[i];
+			}
+			break;
+		case 16 ... 18:	/* repeat earlier data */
+			n = min_t(size_t, 8 + r % 120, len - pos);
+			i = 1 + (r >> 7) % min_t(size_t, pos ?: 1, LZ_WSIZE);
+			if (i > pos)
+				break;
+			for (; n; n--, pos++)
+				buf[pos] = buf[pos - i];
+			break;
+		default:	/* short period runs */
+			n = min_t(size_t, 16 + r % 300, len - pos);
+			i = 1 + (r >> 9) % 7;
+			if (i > pos)
+				break;
+			for (; n; n--, pos++)
+				buf[pos] = buf[pos - i];
+			break;
+		}
+	}
+}
+
+/*
+ * Inflate @in into @out, offering at most @ichunk bytes of input and
+ * @ochunk bytes of output space per zlib_inflate() call.
+ */
+static int inflate_chunked(struct z_stream_s *strm, const u8 *in, size_t inlen,
+			   u8 *out, size_t outlen, size_t ichunk, size_t ochunk)
+{
+	const u8 *in_end = in + inlen;
+	u8 *out_end = out + outlen;
+	int ret;
+
+	ret = zlib_inflateReset(strm);
+	if (ret != Z_OK)
+		return -EINVAL;
+
+	strm->next_in = in;
+	strm->next_out = out;
+
+	do {
+		strm->avail_in = min_t(size_t, ichunk, in_end - strm->next_in);
+		strm->avail_out = min_t(size_t, ochunk, out_end - strm->next_out);
+
+		ret = zlib_inflate(strm, Z_SYNC_FLUSH);
+	} while (ret == Z_OK);
+
+	if (ret != Z_STREAM_END)
+		return -EILSEQ;
+
+	return strm->next_out - out;
+}
+
+static void test_inflate_one(struct z_stream_s *strm, const u8 *corpus,
+			     size_t len, const u8 *comp, size_t clen,
+			     u8 *out, size_t ichunk, size_t ochunk)
+{
+	int ret;
+
+	total_tests++;
+
+	memset(out, 0, len);
+
+	ret = inflate_chunked(strm, comp, clen, out, len, ichunk, ochunk);
+	if (ret == len && !memcmp(out, corpus, len))
+		return;
+
+	printf("inflate of %zu bytes in chunks of %zu/%zu failed: %d\n",
+	       len, ichunk, ochunk, ret);
+	failed_tests++;
+}
+
+/*
+ * "gzip -9 -n" output of 3000 letters with frequencies decreasing by 5/8
+ * from one to the next, zeros up to 32 KiB and a copy of 250 bytes from
+ * 32 KiB back. Unlike the streams above it has dynamic Huffman codes, some
+ * of them in the second level tables, and a match with the most length
+ * and distance extra bits.
+ */
+static const u8 inflate_test_gzip[] = {
+	0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xed, 0x5d,
+	0xc9, 0x96, 0x1c, 0x37, 0x0c, 0xcb, 0xaf, 0x8a, 0x8b, 0x54, 0x5d, 0x33,
+	0x76, 0x5e, 0x0e, 0xf9, 0xff, 0x00, 0xa0, 0xec, 0x7b, 0x72, 0x0d, 0xf0,
+	0xec, 0xee, 0xae, 0xd2, 0xc6, 0x05, 0x04, 0x75, 0x9b, 0xb5, 0x9e, 0xb5,
+	0x2a, 0x62, 0xc5, 0x02, 0x4e, 0x35, 0xbf, 0x3e, 0x6b, 0x25, 0xbf, 0x13,
+	0x6f, 0x53, 0x3f, 0x3b, 0xa3, 0x30, 0x31, 0x62, 0x1f, 0xcd, 0x8c, 0x55,
+	0x59, 0x18, 0xcc, 0xc8, 0x75, 0x27, 0xaf, 0x7c, 0x4e, 0x66, 0x61, 0x8e,
+	0x36, 0xcc, 0xe4, 0xac, 0xf3, 0x68, 0xe8, 0xa9, 0x68, 0x6c, 0xd4, 0x6b,
+	0xe7, 0x2a, 0xcc, 0x0c, 0x2d, 0x5b, 0xb5, 0x23, 0x6a, 0x6d, 0x9e, 0x11,
+	0x8d, 0x81, 0x47, 0x8f, 0x79, 0x6a, 0x26, 0x54, 0xd2, 0x9a, 0xc4, 0x49,
+	0xeb, 0x68, 0x1b, 0xec, 0x7d, 0x64, 0x29, 0x86, 0x9f, 0xdc, 0x7b, 0x61,
+	0x3a, 0x8e, 0x4c, 0x8c, 0xe6, 0xe6, 0xdb, 0xc2, 0x41, 0xeb, 0xc5, 0x8c,
+	0x1d, 0xbf, 0xcd, 0xe2, 0x64, 0x8c, 0x60, 0xa0, 0x69, 0x99, 0xde, 0xc8,
+	0x87, 0xa2, 0x01, 0x89, 0xd7, 0x9c, 0x08, 0x47, 0xf0, 0x96, 0x53, 0x5b,
+	0x16, 0xae, 0x3c, 0x27, 0xfa, 0x68, 0x29, 0x5e, 0xc0, 0x21, 0x2e, 0xd2,
+	0x27, 0xcc, 0x61, 0x38, 0xb0, 0xc5, 0x5e, 0xd5, 0x45, 0x13, 0xb0, 0x7c,
+	0x37, 0x83, 0x02, 0x6b, 0x75, 0xc0, 0x5e, 0x07, 0x33, 0x7a, 0x2b, 0xb2,
+	0x9f, 0x77, 0x82, 0x81, 0xdf, 0x3b, 0xf3, 0xd1, 0x71, 0x88, 0x35, 0x37,
+	0xcc, 0x50, 0x90, 0x11, 0x87, 0xee, 0xf5, 0x66, 0xd0, 0xf6, 0xee, 0xcf,
+	0xd8, 0x7c, 0xcd, 0x87, 0x6f, 0x5c, 0xdb, 0x95, 0x34, 0x95, 0x16, 0x16,
+	0xdc, 0x19, 0x2f, 0x8a, 0x2f, 0x19, 0x90, 0xc5, 0x5c, 0x60, 0x9f, 0x9c,
+	0xf4, 0xa4, 0xac, 0x85, 0x55, 0x4b, 0xd6, 0x29, 0x7e, 0x30, 0xfe, 0x24,
+	0x6d, 0x8c, 0x79, 0xd0, 0xa2, 0x4a, 0x05, 0x22, 0x11, 0xc3, 0x68, 0x46,
+	0x1d, 0xff, 0x2b, 0xf0, 0x50, 0x4c, 0xf4, 0x16, 0x35, 0xb4, 0x61, 0x9e,
+	0x89, 0x0f, 0xfc, 0xfe, 0x56, 0x0a, 0x14, 0x39, 0x6d, 0x44, 0xe7, 0xf6,
+	0x17, 0xec, 0x4a, 0x6e, 0xa1, 0x6c, 0x72, 0x5c, 0xb6, 0x7e, 0x68, 0x1e,
+	0xa3, 0xf7, 0x1c, 0x4d, 0x3d, 0x30, 0xb9, 0x8b, 0xe9, 0x7a, 0xe8, 0x47,
+	0x9c, 0x31, 0x9d, 0x24, 0xe8, 0x28, 0xf1, 0x4d, 0x67, 0x6e, 0x84, 0x61,
+	0x38, 0x18, 0x7f, 0x45, 0x7e, 0x4e, 0xae, 0x9b, 0x1e, 0xd1, 0x29, 0xf9,
+	0xf8, 0xd1, 0x52, 0x4d, 0xc1, 0xca, 0x85, 0xa8, 0x89, 0x53, 0x58, 0xdc,
+	0xa4, 0xb1, 0xcc, 0xeb, 0x20, 0x45, 0x83, 0xe0, 0x3c, 0x72, 0x0c, 0xc9,
+	0x3b, 0xa1, 0xc8, 0x93, 0xa4, 0xa7, 0x86, 0x9e, 0xbb, 0xee, 0x81, 0x22,
+	0x2e, 0xd8, 0xb2, 0xf3, 0x6e, 0xdd, 0x13, 0x47, 0xcc, 0xc3, 0x9c, 0xc4,
+	0xa9, 0x05, 0xe3, 0x19, 0x86, 0xd9, 0xe3, 0x5d, 0x5f, 0x39, 0x29, 0x7c,
+	0x68, 0xdb, 0x77, 0x9d, 0x1a, 0xe2, 0x4d, 0x0c, 0x5a, 0x4c, 0x63, 0x3d,
+	0x44, 0xa5, 0x2a, 0x63, 0xcd, 0x0f, 0x51, 0xa0, 0x68, 0x23, 0x4d, 0xdb,
+	0xc5, 0xd4, 0x2a, 0xfe, 0x93, 0xf8, 0x64, 0xcd, 0x0d, 0x2f, 0xb9, 0x46,
+	0xa1, 0x1e, 0x32, 0x2c, 0x2e, 0xfa, 0xa9, 0x55, 0xfc, 0xa8, 0x89, 0xb7,
+	0x66, 0xc9, 0x26, 0x7e, 0xd6, 0x7e, 0x6e, 0x96, 0xa7, 0xda, 0x76, 0xb0,
+	0xd4, 0xc8, 0x04, 0xf1, 0xe3, 0x28, 0xc0, 0x7c, 0x51, 0xb2, 0x0d, 0x4f,
+	0x9f, 0x35, 0x95, 0x4a, 0x7a, 0x28, 0x02, 0xf9, 0x8b, 0xef, 0x0d, 0x6f,
+	0x95, 0x99, 0x39, 0x12, 0x14, 0xae, 0x50, 0x95, 0x47, 0x4e, 0x41, 0x25,
+	0x2b, 0x62, 0x73, 0x43, 0xe5, 0x9d, 0x83, 0xcf, 0x35, 0xaf, 0xe2, 0x5b,
+	0x67, 0xb2, 0xd2, 0x17, 0xe3, 0xd3, 0x53, 0xf9, 0x98, 0x44, 0x7e, 0x70,
+	0x0d, 0x6b, 0x89, 0x2b, 0xb9, 0x99, 0x92, 0x94, 0xa9, 0xcc, 0x5e, 0x5d,
+	0x21, 0x21, 0x41, 0xb8, 0x29, 0x51, 0x9a, 0x05, 0xaa, 0x4d, 0x10, 0x70,
+	0xe8, 0x53, 0x24, 0x6d, 0xb6, 0x22, 0x0e, 0x2a, 0x2d, 0xb9, 0xab, 0x3a,
+	0x44, 0x90, 0x58, 0xf1, 0x43, 0xf6, 0xc5, 0xf4, 0x9e, 0xb8, 0x59, 0x39,
+	0x54, 0x39, 0x32, 0x02, 0xdc, 0xfb, 0xa1, 0x7a, 0x1e, 0x45, 0xc3, 0x6e,
+	0x2f, 0x75, 0x4d, 0x07, 0xe7, 0x8f, 0x88, 0x29, 0xb1, 0xe4, 0xe4, 0x33,
+	0xde, 0x83, 0x0c, 0xef, 0xa4, 0x7d, 0xfd, 0x09, 0x93, 0x0f, 0xab, 0x72,
+	0x6a, 0x09, 0x31, 0xb9, 0xa4, 0xe2, 0x5e, 0xe7, 0x96, 0xcd, 0x81, 0x6d,
+	0xac, 0x49, 0x45, 0x33, 0x54, 0x10, 0x74, 0x9c, 0x66, 0x62, 0xaf, 0x24,
+	0xa1, 0x50, 0x17, 0xf9, 0xb3, 0x44, 0x50, 0x14, 0x7f, 0x9e, 0xd1, 0x62,
+	0x4a, 0x0c, 0x0e, 0xe6, 0xba, 0x84, 0x66, 0x46, 0xdf, 0xec, 0x47, 0xe7,
+	0x55, 0x21, 0x32, 0x2a, 0x19, 0x34, 0x56, 0xdd, 0x55, 0x1d, 0xc6, 0x61,
+	0x2b, 0x9c, 0x88, 0x2c, 0x8b, 0x9b, 0xc9, 0x29, 0x69, 0xd5, 0xa8, 0xcf,
+	0x51, 0x58, 0x54, 0x07, 0xb0, 0x8d, 0xf2, 0x1a, 0x5a, 0xca, 0x8c, 0xa2,
+	0xfc, 0x94, 0x66, 0x09, 0x9e, 0xb8, 0x2c, 0x26, 0xca, 0xd4, 0xbb, 0xff,
+	0xd5, 0xb7, 0x1a, 0xf3, 0x4b, 0xd5, 0xc4, 0x84, 0xd6, 0x16, 0xcd, 0x9b,
+	0x3b, 0xcf, 0xbf, 0x35, 0x15, 0xa7, 0x6c, 0xd2, 0x05, 0x66, 0x9a, 0xee,
+	0xad, 0xf5, 0xb5, 0xfe, 0x1e, 0x41, 0x99, 0x0a, 0x3c, 0xb4, 0x2f, 0x98,
+	0xa0, 0x1c, 0xed, 0x7a, 0x44, 0x75, 0x3a, 0xc6, 0xf7, 0xe3, 0x37, 0xfa,
+	0xc2, 0xd3, 0x19, 0xbf, 0xd5, 0x46, 0x96, 0x28, 0x23, 0xcc, 0x3b, 0xdd,
+	0x60, 0xde, 0x6f, 0xaf, 0xc9, 0xd1, 0x23, 0x1e, 0x2d, 0xc7, 0xf7, 0x64,
+	0x57, 0x8f, 0xda, 0x73, 0x07, 0xa9, 0xc6, 0x08, 0x51, 0x50, 0xf7, 0xed,
+	0x67, 0x92, 0xd4, 0x2b, 0xcd, 0xd7, 0x69, 0x45, 0x54, 0x65, 0x4c, 0x2f,
+	0x3e, 0xc9, 0xe9, 0xd4, 0x7b, 0xa5, 0x36, 0x95, 0xc6, 0xe8, 0x71, 0x17,
+	0x9b, 0xa1, 0x3f, 0x6e, 0xa5, 0xe6, 0x72, 0xff, 0xee, 0x99, 0x52, 0x3f,
+	0xf5, 0xd0, 0x29, 0x63, 0xed, 0x0b, 0xb1, 0x39, 0xdd, 0xbb, 0xa5, 0x88,
+	0x14, 0x34, 0x39, 0xaa, 0x1e, 0xb6, 0xa5, 0x6b, 0x2b, 0xdf, 0x71, 0x94,
+	0x16, 0x3f, 0x2a, 0x33, 0x99, 0x2a, 0xa5, 0x2b, 0x34, 0x26, 0x91, 0x5f,
+	0x6d, 0x87, 0x36, 0x97, 0x28, 0x12, 0xb7, 0x44, 0x79, 0x42, 0x7f, 0x31,
+	0x3d, 0x10, 0x38, 0xb9, 0x01, 0xae, 0x71, 0xee, 0x0c, 0x17, 0x9b, 0xdc,
+	0x44, 0xb6, 0x25, 0x21, 0x3d, 0x96, 0x2b, 0xfb, 0xe4, 0x4f, 0x89, 0xa0,
+	0xbc, 0x06, 0xa8, 0x4a, 0x25, 0x50, 0xe8, 0xe5, 0x90, 0x8a, 0xbe, 0xea,
+	0xce, 0x85, 0x6a, 0x71, 0xd3, 0xd4, 0x90, 0x9c, 0xfc, 0xe6, 0x9a, 0xcd,
+	0x02, 0x95, 0x8e, 0xa2, 0x36, 0x1e, 0xf4, 0x90, 0xbc, 0xe2, 0x31, 0xc5,
+	0x34, 0x2e, 0x49, 0xd2, 0x72, 0x5c, 0x5b, 0x87, 0xe4, 0x55, 0xe6, 0x91,
+	0xa9, 0xa3, 0xb6, 0xa6, 0x52, 0x67, 0xa7, 0xef, 0x91, 0xa0, 0x1a, 0x35,
+	0xd8, 0xa3, 0xd8, 0xa3, 0x09, 0xf8, 0xf5, 0x32, 0xdf, 0xef, 0xaf, 0x9e,
+	0x7e, 0xc5, 0xe2, 0x12, 0x15, 0xb6, 0x77, 0xdf, 0x1e, 0x49, 0x19, 0xd8,
+	0xeb, 0xc7, 0x83, 0xd1, 0xb7, 0x66, 0x1a, 0xbe, 0x7e, 0xa0, 0xac, 0x72,
+	0x4b, 0x89, 0xb8, 0x48, 0xeb, 0x5a, 0x95, 0x46, 0x6a, 0xe4, 0xa5, 0x16,
+	0x45, 0x9a, 0x95, 0x72, 0xde, 0x21, 0x06, 0xba, 0x74, 0xbf, 0x9f, 0x49,
+	0x47, 0xb0, 0x97, 0xdd, 0x64, 0xf3, 0xfa, 0xa1, 0x8b, 0xc0, 0xef, 0xc4,
+	0x63, 0x5b, 0xb0, 0xfe, 0x30, 0xbf, 0xcf, 0xa3, 0xc4, 0xd7, 0xc8, 0xf7,
+	0x9a, 0xe2, 0xc4, 0xc7, 0x19, 0x83, 0x25, 0x7c, 0x62, 0x5d, 0xb4, 0x28,
+	0xaa, 0xa3, 0x3f, 0x57, 0x80, 0x47, 0x14, 0xb7, 0xd4, 0x6c, 0xc5, 0x3d,
+	0x65, 0x9a, 0xac, 0x88, 0x15, 0xb7, 0xd3, 0x6b, 0x38, 0x47, 0x16, 0x94,
+	0xb9, 0xcb, 0xd2, 0x44, 0xbb, 0x95, 0x7c, 0xa5, 0x04, 0x78, 0x8a, 0x59,
+	0x6a, 0x15, 0xec, 0x6d, 0xbc, 0x5c, 0x54, 0xea, 0xf2, 0xc0, 0xab, 0xd4,
+	0xaf, 0xf8, 0x7f, 0x4d, 0xbc, 0x0f, 0x85, 0x48, 0x57, 0x31, 0xd2, 0x65,
+	0x7a, 0x0a, 0x17, 0x48, 0x25, 0x9b, 0x3b, 0x85, 0x3c, 0xd1, 0x4d, 0x2c,
+	0xa6, 0x1d, 0x3f, 0x4a, 0x19, 0xae, 0x32, 0x8c, 0x1e, 0xc5, 0xa9, 0x6a,
+	0x14, 0x6d, 0xb3, 0x12, 0x1f, 0xfa, 0x4e, 0x29, 0xa8, 0xd1, 0x27, 0x7c,
+	0x7f, 0x42, 0x42, 0xd5, 0x6c, 0x5b, 0x9a, 0x7b, 0x58, 0xab, 0x3a, 0xaa,
+	0x14, 0x97, 0x43, 0x9b, 0xe7, 0x95, 0x48, 0xba, 0xf9, 0x38, 0xcd, 0x92,
+	0x31, 0x56, 0x9e, 0x5f, 0x5d, 0x06, 0xe4, 0x67, 0x4e, 0x57, 0x54, 0x2b,
+	0xe4, 0x0e, 0xdf, 0x35, 0x4d, 0x4a, 0x24, 0xac, 0x11, 0xaa, 0x75, 0xaf,
+	0x04, 0x73, 0xc7, 0xe2, 0xee, 0x38, 0x1f, 0x5f, 0xcd, 0x3e, 0x75, 0xa6,
+	0x29, 0xad, 0xe9, 0xba, 0xa9, 0x90, 0xb6, 0x2e, 0x81, 0x7c, 0x1a, 0x26,
+	0x84, 0xea, 0x7f, 0xeb, 0x06, 0x1c, 0x7b, 0x38, 0x37, 0xd2, 0x19, 0xd4,
+	0x04, 0x75, 0x65, 0xfa, 0xd4, 0xfb, 0x1d, 0x1a, 0x21, 0x07, 0x3c, 0x82,
+	0x57, 0xb1, 0xd8, 0xeb, 0x77, 0xaf, 0x46, 0x43, 0x59, 0xf5, 0x21, 0xc5,
+	0xe6, 0xa2, 0xb6, 0xa6, 0x8f, 0xb2, 0xe2, 0xce, 0xe5, 0x34, 0x85, 0x6b,
+	0xf4, 0x63, 0x6e, 0x0e, 0xbc, 0xbf, 0xf4, 0x1f, 0x86, 0x61, 0x18, 0x86,
+	0x61, 0x18, 0x86, 0x61, 0x18, 0x86, 0x61, 0x18, 0x86, 0x61, 0x18, 0x86,
+	0x61, 0x18, 0x86, 0x61, 0x18, 0x86, 0x61, 0x18, 0x86, 0x61, 0x18, 0x86,
+	0x61, 0x18, 0x86, 0x61, 0x18, 0x86, 0x61, 0x18, 0x86, 0x61, 0x18, 0x86,
+	0x61, 0x18, 0x86, 0x61, 0x18, 0x86, 0x61, 0x18, 0x86, 0x61, 0x18, 0x86,
+	0x61, 0x18, 0x86, 0x61, 0x18, 0x86, 0x61, 0x18, 0x86, 0x61, 0x18, 0x86,
+	0x61, 0x18, 0x86, 0x61, 0x18, 0x86, 0x61, 0x18, 0x86, 0x61, 0x18, 0x86,
+	0x61, 0x18, 0x86, 0x61, 0x18, 0x86, 0x61, 0x18, 0x86, 0xf1, 0x1f, 0xf1,
+	0xff, 0xfd, 0x9b, 0xf4, 0xff, 0x3e, 0xf7, 0xff, 0x00, 0xf2, 0x74, 0x94,
+	0x69, 0x00, 0x80, 0x00, 0x00,
+};
+/*
+ * A dynamic Huffman block made by hand and checked with zlib: 15-bit
+ * length codes with 5 extra bits followed by 15-bit distance codes with
+ * 13 extra bits, the most input a length/distance pair can take, at all
+ * bit offsets. The literals have codes of 2 to 14 bits.
+ */
+static const u8 inflate_test_worst[] = {
+	0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xed, 0xfd,
+	0x01, 0x90, 0x24, 0x49, 0x92, 0x24, 0x49, 0x02, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xb1, 0xa8, 0x79, 0x64,
+	0xf5, 0xec, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x3c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x3c, 0x22, 0xb1, 0xa8, 0x79, 0x64, 0xf5,
+	0xec, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xfc, 0xf7, 0xfb, 0xda,
+	0xde, 0x57, 0xbf, 0x7d, 0xed, 0xf5, 0xdf, 0x5f, 0xdd, 0xbf, 0xb5, 0xda,
+	0xaa, 0xd5, 0xef, 0xae, 0xff, 0xef, 0xd7, 0xde, 0xfb, 0xb7, 0xdf, 0xdb,
+	0xfd, 0xfd, 0xee, 0xea, 0x5b, 0xf7, 0xde, 0x76, 0xdf, 0x6d, 0xf5, 0xfe,
+	0xdf, 0xad, 0xfd, 0xbf, 0xef, 0x7e, 0xdd, 0x7f, 0xb7, 0xee, 0xbf, 0xbe,
+	0xef, 0xef, 0x7d, 0x77, 0xeb, 0x77, 0xdd, 0xb6, 0xbb, 0x5b, 0x75, 0xbf,
+	0xef, 0xfb, 0xfa, 0xbd, 0xea, 0xab, 0x5b, 0x5d, 0xbd, 0x6d, 0x6d, 0xf5,
+	0x77, 0xdd, 0x57, 0xbd, 0xde, 0xbb, 0xfe, 0xef, 0xbb, 0x6e, 0xb7, 0x6b,
+	0xff, 0xfb, 0xed, 0xb7, 0xff, 0xde, 0xea, 0xaf, 0xef, 0x7f, 0xd7, 0xef,
+	0xff, 0xde, 0x6d, 0xbd, 0xd5, 0xdb, 0xf6, 0xfb, 0xab, 0xfd, 0x7f, 0xdf,
+	0x7a, 0xbf, 0x7f, 0xfb, 0x7b, 0xfb, 0xff, 0x7a, 0xf5, 0xd7, 0x77, 0xbf,
+	0xad, 0xdf, 0xfd, 0xf7, 0xd7, 0x55, 0xbf, 0xef, 0xb7, 0xfb, 0x76, 0xd5,
+	0xdf, 0xfd, 0x5b, 0xdf, 0xaf, 0x57, 0x7f, 0xf5, 0xff, 0xad, 0x7a, 0xfd,
+	0xed, 0xff, 0xfe, 0x6a, 0xbd, 0xfa, 0x7f, 0xbb, 0xad, 0xbf, 0xff, 0xfb,
+	0x5f, 0xdd, 0xff, 0xbb, 0xf7, 0xba, 0x55, 0xff, 0x6f, 0xef, 0xfe, 0xdb,
+	0xb6, 0xdf, 0xdf, 0x76, 0x77, 0x55, 0x57, 0xd7, 0xb7, 0x5f, 0xfb, 0xfa,
+	0xaf, 0xef, 0xff, 0x7d, 0xeb, 0xfe, 0xf5, 0xd7, 0x5f, 0xfb, 0xfb, 0xfe,
+	0x7e, 0xef, 0xb5, 0xde, 0xab, 0xff, 0x7d, 0x77, 0xbf, 0x6d, 0x75, 0xbb,
+	0x56, 0xfd, 0xb6, 0xab, 0xdb, 0xed, 0xbd, 0xb6, 0x76, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0xf0, 0xff, 0xef, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xbf, 0xff, 0xff, 0xce, 0xf8, 0x7f, 0xff, 0xff, 0xf3, 0xff, 0xaf, 0x18,
+	0xfb, 0xff, 0xfe, 0xff, 0xf0, 0xff, 0x8f, 0x79, 0xef, 0xbf, 0xff, 0xef,
+	0xff, 0x9f, 0xff, 0xff, 0x0b, 0xed, 0xfb, 0xfe, 0xdf, 0xf7, 0xff, 0xdf,
+	0xff, 0x7f, 0xe4, 0x7b, 0xff, 0xef, 0xff, 0xfd, 0xbf, 0x7f, 0xff, 0xff,
+	0xf9, 0xff, 0x87, 0x2b, 0xfb, 0xdf, 0x7f, 0xff, 0xfb, 0xbb, 0xff, 0x3f,
+	0xf9, 0xff, 0x27, 0xc0, 0xbf, 0xf7, 0xbf, 0xff, 0xf7, 0xff, 0xfd, 0x7f,
+	0xfd, 0xff, 0xdf, 0xff, 0x1f, 0x26, 0xff, 0xff, 0xed, 0xff, 0xbf, 0xc8,
+	0xfe, 0xfd, 0xff, 0xe1, 0xff, 0x9f, 0x51, 0xfd, 0xf7, 0xff, 0xfe, 0xff,
+	0xe1, 0xff, 0x9f, 0x5c, 0xfe, 0xbf, 0xef, 0xff, 0xfe, 0xff, 0xe3, 0xff,
+	0xff, 0x11, 0xff, 0xdf, 0xee, 0xff, 0xfb, 0xff, 0xcf, 0xff, 0xff, 0x4f,
+	0xf9, 0xf7, 0xfe, 0xfe, 0xbf, 0xbf, 0xff, 0x3f, 0xfb, 0xff, 0x2f, 0xaa,
+	0xdf, 0xbf, 0xfb, 0xdf, 0xbf, 0xf7, 0xff, 0x1f, 0xff, 0xff, 0xcc, 0xfd,
+	0xbf, 0xff, 0xfe, 0xf6, 0x7f, 0xdf, 0xf7, 0xff, 0x3f, 0xff, 0xff, 0x1f,
+	0xfc, 0xff, 0xbf, 0xff, 0xff, 0x20, 0xf0, 0xfe, 0xff, 0xf0, 0xff, 0x4f,
+	0xc1, 0xff, 0xd7, 0xff, 0x1f, 0xfc, 0xff, 0x01, 0xdf, 0xf7, 0xee, 0xff,
+	0x9f, 0xfe, 0xff, 0x7f, 0xe9, 0xbf, 0xf7, 0x7d, 0xff, 0x7f, 0xf9, 0xff,
+	0x77, 0x80, 0xff, 0xf7, 0xef, 0xff, 0xfb, 0xff, 0xee, 0xff, 0x1f, 0xff,
+	0xff, 0xd8, 0xf6, 0xdf, 0xdf, 0xfe, 0xbf, 0xf7, 0xbf, 0xff, 0x3f, 0xff,
+	0xff, 0x1f, 0xe2, 0xf7, 0xfd, 0x7f, 0xfb, 0xff, 0xda, 0xff, 0x5f, 0xfe,
+	0xff, 0xb1, 0xc1, 0xff, 0x3f, 0xfe, 0xff, 0xf1, 0xe5, 0xff, 0xfd, 0xff,
+	0xf1, 0xff, 0xbf, 0x17, 0xed, 0xbf, 0xff, 0xff, 0xfa, 0xff, 0xaf, 0xcf,
+	0xbf, 0xff, 0xfe, 0xef, 0xff, 0xbf, 0xfe, 0xff, 0xb7, 0xb4, 0xfd, 0xfb,
+	0x7f, 0xff, 0x7f, 0xf7, 0xff, 0x4f, 0xb3, 0xdf, 0x7f, 0x7f, 0xbf, 0xff,
+	0xef, 0xff, 0x7f, 0xff, 0xff, 0x81, 0x7f, 0xff, 0xf7, 0xf7, 0xf7, 0xfe,
+	0xfb, 0xff, 0x83, 0xff, 0x3f, 0x71, 0xfc, 0xbf, 0xff, 0xfd, 0xbf, 0xff,
+	0xf7, 0xff, 0xfe, 0x7b, 0xff, 0xff, 0xfe, 0xff, 0x57, 0xec, 0xff, 0xff,
+	0xf9, 0xff, 0x67, 0xd1, 0xff, 0xef, 0xff, 0x6f, 0xff, 0xff, 0x8a, 0xf3,
+	0xff, 0xdd, 0xff, 0xdf, 0xfd, 0xff, 0x43, 0xd9, 0xef, 0xbf, 0xfe, 0xff,
+	0xf5, 0xff, 0x8f, 0x8e, 0xff, 0xf7, 0xf7, 0xf7, 0xfb, 0xff, 0xef, 0xff,
+	0x7f, 0x15, 0xf9, 0xf7, 0xff, 0xde, 0xff, 0xfd, 0xdf, 0xff, 0x3f, 0xfd,
+	0xff, 0xa9, 0xc2, 0xdf, 0xff, 0xfb, 0xbf, 0xfb, 0xbf, 0xff, 0xef, 0xff,
+	0xdf, 0xff, 0xff, 0x6d, 0xf9, 0xff, 0xfb, 0xee, 0xff, 0xdb, 0xff, 0xf7,
+	0xbf, 0xff, 0x3f, 0xf8, 0xff, 0x77, 0xd9, 0xff, 0x7f, 0xff, 0xff, 0xbb,
+	0xc3, 0xff, 0xef, 0xff, 0x6f, 0xff, 0xff, 0x50, 0xfa, 0xff, 0xfe, 0xfb,
+	0xff, 0xa7, 0xff, 0xff, 0x6e, 0xfa, 0xf7, 0xfd, 0xfb, 0xff, 0x97, 0xff,
+	0x7f, 0x79, 0xff, 0xaf, 0xef, 0xbf, 0xff, 0xff, 0xf8, 0xff, 0x2f, 0xec,
+	0xfd, 0xf6, 0x7f, 0xff, 0xfe, 0xff, 0xe0, 0xff, 0x1f, 0xa8, 0xfe, 0xfb,
+	0x7f, 0xf7, 0xff, 0xf6, 0xf7, 0xff, 0xa7, 0xff, 0x7f, 0xd3, 0xf8, 0xbf,
+	0xef, 0xfd, 0xf7, 0xde, 0xef, 0xff, 0x8f, 0xfe, 0xff, 0x63, 0xe4, 0xff,
+	0x2f, 0xfe, 0xff, 0x90, 0xf7, 0xdf, 0xff, 0x1f, 0xfe, 0xff, 0x5d, 0xc6,
+	0x7d, 0xff, 0x7f, 0xfa, 0xff, 0x1f, 0x8a, 0xbf, 0xff, 0xfd, 0xbf, 0xff,
+	0xff, 0xf9, 0xff, 0x7f, 0xe4, 0xff, 0xfe, 0xee, 0xdf, 0xff, 0x3f, 0xff,
+	0xff, 0x39, 0xe1, 0xff, 0x7e, 0xff, 0xef, 0x7d, 0xff, 0x7f, 0xff, 0xff,
+	0x0f, 0x7d, 0xff, 0xd7, 0xff, 0xfe, 0x7e, 0x7f, 0xff, 0xff, 0xfe, 0xff,
+	0x37, 0x7f, 0xff, 0xdf, 0xf7, 0xf6, 0x7f, 0xff, 0xef, 0xfe, 0xff, 0xfb,
+	0xff, 0x3f, 0xc6, 0xff, 0xff, 0xf2, 0xff, 0xbf, 0x97, 0xfe, 0xf7, 0xff,
+	0xf7, 0xff, 0x7f, 0x62, 0xf8, 0xef, 0xbf, 0xff, 0x7f, 0xf9, 0xff, 0x7f,
+	0xa3, 0xff, 0xef, 0xfe, 0xdf, 0xff, 0xdf, 0xfd, 0xff, 0x39, 0xee, 0xf7,
+	0xff, 0xfd, 0xbd, 0xff, 0xff, 0xf8, 0xff, 0xcb, 0xb4, 0xff, 0xf7, 0x7f,
+	0xdf, 0xf6, 0xff, 0x3f, 0xff, 0x7f, 0xb4, 0xfc, 0xfb, 0xb7, 0xab, 0xff,
+	0x7f, 0xfe, 0xff, 0xf7, 0x85, 0xff, 0xef, 0xfd, 0x5f, 0xff, 0xfe, 0xdf,
+	0x7f, 0xff, 0x3f, 0x23, 0x42, 0x31, 0x5c, 0x15, 0xbe, 0x00, 0x00,
+};
+
+/* input/output chunk sizes: one shot, and streaming through the window */
+static const size_t inflate_chunks[][2] = {
+	{ SIZE_MAX, SIZE_MAX },
+	{ SZ_4K, SZ_4K },
+	{ 17, 4093 },
+	{ 4093, 300 },
+	{ 1, 1 },
+};
+
+/* Inflate a gzip file without optional header fields, check the trailer */
+static void test_inflate_gzip(struct z_stream_s *strm, const char *name,
+			      const u8 *gz, size_t size, u8 *out, size_t outlen)
+{
+	u32 crc = get_unaligned_le32(gz + size - 8);
+	size_t len = get_unaligned_le32(gz + size - 4);
+	int i, ret;
+
+	if (WARN_ON(gz[3] || len > outlen))
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(inflate_chunks); i++) {
+		size_t ichunk = inflate_chunks[i][0], ochunk = inflate_chunks[i][1];
+
+		total_tests++;
+
+		memset(out, 0, len);
+
+		ret = inflate_chunked(strm, gz + 10, size - 18, out, len,
+				      ichunk, ochunk);
+		if (ret == len && crc32(0, out, len) == crc)
+			continue;
+
+		printf("inflate of %s in chunks of %zu/%zu failed: %d\n",
+		       name, ichunk, ochunk, ret);
+		failed_tests++;
+	}
+}
+
+static void test_inflate(void)
+{
+	const size_t len = SZ_1M;
+	struct z_stream_s strm = {};
+	u8 *corpus, *comp, *out;
+	size_t clen, size;
+	u64 start, ns;
+	int i, ret;
+
+	corpus = malloc(len);
+	comp = malloc(len * 9 / 8 + 8);
+	out = malloc(len);
+	strm.workspace = malloc(zlib_inflate_workspacesize());
+	if (WARN_ON(!corpus || !comp || !out || !strm.workspace))
+		goto out;
+
+	ret = zlib_inflateInit2(&strm, -MAX_WBITS);
+	if (WARN_ON(ret != Z_OK))
+		goto out;
+
+	inflate_make_corpus(corpus, len);
+
+	/* short streams with the fast path only partially or not at all */
+	for (size = 0; size < 600; size += 7) {
+		size_t c = deflate_fixed(corpus + SZ_4K, size, comp);
+
+		test_inflate_one(&strm, corpus + SZ_4K, size, comp, c,
+				 out, SIZE_MAX, SIZE_MAX);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(inflate_chunks); i++) {
+		/* bytewise streaming is slow, keep it short */
+		size = inflate_chunks[i][0] == 1 ? SZ_16K : len;
+		clen = deflate_fixed(corpus, size, comp);
+
+		test_inflate_one(&strm, corpus, size, comp, clen, out,
+				 inflate_chunks[i][0], inflate_chunks[i][1]);
+	}
+
+	test_inflate_gzip(&strm, "gzip -9 stream", inflate_test_gzip,
+			  sizeof(inflate_test_gzip), out, len);
+	test_inflate_gzip(&strm, "longest codes", inflate_test_worst,
+			  sizeof(inflate_test_worst), out, len);
+
+	/* throughput, for comparing implementations; not checked */
+	clen = deflate_fixed(corpus, len, comp);
+
+	start = get_time_ns();
+	for (i = 0; i < 8; i++)
+		inflate_chunked(&strm, comp, clen, out, len, SIZE_MAX, SIZE_MAX);
+	ns = get_time_ns() - start;
+
+	pr_info("%zu KiB from %zu KiB: %llu MB/s\n", len / SZ_1K, clen / SZ_1K,
+		div64_u64(8ULL * len * 1000, max_t(u64, ns, 1)));
+
+	zlib_inflateEnd(&strm);
+out:
+	free(strm.workspace);
+	free(corpus);
+	free(comp);
+	free(out);
+}
+bselftest(core, test_inflate);
@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <common.h>
+#include <block.h>
+#include <bselftest.h>
+#include <clock.h>
+#include <crc.h>
+#include <disks.h>
+#include <driver.h>
+#include <malloc.h>
+#include <mci.h>
+#include <linux/math64.h>
+#include <linux/sizes.h>
+
+BSELFTEST_GLOBALS();
+
+#define MCI_TEST_SIZE	SZ_16M
+
+/* 4KiB to 4MiB in 512 byte blocks */
+static const blkcnt_t mci_test_req_blocks[] = {
+	8, 128, 1024, 8192,
+};
+
+/*
+ * Read the start of the card with each request size, check that the data
+ * doesn't depend on how it was read and print the throughput. The driver
+ * is called directly, so neither the block cache nor the block layer's
+ * request size limit change the requests, only the host's max_req_size.
+ */
+static void test_mci_read(struct mci *mci)
+{
+	blkcnt_t bufblocks = mci_test_req_blocks[ARRAY_SIZE(mci_test_req_blocks) - 1];
+	struct block_device *blk;
+	sector_t len, block;
+	u32 crc, crc_ref = 0;
+	void *buf;
+	int i;
+
+	blk = cdev_get_block_device(cdev_by_name(mci->cdevname));
+	if (!blk || blk->blockbits != SECTOR_SHIFT) {
+		skipped_tests++;
+		return;
+	}
+
+	/* all request sizes divide the largest one */
+	len = ALIGN_DOWN(min_t(sector_t, blk->num_blocks,
+			       MCI_TEST_SIZE >> SECTOR_SHIFT), bufblocks);
+	if (!len) {
+		skipped_tests++;
+		return;
+	}
+
+	buf = malloc(bufblocks << SECTOR_SHIFT);
+	if (!buf) {
+		skipped_tests++;
+		return;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(mci_test_req_blocks); i++) {
+		blkcnt_t req = mci_test_req_blocks[i];
+		blkcnt_t cmd_blocks = min(req, mci_max_req_blocks(mci, SECTOR_SIZE));
+		u64 ns = 0, start;
+		int ret;
+
+		total_tests++;
+		crc = 0;
+
+		for (block = 0; block < len; block += req) {
+			start = get_time_ns();
+			ret = blk->ops->read(blk, buf, block, req);
+			ns += get_time_ns() - start;
+			if (ret) {
+				failed_tests++;
+				printf("%s: reading %llu blocks at %llu failed: %pe\n",
+				       mci->cdevname, (u64)req, (u64)block,
+				       ERR_PTR(ret));
+				goto out;
+			}
+
+			crc = crc32(crc, buf, req << SECTOR_SHIFT);
+		}
+
+		if (!i) {
+			crc_ref = crc;
+		} else if (crc != crc_ref) {
+			failed_tests++;
+			printf("%s: data read with %llu block requests differs\n",
+			       mci->cdevname, (u64)req);
+		}
+
+		/* multi block reads are always ended with STOP_TRANSMISSION */
+		pr_info("%s: %4llu block requests: %llu x CMD18+CMD12 each, %6llu MB/s\n",
+			mci->cdevname, (u64)req, (u64)DIV_ROUND_UP(req, cmd_blocks),
+			div64_u64((u64)len * SECTOR_SIZE * 1000, max_t(u64, ns, 1)));
+	}
+out:
+	free(buf);
+}
+
+static void test_mci(void)
+{
+	struct mci *mci;
+
+	for_each_mci(mci) {
+		/* don't probe cards here, "detect" them first */
+		if (!mci->ready_for_use) {
+			skipped_tests++;
+			continue;
+		}
+
+		test_mci_read(mci);
+	}
+}
+bselftest(core, test_mci);
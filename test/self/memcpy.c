@@ -0,0 +1,268 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <common.h>
+#include <bselftest.h>
+#include <clock.h>
+#include <malloc.h>
+#include <string.h>
+#include <linux/math64.h>
+#include <linux/sizes.h>
+
+BSELFTEST_GLOBALS();
+
+/*
+ * All buffers are checked for the whole length, so a routine writing
+ * outside of [dest, dest + len) is caught by the guard area around it.
+ */
+#define MEM_GUARD	64
+#define MEM_BUFSIZE	(SZ_2K + 2 * MEM_GUARD)
+
+static const size_t mem_test_lens[] = {
+	/* 0..300 are all tested, these are added on top */
+	511, 512, 513, 1023, 1024, 1025, 1500, 2047, 2048,
+};
+
+static inline u8 mem_pattern(size_t i)
+{
+	return (i * 13 + 7) ^ (i >> 8);
+}
+
+static void mem_fill(u8 *buf, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = mem_pattern(i);
+}
+
+static bool mem_check(const char *func, const u8 *buf, const u8 *ref,
+		      size_t len, size_t soff, size_t doff)
+{
+	size_t i;
+
+	for (i = 0; i < MEM_BUFSIZE; i++) {
+		if (buf[i] == ref[i])
+			continue;
+
+		printf("%s(len=%zu, src+%zu, dest+%zu): mismatch at byte %zd: 0x%02x != 0x%02x\n",
+		       func, len, soff, doff, (ssize_t)i - MEM_GUARD, buf[i], ref[i]);
+		failed_tests++;
+		return false;
+	}
+
+	return true;
+}
+
+/* byte-wise references, written so the compiler can't turn them into calls */
+static void mem_ref_move(volatile u8 *dest, volatile const u8 *src, size_t len)
+{
+	size_t i;
+
+	if (dest <= src) {
+		for (i = 0; i < len; i++)
+			dest[i] = src[i];
+	} else {
+		for (i = len; i > 0; i--)
+			dest[i - 1] = src[i - 1];
+	}
+}
+
+static void mem_ref_set(volatile u8 *s, u8 c, size_t len)
+{
+	while (len--)
+		*s++ = c;
+}
+
+static size_t mem_next_len(size_t len)
+{
+	int i;
+
+	if (len < 300)
+		return len + 1;
+
+	for (i = 0; i < ARRAY_SIZE(mem_test_lens); i++)
+		if (mem_test_lens[i] > len)
+			return mem_test_lens[i];
+
+	return 0;
+}
+
+static bool test_memcpy_one(u8 *buf, u8 *ref, const u8 *src,
+			    size_t len, size_t soff, size_t doff)
+{
+	void *ret;
+
+	memset(buf, 0xa5, MEM_BUFSIZE);
+	mem_ref_set(ref, 0xa5, MEM_BUFSIZE);
+
+	ret = memcpy(buf + MEM_GUARD + doff, src + soff, len);
+	mem_ref_move(ref + MEM_GUARD + doff, src + soff, len);
+
+	if (ret != buf + MEM_GUARD + doff) {
+		printf("memcpy(len=%zu): wrong return value\n", len);
+		failed_tests++;
+		return false;
+	}
+
+	return mem_check("memcpy", buf, ref, len, soff, doff);
+}
+
+static bool test_memset_one(u8 *buf, u8 *ref, size_t len, size_t doff)
+{
+	u8 c = len + doff;
+	void *ret;
+
+	mem_fill(buf, MEM_BUFSIZE);
+	mem_fill(ref, MEM_BUFSIZE);
+
+	ret = memset(buf + MEM_GUARD + doff, c, len);
+	mem_ref_set(ref + MEM_GUARD + doff, c, len);
+
+	if (ret != buf + MEM_GUARD + doff) {
+		printf("memset(len=%zu): wrong return value\n", len);
+		failed_tests++;
+		return false;
+	}
+
+	return mem_check("memset", buf, ref, len, 0, doff);
+}
+
+static bool test_memmove_one(u8 *buf, u8 *ref, size_t len,
+			     size_t soff, size_t doff)
+{
+	void *ret;
+
+	if (max(soff, doff) + len > MEM_BUFSIZE - 2 * MEM_GUARD)
+		return true;
+
+	mem_fill(buf, MEM_BUFSIZE);
+	mem_fill(ref, MEM_BUFSIZE);
+
+	ret = memmove(buf + MEM_GUARD + doff, buf + MEM_GUARD + soff, len);
+	mem_ref_move(ref + MEM_GUARD + doff, ref + MEM_GUARD + soff, len);
+
+	if (ret != buf + MEM_GUARD + doff) {
+		printf("memmove(len=%zu): wrong return value\n", len);
+		failed_tests++;
+		return false;
+	}
+
+	return mem_check("memmove", buf, ref, len, soff, doff);
+}
+
+static void test_mem_functions(void)
+{
+	/* distances between overlapping source and destination */
+	static const int deltas[] = {
+		1, 3, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 129,
+	};
+	u8 *buf, *ref, *src;
+	size_t len, soff, doff;
+	int i;
+
+	buf = malloc(MEM_BUFSIZE);
+	ref = malloc(MEM_BUFSIZE);
+	src = malloc(MEM_BUFSIZE);
+	if (WARN_ON(!buf || !ref || !src))
+		goto out;
+
+	for (i = 0; i < MEM_BUFSIZE; i++)
+		src[i] = ~mem_pattern(i);
+
+	len = 0;
+	do {
+		/* one test each for memcpy, memset and memmove per length */
+		total_tests += 3;
+
+		for (soff = 0; soff < 16; soff++)
+			for (doff = 0; doff < 16; doff++)
+				if (!test_memcpy_one(buf, ref, src, len, soff, doff))
+					goto out;
+
+		for (doff = 0; doff < 16; doff++)
+			if (!test_memset_one(buf, ref, len, doff))
+				goto out;
+
+		for (soff = 0; soff < 8; soff++) {
+			for (i = 0; i < ARRAY_SIZE(deltas); i++) {
+				doff = soff + deltas[i];
+
+				/* dest above and below src */
+				if (!test_memmove_one(buf, ref, len, soff, doff) ||
+				    !test_memmove_one(buf, ref, len, doff, soff))
+					goto out;
+			}
+		}
+	} while ((len = mem_next_len(len)));
+
+out:
+	free(buf);
+	free(ref);
+	free(src);
+}
+
+/*
+ * Throughput of the string functions, for comparing implementations.
+ * Results are printed and not checked. barrier_data() keeps the compiler
+ * from dropping stores that are never read back.
+ */
+static void mem_bench_print(const char *func, size_t size, u64 bytes, u64 ns)
+{
+	pr_info("%-8s %7zu bytes: %6llu MB/s\n", func, size,
+		div64_u64(bytes * 1000, max_t(u64, ns, 1)));
+}
+
+static void test_mem_benchmark(void)
+{
+	static const size_t sizes[] = { 64, SZ_4K, SZ_1M };
+	const u64 total = SZ_16M;
+	u8 *dst, *src;
+	u64 start, n;
+	int i;
+
+	dst = malloc(SZ_1M + 64);
+	src = malloc(SZ_1M + 64);
+	if (WARN_ON(!dst || !src))
+		goto out;
+
+	memset(src, 0x5a, SZ_1M + 64);
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		size_t size = sizes[i];
+		u64 loops = div64_u64(total, size);
+
+		start = get_time_ns();
+		for (n = 0; n < loops; n++) {
+			memcpy(dst, src, size);
+			barrier_data(dst);
+		}
+		mem_bench_print("memcpy", size, total, get_time_ns() - start);
+
+		start = get_time_ns();
+		for (n = 0; n < loops; n++) {
+			memset(dst, n, size);
+			barrier_data(dst);
+		}
+		mem_bench_print("memset", size, total, get_time_ns() - start);
+
+		start = get_time_ns();
+		for (n = 0; n < loops; n++) {
+			memmove(dst + 64, dst, size);
+			barrier_data(dst);
+		}
+		mem_bench_print("memmove", size, total, get_time_ns() - start);
+	}
+
+out:
+	free(dst);
+	free(src);
+}
+
+static void test_memcpy(void)
+{
+	test_mem_functions();
+	test_mem_benchmark();
+}
+bselftest(core, test_memcpy);
@@ -0,0 +1,213 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <common.h>
+#include <bselftest.h>
+#include <driver.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <param.h>
+#include <stdlib.h>
+#include <linux/mtd/mtd.h>
+#include <linux/sizes.h>
+#include <mtd/nandsim.h>
+
+BSELFTEST_GLOBALS();
+
+#define NANDSIM_TEST_PAGES	16
+#define NANDSIM_TEST_BLOCKS	16
+#define NANDSIM_TEST_FACTORY_BAD	3
+#define NANDSIM_TEST_MARKED_BAD		5
+/* written through the bad block aware device, skipping the bad blocks */
+#define NANDSIM_TEST_DATA_BLOCKS	8
+
+static void nandsim_test_fail(const char *fmt, ...)
+{
+	va_list args;
+
+	failed_tests++;
+
+	va_start(args, fmt);
+	vprintf(fmt, args);
+	va_end(args);
+}
+
+/* both the factory marked and a block marked bad later must be skipped */
+static void test_nandsim_badblocks(struct mtd_info *mtd)
+{
+	loff_t bad = NANDSIM_TEST_MARKED_BAD * mtd->erasesize;
+	struct mtd_oob_ops ops = {
+		.mode = MTD_OPS_RAW,
+		.ooblen = 2,
+	};
+	u8 bbm[2];
+	int ret;
+
+	total_tests++;
+	if (mtd_block_isbad(mtd, NANDSIM_TEST_FACTORY_BAD * mtd->erasesize) != 1)
+		nandsim_test_fail("%s: factory bad block not detected\n",
+				  mtd->cdev.name);
+
+	total_tests++;
+	if (mtd_block_isbad(mtd, bad))
+		nandsim_test_fail("%s: block %u bad before marking it\n",
+				  mtd->cdev.name, NANDSIM_TEST_MARKED_BAD);
+
+	total_tests++;
+	ret = mtd_block_markbad(mtd, bad);
+	if (ret) {
+		nandsim_test_fail("%s: marking block %u bad failed: %pe\n",
+				  mtd->cdev.name, NANDSIM_TEST_MARKED_BAD,
+				  ERR_PTR(ret));
+		return;
+	}
+
+	total_tests++;
+	if (mtd_block_isbad(mtd, bad) != 1)
+		nandsim_test_fail("%s: marked block %u not bad\n",
+				  mtd->cdev.name, NANDSIM_TEST_MARKED_BAD);
+
+	/* the marker must have been programmed to the chip */
+	total_tests++;
+	ops.oobbuf = bbm;
+	ret = mtd_read_oob(mtd, bad, &ops);
+	if (ret < 0)
+		nandsim_test_fail("%s: reading OOB of block %u failed: %pe\n",
+				  mtd->cdev.name, NANDSIM_TEST_MARKED_BAD,
+				  ERR_PTR(ret));
+	else if (bbm[0] == 0xff)
+		nandsim_test_fail("%s: no bad block marker in block %u\n",
+				  mtd->cdev.name, NANDSIM_TEST_MARKED_BAD);
+}
+
+/*
+ * Write through the bad block aware device and read it back with bitflips
+ * injected. The ECC corrects them, which must not fail the read.
+ */
+static void test_nandsim_bitflips(struct mtd_info *mtd, struct device *dev,
+				  unsigned int ecc_bits)
+{
+	size_t len = NANDSIM_TEST_DATA_BLOCKS * mtd->erasesize;
+	unsigned int corrected = mtd->ecc_stats.corrected;
+	u8 *buf, *rbuf;
+	size_t retlen;
+	ssize_t ret;
+	int i;
+
+	buf = malloc(len);
+	rbuf = malloc(len);
+	if (!buf || !rbuf) {
+		skipped_tests++;
+		goto out;
+	}
+
+	for (i = 0; i < len; i++)
+		buf[i] = random32();
+
+	/* the bad block aware device writes sequentially, from open to close */
+	total_tests++;
+	ret = cdev_open(mtd->cdev_bb, O_WRONLY);
+	if (!ret) {
+		ret = cdev_write(mtd->cdev_bb, buf, len, 0, 0);
+		cdev_close(mtd->cdev_bb);
+	}
+	if (ret != len) {
+		nandsim_test_fail("%s: writing %zu bytes failed: %pe\n",
+				  mtd->cdev_bb->name, len,
+				  ERR_PTR(ret < 0 ? ret : -EIO));
+		goto out;
+	}
+
+	/* the bad blocks were skipped, the data behind them is moved */
+	total_tests++;
+	ret = mtd_read(mtd, (NANDSIM_TEST_FACTORY_BAD + 1) * mtd->erasesize,
+		       mtd->erasesize, &retlen, rbuf);
+	if (ret < 0 || memcmp(rbuf, buf + NANDSIM_TEST_FACTORY_BAD * mtd->erasesize,
+			      mtd->erasesize))
+		nandsim_test_fail("%s: bad block %u not skipped\n",
+				  mtd->cdev_bb->name, NANDSIM_TEST_FACTORY_BAD);
+
+	dev_set_param(dev, "bitflips", ecc_bits == 1 ? "1" : "2");
+	/* report every corrected bitflip as -EUCLEAN */
+	mtd->bitflip_threshold = 1;
+
+	total_tests++;
+	ret = mtd_read(mtd, 0, mtd->writesize, &retlen, rbuf);
+	if (ret != -EUCLEAN)
+		nandsim_test_fail("%s: reading a page with bitflips returned %pe\n",
+				  mtd->cdev.name, ERR_PTR(ret));
+
+	total_tests++;
+	memset(rbuf, 0, len);
+	ret = cdev_open(mtd->cdev_bb, O_RDONLY);
+	if (!ret) {
+		ret = cdev_read(mtd->cdev_bb, rbuf, len, 0, 0);
+		cdev_close(mtd->cdev_bb);
+	}
+	if (ret != len) {
+		nandsim_test_fail("%s: reading %zu bytes with bitflips failed: %pe\n",
+				  mtd->cdev_bb->name, len,
+				  ERR_PTR(ret < 0 ? ret : -EIO));
+	} else if (memcmp(rbuf, buf, len)) {
+		nandsim_test_fail("%s: bitflips not corrected\n",
+				  mtd->cdev_bb->name);
+	}
+
+	total_tests++;
+	if (mtd->ecc_stats.corrected == corrected)
+		nandsim_test_fail("%s: no corrected bitflips counted\n",
+				  mtd->cdev.name);
+
+	dev_set_param(dev, "bitflips", "0");
+out:
+	free(rbuf);
+	free(buf);
+}
+
+static void test_nandsim_ecc(unsigned int ecc_bits)
+{
+	struct nandsim *ns;
+	struct mtd_info *mtd;
+	struct device *dev;
+	int ret;
+
+	ns = nandsim_create(SZ_2K, 64, NANDSIM_TEST_PAGES, NANDSIM_TEST_BLOCKS,
+			    ecc_bits);
+	if (IS_ERR(ns)) {
+		skipped_tests++;
+		return;
+	}
+
+	nandsim_mark_bad(ns, NANDSIM_TEST_FACTORY_BAD);
+
+	ret = nandsim_register(ns);
+	if (ret) {
+		failed_tests++;
+		printf("registering nandsim failed: %pe\n", ERR_PTR(ret));
+		nandsim_free(ns);
+		return;
+	}
+
+	mtd = nandsim_mtd(ns);
+	dev = mtd->dev.parent;
+
+	/* no need to simulate the timing */
+	dev_set_param(dev, "tR", "0");
+	dev_set_param(dev, "tPROG", "0");
+	dev_set_param(dev, "tBERS", "0");
+	dev_set_param(dev, "tRC", "0");
+
+	test_nandsim_badblocks(mtd);
+	test_nandsim_bitflips(mtd, dev, ecc_bits);
+
+	nandsim_unregister(ns);
+}
+
+static void test_nandsim(void)
+{
+	/* Hamming and BCH */
+	test_nandsim_ecc(1);
+	test_nandsim_ecc(4);
+}
+bselftest(core, test_nandsim);
@@ -51,6 +51,243 @@ static inline int get_file_count(int i)
 	return i + 1;
 }
 
+#define RAMFS_EXTENT_SIZE	SZ_1M
+#define RAMFS_EXTENT_WRITE	1000
+
+/*
+ * A file written in small pieces must still be mappable and
+ * truncating it down and up again must not reveal old content.
+ */
+static void test_ramfs_extents(const char *fname)
+{
+	char *buf, *map;
+	int fd, i, ret;
+	bool ok;
+
+	buf = malloc(RAMFS_EXTENT_SIZE);
+	if (WARN_ON(!buf))
+		return;
+
+	for (i = 0; i < RAMFS_EXTENT_SIZE; i++)
+		buf[i] = i % 251;
+
+	fd = open(fname, O_RDWR | O_CREAT);
+	if (!expect_success(fd, "creating file"))
+		goto out;
+
+	for (i = 0; i < RAMFS_EXTENT_SIZE; i += RAMFS_EXTENT_WRITE) {
+		ret = write(fd, buf + i,
+			    min(RAMFS_EXTENT_WRITE, RAMFS_EXTENT_SIZE - i));
+		if (!expect_success(ret, "writing file in pieces"))
+			break;
+	}
+	close(fd);
+
+	fd = open(fname, O_RDONLY);
+	if (!expect_success(fd, "opening file"))
+		goto out;
+
+	map = memmap(fd, PROT_READ);
+	if (expect_success(map == MAP_FAILED ? -errno : 0, "memmap()"))
+		expect_success(memcmp(map, buf, RAMFS_EXTENT_SIZE) ? -EILSEQ : 0,
+			       "memmap() content");
+	close(fd);
+
+	fd = open(fname, O_RDWR);
+	if (!expect_success(fd, "opening file"))
+		goto out;
+
+	ret = ftruncate(fd, 100);
+	expect_success(ret, "truncating file down");
+	ret = ftruncate(fd, SZ_4K);
+	expect_success(ret, "truncating file up");
+
+	ret = pread(fd, buf, SZ_4K, 0);
+	expect_success(ret == SZ_4K ? 0 : -EIO, "reading truncated file");
+
+	ok = true;
+	for (i = 0; i < SZ_4K; i++)
+		if (buf[i] != (i < 100 ? i % 251 : 0))
+			ok = false;
+	expect_success(ok ? 0 : -EILSEQ, "truncated file content");
+
+	close(fd);
+	unlink(fname);
+out:
+	free(buf);
+}
+
+#define RAMFS_FRAG_SIZE		SZ_2M
+#define RAMFS_FRAG_GROW		SZ_512K
+#define RAMFS_HOG_SIZE		SZ_1M
+
+struct ramfs_hog {
+	struct ramfs_hog *next;
+	size_t size;
+};
+
+/* use up the malloc pool */
+static struct ramfs_hog *ramfs_hog_memory(void)
+{
+	struct ramfs_hog *hogs = NULL, *hog;
+	size_t size = RAMFS_HOG_SIZE;
+
+	while (size >= sizeof(*hog)) {
+		hog = malloc(size);
+		if (!hog) {
+			size /= 2;
+			continue;
+		}
+
+		hog->next = hogs;
+		hog->size = size;
+		hogs = hog;
+	}
+
+	return hogs;
+}
+
+/*
+ * Free a single hog not adjacent to the extent at @map, so the extent
+ * can neither be grown in place nor moved, but a new one fits.
+ */
+static bool ramfs_free_hog(struct ramfs_hog **hogs, const char *map,
+			   size_t size)
+{
+	struct ramfs_hog **p, *hog;
+
+	for (p = hogs; (hog = *p); p = &hog->next) {
+		const char *start = (const char *)hog;
+
+		if (hog->size != RAMFS_HOG_SIZE)
+			continue;
+		if (start + hog->size + SZ_4K > map && start < map + size + SZ_4K)
+			continue;
+
+		*p = hog->next;
+		free(hog);
+
+		return true;
+	}
+
+	return false;
+}
+
+static void ramfs_free_hogs(struct ramfs_hog *hogs)
+{
+	struct ramfs_hog *hog;
+
+	while ((hog = hogs)) {
+		hogs = hog->next;
+		free(hog);
+	}
+}
+
+/*
+ * With fragmented memory a growing file is stored in several extents.
+ * Overwriting and truncating across extents must work and mapping the
+ * file must merge them without losing data.
+ */
+static void test_ramfs_fragmented(const char *fname)
+{
+	const size_t size = RAMFS_FRAG_SIZE + RAMFS_FRAG_GROW;
+	struct ramfs_hog *hogs = NULL;
+	char *ref, *data, *map;
+	int fd, i, ret;
+	bool hole;
+
+	if (IS_ENABLED(CONFIG_MALLOC_LIBC)) {
+		skipped_tests++;
+		return;
+	}
+
+	ref = malloc(size);
+	data = malloc(SZ_64K);
+	if (WARN_ON(!ref || !data))
+		goto out;
+
+	for (i = 0; i < size; i++)
+		ref[i] = i % 251;
+	for (i = 0; i < SZ_64K; i++)
+		data[i] = i % 241 ^ 0x5a;
+
+	fd = open(fname, O_RDWR | O_CREAT);
+	if (!expect_success(fd, "creating file"))
+		goto out;
+
+	ret = ftruncate(fd, RAMFS_FRAG_SIZE);
+	expect_success(ret, "sizing file");
+	ret = pwrite(fd, ref, RAMFS_FRAG_SIZE, 0);
+	expect_success(ret == RAMFS_FRAG_SIZE ? 0 : -EIO, "writing file");
+
+	map = memmap(fd, PROT_READ);
+	if (!expect_success(map == MAP_FAILED ? -errno : 0, "memmap()"))
+		goto out_close;
+
+	hogs = ramfs_hog_memory();
+	hole = ramfs_free_hog(&hogs, map, RAMFS_FRAG_SIZE);
+
+	/* only the hole is left, the file has to grow into a second extent */
+	ret = pwrite(fd, ref + RAMFS_FRAG_SIZE, RAMFS_FRAG_GROW, RAMFS_FRAG_SIZE);
+	if (ret != RAMFS_FRAG_GROW)
+		ret = ret < 0 ? ret : -EIO;
+
+	/* overwrite across both extents */
+	if (ret >= 0)
+		ret = pwrite(fd, data, SZ_64K, RAMFS_FRAG_SIZE - SZ_32K);
+	memcpy(ref + RAMFS_FRAG_SIZE - SZ_32K, data, SZ_64K);
+
+	/* drop the second extent, growing again needs a new one */
+	if (ret >= 0)
+		ret = ftruncate(fd, RAMFS_FRAG_SIZE - 100);
+	if (ret >= 0)
+		ret = ftruncate(fd, size);
+	memset(ref + RAMFS_FRAG_SIZE - 100, 0, RAMFS_FRAG_GROW + 100);
+
+	if (ret >= 0)
+		ret = pwrite(fd, data, SZ_4K, RAMFS_FRAG_SIZE);
+	memcpy(ref + RAMFS_FRAG_SIZE, data, SZ_4K);
+
+	/* truncate within the second extent and up again */
+	if (ret >= 0)
+		ret = ftruncate(fd, RAMFS_FRAG_SIZE + 100);
+	if (ret >= 0)
+		ret = ftruncate(fd, size);
+	memset(ref + RAMFS_FRAG_SIZE + 100, 0, RAMFS_FRAG_GROW - 100);
+
+	ramfs_free_hogs(hogs);
+
+	if (!hole) {
+		skipped_tests++;
+		goto out_close;
+	}
+
+	expect_success(ret, "modifying fragmented file");
+
+	close(fd);
+
+	fd = open(fname, O_RDONLY);
+	if (!expect_success(fd, "opening file"))
+		goto out;
+
+	ret = pread(fd, data, SZ_64K, RAMFS_FRAG_SIZE - SZ_32K);
+	expect_success(ret == SZ_64K ? 0 : -EIO, "reading across extents");
+	expect_success(memcmp(data, ref + RAMFS_FRAG_SIZE - SZ_32K, SZ_64K) ?
+		       -EILSEQ : 0, "content across extents");
+
+	map = memmap(fd, PROT_READ);
+	if (expect_success(map == MAP_FAILED ? -errno : 0, "memmap() merged"))
+		expect_success(memcmp(map, ref, size) ? -EILSEQ : 0,
+			       "merged content");
+
+out_close:
+	close(fd);
+	unlink(fname);
+out:
+	free(data);
+	free(ref);
+}
+
 static void test_ramfs(void)
 {
 	int files[] = { 1, 3, 5, 7, 11, 13, 17 };
@@ -200,6 +437,9 @@ static void test_ramfs(void)
 		free(buf);
 	}
 
+	test_ramfs_extents("extents");
+	test_ramfs_fragmented("fragmented");
+
 out:
 	popd(oldpwd);
 	free(content);
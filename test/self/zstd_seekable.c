@@ -0,0 +1,550 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <common.h>
+#include <bselftest.h>
+#include <driver.h>
+#include <fcntl.h>
+#include <libfile.h>
+#include <malloc.h>
+#include <uncompress.h>
+#include <unistd.h>
+#include <zstd_seekable.h>
+#include <linux/sizes.h>
+
+BSELFTEST_GLOBALS();
+
+#define ZSTD_TEST_FILE	"/zstd-seekable-test.zst"
+#define ZSTD_TEST_SIZE	16384
+
+/*
+ * zstd_seekable_make_corpus() output in six frames of 4096, 1, 0, 5000,
+ * 3000 and 4287 bytes, each compressed with "zstd -19 -C", followed by
+ * a seek table with checksums.
+ */
+static const u8 zstd_seekable_test[] = {
+	0x28, 0xb5, 0x2f, 0xfd, 0x04, 0x68, 0x95, 0x13, 0x00, 0xc2, 0x45, 0x12,
+	0x11, 0x90, 0x7d, 0x64, 0xd0, 0x64, 0xe2, 0x84, 0x71, 0x37, 0x91, 0x87,
+	0x1d, 0x0d, 0xce, 0xd7, 0x2d, 0x15, 0xee, 0xee, 0xee, 0xee, 0xee, 0xae,
+	0xeb, 0x6a, 0x57, 0x2d, 0x77, 0x67, 0x19, 0x6f, 0x7f, 0x7f, 0xa6, 0xda,
+	0xfd, 0x36, 0xd5, 0x75, 0x9f, 0xd0, 0x31, 0x85, 0x0c, 0x11, 0xc0, 0xe7,
+	0x86, 0x9d, 0xab, 0xdf, 0x9e, 0x9a, 0xf0, 0x69, 0x85, 0x19, 0xe6, 0xab,
+	0xec, 0xfb, 0x37, 0xb9, 0x54, 0x6c, 0x0d, 0x63, 0x97, 0x6b, 0xbd, 0xef,
+	0x01, 0x81, 0x1a, 0xa8, 0x91, 0x33, 0xa9, 0x64, 0xaf, 0x39, 0x21, 0x08,
+	0x01, 0x44, 0x81, 0x28, 0x84, 0x6c, 0x1d, 0x12, 0xe8, 0x60, 0x08, 0x90,
+	0x08, 0x0c, 0x13, 0x30, 0x05, 0x9c, 0xc0, 0x13, 0x28, 0x20, 0x71, 0x49,
+	0x52, 0xac, 0xcc, 0x01, 0x87, 0x4b, 0x01, 0x66, 0x12, 0x97, 0x86, 0x30,
+	0x97, 0x8b, 0x96, 0x67, 0x7e, 0x7a, 0x5d, 0x20, 0x75, 0xb6, 0xfa, 0x09,
+	0x93, 0x98, 0x59, 0x4b, 0x24, 0x37, 0xf7, 0x25, 0x7b, 0x2d, 0x16, 0x5a,
+	0x41, 0xab, 0x53, 0x02, 0x9b, 0x91, 0x58, 0xd6, 0xf1, 0xf5, 0xe7, 0x63,
+	0xa9, 0x16, 0xf0, 0x51, 0xda, 0x3e, 0x44, 0xcf, 0x57, 0xfc, 0xa8, 0xd2,
+	0x53, 0xf7, 0x94, 0xca, 0x22, 0x42, 0xb7, 0x84, 0x1f, 0xc8, 0x62, 0x98,
+	0x39, 0x06, 0x6e, 0x4b, 0xad, 0x5b, 0xbd, 0xb0, 0x6f, 0x27, 0xf3, 0x48,
+	0x16, 0x21, 0x06, 0x14, 0x4b, 0x9f, 0xa9, 0x65, 0xe1, 0x03, 0x27, 0x48,
+	0x74, 0xca, 0x91, 0x13, 0x45, 0x7e, 0x0d, 0x99, 0x84, 0xa7, 0x7a, 0x67,
+	0x02, 0x0c, 0xca, 0xa9, 0xfc, 0x14, 0x36, 0x0d, 0x5d, 0x72, 0x61, 0x73,
+	0x28, 0x40, 0x50, 0x95, 0x70, 0xa7, 0xa5, 0x97, 0x9f, 0x30, 0xe2, 0x03,
+	0x25, 0x01, 0x65, 0xde, 0x73, 0x9a, 0x12, 0xc7, 0xab, 0xf3, 0x2b, 0xd1,
+	0xa7, 0xd0, 0x7a, 0xf2, 0x3e, 0xb8, 0x86, 0xaa, 0x2c, 0x71, 0xd6, 0xcf,
+	0x9c, 0x98, 0x9d, 0x17, 0x76, 0x4e, 0xd2, 0xf2, 0xde, 0x89, 0x32, 0xd8,
+	0x02, 0x68, 0x40, 0x91, 0x4c, 0x9d, 0xe4, 0x96, 0xb5, 0xf3, 0xd3, 0x19,
+	0xde, 0x7d, 0x10, 0xdb, 0x1c, 0xbe, 0x85, 0xda, 0x0b, 0xf8, 0x5a, 0x7f,
+	0x26, 0xf9, 0xd7, 0x42, 0xbf, 0x9e, 0x53, 0x73, 0x74, 0xcd, 0x6d, 0x5e,
+	0x2e, 0x01, 0x88, 0x08, 0x18, 0x98, 0xa1, 0x0e, 0x2e, 0x01, 0x8c, 0xa9,
+	0x71, 0x24, 0x1a, 0x3e, 0xaa, 0x20, 0x00, 0xde, 0xf2, 0x6f, 0x18, 0xaf,
+	0xdd, 0x73, 0x5b, 0x6b, 0xf0, 0x15, 0xfd, 0x6b, 0xee, 0x88, 0x4a, 0xc6,
+	0x21, 0xf1, 0x10, 0xd1, 0x78, 0x6f, 0x82, 0xee, 0x9c, 0x36, 0xbe, 0xa6,
+	0x35, 0xb5, 0x91, 0xa7, 0x35, 0x57, 0x67, 0xc1, 0x17, 0x7d, 0x7c, 0x6d,
+	0xab, 0xaa, 0xec, 0x10, 0xb5, 0x60, 0xfa, 0x16, 0x2f, 0x9c, 0xed, 0x74,
+	0x57, 0x7d, 0x8f, 0xfb, 0x61, 0xd1, 0xd8, 0xfe, 0x9a, 0x54, 0x51, 0x15,
+	0xc2, 0x82, 0x2d, 0xe3, 0x0c, 0xd4, 0xb7, 0x4b, 0x80, 0xc2, 0x6e, 0x0f,
+	0x80, 0xef, 0x9b, 0x72, 0x35, 0x9c, 0x87, 0xb8, 0x16, 0xc8, 0x6f, 0xd1,
+	0x3b, 0x01, 0x98, 0xe0, 0x0a, 0xca, 0x54, 0xf3, 0x52, 0x43, 0x89, 0x36,
+	0xe4, 0x67, 0xe5, 0xeb, 0x02, 0xa5, 0x5f, 0xe4, 0x0b, 0xd0, 0x0b, 0x04,
+	0x6c, 0x6b, 0x00, 0x24, 0xde, 0xca, 0x36, 0x80, 0x63, 0x63, 0x57, 0xb3,
+	0x35, 0x73, 0xbf, 0xda, 0xe7, 0xff, 0xc0, 0x91, 0xce, 0x50, 0xdf, 0x3e,
+	0xc3, 0x65, 0xb7, 0x52, 0x03, 0x99, 0x09, 0x67, 0x46, 0x6b, 0xfd, 0x0c,
+	0xf1, 0x1c, 0x9a, 0xfa, 0x61, 0xd3, 0x4b, 0x7c, 0x4b, 0x29, 0x47, 0xe7,
+	0x0b, 0xbf, 0x24, 0xe2, 0x76, 0xcc, 0x4f, 0x82, 0x26, 0x3a, 0xc7, 0x1c,
+	0xfd, 0xc6, 0xb8, 0xab, 0x4f, 0xbe, 0x12, 0xc8, 0x07, 0x59, 0x1b, 0x70,
+	0xa5, 0x97, 0xd0, 0x51, 0xaf, 0x0c, 0x13, 0x8f, 0xec, 0x08, 0x0f, 0xed,
+	0x06, 0x32, 0x8d, 0xde, 0x59, 0x3b, 0xba, 0x5d, 0x18, 0x94, 0xb1, 0x14,
+	0xf1, 0x70, 0x55, 0x1c, 0x84, 0xc7, 0x5e, 0xa4, 0x50, 0xcb, 0x83, 0xe9,
+	0x7e, 0x01, 0xca, 0x92, 0x9d, 0x86, 0x66, 0x62, 0x9d, 0x8d, 0x64, 0x5b,
+	0x10, 0x7a, 0x7d, 0x12, 0x18, 0xa4, 0xb4, 0x59, 0xd3, 0xcd, 0x20, 0x79,
+	0x50, 0x8c, 0xf6, 0x4f, 0x02, 0xce, 0x34, 0xcc, 0x16, 0x06, 0xb8, 0xd2,
+	0x23, 0x46, 0xef, 0xa4, 0xec, 0xa7, 0x4f, 0x8c, 0xd7, 0x85, 0x64, 0x9d,
+	0x15, 0x65, 0x14, 0xca, 0x6e, 0xe8, 0x6c, 0x9b, 0x51, 0x9d, 0x5e, 0x09,
+	0x64, 0x6a, 0xf2, 0x41, 0x00, 0x8c, 0x54, 0xaa, 0x36, 0xec, 0x1f, 0xe7,
+	0x5b, 0x6b, 0x5a, 0x28, 0xb5, 0x2f, 0xfd, 0x04, 0x68, 0x09, 0x00, 0x00,
+	0x73, 0x1d, 0x24, 0xcc, 0x14, 0x28, 0xb5, 0x2f, 0xfd, 0x24, 0x00, 0x01,
+	0x00, 0x00, 0x99, 0xe9, 0xd8, 0x51, 0x28, 0xb5, 0x2f, 0xfd, 0x04, 0x68,
+	0xed, 0x16, 0x00, 0x62, 0x85, 0x11, 0x11, 0x90, 0x7d, 0x64, 0xd0, 0x64,
+	0xe2, 0x84, 0x71, 0x37, 0x91, 0x87, 0x1d, 0x0d, 0xce, 0xd7, 0x2d, 0x15,
+	0xee, 0xee, 0xee, 0xee, 0xfe, 0xee, 0xed, 0xa9, 0x09, 0x9d, 0x56, 0x98,
+	0x61, 0xbe, 0xca, 0x7e, 0x9b, 0xea, 0xba, 0x67, 0x19, 0xef, 0x67, 0xaa,
+	0xdd, 0x6f, 0x72, 0xa9, 0xd8, 0x1a, 0xce, 0x0d, 0x3b, 0x57, 0x1f, 0xbb,
+	0x5c, 0xeb, 0xd5, 0x75, 0xb5, 0xab, 0xd6, 0x27, 0x74, 0x4c, 0x21, 0x43,
+	0x04, 0xf0, 0x2c, 0x07, 0x81, 0x52, 0xa8, 0xa1, 0x2f, 0x28, 0xd4, 0x63,
+	0x63, 0x0e, 0x21, 0x08, 0x01, 0x44, 0x61, 0x52, 0x62, 0x4c, 0x3d, 0x12,
+	0x68, 0x21, 0x08, 0x48, 0x13, 0x80, 0x5c, 0x82, 0x60, 0x89, 0x93, 0x06,
+	0x92, 0x0b, 0x2c, 0x48, 0x0c, 0x59, 0x36, 0x03, 0x84, 0x12, 0x05, 0x1e,
+	0xad, 0x7b, 0xd5, 0x97, 0xf1, 0xdb, 0xb8, 0x56, 0x00, 0xd9, 0x93, 0x20,
+	0xd9, 0xf6, 0x5b, 0xcc, 0x1c, 0x8a, 0x51, 0x87, 0x40, 0x06, 0x42, 0x50,
+	0x8c, 0x95, 0xb2, 0xc2, 0xc6, 0xc9, 0xea, 0x57, 0x98, 0xa0, 0x81, 0x64,
+	0xbe, 0xa2, 0x10, 0x18, 0xde, 0x24, 0x92, 0x3c, 0xf2, 0x97, 0xea, 0x4b,
+	0x7c, 0xa8, 0x4d, 0x74, 0x7a, 0x0d, 0xd8, 0xb7, 0x60, 0x03, 0xc9, 0xa6,
+	0x4f, 0x1a, 0x61, 0x49, 0x62, 0x74, 0x6f, 0x62, 0x7f, 0xd5, 0x6a, 0xd9,
+	0x1f, 0xee, 0xb6, 0x85, 0xf8, 0x3f, 0xc8, 0x59, 0xdc, 0xab, 0x0e, 0x0c,
+	0x02, 0x52, 0x80, 0x90, 0x70, 0x12, 0x60, 0xd7, 0x3e, 0xf0, 0x08, 0x1c,
+	0xb9, 0x01, 0x82, 0xe9, 0xcc, 0x19, 0x33, 0x9a, 0x00, 0xfe, 0x40, 0x9f,
+	0x12, 0x8b, 0x2f, 0x76, 0x1d, 0x9a, 0xc9, 0xef, 0x63, 0xa3, 0x11, 0x08,
+	0x9c, 0x82, 0x7f, 0x23, 0xeb, 0xef, 0xde, 0x70, 0x6a, 0xc9, 0x86, 0xd6,
+	0x6a, 0xdf, 0xe3, 0xa7, 0x17, 0x5a, 0x53, 0x26, 0x8c, 0x4e, 0xd9, 0x79,
+	0xda, 0xbb, 0x12, 0xde, 0x8b, 0x98, 0x3c, 0x3c, 0x18, 0x84, 0xdf, 0x2c,
+	0x53, 0x3d, 0x96, 0xca, 0x2a, 0x8a, 0xcf, 0xba, 0x3e, 0xb4, 0x21, 0x6e,
+	0x61, 0x4c, 0x5f, 0x50, 0xf8, 0xf0, 0xb5, 0x49, 0x8a, 0x82, 0x2f, 0x90,
+	0xc6, 0xcc, 0xb9, 0xc2, 0xfc, 0x22, 0x4c, 0x19, 0x66, 0x44, 0x96, 0xe7,
+	0x65, 0x6d, 0x31, 0x01, 0x6f, 0x60, 0xb2, 0x7a, 0xee, 0x98, 0xa7, 0x95,
+	0xca, 0xc7, 0x8c, 0x0a, 0x8a, 0x8d, 0x73, 0xa3, 0xb1, 0x50, 0x31, 0x36,
+	0x1a, 0x09, 0x40, 0x73, 0xed, 0xc1, 0x33, 0xa0, 0x98, 0x51, 0x3f, 0xa0,
+	0x06, 0x3c, 0xff, 0xd4, 0x12, 0x2f, 0x20, 0xc1, 0x98, 0x30, 0x22, 0xdc,
+	0x4c, 0x31, 0xd2, 0x33, 0x63, 0xdf, 0x5e, 0x03, 0x61, 0x28, 0x96, 0x24,
+	0xe6, 0x1a, 0x4b, 0x58, 0x2d, 0xf0, 0x02, 0x30, 0x8e, 0x76, 0xf7, 0x43,
+	0x4a, 0x7c, 0x2e, 0xb9, 0x8f, 0x49, 0xd5, 0x9d, 0x45, 0xc6, 0x92, 0x7d,
+	0x38, 0xac, 0xae, 0xbb, 0xa1, 0xab, 0xf0, 0x92, 0xad, 0x0a, 0xca, 0xc1,
+	0xdf, 0x38, 0x14, 0x53, 0xc2, 0x85, 0xc3, 0xd1, 0xe1, 0xc9, 0xc7, 0xba,
+	0x21, 0x4c, 0x18, 0x7c, 0x04, 0x59, 0x42, 0x86, 0xca, 0xfb, 0xb3, 0x77,
+	0xcd, 0x8a, 0x14, 0xa9, 0x9e, 0x72, 0x43, 0xb1, 0x78, 0xb0, 0x5a, 0x0f,
+	0x60, 0x8f, 0xc6, 0x4d, 0x75, 0x8b, 0xf2, 0xb5, 0xd4, 0xf3, 0x2a, 0xd1,
+	0x47, 0x11, 0x59, 0x07, 0xd8, 0xc5, 0x9b, 0x89, 0x5a, 0x62, 0xe1, 0x0f,
+	0x82, 0xe9, 0x49, 0xcd, 0x53, 0xbf, 0xf6, 0xa4, 0x9b, 0xc7, 0x3a, 0x44,
+	0xca, 0xd3, 0x6d, 0x91, 0x99, 0x6f, 0xe1, 0x63, 0x6a, 0x2e, 0x21, 0x48,
+	0xc5, 0x2a, 0xfd, 0xa4, 0xd1, 0x35, 0xba, 0x44, 0x7b, 0x5b, 0x23, 0x3d,
+	0x16, 0xdf, 0xcd, 0xf0, 0xf9, 0x25, 0x04, 0x65, 0x8e, 0xd8, 0x9d, 0x84,
+	0x6f, 0x92, 0x0e, 0xa5, 0x2c, 0xf6, 0x28, 0x2e, 0x71, 0xb5, 0x54, 0x3c,
+	0xe0, 0x9e, 0x0e, 0x92, 0x91, 0x1a, 0xe9, 0x65, 0x10, 0xdd, 0x23, 0xdf,
+	0xff, 0xea, 0x4e, 0x99, 0x9a, 0x28, 0x35, 0xb7, 0x70, 0x3f, 0xb5, 0x19,
+	0x93, 0x67, 0x70, 0x68, 0x43, 0x57, 0xc5, 0x12, 0x01, 0xa2, 0x75, 0x2e,
+	0x43, 0x1a, 0xc3, 0xe4, 0x93, 0xeb, 0x91, 0xdd, 0x90, 0x12, 0x14, 0xf8,
+	0x5a, 0x85, 0xe0, 0xc1, 0x4c, 0x18, 0x7d, 0x08, 0x4f, 0xf4, 0x81, 0xf1,
+	0xab, 0x50, 0x17, 0x7c, 0x74, 0xa6, 0x82, 0xc0, 0xdc, 0x9f, 0xd8, 0xc5,
+	0xb2, 0xe5, 0x8a, 0x9c, 0x0e, 0xcb, 0xa8, 0xef, 0x8a, 0x24, 0x9a, 0x7d,
+	0x33, 0x11, 0xc6, 0xa8, 0x58, 0xbd, 0xa5, 0x43, 0x5c, 0xd9, 0x77, 0xbb,
+	0x0e, 0x41, 0x7d, 0x0a, 0x52, 0x10, 0xe1, 0x39, 0xef, 0x65, 0x2c, 0xc0,
+	0x97, 0xd7, 0x95, 0x24, 0xb9, 0x0f, 0x3a, 0x22, 0x65, 0x18, 0xea, 0x4d,
+	0xbc, 0x10, 0x93, 0xc0, 0xcc, 0x13, 0x79, 0x1b, 0xa9, 0xe2, 0x2f, 0xb0,
+	0xa6, 0xc2, 0x47, 0x62, 0x98, 0xa4, 0x27, 0x06, 0x6b, 0x8a, 0x35, 0xaa,
+	0xd0, 0x9e, 0xd1, 0x06, 0xfe, 0x95, 0xc0, 0x88, 0x27, 0x4d, 0x3b, 0x95,
+	0x39, 0x91, 0x64, 0x48, 0x1c, 0x38, 0x7f, 0xd7, 0x5b, 0x0b, 0xdf, 0x0e,
+	0x24, 0xf0, 0xdc, 0x6f, 0xa3, 0x96, 0x58, 0xb7, 0xd3, 0xdb, 0x65, 0x27,
+	0x5c, 0x05, 0xb9, 0x1f, 0x85, 0x90, 0x30, 0xe9, 0xc7, 0xb2, 0x6f, 0x8f,
+	0xb5, 0xa1, 0x66, 0x39, 0xd8, 0x0d, 0x65, 0x47, 0x56, 0x61, 0x25, 0xeb,
+	0xff, 0xf5, 0x55, 0x0d, 0x10, 0xf7, 0x30, 0x6a, 0x28, 0xb5, 0x2f, 0xfd,
+	0x04, 0x68, 0x65, 0x0f, 0x00, 0xf2, 0x84, 0x10, 0x11, 0x90, 0x7d, 0x64,
+	0xd0, 0x64, 0xe2, 0xd3, 0xd2, 0xff, 0x65, 0x50, 0xfa, 0x3c, 0xdf, 0xe7,
+	0xa2, 0x0a, 0xee, 0xee, 0xee, 0xee, 0x8e, 0x5d, 0xae, 0xf5, 0x82, 0x97,
+	0x6c, 0xc5, 0x7f, 0xec, 0xff, 0xd6, 0x84, 0xb4, 0xc2, 0x0c, 0xf3, 0x5d,
+	0x36, 0x3f, 0x76, 0xae, 0xb6, 0x8c, 0xb7, 0xff, 0x5c, 0xd7, 0x81, 0xb6,
+	0xfe, 0xfe, 0x5d, 0x0c, 0xa8, 0x84, 0x8e, 0x29, 0x64, 0x88, 0x00, 0x74,
+	0x65, 0x01, 0x80, 0xda, 0xa8, 0x71, 0x53, 0x92, 0x54, 0xb2, 0x31, 0x06,
+	0x20, 0x44, 0x60, 0x8c, 0x52, 0x56, 0xe6, 0x01, 0x12, 0x40, 0x10, 0xc0,
+	0x11, 0x50, 0x19, 0x88, 0x46, 0x98, 0x02, 0xc2, 0x94, 0x63, 0x42, 0xdb,
+	0x1a, 0x1b, 0x63, 0x27, 0x0f, 0xcc, 0xf6, 0xe9, 0x5a, 0x97, 0x9f, 0x7d,
+	0xee, 0xaa, 0xbc, 0x66, 0xa7, 0xfb, 0xd3, 0x25, 0xa8, 0x96, 0x39, 0xfe,
+	0xa2, 0xe9, 0x33, 0x4e, 0x09, 0x01, 0x91, 0x88, 0x8c, 0x8c, 0xa4, 0x2d,
+	0x5d, 0x75, 0x21, 0x46, 0x71, 0xf2, 0xd9, 0x8b, 0x38, 0xc1, 0xc5, 0x59,
+	0xf4, 0x91, 0x56, 0x2d, 0xbf, 0x70, 0xa3, 0x09, 0x31, 0xd2, 0x47, 0x40,
+	0xfa, 0xbd, 0x22, 0xc1, 0x28, 0x2d, 0x38, 0x7f, 0x7e, 0xf0, 0x41, 0x21,
+	0xab, 0x65, 0xbb, 0x04, 0x05, 0x16, 0xcd, 0x94, 0x77, 0x83, 0x28, 0x9b,
+	0xff, 0x59, 0xa5, 0xc0, 0xf1, 0x9c, 0xdb, 0x88, 0x8f, 0x23, 0xa5, 0x60,
+	0xa9, 0x71, 0xbc, 0x71, 0x98, 0xc6, 0x5b, 0x50, 0x1a, 0x2c, 0x08, 0x0c,
+	0xe1, 0x92, 0x15, 0x42, 0x85, 0x81, 0x26, 0x6c, 0x29, 0x0d, 0x87, 0x15,
+	0x4d, 0x8e, 0xb3, 0x4b, 0xd2, 0x7c, 0x7b, 0xf0, 0xd2, 0xcd, 0xa6, 0xd5,
+	0x5a, 0xf5, 0x27, 0x19, 0x02, 0x72, 0x7e, 0x99, 0xb5, 0xc4, 0xc7, 0x37,
+	0x2e, 0x07, 0x36, 0xfd, 0xf8, 0x51, 0xc0, 0x3c, 0x07, 0x21, 0x11, 0x05,
+	0x0f, 0x9f, 0x42, 0x8f, 0x74, 0xc6, 0x61, 0x52, 0xdb, 0xd3, 0xc9, 0x0b,
+	0xc9, 0xb0, 0x80, 0x90, 0x6b, 0x99, 0x0f, 0xe5, 0x40, 0x42, 0xdf, 0x4f,
+	0xd6, 0xf9, 0x9a, 0x06, 0xbe, 0x90, 0xab, 0x08, 0x46, 0x26, 0x56, 0xd5,
+	0x5d, 0x26, 0xc0, 0xb5, 0x13, 0x88, 0x26, 0x8f, 0x0c, 0x7c, 0x01, 0x4e,
+	0x5a, 0x51, 0xf8, 0x7c, 0xe8, 0xa8, 0xf3, 0xaa, 0x28, 0x41, 0xb3, 0x46,
+	0x43, 0xa7, 0x84, 0x35, 0xbc, 0xa9, 0x3f, 0xea, 0x14, 0x32, 0x7c, 0xd5,
+	0x3b, 0x00, 0x06, 0x6a, 0x78, 0x5b, 0x9d, 0x6b, 0x75, 0xa3, 0xb6, 0xe6,
+	0xb9, 0xcd, 0x48, 0xe0, 0x3b, 0xbe, 0xaf, 0x0a, 0x73, 0xc0, 0xdf, 0x40,
+	0x03, 0x3e, 0x8f, 0xf1, 0x30, 0xd7, 0x08, 0x33, 0xdb, 0x96, 0x1c, 0xa5,
+	0x46, 0x85, 0x8e, 0xd1, 0xbb, 0xca, 0x09, 0x67, 0xb5, 0xa7, 0x99, 0xc6,
+	0x50, 0x91, 0x28, 0x92, 0xc1, 0x8a, 0xcb, 0xaa, 0xc0, 0x27, 0x3a, 0xb7,
+	0xff, 0x67, 0xe3, 0x51, 0xdf, 0x24, 0x1b, 0x1d, 0x5d, 0x7b, 0xd9, 0x57,
+	0x13, 0x83, 0x51, 0xf6, 0xa4, 0xa3, 0x31, 0x8a, 0x6e, 0x22, 0xed, 0x7a,
+	0x3d, 0xce, 0x44, 0x9d, 0x93, 0x07, 0x4d, 0x01, 0xce, 0xb8, 0xe6, 0x72,
+	0x1d, 0x02, 0x0f, 0xb7, 0x36, 0x8e, 0xb8, 0xe9, 0x7e, 0x75, 0x10, 0x96,
+	0x3c, 0x1f, 0xd8, 0x84, 0xc9, 0x55, 0xd4, 0xe6, 0x82, 0xbf, 0x2b, 0xe8,
+	0xa1, 0x81, 0x7f, 0x0b, 0x68, 0x25, 0xf7, 0xe1, 0x49, 0xc5, 0x0a, 0xda,
+	0x7b, 0xc0, 0x6b, 0x3c, 0x90, 0xd1, 0x17, 0xeb, 0x19, 0x1a, 0x44, 0x25,
+	0x07, 0x5d, 0xbd, 0x92, 0x33, 0xd0, 0x93, 0xc2, 0x19, 0x55, 0xf5, 0xae,
+	0xcf, 0xdf, 0x00, 0xb3, 0x0a, 0xbd, 0x60, 0x70, 0x4e, 0x28, 0xb5, 0x2f,
+	0xfd, 0x04, 0x68, 0xa5, 0x14, 0x00, 0x72, 0x85, 0x11, 0x11, 0x90, 0x7d,
+	0x64, 0xd0, 0x64, 0xe2, 0x84, 0x71, 0x37, 0x91, 0x87, 0x1d, 0x0d, 0xce,
+	0xd7, 0x2d, 0x15, 0xee, 0xee, 0xee, 0xee, 0xee, 0xef, 0xee, 0x9e, 0xd0,
+	0x31, 0x85, 0x0c, 0x11, 0xc0, 0x33, 0xd5, 0xae, 0xd3, 0x0a, 0x33, 0xcc,
+	0x57, 0xd9, 0xd7, 0x75, 0xb5, 0xab, 0xd6, 0x37, 0xb9, 0x54, 0x6c, 0x0d,
+	0xb7, 0xa7, 0x26, 0x7c, 0x96, 0xf1, 0xce, 0x0d, 0x3b, 0x57, 0xbf, 0x4d,
+	0x75, 0xdd, 0x63, 0x97, 0x6b, 0xbd, 0x1f, 0x81, 0x2a, 0xa8, 0x91, 0x33,
+	0xa8, 0x55, 0x63, 0x19, 0x03, 0x21, 0x08, 0x01, 0x84, 0x61, 0x8e, 0x5a,
+	0xaf, 0x07, 0x11, 0x34, 0x08, 0x03, 0x42, 0x02, 0xa3, 0x90, 0x24, 0xd4,
+	0x90, 0x88, 0x51, 0x90, 0xa4, 0xb0, 0x1c, 0xb6, 0xae, 0xcd, 0x65, 0x0e,
+	0xe5, 0x6a, 0x41, 0x3b, 0x08, 0xf8, 0x72, 0xd8, 0xc6, 0x55, 0x23, 0xd5,
+	0x05, 0x4c, 0x20, 0x32, 0x77, 0x66, 0x6b, 0xff, 0x1f, 0xa4, 0x92, 0x05,
+	0x2d, 0xbd, 0x81, 0x40, 0xea, 0xe9, 0x6f, 0x34, 0x21, 0x93, 0xb6, 0x38,
+	0xcc, 0xd7, 0x94, 0xea, 0xc1, 0x9d, 0xe0, 0x01, 0xfd, 0x75, 0xef, 0xf6,
+	0xe1, 0x5f, 0x6e, 0xc1, 0x31, 0xf9, 0xab, 0x3b, 0xb9, 0xa6, 0x97, 0x2b,
+	0xd3, 0xcf, 0x7d, 0x84, 0x3f, 0x7f, 0x3b, 0x74, 0x15, 0xbc, 0x2d, 0x34,
+	0x7d, 0xa6, 0x48, 0xc7, 0x9c, 0xdc, 0xf0, 0x39, 0x55, 0x42, 0x37, 0x4f,
+	0xba, 0x39, 0xee, 0xe8, 0xaa, 0x0d, 0xee, 0x10, 0x0b, 0x71, 0xc4, 0x8b,
+	0x99, 0x9a, 0x29, 0x3f, 0xb0, 0xd5, 0x46, 0xcf, 0x0b, 0x17, 0x86, 0x77,
+	0xc5, 0x2d, 0x79, 0x80, 0xee, 0x76, 0x3e, 0x0a, 0x98, 0x08, 0x86, 0x24,
+	0x2f, 0x43, 0x51, 0x28, 0xe7, 0xdb, 0x32, 0xb6, 0x53, 0x72, 0x00, 0x91,
+	0x18, 0xe3, 0x21, 0x21, 0xb9, 0x70, 0x13, 0x87, 0x76, 0xdd, 0x31, 0x0f,
+	0x88, 0x33, 0xc4, 0x2a, 0x5a, 0x92, 0x48, 0xb5, 0x68, 0x58, 0x63, 0x77,
+	0x03, 0x42, 0xde, 0xae, 0xc7, 0xd7, 0xa6, 0x48, 0x5f, 0xd3, 0x4a, 0x1a,
+	0x0e, 0x57, 0xeb, 0xb2, 0x0e, 0xec, 0xdf, 0xf3, 0x06, 0xb1, 0x9f, 0x18,
+	0xa4, 0x94, 0x69, 0x9b, 0x15, 0xdb, 0x9a, 0xc0, 0x07, 0x32, 0x92, 0xe0,
+	0xbb, 0x1c, 0x91, 0xec, 0xb0, 0x68, 0xd2, 0xf9, 0xd4, 0x99, 0x48, 0xbb,
+	0x87, 0xae, 0xd3, 0x38, 0x8c, 0x4f, 0xde, 0xf0, 0xa3, 0x5f, 0xe3, 0x90,
+	0x26, 0x30, 0xa3, 0xbd, 0x19, 0xf7, 0xee, 0x8a, 0xb4, 0xe9, 0xc8, 0x32,
+	0x56, 0xb4, 0x51, 0xf9, 0x22, 0x10, 0x69, 0x75, 0xed, 0x6f, 0x3a, 0x85,
+	0xad, 0xe0, 0x41, 0x96, 0x83, 0x84, 0x95, 0x68, 0x59, 0x97, 0x86, 0x71,
+	0x61, 0x74, 0x51, 0x3e, 0x24, 0x3a, 0x24, 0xe8, 0x87, 0x2e, 0xf3, 0x82,
+	0x2a, 0xdb, 0xeb, 0x90, 0x6d, 0x59, 0xcd, 0xd1, 0x30, 0x8f, 0x37, 0x75,
+	0xdf, 0x9c, 0x66, 0x4b, 0xf6, 0x54, 0x6e, 0x23, 0x16, 0xd4, 0x5a, 0xf6,
+	0x9a, 0x8d, 0xd3, 0x14, 0xc4, 0x2a, 0x6c, 0xca, 0xff, 0x8b, 0xd9, 0xd0,
+	0x22, 0x12, 0x90, 0x92, 0xb5, 0xf5, 0xa5, 0x41, 0x0f, 0x31, 0x34, 0x1b,
+	0x5c, 0xff, 0x0a, 0x32, 0xd4, 0x50, 0x3b, 0xc3, 0x82, 0x87, 0xfb, 0x34,
+	0xb5, 0xe0, 0xec, 0x85, 0xb0, 0x0c, 0x5a, 0x7a, 0x60, 0x23, 0x93, 0x5b,
+	0xb4, 0xbf, 0xe8, 0x88, 0xd6, 0x41, 0xd7, 0xca, 0x97, 0x06, 0xc6, 0xd6,
+	0x08, 0x2c, 0x52, 0x6b, 0x31, 0xc1, 0xcb, 0x0f, 0xe3, 0x5d, 0xc5, 0xdc,
+	0x11, 0x3c, 0x91, 0x6d, 0x41, 0xfd, 0x19, 0x97, 0xf2, 0xe2, 0xb8, 0xd5,
+	0xa9, 0x87, 0x92, 0x3c, 0x15, 0xc6, 0x17, 0x6d, 0x68, 0xc1, 0xe1, 0x27,
+	0x27, 0x3b, 0x43, 0x54, 0x97, 0xb0, 0xfb, 0xce, 0x55, 0x4d, 0xaf, 0xa6,
+	0x75, 0xba, 0xa8, 0xf1, 0x12, 0x24, 0x1b, 0xda, 0x6c, 0x1e, 0x1a, 0x53,
+	0x9a, 0xf4, 0x72, 0x7c, 0xd5, 0xad, 0x3e, 0xe2, 0xb5, 0x9e, 0xb6, 0x08,
+	0x0e, 0x61, 0xc5, 0xe3, 0x5c, 0xb9, 0x7d, 0xf8, 0x58, 0x05, 0x60, 0x93,
+	0xfd, 0x34, 0xd5, 0x78, 0x41, 0x18, 0x87, 0x50, 0xaf, 0x38, 0x34, 0x3c,
+	0x90, 0x07, 0x0e, 0x47, 0xa3, 0x91, 0x18, 0xef, 0xd1, 0x08, 0x6f, 0x1c,
+	0x3f, 0x7d, 0x37, 0x90, 0x13, 0x4c, 0x32, 0x45, 0x26, 0x46, 0xee, 0x5f,
+	0x4f, 0xb3, 0x69, 0xc7, 0x09, 0x06, 0xe4, 0xa2, 0x82, 0xbc, 0xd2, 0x95,
+	0xdd, 0xcb, 0xf1, 0x83, 0x12, 0x25, 0xb8, 0xae, 0x2a, 0x06, 0x43, 0x42,
+	0x74, 0xfc, 0x10, 0x3a, 0xfa, 0x25, 0xdf, 0xdc, 0xa8, 0x78, 0x5f, 0xc5,
+	0xa3, 0x79, 0x6c, 0x12, 0xe3, 0x16, 0x8b, 0xcf, 0x71, 0x11, 0x6a, 0x8f,
+	0x18, 0x40, 0xa5, 0x74, 0xde, 0x37, 0x02, 0x97, 0x59, 0x40, 0xad, 0xab,
+	0x72, 0xd0, 0xd6, 0x82, 0x01, 0x3b, 0xc3, 0xa7, 0x76, 0x26, 0x4b, 0x74,
+	0x15, 0x0b, 0x45, 0x03, 0xab, 0x06, 0x39, 0xa1, 0x2d, 0xa4, 0x5e, 0x2a,
+	0x4d, 0x18, 0x51, 0x00, 0x00, 0x00, 0x7f, 0x02, 0x00, 0x00, 0x00, 0x10,
+	0x00, 0x00, 0xe7, 0x5b, 0x6b, 0x5a, 0x0e, 0x00, 0x00, 0x00, 0x01, 0x00,
+	0x00, 0x00, 0x1d, 0x24, 0xcc, 0x14, 0x0d, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x99, 0xe9, 0xd8, 0x51, 0xea, 0x02, 0x00, 0x00, 0x88, 0x13,
+	0x00, 0x00, 0x10, 0xf7, 0x30, 0x6a, 0xf9, 0x01, 0x00, 0x00, 0xb8, 0x0b,
+	0x00, 0x00, 0xbd, 0x60, 0x70, 0x4e, 0xa1, 0x02, 0x00, 0x00, 0xbf, 0x10,
+	0x00, 0x00, 0x39, 0xa1, 0x2d, 0xa4, 0x06, 0x00, 0x00, 0x00, 0x80, 0xb1,
+	0xea, 0x92, 0x8f,
+};
+
+/*
+ * The first 1024 and the next 4096 bytes of zstd_seekable_make_corpus()
+ * output, compressed with "zstd -19 --no-check" and, from a pipe so
+ * without content size, "zstd -19 --no-check --zstd=wlog=12". The frames
+ * have a window size of 1KiB and 4KiB.
+ */
+static const u8 zstd_two_windows_test[] = {
+	0x28, 0xb5, 0x2f, 0xfd, 0x60, 0x00, 0x03, 0x7d, 0x07, 0x00, 0x52, 0x45,
+	0x11, 0x11, 0x90, 0x7d, 0x64, 0xd0, 0x64, 0xe2, 0x84, 0x71, 0x37, 0x91,
+	0x87, 0x1d, 0x0d, 0xce, 0xd7, 0x2d, 0x15, 0x13, 0xba, 0xeb, 0xba, 0xda,
+	0x55, 0xcb, 0xdd, 0x59, 0xc6, 0xdb, 0xdf, 0x9f, 0xa9, 0x76, 0xbf, 0x4d,
+	0x75, 0xdd, 0x27, 0x74, 0x4c, 0x21, 0x43, 0x04, 0xf0, 0xb9, 0x61, 0xe7,
+	0xea, 0xb7, 0xa7, 0x26, 0x7c, 0x5a, 0x61, 0x86, 0xf9, 0x2a, 0xfb, 0xfe,
+	0x4d, 0x2e, 0x15, 0x5b, 0xc3, 0xd8, 0xe5, 0x5a, 0xef, 0x7b, 0x55, 0xa8,
+	0x81, 0x57, 0x52, 0xc9, 0x5e, 0x73, 0x10, 0x10, 0x01, 0x42, 0x8c, 0xba,
+	0x0e, 0x11, 0x94, 0x20, 0x01, 0x28, 0xd0, 0x26, 0xb0, 0x60, 0x02, 0xd2,
+	0x82, 0x42, 0xcb, 0x18, 0x5a, 0xa4, 0xe7, 0xe6, 0x65, 0x75, 0x7f, 0x62,
+	0x7a, 0x8d, 0x8f, 0x55, 0x9c, 0xe7, 0xff, 0xd7, 0x20, 0x31, 0x1c, 0xe5,
+	0x09, 0x81, 0xa6, 0x8c, 0x8e, 0x45, 0xfa, 0xb7, 0xf1, 0xa4, 0xbf, 0xbc,
+	0x07, 0x7a, 0x5d, 0x10, 0x99, 0x0d, 0x32, 0x25, 0x62, 0x21, 0x7d, 0x6a,
+	0x30, 0x8f, 0xad, 0x63, 0x1f, 0x91, 0x37, 0x82, 0x14, 0x5f, 0xa6, 0xad,
+	0xdc, 0x18, 0x36, 0x6e, 0x4c, 0x71, 0x48, 0xa1, 0x07, 0xc8, 0xc5, 0x8f,
+	0x14, 0x5b, 0x48, 0xd8, 0x8d, 0x06, 0xd0, 0x08, 0xce, 0x95, 0xc6, 0x5a,
+	0x77, 0x24, 0x40, 0xc8, 0x79, 0x50, 0x96, 0x43, 0x2c, 0xda, 0x00, 0xdd,
+	0x05, 0xf3, 0x21, 0x46, 0x83, 0x97, 0xc0, 0xd8, 0x1f, 0xb7, 0xa4, 0x41,
+	0xa4, 0xef, 0xcc, 0xee, 0xb3, 0xa3, 0x07, 0x70, 0x43, 0x2f, 0x24, 0xcd,
+	0x42, 0x66, 0xca, 0xaf, 0x81, 0xed, 0x63, 0xe4, 0xf8, 0x4f, 0x64, 0x6a,
+	0xd2, 0x8c, 0x3a, 0x8c, 0x92, 0x2a, 0xc4, 0xfd, 0x01, 0x28, 0xb5, 0x2f,
+	0xfd, 0x00, 0x10, 0xa5, 0x13, 0x00, 0x82, 0xc5, 0x11, 0x11, 0x90, 0x7d,
+	0x64, 0xd0, 0x64, 0xe2, 0xd3, 0xd2, 0xff, 0x65, 0x50, 0xfa, 0x3c, 0xdf,
+	0xe7, 0xa2, 0x0a, 0xee, 0xee, 0xee, 0xee, 0xee, 0xee, 0xfe, 0x73, 0x5d,
+	0x97, 0x1f, 0x3b, 0x57, 0x69, 0x85, 0x19, 0xe6, 0xbb, 0x2c, 0x68, 0xeb,
+	0xef, 0xbf, 0x35, 0x21, 0x70, 0x80, 0x5d, 0xae, 0xf5, 0xaa, 0x84, 0x8e,
+	0x29, 0x64, 0x88, 0x00, 0x74, 0x65, 0x7f, 0x17, 0x03, 0x2f, 0xd9, 0x8a,
+	0xff, 0x18, 0xb4, 0x8c, 0x37, 0xf8, 0xb7, 0x02, 0x81, 0x23, 0xa8, 0xa1,
+	0x33, 0x65, 0x8f, 0x3d, 0x03, 0x21, 0x08, 0x01, 0x04, 0x92, 0x52, 0x3a,
+	0xf8, 0x06, 0x12, 0x40, 0x20, 0xb8, 0x04, 0x24, 0x01, 0x95, 0x50, 0x28,
+	0x01, 0x54, 0x20, 0x92, 0xe0, 0x90, 0x4c, 0xa5, 0x85, 0x49, 0x9b, 0x01,
+	0x75, 0x4e, 0x89, 0x9f, 0x8a, 0xbc, 0xf2, 0xec, 0x4c, 0x83, 0x5e, 0xd3,
+	0xdd, 0x02, 0x4e, 0x68, 0xb6, 0x9a, 0x33, 0x01, 0x8d, 0x4e, 0x07, 0x69,
+	0x78, 0xdd, 0x33, 0xfc, 0xc8, 0x55, 0xe8, 0x8e, 0xf7, 0x48, 0xe7, 0x1d,
+	0x8d, 0x51, 0xe0, 0x8b, 0x12, 0xa9, 0x10, 0xaf, 0x80, 0x4e, 0x91, 0x16,
+	0x4b, 0x57, 0xd7, 0x11, 0xc8, 0x6d, 0x2d, 0x75, 0x47, 0xf4, 0x10, 0xaa,
+	0xc5, 0x68, 0x24, 0xac, 0xf9, 0x57, 0xbf, 0xe2, 0x28, 0x8a, 0x8a, 0x7d,
+	0xb3, 0x24, 0x2d, 0x38, 0xea, 0x5f, 0xce, 0xbb, 0xc1, 0x7b, 0x6b, 0x17,
+	0x77, 0xfd, 0xdf, 0xb9, 0x1b, 0xdc, 0x64, 0xae, 0x16, 0x55, 0x75, 0x36,
+	0xdf, 0xe1, 0x19, 0xfd, 0x0b, 0xf9, 0xd0, 0xa5, 0x28, 0x66, 0x60, 0x46,
+	0x1c, 0xa3, 0xe0, 0xbd, 0x4a, 0x20, 0xcd, 0xe2, 0x17, 0xd0, 0x12, 0xd4,
+	0x80, 0xa1, 0x07, 0xd0, 0xd0, 0x4b, 0x97, 0x95, 0x96, 0xd8, 0x3c, 0xf2,
+	0x1a, 0x59, 0x4c, 0xc4, 0xd4, 0xef, 0x6d, 0x92, 0xa8, 0x48, 0x63, 0xcb,
+	0xd8, 0xa9, 0xaf, 0xb0, 0xaf, 0x39, 0x43, 0x2b, 0x8a, 0x31, 0x4b, 0xee,
+	0x57, 0x85, 0xdd, 0xcf, 0x60, 0x18, 0xaf, 0xf7, 0x1c, 0x20, 0xc6, 0x18,
+	0x21, 0xa9, 0x0b, 0x04, 0x16, 0x9a, 0x0f, 0x99, 0xa3, 0xa6, 0x37, 0xfb,
+	0x2a, 0xfd, 0x23, 0x46, 0x5b, 0x84, 0x07, 0xda, 0x18, 0xc7, 0x1c, 0x01,
+	0x5e, 0xa9, 0xd5, 0x5f, 0x8f, 0xec, 0xd7, 0xc9, 0x1d, 0x52, 0x07, 0x9e,
+	0x92, 0x6d, 0xbd, 0x99, 0xe0, 0x36, 0xb9, 0x2a, 0xde, 0x9d, 0x0c, 0xe3,
+	0x24, 0x03, 0x79, 0x77, 0x88, 0x24, 0x65, 0x6a, 0x7d, 0xf4, 0xe5, 0x31,
+	0x28, 0x25, 0xe5, 0x0f, 0x94, 0xa7, 0xa9, 0x94, 0xd4, 0x62, 0xe3, 0x15,
+	0x5d, 0x50, 0x9c, 0x50, 0x07, 0x4b, 0x2e, 0x3d, 0x41, 0xe1, 0xe3, 0xf5,
+	0x8e, 0xcc, 0xe7, 0x67, 0xb5, 0x1d, 0xe5, 0x18, 0xa2, 0x19, 0x13, 0xea,
+	0x65, 0x0a, 0xf5, 0x5d, 0x7b, 0x47, 0xcc, 0xfc, 0x7d, 0xf9, 0x66, 0x16,
+	0x9c, 0xdc, 0x92, 0xeb, 0xf1, 0xc2, 0xb9, 0x49, 0x62, 0x77, 0x99, 0x68,
+	0x17, 0x5b, 0x1c, 0x8d, 0x58, 0xa4, 0x4d, 0x67, 0xbc, 0x45, 0xc1, 0x9c,
+	0xce, 0xda, 0x5d, 0x31, 0x08, 0x4b, 0xcd, 0xfb, 0xf8, 0xbd, 0xc0, 0x44,
+	0x2d, 0x93, 0x49, 0xe1, 0x2e, 0xc9, 0x49, 0xcf, 0x2c, 0x4a, 0x6a, 0x8f,
+	0xe6, 0xc5, 0x0b, 0x24, 0x40, 0x53, 0xb2, 0xe1, 0x00, 0x1c, 0xd4, 0x79,
+	0x93, 0xc3, 0x98, 0x19, 0x4f, 0x22, 0xa6, 0x5f, 0xfa, 0x91, 0xa0, 0xc2,
+	0xfb, 0xff, 0x9b, 0xb1, 0xeb, 0x4b, 0xd6, 0xb6, 0x04, 0x53, 0xd1, 0x4a,
+	0xeb, 0x8f, 0x84, 0x64, 0xec, 0x88, 0x87, 0xdf, 0xac, 0x0a, 0x1c, 0x01,
+	0x94, 0x65, 0x59, 0xd2, 0xd6, 0x6b, 0xea, 0xd4, 0xab, 0x79, 0x2a, 0xa9,
+	0xae, 0x34, 0xf1, 0x5a, 0x61, 0xff, 0x0e, 0x20, 0x4c, 0x26, 0xea, 0x02,
+	0x02, 0xc4, 0x98, 0x16, 0x2d, 0xce, 0x75, 0x80, 0x6b, 0x6f, 0xa7, 0xb8,
+	0x25, 0x4d, 0xdc, 0xa7, 0x49, 0x2f, 0x6a, 0x70, 0x08, 0xf0, 0xed, 0xa1,
+	0x3d, 0xb9, 0x84, 0xd2, 0x12, 0x72, 0x89, 0x5e, 0x9c, 0xb7, 0xf0, 0x0c,
+	0x48, 0x63, 0xf3, 0xc4, 0x12, 0x36, 0x75, 0x48, 0xca, 0xde, 0x1e, 0xf8,
+	0x09, 0x67, 0x67, 0x4c, 0x38, 0x51, 0xf0, 0x2c, 0xc9, 0x2a, 0x89, 0x29,
+	0xf8, 0x12, 0x26, 0xde, 0x3d, 0x30, 0x97, 0x65, 0x1f, 0xfa, 0x33, 0x95,
+	0xa6, 0xe2, 0x55, 0xbc, 0x9a, 0xf0, 0x05, 0x00, 0xa5, 0x16, 0x0e, 0xe1,
+	0x48, 0xea, 0x40, 0x22, 0x42, 0xde, 0xb2, 0x9a, 0x03, 0xfa, 0x16, 0xc5,
+	0x14, 0x7c, 0x29, 0x69, 0x32, 0xe6, 0xf8, 0x51, 0xc0, 0xef, 0x0e, 0x3b,
+	0x84, 0xdb, 0xc6, 0x56, 0x65, 0x50, 0x49, 0x30, 0x44, 0x15,
+};
+
+static void zstd_seekable_make_corpus(u8 *buf, size_t len)
+{
+	static const char * const words[] = {
+		"barebox", "zstd", "seekable", "frame", "rootfs", "partition",
+		"read", "offset", "\n", "0123456789", "image",
+	};
+	u32 seed = 1;
+	size_t pos = 0;
+
+	while (pos < len) {
+		const char *w;
+
+		seed = seed * 1103515245 + 12345;
+		w = words[(seed >> 16) % ARRAY_SIZE(words)];
+
+		while (*w && pos < len)
+			buf[pos++] = *w++;
+		if (pos < len)
+			buf[pos++] = ' ';
+	}
+}
+
+static void expect_read(struct zstd_seekable *zs, const u8 *corpus, u8 *buf,
+			loff_t offset, size_t count)
+{
+	size_t expected = 0;
+	ssize_t ret;
+
+	total_tests++;
+
+	if (offset < ZSTD_TEST_SIZE)
+		expected = min_t(size_t, count, ZSTD_TEST_SIZE - offset);
+
+	ret = zstd_seekable_read(zs, buf, count, offset);
+	if (ret == expected && !memcmp(buf, corpus + offset, expected))
+		return;
+
+	printf("read of %zu bytes at %lld failed: %zd\n", count, offset, ret);
+	failed_tests++;
+}
+
+static void test_zstd_seekable_read(const u8 *corpus, u8 *buf, int fd)
+{
+	/* frame boundaries are at 4096, 4097, 9097 and 12097 */
+	static const struct {
+		loff_t offset;
+		size_t count;
+	} reads[] = {
+		{ 0, ZSTD_TEST_SIZE },
+		{ 0, 1 },
+		{ 4095, 2 },		/* across the one byte and empty frames */
+		{ 4096, 1 },
+		{ 4097, 5000 },
+		{ 9000, 200 },
+		{ 12096, 2 },
+		{ 100, 16000 },
+		{ ZSTD_TEST_SIZE - 1, 10 },	/* short read at the end */
+		{ ZSTD_TEST_SIZE, 10 },
+		{ ZSTD_TEST_SIZE + 100, 10 },
+		{ 3000, 0 },
+	};
+	struct zstd_seekable *zs;
+	loff_t offset;
+	int i;
+
+	total_tests++;
+	zs = zstd_seekable_open(fd);
+	if (IS_ERR(zs)) {
+		printf("zstd_seekable_open: %pe\n", zs);
+		failed_tests++;
+		return;
+	}
+
+	total_tests++;
+	if (zstd_seekable_size(zs) != ZSTD_TEST_SIZE ||
+	    zstd_seekable_num_frames(zs) != 6) {
+		printf("wrong size %lld or number of frames %u\n",
+		       zstd_seekable_size(zs), zstd_seekable_num_frames(zs));
+		failed_tests++;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(reads); i++)
+		expect_read(zs, corpus, buf, reads[i].offset, reads[i].count);
+
+	/* backwards in odd sized chunks, each one in a different frame */
+	for (offset = ZSTD_TEST_SIZE - 1777; offset > 0; offset -= 1777)
+		expect_read(zs, corpus, buf, offset, 1777);
+
+	zstd_seekable_close(zs);
+}
+
+static void test_zstd_seekable(void)
+{
+	const size_t size = sizeof(zstd_seekable_test);
+	u8 *corpus, *buf, *image;
+	struct zstd_seekable *zs;
+	struct cdev *cdev;
+	char *devpath;
+	void *out = NULL;
+	ssize_t ret;
+	int fd;
+
+	corpus = malloc(ZSTD_TEST_SIZE);
+	buf = malloc(ZSTD_TEST_SIZE);
+	image = malloc(size);
+	if (WARN_ON(!corpus || !buf || !image))
+		goto out;
+
+	zstd_seekable_make_corpus(corpus, ZSTD_TEST_SIZE);
+
+	/* the whole file, all frames and the seek table, in one go */
+	total_tests++;
+	ret = uncompress_buf_to_buf(zstd_seekable_test, size, &out,
+				    uncompress_err_stdout);
+	if (ret != ZSTD_TEST_SIZE || memcmp(out, corpus, ZSTD_TEST_SIZE)) {
+		printf("uncompress of multi-frame file failed: %zd\n", ret);
+		failed_tests++;
+	}
+	free(out);
+
+	/* a later frame with a larger window than the first one */
+	total_tests++;
+	out = NULL;
+	ret = uncompress_buf_to_buf(zstd_two_windows_test,
+				    sizeof(zstd_two_windows_test), &out,
+				    uncompress_err_stdout);
+	if (ret != 5120 || memcmp(out, corpus, 5120)) {
+		printf("uncompress of frames with growing window failed: %zd\n",
+		       ret);
+		failed_tests++;
+	}
+	free(out);
+
+	ret = write_file(ZSTD_TEST_FILE, zstd_seekable_test, size);
+	if (WARN_ON(ret))
+		goto out;
+
+	fd = open(ZSTD_TEST_FILE, O_RDONLY);
+	if (WARN_ON(fd < 0))
+		goto out_unlink;
+
+	test_zstd_seekable_read(corpus, buf, fd);
+
+	close(fd);
+
+	/* reading through a device */
+	total_tests++;
+	cdev = zstd_seekable_cdev_create(ZSTD_TEST_FILE);
+	if (IS_ERR(cdev)) {
+		printf("zstd_seekable_cdev_create: %pe\n", cdev);
+		failed_tests++;
+	} else {
+		devpath = basprintf("/dev/%s", cdev->name);
+		fd = open(devpath, O_RDONLY);
+		ret = fd < 0 ? fd : pread_full(fd, buf, ZSTD_TEST_SIZE, 0);
+		if (ret != ZSTD_TEST_SIZE || memcmp(buf, corpus, ZSTD_TEST_SIZE)) {
+			printf("read from %s failed: %zd\n", devpath, ret);
+			failed_tests++;
+		}
+		if (fd >= 0)
+			close(fd);
+		free(devpath);
+
+		total_tests++;
+		if (zstd_seekable_cdev_remove(cdev)) {
+			printf("zstd_seekable_cdev_remove failed\n");
+			failed_tests++;
+		}
+	}
+
+	/* a corrupted frame is caught by the seek table checksum */
+	memcpy(image, zstd_seekable_test, size);
+	image[size - 9 - 1] ^= 1;	/* checksum of the last frame */
+	write_file(ZSTD_TEST_FILE, image, size);
+
+	fd = open(ZSTD_TEST_FILE, O_RDONLY);
+	if (WARN_ON(fd < 0))
+		goto out_unlink;
+
+	total_tests++;
+	zs = zstd_seekable_open(fd);
+	if (IS_ERR(zs) || zstd_seekable_read(zs, buf, 1, 0) != 1 ||
+	    zstd_seekable_read(zs, buf, 1, ZSTD_TEST_SIZE - 1) != -EILSEQ) {
+		printf("corrupted checksum not detected\n");
+		failed_tests++;
+	}
+	if (!IS_ERR(zs))
+		zstd_seekable_close(zs);
+	close(fd);
+
+	/* without the seek table */
+	write_file(ZSTD_TEST_FILE, zstd_seekable_test, size - 1);
+
+	fd = open(ZSTD_TEST_FILE, O_RDONLY);
+	if (WARN_ON(fd < 0))
+		goto out_unlink;
+
+	total_tests++;
+	zs = zstd_seekable_open(fd);
+	if (PTR_ERR(zs) != -EINVAL) {
+		printf("missing seek table not detected\n");
+		failed_tests++;
+	}
+	if (!IS_ERR(zs))
+		zstd_seekable_close(zs);
+	close(fd);
+
+out_unlink:
+	unlink(ZSTD_TEST_FILE);
+out:
+	free(corpus);
+	free(buf);
+	free(image);
+}
+bselftest(core, test_zstd_seekable);